@@ -0,0 +1,309 @@
+//! NVPrime Microbenchmarks
+//!
+//! `zig build bench` runs every case and prints one JSON document with
+//! per-operation latency percentiles on stdout:
+//!
+//!   zig build bench -Doptimize=ReleaseFast -- [filter] > results.json
+//!
+//! Built with -Dnvml=false, NVML is replaced by bench/nvml_mock.zig so the
+//! numbers cover nvprime's own overhead; with the driver they include NVML
+//! and can be compared across driver versions (see "driver_version").
+
+const std = @import("std");
+const nvprime = @import("nvprime");
+
+const frame_pacing = nvprime.nvruntime.primetime.frame_pacing;
+const nvstream = nvprime.nvruntime.nvstream;
+const sampler = nvprime.nvmon.sampler;
+
+// C API, resolved from the bench build of libnvprime
+extern fn nvprime_init() c_int;
+extern fn nvprime_shutdown() void;
+extern fn nvprime_sampler_start(interval_ms: u32, field_mask: u64) c_int;
+extern fn nvprime_sampler_stop() void;
+extern fn nvprime_get_gpu_temperature(index: u32) c_int;
+extern fn nvprime_get_gpu_power_usage(index: u32) c_int;
+extern fn nvprime_get_gpu_clock(index: u32) c_int;
+extern fn nvprime_get_mem_clock(index: u32) c_int;
+extern fn nvprime_get_pstate(index: u32) c_int;
+extern fn nvprime_core_get_gpu_utilization(index: u32) c_int;
+extern fn nvprime_core_get_sm_clock(index: u32) c_int;
+extern fn nvprime_power_get_temperature(index: u32) c_int;
+extern fn nvprime_power_get_fan_speed(index: u32) c_int;
+
+const CGetter = struct {
+    name: []const u8,
+    call: *const fn (u32) callconv(.c) c_int,
+};
+
+const c_getters = [_]CGetter{
+    .{ .name = "get_gpu_temperature", .call = nvprime_get_gpu_temperature },
+    .{ .name = "get_gpu_power_usage", .call = nvprime_get_gpu_power_usage },
+    .{ .name = "get_gpu_clock", .call = nvprime_get_gpu_clock },
+    .{ .name = "get_mem_clock", .call = nvprime_get_mem_clock },
+    .{ .name = "get_pstate", .call = nvprime_get_pstate },
+    .{ .name = "core_get_gpu_utilization", .call = nvprime_core_get_gpu_utilization },
+    .{ .name = "core_get_sm_clock", .call = nvprime_core_get_sm_clock },
+    .{ .name = "power_get_temperature", .call = nvprime_power_get_temperature },
+    .{ .name = "power_get_fan_speed", .call = nvprime_power_get_fan_speed },
+};
+
+/// Timed samples per case; each sample times `batch` operations
+const default_samples = 2000;
+
+/// Latency distribution of one case, per operation
+const Result = struct {
+    name: []const u8,
+    samples: usize,
+    batch: u32,
+    p50_ns: f64,
+    p99_ns: f64,
+    mean_ns: f64,
+    max_ns: f64,
+};
+
+const Suite = struct {
+    filter: ?[]const u8,
+    buf: [default_samples]f64 = undefined,
+    results: [64]Result = undefined,
+    names: [64][64]u8 = undefined,
+    count: usize = 0,
+
+    fn enabled(self: *const Suite, name: []const u8) bool {
+        const filter = self.filter orelse return true;
+        return std.mem.indexOf(u8, name, filter) != null;
+    }
+
+    fn add(self: *Suite, name: []const u8, result: Result) void {
+        if (self.count == self.results.len) return;
+        const len = @min(name.len, self.names[self.count].len);
+        @memcpy(self.names[self.count][0..len], name[0..len]);
+        var stored = result;
+        stored.name = self.names[self.count][0..len];
+        self.results[self.count] = stored;
+        self.count += 1;
+    }
+
+    /// Time `op(context)` in batches and record the per-operation distribution
+    fn measure(self: *Suite, name: []const u8, samples: usize, batch: u32, context: anytype, comptime op: fn (@TypeOf(context)) void) void {
+        if (!self.enabled(name)) return;
+        const n = @min(samples, self.buf.len);
+        for (0..batch) |_| op(context); // warm up
+
+        for (self.buf[0..n]) |*sample| {
+            var timer = std.time.Timer.start() catch return;
+            for (0..batch) |_| op(context);
+            sample.* = @as(f64, @floatFromInt(timer.read())) / @as(f64, @floatFromInt(batch));
+        }
+        self.add(name, summarize(self.buf[0..n], batch));
+    }
+
+    fn write(self: *const Suite, out: *std.Io.Writer, driver_version: []const u8) !void {
+        try out.print("{{\n  \"nvprime\": \"{s}\",\n  \"driver_version\": \"{s}\",\n  \"optimize\": \"{s}\",\n  \"cases\": [\n", .{
+            nvprime.version.string,
+            driver_version,
+            @tagName(@import("builtin").mode),
+        });
+        for (self.results[0..self.count], 0..) |r, i| {
+            try out.print("    {{ \"name\": \"{s}\", \"samples\": {d}, \"batch\": {d}, \"p50_ns\": {d:.1}, \"p99_ns\": {d:.1}, \"mean_ns\": {d:.1}, \"max_ns\": {d:.1} }}{s}\n", .{
+                r.name,
+                r.samples,
+                r.batch,
+                r.p50_ns,
+                r.p99_ns,
+                r.mean_ns,
+                r.max_ns,
+                if (i + 1 < self.count) "," else "",
+            });
+        }
+        try out.writeAll("  ]\n}\n");
+    }
+};
+
+fn summarize(samples: []f64, batch: u32) Result {
+    std.mem.sort(f64, samples, {}, std.sort.asc(f64));
+    var sum: f64 = 0;
+    for (samples) |s| sum += s;
+    const last = samples.len - 1;
+    return .{
+        .name = "",
+        .samples = samples.len,
+        .batch = batch,
+        .p50_ns = samples[last / 2],
+        .p99_ns = samples[last * 99 / 100],
+        .mean_ns = sum / @as(f64, @floatFromInt(samples.len)),
+        .max_ns = samples[last],
+    };
+}
+
+// ============================================================================
+// Cases
+// ============================================================================
+
+fn benchCApi(suite: *Suite) void {
+    if (nvprime_init() != 0) return;
+    defer nvprime_shutdown();
+
+    var name_buf: [64]u8 = undefined;
+    // Direct NVML first, then served from the background sampler's cache
+    inline for (.{ "nvml", "cached" }) |mode| {
+        const cached = comptime std.mem.eql(u8, mode, "cached");
+        if (cached and nvprime_sampler_start(10, std.math.maxInt(u64)) != 0) return;
+        if (cached) std.Thread.sleep(50 * std.time.ns_per_ms);
+        defer if (cached) nvprime_sampler_stop();
+
+        for (c_getters) |getter| {
+            const name = std.fmt.bufPrint(&name_buf, "capi.{s}.{s}", .{ getter.name, mode }) catch continue;
+            suite.measure(name, default_samples, if (cached) 64 else 4, getter.call, callGetter);
+        }
+    }
+}
+
+fn callGetter(call: *const fn (u32) callconv(.c) c_int) void {
+    std.mem.doNotOptimizeAway(call(0));
+}
+
+fn benchSampler(suite: *Suite) void {
+    if (!suite.enabled("sampler.latest")) return;
+    nvprime.nvml.init() catch return;
+    defer nvprime.nvml.shutdown();
+    nvprime.nvcaps.init() catch return;
+    defer nvprime.nvcaps.deinit();
+
+    sampler.start(.{ .interval_ms = 10 }) catch return;
+    defer sampler.stop();
+    // Wait for the first pass to publish
+    var waited: u32 = 0;
+    while (sampler.latest(0) == null and waited < 100) : (waited += 1) std.Thread.sleep(std.time.ns_per_ms);
+
+    suite.measure("sampler.latest", default_samples, 256, @as(u32, 0), readLatest);
+}
+
+fn readLatest(index: u32) void {
+    std.mem.doNotOptimizeAway(sampler.latest(index));
+}
+
+const Window = frame_pacing.RollingStats(300);
+
+const WindowContext = struct {
+    stats: *Window,
+    inputs: *const [1024]f32,
+    next: *usize,
+};
+
+fn pushWindow(ctx: WindowContext) void {
+    ctx.stats.push(ctx.inputs[ctx.next.* & 1023]);
+    ctx.next.* +%= 1;
+}
+
+fn percentileWindow(stats: *const Window) void {
+    std.mem.doNotOptimizeAway(stats.percentile(99));
+}
+
+fn benchRollingStats(suite: *Suite) void {
+    // Frame times around 6.9 ms (144 Hz) with occasional hitches
+    var inputs: [1024]f32 = undefined;
+    var prng = std.Random.DefaultPrng.init(0x6e767072);
+    const random = prng.random();
+    for (&inputs) |*v| {
+        v.* = 6.9 + random.floatNorm(f32) * 0.3;
+        if (random.uintLessThan(u32, 100) == 0) v.* *= 3;
+    }
+
+    var stats: Window = .{};
+    var next: usize = 0;
+    const ctx = WindowContext{ .stats = &stats, .inputs = &inputs, .next = &next };
+    suite.measure("rolling_stats.push", default_samples, 256, ctx, pushWindow);
+    suite.measure("rolling_stats.percentile", default_samples, 64, @as(*const Window, &stats), percentileWindow);
+}
+
+fn benchDeadlineJitter(suite: *Suite) void {
+    const period_ns = std.time.ns_per_s / 240;
+    const iterations = 480; // two seconds at 240 Hz
+    inline for (.{ frame_pacing.WaitStrategy.sleep, frame_pacing.WaitStrategy.hybrid }) |strategy| {
+        const name = "frame_pacer.deadline_jitter." ++ @tagName(strategy);
+        if (suite.enabled(name)) {
+            const report = frame_pacing.measureDeadlineJitter(strategy, period_ns, iterations);
+            suite.add(name, .{
+                .name = name,
+                .samples = iterations,
+                .batch = 1,
+                .p50_ns = report.p50_us * std.time.ns_per_us,
+                .p99_ns = report.p99_us * std.time.ns_per_us,
+                .mean_ns = report.mean_us * std.time.ns_per_us,
+                .max_ns = report.max_us * std.time.ns_per_us,
+            });
+        }
+    }
+}
+
+const CurveContext = struct {
+    curve: *const nvprime.nvpower.fans.FanCurve,
+    temp: *u32,
+};
+
+fn curveLookup(ctx: CurveContext) void {
+    ctx.temp.* = if (ctx.temp.* >= 95) 30 else ctx.temp.* + 1;
+    std.mem.doNotOptimizeAway(ctx.curve.getSpeedAt(ctx.temp.*));
+}
+
+fn benchFanCurve(suite: *Suite) void {
+    const curve = nvprime.nvpower.fans.FanPreset.balanced.getCurve();
+    var temp: u32 = 30;
+    suite.measure("fan_curve.get_speed_at", default_samples, 256, CurveContext{ .curve = &curve, .temp = &temp }, curveLookup);
+}
+
+fn processFrame(engine: *nvstream.StreamEngine) void {
+    engine.processFrame() catch {};
+}
+
+fn benchStream(suite: *Suite, allocator: std.mem.Allocator) void {
+    const name = "nvstream.capture_encode_send";
+    if (!suite.enabled(name)) return;
+
+    // Packets go to a local socket nobody reads; the kernel drops the overflow
+    const sink = std.posix.socket(std.posix.AF.INET, std.posix.SOCK.DGRAM, 0) catch return;
+    defer std.posix.close(sink);
+    var addr = std.net.Address.initIp4(.{ 127, 0, 0, 1 }, 0);
+    std.posix.bind(sink, &addr.any, addr.getOsSockLen()) catch return;
+    var len = addr.getOsSockLen();
+    std.posix.getsockname(sink, &addr.any, &len) catch return;
+
+    const engine = nvstream.StreamEngine.init(allocator, .{ .pipelined = false, .adaptive_bitrate = false }) catch return;
+    defer engine.deinit();
+    engine.start("127.0.0.1", addr.getPort()) catch return;
+
+    suite.measure(name, 300, 1, engine, processFrame);
+}
+
+pub fn main() !void {
+    var gpa = std.heap.GeneralPurposeAllocator(.{}){};
+    defer _ = gpa.deinit();
+    const allocator = gpa.allocator();
+
+    var args = try std.process.argsWithAllocator(allocator);
+    defer args.deinit();
+    _ = args.next();
+
+    // Measure in-process NVML/sampler paths even if a daemon is running
+    _ = std.c.setenv("NVPRIME_NO_DAEMON", "1", 1);
+
+    var suite = Suite{ .filter = args.next() };
+    benchCApi(&suite);
+    benchSampler(&suite);
+    benchRollingStats(&suite);
+    benchDeadlineJitter(&suite);
+    benchFanCurve(&suite);
+    benchStream(&suite, allocator);
+
+    var driver_buf: [80]u8 = [_]u8{0} ** 80;
+    if (nvprime.nvml.init()) {
+        driver_buf = nvprime.nvml.getDriverVersion() catch driver_buf;
+        nvprime.nvml.shutdown();
+    } else |_| {}
+
+    var stdout_buf: [4096]u8 = undefined;
+    var stdout = std.fs.File.stdout().writer(&stdout_buf);
+    try suite.write(&stdout.interface, std.mem.sliceTo(&driver_buf, 0));
+    try stdout.interface.flush();
+}
@@ -0,0 +1,418 @@
+//! NVML mock for benchmarks
+//!
+//! Exports the libnvidia-ml entry points nvprime binds to, answering from
+//! constant tables without touching the driver. `zig build bench` links it
+//! in place of libnvidia-ml when built with -Dnvml=false, so results measure
+//! nvprime's own overhead and stay comparable between machines.
+//!
+//! Two GPUs are reported. The power limit and clock offsets are remembered
+//! and range-checked like the driver does, so module tests can drive a
+//! tuning rollback; other control calls succeed without effect. NVLink and
+//! events return NVML_ERROR_NOT_SUPPORTED.
+
+const std = @import("std");
+const c = @cImport({
+    @cInclude("nvml.h");
+});
+
+const device_count = 2;
+
+const MockGpu = struct {
+    name: []const u8,
+    uuid: []const u8,
+    bus: u32,
+    vram_total_mb: u64,
+    compute_major: c_int,
+    compute_minor: c_int,
+    temperature_c: c_uint,
+    power_mw: c_uint,
+    power_limit_mw: c_uint,
+    gpu_clock_mhz: c_uint,
+    mem_clock_mhz: c_uint,
+};
+
+const gpus = [device_count]MockGpu{
+    .{
+        .name = "NVIDIA GeForce RTX 4090 (mock)",
+        .uuid = "GPU-00000000-0000-0000-0000-000000000000",
+        .bus = 0x01,
+        .vram_total_mb = 24564,
+        .compute_major = 8,
+        .compute_minor = 9,
+        .temperature_c = 62,
+        .power_mw = 285_000,
+        .power_limit_mw = 450_000,
+        .gpu_clock_mhz = 2520,
+        .mem_clock_mhz = 10501,
+    },
+    .{
+        .name = "NVIDIA GeForce RTX 3060 (mock)",
+        .uuid = "GPU-00000000-0000-0000-0000-000000000001",
+        .bus = 0x41,
+        .vram_total_mb = 12288,
+        .compute_major = 8,
+        .compute_minor = 6,
+        .temperature_c = 48,
+        .power_mw = 35_000,
+        .power_limit_mw = 170_000,
+        .gpu_clock_mhz = 210,
+        .mem_clock_mhz = 405,
+    },
+};
+
+/// Handles are pointers into this array
+var handles: [device_count]u8 = .{ 0, 0 };
+
+/// Offsets the mock accepts, in MHz
+const max_gpc_offset_mhz = 1000;
+const max_mem_offset_mhz = 3000;
+
+/// Settable state, starting at the board defaults
+var power_limits_mw: [device_count]c_uint = .{ gpus[0].power_limit_mw, gpus[1].power_limit_mw };
+var gpc_offsets_mhz: [device_count]c_int = .{ 0, 0 };
+var mem_offsets_mhz: [device_count]c_int = .{ 0, 0 };
+
+fn indexOf(device: c.nvmlDevice_t) ?usize {
+    const addr = @intFromPtr(device);
+    const base = @intFromPtr(&handles);
+    if (addr < base or addr >= base + device_count) return null;
+    return addr - base;
+}
+
+fn gpuOf(device: c.nvmlDevice_t) ?*const MockGpu {
+    return &gpus[indexOf(device) orelse return null];
+}
+
+fn copyString(src: []const u8, dst: [*c]u8, len: c_uint) c.nvmlReturn_t {
+    if (len <= src.len) return c.NVML_ERROR_INSUFFICIENT_SIZE;
+    @memcpy(dst[0..src.len], src);
+    dst[src.len] = 0;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlInit_v2() c.nvmlReturn_t {
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlShutdown() c.nvmlReturn_t {
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlSystemGetDriverVersion(version: [*c]u8, len: c_uint) c.nvmlReturn_t {
+    return copyString("mock", version, len);
+}
+
+export fn nvmlSystemGetNVMLVersion(version: [*c]u8, len: c_uint) c.nvmlReturn_t {
+    return copyString("mock", version, len);
+}
+
+export fn nvmlDeviceGetCount_v2(count: [*c]c_uint) c.nvmlReturn_t {
+    count.* = device_count;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetHandleByIndex_v2(index: c_uint, device: [*c]c.nvmlDevice_t) c.nvmlReturn_t {
+    if (index >= device_count) return c.NVML_ERROR_INVALID_ARGUMENT;
+    device.* = @ptrCast(&handles[index]);
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetName(device: c.nvmlDevice_t, name: [*c]u8, len: c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return copyString(gpu.name, name, len);
+}
+
+export fn nvmlDeviceGetUUID(device: c.nvmlDevice_t, uuid: [*c]u8, len: c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return copyString(gpu.uuid, uuid, len);
+}
+
+export fn nvmlDeviceGetPciInfo_v3(device: c.nvmlDevice_t, pci: [*c]c.nvmlPciInfo_t) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    pci.* = std.mem.zeroes(c.nvmlPciInfo_t);
+    pci.*.domain = 0;
+    pci.*.bus = gpu.bus;
+    pci.*.device = 0;
+    pci.*.pciDeviceId = 0x268410de;
+    _ = std.fmt.bufPrint(&pci.*.busId, "00000000:{X:0>2}:00.0", .{gpu.bus}) catch {};
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetMaxPcieLinkGeneration(device: c.nvmlDevice_t, gen: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    gen.* = 4;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetMaxPcieLinkWidth(device: c.nvmlDevice_t, width: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    width.* = 16;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetMemoryInfo(device: c.nvmlDevice_t, memory: [*c]c.nvmlMemory_t) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    const total = gpu.vram_total_mb * 1024 * 1024;
+    memory.*.total = total;
+    memory.*.used = total / 4;
+    memory.*.free = total - total / 4;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetUtilizationRates(device: c.nvmlDevice_t, util: [*c]c.nvmlUtilization_t) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    util.*.gpu = 87;
+    util.*.memory = 41;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetClockInfo(device: c.nvmlDevice_t, clock_type: c.nvmlClockType_t, clock: [*c]c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    clock.* = switch (clock_type) {
+        c.NVML_CLOCK_MEM => gpu.mem_clock_mhz,
+        c.NVML_CLOCK_VIDEO => gpu.gpu_clock_mhz * 4 / 5,
+        else => gpu.gpu_clock_mhz,
+    };
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetMaxClockInfo(device: c.nvmlDevice_t, clock_type: c.nvmlClockType_t, clock: [*c]c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    clock.* = if (clock_type == c.NVML_CLOCK_MEM) gpu.mem_clock_mhz else 3105;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetPerformanceState(device: c.nvmlDevice_t, pstate: [*c]c.nvmlPstates_t) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    pstate.* = c.NVML_PSTATE_0;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetTemperature(device: c.nvmlDevice_t, sensor: c.nvmlTemperatureSensors_t, temp: [*c]c_uint) c.nvmlReturn_t {
+    _ = sensor;
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    temp.* = gpu.temperature_c;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetTemperatureThreshold(device: c.nvmlDevice_t, threshold: c.nvmlTemperatureThresholds_t, temp: [*c]c_uint) c.nvmlReturn_t {
+    _ = threshold;
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    temp.* = 87;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetPowerUsage(device: c.nvmlDevice_t, power: [*c]c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    power.* = gpu.power_mw;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetPowerManagementLimit(device: c.nvmlDevice_t, limit: [*c]c_uint) c.nvmlReturn_t {
+    const index = indexOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    limit.* = power_limits_mw[index];
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetPowerManagementDefaultLimit(device: c.nvmlDevice_t, limit: [*c]c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    limit.* = gpu.power_limit_mw;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetPowerManagementLimitConstraints(device: c.nvmlDevice_t, min: [*c]c_uint, max: [*c]c_uint) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    min.* = gpu.power_limit_mw / 2;
+    max.* = gpu.power_limit_mw * 11 / 10;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceSetPowerManagementLimit(device: c.nvmlDevice_t, limit: c_uint) c.nvmlReturn_t {
+    const index = indexOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    const default = gpus[index].power_limit_mw;
+    if (limit < default / 2 or limit > default * 11 / 10) return c.NVML_ERROR_INVALID_ARGUMENT;
+    power_limits_mw[index] = limit;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceSetGpuLockedClocks(device: c.nvmlDevice_t, min: c_uint, max: c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return if (min <= max) c.NVML_SUCCESS else c.NVML_ERROR_INVALID_ARGUMENT;
+}
+
+export fn nvmlDeviceResetGpuLockedClocks(device: c.nvmlDevice_t) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceSetMemoryLockedClocks(device: c.nvmlDevice_t, min: c_uint, max: c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return if (min <= max) c.NVML_SUCCESS else c.NVML_ERROR_INVALID_ARGUMENT;
+}
+
+export fn nvmlDeviceResetMemoryLockedClocks(device: c.nvmlDevice_t) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetGpcClkVfOffset(device: c.nvmlDevice_t, offset: [*c]c_int) c.nvmlReturn_t {
+    const index = indexOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    offset.* = gpc_offsets_mhz[index];
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceSetGpcClkVfOffset(device: c.nvmlDevice_t, offset: c_int) c.nvmlReturn_t {
+    const index = indexOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    if (@abs(offset) > max_gpc_offset_mhz) return c.NVML_ERROR_INVALID_ARGUMENT;
+    gpc_offsets_mhz[index] = offset;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetMemClkVfOffset(device: c.nvmlDevice_t, offset: [*c]c_int) c.nvmlReturn_t {
+    const index = indexOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    offset.* = mem_offsets_mhz[index];
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceSetMemClkVfOffset(device: c.nvmlDevice_t, offset: c_int) c.nvmlReturn_t {
+    const index = indexOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    if (@abs(offset) > max_mem_offset_mhz) return c.NVML_ERROR_INVALID_ARGUMENT;
+    mem_offsets_mhz[index] = offset;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetFanSpeed(device: c.nvmlDevice_t, speed: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    speed.* = 45;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetNumFans(device: c.nvmlDevice_t, count: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    count.* = 2;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetFanSpeed_v2(device: c.nvmlDevice_t, fan: c_uint, speed: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    if (fan >= 2) return c.NVML_ERROR_INVALID_ARGUMENT;
+    speed.* = 45;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetMinMaxFanSpeed(device: c.nvmlDevice_t, min: [*c]c_uint, max: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    min.* = 30;
+    max.* = 100;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceSetFanSpeed_v2(device: c.nvmlDevice_t, fan: c_uint, speed: c_uint) c.nvmlReturn_t {
+    _ = speed;
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return if (fan < 2) c.NVML_SUCCESS else c.NVML_ERROR_INVALID_ARGUMENT;
+}
+
+export fn nvmlDeviceSetDefaultFanSpeed_v2(device: c.nvmlDevice_t, fan: c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    return if (fan < 2) c.NVML_SUCCESS else c.NVML_ERROR_INVALID_ARGUMENT;
+}
+
+export fn nvmlDeviceGetEncoderStats(device: c.nvmlDevice_t, sessions: [*c]c_uint, fps: [*c]c_uint, latency: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    sessions.* = 0;
+    fps.* = 0;
+    latency.* = 0;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetEncoderUtilization(device: c.nvmlDevice_t, utilization: [*c]c_uint, period_us: [*c]c_uint) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    utilization.* = 0;
+    period_us.* = 167_000;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetTopologyCommonAncestor(a: c.nvmlDevice_t, b: c.nvmlDevice_t, level: [*c]c.nvmlGpuTopologyLevel_t) c.nvmlReturn_t {
+    _ = gpuOf(a) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    _ = gpuOf(b) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    level.* = if (a == b) c.NVML_TOPOLOGY_INTERNAL else c.NVML_TOPOLOGY_HOSTBRIDGE;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetNvLinkState(device: c.nvmlDevice_t, link: c_uint, state: [*c]c.nvmlEnableState_t) c.nvmlReturn_t {
+    _ = device;
+    _ = link;
+    _ = state;
+    return c.NVML_ERROR_NOT_SUPPORTED;
+}
+
+export fn nvmlDeviceGetNvLinkRemotePciInfo_v2(device: c.nvmlDevice_t, link: c_uint, pci: [*c]c.nvmlPciInfo_t) c.nvmlReturn_t {
+    _ = device;
+    _ = link;
+    _ = pci;
+    return c.NVML_ERROR_NOT_SUPPORTED;
+}
+
+export fn nvmlDeviceGetFieldValues(device: c.nvmlDevice_t, count: c_int, values: [*c]c.nvmlFieldValue_t) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    for (values[0..@intCast(count)]) |*value| {
+        value.valueType = c.NVML_VALUE_TYPE_UNSIGNED_INT;
+        value.nvmlReturn = c.NVML_SUCCESS;
+        switch (value.fieldId) {
+            c.NVML_FI_DEV_POWER_INSTANT => value.value.uiVal = gpu.power_mw,
+            c.NVML_FI_DEV_MEMORY_TEMP => value.value.uiVal = gpu.temperature_c + 8,
+            else => value.nvmlReturn = c.NVML_ERROR_NOT_SUPPORTED,
+        }
+    }
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetCurrentClocksThrottleReasons(device: c.nvmlDevice_t, reasons: [*c]c_ulonglong) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    reasons.* = 0;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetSupportedEventTypes(device: c.nvmlDevice_t, types: [*c]c_ulonglong) c.nvmlReturn_t {
+    _ = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    types.* = 0;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlEventSetCreate(set: [*c]c.nvmlEventSet_t) c.nvmlReturn_t {
+    _ = set;
+    return c.NVML_ERROR_NOT_SUPPORTED;
+}
+
+export fn nvmlEventSetFree(set: c.nvmlEventSet_t) c.nvmlReturn_t {
+    _ = set;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceRegisterEvents(device: c.nvmlDevice_t, types: c_ulonglong, set: c.nvmlEventSet_t) c.nvmlReturn_t {
+    _ = device;
+    _ = types;
+    _ = set;
+    return c.NVML_ERROR_NOT_SUPPORTED;
+}
+
+export fn nvmlEventSetWait_v2(set: c.nvmlEventSet_t, data: [*c]c.nvmlEventData_t, timeout_ms: c_uint) c.nvmlReturn_t {
+    _ = set;
+    _ = data;
+    _ = timeout_ms;
+    return c.NVML_ERROR_NOT_SUPPORTED;
+}
+
+export fn nvmlDeviceGetCudaComputeCapability(device: c.nvmlDevice_t, major: [*c]c_int, minor: [*c]c_int) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    major.* = gpu.compute_major;
+    minor.* = gpu.compute_minor;
+    return c.NVML_SUCCESS;
+}
+
+export fn nvmlDeviceGetArchitecture(device: c.nvmlDevice_t, arch: [*c]c.nvmlDeviceArchitecture_t) c.nvmlReturn_t {
+    const gpu = gpuOf(device) orelse return c.NVML_ERROR_INVALID_ARGUMENT;
+    arch.* = if (gpu.compute_minor == 9) c.NVML_DEVICE_ARCH_ADA else c.NVML_DEVICE_ARCH_AMPERE;
+    return c.NVML_SUCCESS;
+}
@@ -8,6 +8,17 @@ pub fn build(b: *std.Build) void {
     const use_nvml = b.option(bool, "nvml", "Link against NVML (requires NVIDIA driver)") orelse true;
     // Option to build with DRM/wlroots for compositor
     const use_drm = b.option(bool, "drm", "Link against libdrm for compositor") orelse false;
+    // Option to compile in hot-path tracing (nvmon.trace)
+    const use_trace = b.option(bool, "trace", "Record spans and counters for Chrome/Perfetto trace export") orelse false;
+    // NVML headers, needed to compile even when linking the bench mock
+    const nvml_include = b.option([]const u8, "nvml-include", "Directory containing nvml.h") orelse "/opt/cuda/targets/x86_64-linux/include";
+
+    const build_options = b.addOptions();
+    build_options.addOption(bool, "trace", use_trace);
+    // primetime's DRM backend uses libdrm instead of its stubs
+    build_options.addOption(bool, "drm_enabled", use_drm);
+    // Module tests that need settable NVML state run only against the mock
+    build_options.addOption(bool, "nvml_mock", !use_nvml);
 
     // Fetch external dependencies
     const nvvk_dep = b.dependency("nvvk", .{
@@ -39,27 +50,33 @@ pub fn build(b: *std.Build) void {
         .optimize = optimize,
     });
 
+    const mod_imports = [_]std.Build.Module.Import{
+        .{ .name = "nvvk", .module = nvvk_dep.module("nvvk") },
+        .{ .name = "nvhud", .module = nvhud_dep.module("nvhud") },
+        .{ .name = "nvlatency", .module = nvlatency_dep.module("nvlatency") },
+        .{ .name = "nvsync", .module = nvsync_dep.module("nvsync") },
+        .{ .name = "nvshader", .module = nvshader_dep.module("nvshader") },
+        .{ .name = "zeus", .module = zeus_dep.module("zeus") },
+        .{ .name = "ghostvk", .module = ghostvk_dep.module("ghostVK") },
+    };
+
     // Create the nvprime module
     const mod = b.addModule("nvprime", .{
         .root_source_file = b.path("src/root.zig"),
         .target = target,
         .optimize = optimize,
-        .imports = &.{
-            .{ .name = "nvvk", .module = nvvk_dep.module("nvvk") },
-            .{ .name = "nvhud", .module = nvhud_dep.module("nvhud") },
-            .{ .name = "nvlatency", .module = nvlatency_dep.module("nvlatency") },
-            .{ .name = "nvsync", .module = nvsync_dep.module("nvsync") },
-            .{ .name = "nvshader", .module = nvshader_dep.module("nvshader") },
-            .{ .name = "zeus", .module = zeus_dep.module("zeus") },
-            .{ .name = "ghostvk", .module = ghostvk_dep.module("ghostVK") },
-        },
+        .imports = &mod_imports,
     });
 
+    mod.addOptions("build_options", build_options);
+    // The field table's test checks the C header against it
+    mod.addAnonymousImport("nvprime.h", .{ .root_source_file = b.path("include/nvprime.h") });
+
     // Link NVML to module (libc required for NVML's internal dependencies)
     if (use_nvml) {
         mod.linkSystemLibrary("nvidia-ml", .{});
         mod.linkSystemLibrary("c", .{});
-        mod.addIncludePath(.{ .cwd_relative = "/opt/cuda/targets/x86_64-linux/include" });
+        mod.addIncludePath(.{ .cwd_relative = nvml_include });
     }
 
     // Link DRM for compositor functionality
@@ -84,7 +101,7 @@ pub fn build(b: *std.Build) void {
     if (use_nvml) {
         exe.linkSystemLibrary("nvidia-ml");
         exe.linkLibC();
-        exe.root_module.addIncludePath(.{ .cwd_relative = "/opt/cuda/targets/x86_64-linux/include" });
+        exe.root_module.addIncludePath(.{ .cwd_relative = nvml_include });
     }
 
     // Install the executable
@@ -107,7 +124,7 @@ pub fn build(b: *std.Build) void {
     if (use_nvml) {
         lib.linkSystemLibrary("nvidia-ml");
         lib.linkLibC();
-        lib.root_module.addIncludePath(.{ .cwd_relative = "/opt/cuda/targets/x86_64-linux/include" });
+        lib.root_module.addIncludePath(.{ .cwd_relative = nvml_include });
     }
 
     b.installArtifact(lib);
@@ -125,12 +142,50 @@ pub fn build(b: *std.Build) void {
         run_cmd.addArgs(args);
     }
 
+    // With -Dnvml=false a mock libnvidia-ml stands in for the module tests
+    // and the microbenchmarks, so both run without an NVIDIA driver or GPU;
+    // nvml.h (-Dnvml-include) is still needed to compile. They get their
+    // own nvprime module so the mock's include path stays off the exported
+    // one.
+    const mock_mod = if (use_nvml) mod else blk: {
+        const m = b.createModule(.{
+            .root_source_file = b.path("src/root.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &mod_imports,
+        });
+        m.addOptions("build_options", build_options);
+        m.addAnonymousImport("nvprime.h", .{ .root_source_file = b.path("include/nvprime.h") });
+        m.addIncludePath(.{ .cwd_relative = nvml_include });
+        if (use_drm) {
+            m.linkSystemLibrary("drm", .{});
+            m.linkSystemLibrary("c", .{});
+        }
+        break :blk m;
+    };
+    const nvml_mock = if (use_nvml) null else blk: {
+        const m = b.addLibrary(.{
+            .linkage = .dynamic,
+            .name = "nvidia-ml-mock",
+            .root_module = b.createModule(.{
+                .root_source_file = b.path("bench/nvml_mock.zig"),
+                .target = target,
+                .optimize = optimize,
+            }),
+        });
+        m.root_module.addIncludePath(.{ .cwd_relative = nvml_include });
+        break :blk m;
+    };
+
     // Test step for the module
     const mod_tests = b.addTest(.{
-        .root_module = mod,
+        .root_module = mock_mod,
     });
 
-    if (use_nvml) {
+    if (nvml_mock) |mock| {
+        mod_tests.linkLibrary(mock);
+        mod_tests.linkLibC();
+    } else {
         mod_tests.linkSystemLibrary("nvidia-ml");
         mod_tests.linkLibC();
     }
@@ -144,16 +199,19 @@ pub fn build(b: *std.Build) void {
             .target = target,
             .optimize = optimize,
             .imports = &.{
-                .{ .name = "nvprime", .module = mod },
+                .{ .name = "nvprime", .module = mock_mod },
             },
         }),
     });
 
-    if (use_nvml) {
+    if (nvml_mock) |mock| {
+        exe_tests.linkLibrary(mock);
+        exe_tests.linkLibC();
+    } else {
         exe_tests.linkSystemLibrary("nvidia-ml");
         exe_tests.linkLibC();
-        exe_tests.root_module.addIncludePath(.{ .cwd_relative = "/opt/cuda/targets/x86_64-linux/include" });
     }
+    exe_tests.root_module.addIncludePath(.{ .cwd_relative = nvml_include });
 
     const run_exe_tests = b.addRunArtifact(exe_tests);
 
@@ -162,6 +220,49 @@ pub fn build(b: *std.Build) void {
     test_step.dependOn(&run_mod_tests.step);
     test_step.dependOn(&run_exe_tests.step);
 
+    // Microbenchmarks (zig build bench)
+    const bench_capi = b.addLibrary(.{
+        .linkage = .dynamic,
+        .name = "nvprime-bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("src/capi/capi.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "nvprime", .module = mock_mod },
+            },
+        }),
+    });
+    const bench_exe = b.addExecutable(.{
+        .name = "nvprime-bench",
+        .root_module = b.createModule(.{
+            .root_source_file = b.path("bench/bench.zig"),
+            .target = target,
+            .optimize = optimize,
+            .imports = &.{
+                .{ .name = "nvprime", .module = mock_mod },
+            },
+        }),
+    });
+    bench_exe.linkLibrary(bench_capi);
+    bench_exe.linkLibC();
+
+    if (nvml_mock) |mock| {
+        bench_capi.linkLibrary(mock);
+        bench_exe.linkLibrary(mock);
+    } else {
+        bench_capi.linkSystemLibrary("nvidia-ml");
+        bench_capi.linkLibC();
+        bench_exe.linkSystemLibrary("nvidia-ml");
+    }
+
+    const run_bench = b.addRunArtifact(bench_exe);
+    if (b.args) |args| {
+        run_bench.addArgs(args);
+    }
+    const bench_step = b.step("bench", "Run microbenchmarks (JSON on stdout)");
+    bench_step.dependOn(&run_bench.step);
+
     // Check step (compile without running)
     const check_step = b.step("check", "Check if the code compiles");
     check_step.dependOn(&exe.step);
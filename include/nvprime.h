@@ -51,9 +51,9 @@ extern "C" {
  * Version
  * ============================================================================ */
 
-#define NVPRIME_VERSION "0.1.0"
+#define NVPRIME_VERSION "0.2.0"
 #define NVPRIME_VERSION_MAJOR 0
-#define NVPRIME_VERSION_MINOR 1
+#define NVPRIME_VERSION_MINOR 2
 #define NVPRIME_VERSION_PATCH 0
 
 /** Get library version string */
@@ -69,6 +69,12 @@ int nvprime_version_int(void);
 /**
  * Initialize the NVPrime library.
  * Must be called before any other nvprime functions.
+ * Resolves and caches every GPU's handle, UUID and PCI bus ID.
+ *
+ * If `nvprime daemon` is running, attaches to its shared telemetry segment
+ * instead: telemetry getters and GPU lookups are served from shared memory
+ * and NVML is only initialized if a call needs a device handle.
+ * Set NVPRIME_NO_DAEMON=1 to always initialize NVML in-process.
  * @return 0 on success, negative on error
  */
 int nvprime_init(void);
@@ -134,6 +140,28 @@ typedef struct {
 /** Get number of detected GPUs */
 int nvprime_get_gpu_count(void);
 
+/**
+ * Look up a GPU index by UUID ("GPU-...") or PCI bus ID.
+ * Bus IDs are accepted in both NVML ("00000000:01:00.0") and sysfs ("0000:01:00.0") form.
+ * @return GPU index, or -1 if not found
+ */
+int nvprime_get_gpu_index_by_uuid(const char* uuid);
+int nvprime_get_gpu_index_by_bus_id(const char* bus_id);
+
+/**
+ * Re-resolve cached device handles.
+ * Call after GPU hotplug, or once a query has failed because a GPU was lost.
+ * @return 0 on success, negative on error
+ */
+int nvprime_refresh_devices(void);
+
+/**
+ * Set how long cached dynamic state (temperature, power, clocks) is reused
+ * by nvprime_get_gpu_caps before NVML is queried again. 0 always re-reads.
+ * Static capabilities (name, features, VRAM size) are read once and cached.
+ */
+void nvprime_caps_set_staleness_ms(uint32_t ms);
+
 /** Get capabilities for a specific GPU */
 int nvprime_get_gpu_caps(uint32_t index, NvGpuCapabilities* out_caps);
 
@@ -151,6 +179,57 @@ int nvprime_get_gpu_name(uint32_t index, char* buffer, size_t buffer_size);
 uint64_t nvprime_get_vram_total(uint32_t index);
 uint64_t nvprime_get_vram_used(uint32_t index);
 
+/** Get memory (HBM/GDDR) temperature in Celsius, -1 if unsupported */
+int nvprime_get_memory_temperature(uint32_t index);
+
+/* ============================================================================
+ * GPU Placement (nvcaps)
+ * ============================================================================ */
+
+typedef enum {
+    NV_WORKLOAD_RENDER = 0,   /* Rendering; frames are shown on the display GPU */
+    NV_WORKLOAD_COMPUTE = 1,  /* Compute; only capacity matters */
+    NV_WORKLOAD_ENCODE = 2,   /* NVENC streaming or recording */
+    NV_WORKLOAD_DISPLAY = 3,  /* Compositor driving the display */
+} NvWorkloadKind;
+
+/** Allow GPUs at or past their thermal slowdown point */
+#define NV_PLACEMENT_ALLOW_THROTTLED (1u << 0)
+
+typedef struct {
+    NvWorkloadKind kind;
+    uint32_t encoder_sessions;  /* NVENC sessions the workload will open */
+    uint64_t min_free_vram_mb;  /* Skip GPUs with less free VRAM */
+    int32_t display_gpu;        /* GPU driving the display, or -1 for none */
+    uint32_t flags;             /* NV_PLACEMENT_* */
+} NvWorkloadHints;
+
+typedef struct {
+    uint32_t index;
+    float score;                /* 0 (worst) to 1 (best) */
+    uint64_t free_vram_mb;
+    uint32_t utilization;
+    int32_t thermal_headroom_c;
+    uint32_t encoder_sessions;
+    uint32_t link;              /* To the display GPU: 0 same, 1 NVLink, 2 PCIe switch,
+                                   3 host bridge, 4 NUMA node, 5 cross-socket, 6 unknown */
+} NvGpuPlacement;
+
+/**
+ * Pick the best GPU for a workload from free VRAM, utilization, thermal
+ * headroom, NVENC load and the link to the display GPU.
+ * Uses the background sampler's data when it is running.
+ * @param hints Workload description, or NULL for an unconstrained render workload
+ * @return GPU index, or -1 if no GPU qualifies
+ */
+int nvprime_select_gpu(const NvWorkloadHints* hints);
+
+/**
+ * Rank qualifying GPUs for a workload, best first.
+ * @return Number of entries written (up to max), or -1 on error
+ */
+int nvprime_rank_gpus(const NvWorkloadHints* hints, NvGpuPlacement* out, uint32_t max);
+
 /* ============================================================================
  * GPU Core State (nvcore)
  * ============================================================================ */
@@ -205,6 +284,78 @@ uint32_t nvprime_profile_gpu_clock_percent(NvPerformanceProfile profile);
 uint32_t nvprime_profile_mem_clock_percent(NvPerformanceProfile profile);
 uint32_t nvprime_profile_power_limit_percent(NvPerformanceProfile profile);
 
+/* ============================================================================
+ * Tuning Transactions (nvcore)
+ * ============================================================================ */
+
+/**
+ * Stage clock offsets, locked clocks, the power limit and the fan target,
+ * then apply them as one batch on a worker thread. Steps that applied before
+ * a failing one are rolled back. Writes require root.
+ *
+ *   NvTuningTransaction* tx = nvprime_tuning_begin(0);
+ *   nvprime_tuning_stage_profile(tx, NV_PROFILE_MAXIMUM);
+ *   nvprime_tuning_set_fan_speed(tx, 70);
+ *   nvprime_tuning_commit(tx, on_done, ctx);   // returns immediately
+ *   nvprime_tuning_free(tx);                   // safe while pending
+ */
+typedef struct NvTuningTransaction NvTuningTransaction;
+
+typedef enum {
+    NV_TUNING_IDLE = 0,            /* Never committed */
+    NV_TUNING_PENDING = 1,         /* Queued or being applied */
+    NV_TUNING_COMMITTED = 2,       /* Every step applied */
+    NV_TUNING_ROLLED_BACK = 3,     /* A step failed; earlier steps were undone */
+    NV_TUNING_ROLLBACK_FAILED = 4, /* A step failed and undoing failed too */
+} NvTuningStatus;
+
+/* Steps, in the order they are applied */
+#define NV_TUNING_STEP_POWER_LIMIT   0
+#define NV_TUNING_STEP_FAN           1
+#define NV_TUNING_STEP_CLOCK_OFFSETS 2
+#define NV_TUNING_STEP_GPU_LOCK      3
+#define NV_TUNING_STEP_MEM_LOCK      4
+
+/** Called on the tuning worker; failed_step is NV_TUNING_STEP_* or -1 */
+typedef void (*NvTuningCallback)(uint32_t index, NvTuningStatus status, int failed_step, void* user_data);
+
+/** Start a transaction for a GPU (NULL on allocation failure) */
+NvTuningTransaction* nvprime_tuning_begin(uint32_t index);
+
+/**
+ * Stage changes. Return 0, or -1 if invalid or the transaction is pending
+ * (until its callback, if any, has returned).
+ */
+int nvprime_tuning_set_clock_offsets(NvTuningTransaction* tx, int32_t gpu_offset_mhz, int32_t mem_offset_mhz);
+int nvprime_tuning_lock_gpu_clocks(NvTuningTransaction* tx, uint32_t min_mhz, uint32_t max_mhz);
+int nvprime_tuning_lock_mem_clocks(NvTuningTransaction* tx, uint32_t min_mhz, uint32_t max_mhz);
+int nvprime_tuning_unlock_clocks(NvTuningTransaction* tx);
+int nvprime_tuning_set_power_limit(NvTuningTransaction* tx, uint32_t limit_mw);
+int nvprime_tuning_set_fan_speed(NvTuningTransaction* tx, uint32_t speed_percent);
+int nvprime_tuning_set_fan_auto(NvTuningTransaction* tx);
+/** Stage the clock caps and power limit of a profile */
+int nvprime_tuning_stage_profile(NvTuningTransaction* tx, NvPerformanceProfile profile);
+
+/**
+ * Queue the staged changes and return immediately.
+ * @param callback Optional completion callback (runs on the worker thread)
+ * @return 0 if queued, -1 if invalid or still pending (including its callback),
+ *         -2 if the worker could not start
+ */
+int nvprime_tuning_commit(NvTuningTransaction* tx, NvTuningCallback callback, void* user_data);
+
+/** Current status */
+NvTuningStatus nvprime_tuning_status(const NvTuningTransaction* tx);
+
+/** Wait for completion (timeout_ms < 0 waits forever); NV_TUNING_PENDING on timeout */
+NvTuningStatus nvprime_tuning_wait(NvTuningTransaction* tx, int timeout_ms);
+
+/** Step that failed, or -1 */
+int nvprime_tuning_failed_step(const NvTuningTransaction* tx);
+
+/** Release a transaction; a pending one is freed when it finishes */
+void nvprime_tuning_free(NvTuningTransaction* tx);
+
 /* ============================================================================
  * Power & Thermal (nvpower)
  * ============================================================================ */
@@ -216,6 +367,13 @@ typedef enum {
     NV_FAN_ZERO_RPM = 3,
 } NvFanMode;
 
+typedef enum {
+    NV_FAN_PRESET_SILENT = 0,
+    NV_FAN_PRESET_BALANCED = 1,
+    NV_FAN_PRESET_PERFORMANCE = 2,
+    NV_FAN_PRESET_AGGRESSIVE = 3,
+} NvFanPreset;
+
 typedef enum {
     NV_HEALTH_OPTIMAL = 0,
     NV_HEALTH_MODERATE = 1,
@@ -258,6 +416,9 @@ NvPowerHealth nvprime_power_get_health(uint32_t index);
 bool nvprime_power_is_thermal_throttling(uint32_t index);
 bool nvprime_power_is_power_throttling(uint32_t index);
 
+/** Current clock throttle reasons (NV_THROTTLE_* bits), 0 if unavailable */
+uint64_t nvprime_power_get_throttle_reasons(uint32_t index);
+
 /** Power queries */
 float nvprime_power_get_power_draw(uint32_t index);
 float nvprime_power_get_power_limit(uint32_t index);
@@ -269,10 +430,304 @@ int nvprime_power_set_power_limit(uint32_t index, uint32_t limit_mw);
 int nvprime_power_get_temperature(uint32_t index);
 int nvprime_power_get_fan_speed(uint32_t index);
 
+/**
+ * Fan control (requires root).
+ * A preset runs as a closed loop on the background sampler (started if
+ * needed): hysteresis and slew limiting keep bursty loads from making the
+ * fans hunt, and NVML is only written when the speed changes.
+ * Setting a fixed speed or auto stops the curve.
+ * @return 0 on success, -1 on error
+ */
+int nvprime_fan_apply_preset(uint32_t index, NvFanPreset preset);
+int nvprime_fan_set_speed(uint32_t index, uint32_t speed_percent);
+int nvprime_fan_set_auto(uint32_t index);
+
 /** Efficiency mode helpers */
 uint32_t nvprime_efficiency_power_percent(NvEfficiencyMode mode);
 uint32_t nvprime_efficiency_thermal_target(NvEfficiencyMode mode);
 
+/* ============================================================================
+ * Perf-per-Watt Auto-Tuner (nvpower)
+ * ============================================================================ */
+
+/**
+ * While a game runs, the tuner steps the power limit and graphics clock cap
+ * down from 100%, measures FPS against board power, then holds the best FPS
+ * per watt that stays above the FPS floor. Curves are cached per executable
+ * in $XDG_CACHE_HOME/nvprime/autotune, so later launches start at that point.
+ */
+typedef struct {
+    int phase;                    /* 0 = not running, 1 = sweeping, 2 = holding */
+    uint32_t device_index;
+    uint32_t level_percent;       /* Current power limit / clock cap level */
+    uint32_t point_count;         /* Measured points on the curve */
+    uint32_t knee_level_percent;  /* Operating point (0 if none yet) */
+    float knee_fps;
+    float knee_watts;
+} NvAutotuneStatus;
+
+/**
+ * Start tuning a GPU for an executable (requires root).
+ * @return 0 on success, -1 if invalid or already running, -2 on failure
+ */
+int nvprime_autotune_start(uint32_t index, const char* exe_name, float fps_floor);
+
+/** Stop tuning, cache the curve and restore the power limit and clocks from before start */
+void nvprime_autotune_stop(void);
+
+/** Report a presented frame (call once per frame; a no-op when not running) */
+void nvprime_autotune_record_frame(void);
+
+/** Get tuner state */
+int nvprime_autotune_get_status(NvAutotuneStatus* out_status);
+
+/* ============================================================================
+ * Batched Telemetry (nvmon)
+ * ============================================================================ */
+
+/** Field bits for nvprime_sample_all() */
+#define NV_FIELD_TEMPERATURE        (1ull << 0)
+#define NV_FIELD_MEMORY_TEMPERATURE (1ull << 1)
+#define NV_FIELD_POWER_DRAW         (1ull << 2)
+#define NV_FIELD_POWER_LIMIT        (1ull << 3)
+#define NV_FIELD_GPU_CLOCK          (1ull << 4)
+#define NV_FIELD_MEM_CLOCK          (1ull << 5)
+#define NV_FIELD_SM_CLOCK           (1ull << 6)
+#define NV_FIELD_VIDEO_CLOCK        (1ull << 7)
+#define NV_FIELD_UTILIZATION        (1ull << 8)
+#define NV_FIELD_FAN_SPEED          (1ull << 9)
+#define NV_FIELD_VRAM               (1ull << 10)
+#define NV_FIELD_PSTATE             (1ull << 11)
+#define NV_FIELD_THROTTLE_REASONS   (1ull << 12)
+#define NV_FIELD_ENCODER            (1ull << 13)
+#define NV_FIELD_ALL                ((1ull << 14) - 1)
+
+/**
+ * One GPU's sample. 120 bytes since 0.2.0, which appended the throttle and
+ * NVENC members; check nvprime_version_int() before passing arrays of it.
+ */
+typedef struct {
+    uint32_t index;
+    uint32_t pstate;
+    uint64_t valid_mask;       /* NV_FIELD_* bits that were read successfully */
+    uint64_t timestamp_ns;     /* CLOCK_MONOTONIC time the sample started */
+    uint64_t duration_ns;      /* Time spent sampling this device */
+    uint32_t temperature_c;
+    uint32_t memory_temp_c;
+    uint32_t power_draw_mw;
+    uint32_t power_limit_mw;
+    uint32_t gpu_clock_mhz;
+    uint32_t mem_clock_mhz;
+    uint32_t sm_clock_mhz;
+    uint32_t video_clock_mhz;
+    uint32_t gpu_utilization;
+    uint32_t mem_utilization;
+    uint32_t fan_speed_percent;
+    uint32_t _reserved;
+    uint64_t vram_used_mb;
+    uint64_t vram_total_mb;
+    uint64_t throttle_reasons; /* NV_THROTTLE_* bits */
+    uint32_t encoder_sessions; /* Active NVENC sessions */
+    uint32_t encoder_fps;      /* Average NVENC FPS across sessions */
+    uint32_t encoder_latency_us;
+    uint32_t encoder_utilization; /* NVENC engine utilization percent */
+} NvGpuSample;
+
+/**
+ * Sample every GPU in one pass.
+ * Only fields set in field_mask are queried; NVML field-value batching is
+ * used where the driver supports it.
+ * @param out Caller-owned array of at least max entries
+ * @return Number of samples written, or negative on error
+ */
+int nvprime_sample_all(NvGpuSample* out, uint32_t max, uint64_t field_mask);
+
+/** Duration of the most recent nvprime_sample_all() pass in nanoseconds */
+uint64_t nvprime_sample_last_duration_ns(void);
+
+/**
+ * Start the background sampler thread.
+ * While it runs, the nvprime_*_get_* telemetry getters return the latest
+ * sample from memory instead of querying NVML.
+ * @param interval_ms Sampling period (0 is rejected)
+ * @param field_mask NV_FIELD_* bits to sample
+ * @return 0 on success, negative on error
+ */
+int nvprime_sampler_start(uint32_t interval_ms, uint64_t field_mask);
+
+/** Stop the background sampler thread */
+void nvprime_sampler_stop(void);
+
+/** Whether the background sampler is running */
+bool nvprime_sampler_is_running(void);
+
+/** Whether telemetry is served by a live nvprime daemon (see nvprime_init) */
+bool nvprime_daemon_attached(void);
+
+/**
+ * Copy the latest background sample for a GPU (no NVML calls).
+ * Reads the daemon's segment when attached and no local sampler runs.
+ * @return 0 on success, -1 if no fresh sample is available
+ */
+int nvprime_sampler_get_latest(uint32_t index, NvGpuSample* out);
+
+/* ============================================================================
+ * GPU Events (nvmon)
+ * ============================================================================ */
+
+/** Clock throttle reason bits returned by nvprime_power_get_throttle_reasons() */
+#define NV_THROTTLE_GPU_IDLE            0x0000000000000001ull
+#define NV_THROTTLE_APPLICATIONS_CLOCKS 0x0000000000000002ull
+#define NV_THROTTLE_SW_POWER_CAP        0x0000000000000004ull
+#define NV_THROTTLE_HW_SLOWDOWN         0x0000000000000008ull
+#define NV_THROTTLE_SYNC_BOOST          0x0000000000000010ull
+#define NV_THROTTLE_SW_THERMAL          0x0000000000000020ull
+#define NV_THROTTLE_HW_THERMAL          0x0000000000000040ull
+#define NV_THROTTLE_HW_POWER_BRAKE      0x0000000000000080ull
+
+typedef enum {
+    NV_EVENT_THROTTLE_CHANGED = 0,    /* value = new reasons, aux = previous reasons */
+    NV_EVENT_THERMAL_WARNING = 1,     /* value = temperature C, aux = threshold C */
+    NV_EVENT_POWER_LIMIT_REACHED = 2, /* value = power draw mW, aux = limit mW */
+    NV_EVENT_PSTATE_CHANGE = 3,       /* value = new P-state */
+    NV_EVENT_XID = 4,                 /* value = Xid code */
+} NvEventKind;
+
+/** Kind bits for nvprime_events_start() */
+#define NV_EVENT_MASK(kind) (1u << (kind))
+#define NV_EVENT_MASK_ALL   ((1u << 5) - 1)
+
+typedef struct {
+    NvEventKind kind;
+    uint32_t gpu_index;
+    uint64_t timestamp_ns;     /* CLOCK_MONOTONIC */
+    uint64_t value;
+    uint64_t aux;
+} NvGpuEvent;
+
+/** Callback invoked on the monitor thread for each event */
+typedef void (*NvEventCallback)(const NvGpuEvent* event, void* user_data);
+
+/**
+ * Start the event monitor thread.
+ * Blocks in nvmlEventSetWait for P-state and Xid events and tracks clock
+ * throttle reasons, reporting transitions as events.
+ * @return 0 on success, negative on error
+ */
+int nvprime_events_start(uint32_t kind_mask);
+
+/** Stop the event monitor thread */
+void nvprime_events_stop(void);
+
+/**
+ * File descriptor that becomes readable when events are queued.
+ * Add it to epoll/poll and call nvprime_events_poll() when it fires.
+ * @return fd, or -1 if the monitor was never started
+ */
+int nvprime_events_get_fd(void);
+
+/** Drain queued events; returns the number written to out */
+int nvprime_events_poll(NvGpuEvent* out, uint32_t max);
+
+/**
+ * Register a callback for all delivered events.
+ * @return Subscription id, or -1 if no slots are free
+ */
+int nvprime_events_add_callback(NvEventCallback callback, void* user_data);
+void nvprime_events_remove_callback(uint32_t id);
+
+/* ============================================================================
+ * Telemetry Flight Recorder (nvmon)
+ * ============================================================================ */
+
+#define NV_RECORD_MAX_GPUS 32
+
+/** Frame-time summary for one recorder interval */
+typedef struct {
+    uint16_t frame_count;
+    uint16_t stutter_count;   /* frames over 2x the previous interval's average */
+    uint32_t avg_frame_us;
+    uint32_t max_frame_us;
+    uint32_t max_latency_us;
+} NvFrameSummary;
+
+/** Decoded GPU values; valid holds NV_RECORD_* bits */
+#define NV_RECORD_TEMPERATURE (1u << 0)
+#define NV_RECORD_POWER       (1u << 1)
+#define NV_RECORD_GPU_CLOCK   (1u << 2)
+#define NV_RECORD_MEM_CLOCK   (1u << 3)
+#define NV_RECORD_VRAM        (1u << 4)
+#define NV_RECORD_UTILIZATION (1u << 5)
+#define NV_RECORD_FAN         (1u << 6)
+#define NV_RECORD_PSTATE      (1u << 7)
+
+typedef struct {
+    uint32_t valid;
+    uint32_t pstate;
+    uint32_t temperature_c;
+    uint32_t power_mw;        /* 100 mW resolution */
+    uint32_t gpu_clock_mhz;
+    uint32_t mem_clock_mhz;
+    uint32_t utilization;
+    uint32_t mem_utilization;
+    uint32_t fan_percent;
+    uint32_t _reserved;
+    uint64_t vram_used_mb;    /* 8 MB resolution */
+} NvRecordedGpu;
+
+typedef struct {
+    uint32_t time_ms;         /* since the recording started */
+    NvFrameSummary summary;
+    uint32_t gpu_count;
+    uint32_t _reserved;
+    NvRecordedGpu gpus[NV_RECORD_MAX_GPUS];
+} NvRecordedFrame;
+
+/**
+ * Record telemetry to a memory-mapped ring file. One frame is written per
+ * interval from the background sampler (started if needed).
+ * @param interval_ms Frame interval (0 = 500 ms)
+ * @param duration_s Seconds kept before the ring wraps (0 = 4 hours)
+ * @return 0 on success, negative on error
+ */
+int nvprime_recorder_start(const char* path, uint32_t interval_ms, uint32_t duration_s);
+void nvprime_recorder_stop(void);
+
+/** Report a presented frame; lock-free and safe to call from the render thread */
+void nvprime_recorder_record_frame(uint64_t frame_time_ns, uint64_t latency_ns);
+
+/**
+ * Open a recording for replay. Works on files still being written.
+ * @return Handle, or NULL on error
+ */
+void* nvprime_recording_open(const char* path);
+
+/** Decode the next frame, oldest first. @return 1 if out was filled, 0 at the end, -1 on a NULL handle */
+int nvprime_recording_next(void* recording, NvRecordedFrame* out);
+
+/** Restart from the oldest frame still in the ring */
+void nvprime_recording_rewind(void* recording);
+uint32_t nvprime_recording_gpu_count(void* recording);
+void nvprime_recording_close(void* recording);
+
+/* ============================================================================
+ * Tracing (nvmon)
+ * ============================================================================ */
+
+/** Whether tracing was compiled in (zig build -Dtrace=true) */
+bool nvprime_trace_available(void);
+
+/** Start/stop recording spans, counters and frame markers */
+void nvprime_trace_start(void);
+void nvprime_trace_stop(void);
+
+/**
+ * Stop recording and write the buffered events as Chrome trace JSON,
+ * viewable in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * @return 0 on success, -1 on I/O error, -2 if tracing is compiled out
+ */
+int nvprime_trace_dump(const char* path);
+
 /* ============================================================================
  * Convenience aliases
  * ============================================================================ */
@@ -73,6 +73,9 @@ pub const Utilization = c.nvmlUtilization_t;
 pub const PStates = c.nvmlPstates_t;
 pub const ClockType = c.nvmlClockType_t;
 pub const TemperatureSensors = c.nvmlTemperatureSensors_t;
+pub const FieldValue = c.nvmlFieldValue_t;
+pub const EventSet = c.nvmlEventSet_t;
+pub const EventData = c.nvmlEventData_t;
 
 // Clock type constants
 pub const CLOCK_GRAPHICS = c.NVML_CLOCK_GRAPHICS;
@@ -82,6 +85,38 @@ pub const CLOCK_VIDEO = c.NVML_CLOCK_VIDEO;
 
 // Temperature sensor constants
 pub const TEMPERATURE_GPU = c.NVML_TEMPERATURE_GPU;
+pub const TEMPERATURE_THRESHOLD_SLOWDOWN = c.NVML_TEMPERATURE_THRESHOLD_SLOWDOWN;
+
+// GPU topology levels (nearest common ancestor of two GPUs)
+pub const TopologyLevel = c.nvmlGpuTopologyLevel_t;
+pub const TOPOLOGY_INTERNAL = c.NVML_TOPOLOGY_INTERNAL;
+pub const TOPOLOGY_SINGLE = c.NVML_TOPOLOGY_SINGLE;
+pub const TOPOLOGY_MULTIPLE = c.NVML_TOPOLOGY_MULTIPLE;
+pub const TOPOLOGY_HOSTBRIDGE = c.NVML_TOPOLOGY_HOSTBRIDGE;
+pub const TOPOLOGY_NODE = c.NVML_TOPOLOGY_NODE;
+pub const TOPOLOGY_SYSTEM = c.NVML_TOPOLOGY_SYSTEM;
+
+pub const NVLINK_MAX_LINKS = c.NVML_NVLINK_MAX_LINKS;
+
+// Field value IDs (for batched nvmlDeviceGetFieldValues queries)
+pub const FI_DEV_MEMORY_TEMP = c.NVML_FI_DEV_MEMORY_TEMP;
+pub const FI_DEV_POWER_INSTANT = c.NVML_FI_DEV_POWER_INSTANT;
+
+// Event types (bitmask)
+pub const EVENT_TYPE_PSTATE: u64 = c.nvmlEventTypePState;
+pub const EVENT_TYPE_XID_CRITICAL_ERROR: u64 = c.nvmlEventTypeXidCriticalError;
+pub const EVENT_TYPE_CLOCK: u64 = c.nvmlEventTypeClock;
+pub const EVENT_TYPE_POWER_SOURCE_CHANGE: u64 = c.nvmlEventTypePowerSourceChange;
+
+// Clock throttle reasons (bitmask)
+pub const THROTTLE_GPU_IDLE: u64 = c.nvmlClocksThrottleReasonGpuIdle;
+pub const THROTTLE_APPLICATIONS_CLOCKS: u64 = c.nvmlClocksThrottleReasonApplicationsClocksSetting;
+pub const THROTTLE_SW_POWER_CAP: u64 = c.nvmlClocksThrottleReasonSwPowerCap;
+pub const THROTTLE_HW_SLOWDOWN: u64 = c.nvmlClocksThrottleReasonHwSlowdown;
+pub const THROTTLE_SYNC_BOOST: u64 = c.nvmlClocksThrottleReasonSyncBoost;
+pub const THROTTLE_SW_THERMAL: u64 = c.nvmlClocksThrottleReasonSwThermalSlowdown;
+pub const THROTTLE_HW_THERMAL: u64 = c.nvmlClocksThrottleReasonHwThermalSlowdown;
+pub const THROTTLE_HW_POWER_BRAKE: u64 = c.nvmlClocksThrottleReasonHwPowerBrakeSlowdown;
 
 // P-state constants
 pub const PSTATE_0 = c.NVML_PSTATE_0;
@@ -157,6 +192,20 @@ pub fn getDevicePciInfo(device: Device) NvmlError!PciInfo {
     return pci;
 }
 
+/// Get maximum PCIe link generation supported by device and system
+pub fn getDeviceMaxPcieLinkGeneration(device: Device) NvmlError!u32 {
+    var gen: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetMaxPcieLinkGeneration(device, &gen));
+    return gen;
+}
+
+/// Get maximum PCIe link width supported by device and system
+pub fn getDeviceMaxPcieLinkWidth(device: Device) NvmlError!u32 {
+    var width: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetMaxPcieLinkWidth(device, &width));
+    return width;
+}
+
 /// Get device memory info
 pub fn getDeviceMemoryInfo(device: Device) NvmlError!Memory {
     var memory: Memory = undefined;
@@ -213,11 +262,75 @@ pub fn getDevicePowerLimit(device: Device) NvmlError!u32 {
     return limit;
 }
 
+/// Default (board) power limit in milliwatts
+pub fn getDevicePowerDefaultLimit(device: Device) NvmlError!u32 {
+    var limit: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetPowerManagementDefaultLimit(device, &limit));
+    return limit;
+}
+
+/// Range the power limit may be set within, in milliwatts
+pub const PowerLimitRange = struct {
+    min_mw: u32,
+    max_mw: u32,
+};
+
+pub fn getDevicePowerLimitConstraints(device: Device) NvmlError!PowerLimitRange {
+    var min: c_uint = 0;
+    var max: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetPowerManagementLimitConstraints(device, &min, &max));
+    return .{ .min_mw = min, .max_mw = max };
+}
+
 /// Set GPU power limit (milliwatts) - requires root
 pub fn setDevicePowerLimit(device: Device, limit: u32) NvmlError!void {
     try mapNvmlReturn(c.nvmlDeviceSetPowerManagementLimit(device, limit));
 }
 
+/// Lock the graphics clock to a range in MHz (requires root)
+pub fn setDeviceGpuLockedClocks(device: Device, min_mhz: u32, max_mhz: u32) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceSetGpuLockedClocks(device, min_mhz, max_mhz));
+}
+
+/// Return the graphics clock to driver control (requires root)
+pub fn resetDeviceGpuLockedClocks(device: Device) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceResetGpuLockedClocks(device));
+}
+
+/// Lock the memory clock to a range in MHz (requires root, Ampere+)
+pub fn setDeviceMemoryLockedClocks(device: Device, min_mhz: u32, max_mhz: u32) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceSetMemoryLockedClocks(device, min_mhz, max_mhz));
+}
+
+/// Return the memory clock to driver control (requires root)
+pub fn resetDeviceMemoryLockedClocks(device: Device) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceResetMemoryLockedClocks(device));
+}
+
+/// Graphics clock V/F curve offset in MHz
+pub fn getDeviceGpcClkVfOffset(device: Device) NvmlError!i32 {
+    var offset: c_int = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetGpcClkVfOffset(device, &offset));
+    return offset;
+}
+
+/// Set the graphics clock V/F curve offset in MHz (requires root)
+pub fn setDeviceGpcClkVfOffset(device: Device, offset_mhz: i32) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceSetGpcClkVfOffset(device, offset_mhz));
+}
+
+/// Memory clock V/F curve offset in MHz
+pub fn getDeviceMemClkVfOffset(device: Device) NvmlError!i32 {
+    var offset: c_int = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetMemClkVfOffset(device, &offset));
+    return offset;
+}
+
+/// Set the memory clock V/F curve offset in MHz (requires root)
+pub fn setDeviceMemClkVfOffset(device: Device, offset_mhz: i32) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceSetMemClkVfOffset(device, offset_mhz));
+}
+
 /// Get fan speed percentage
 pub fn getDeviceFanSpeed(device: Device) NvmlError!u32 {
     var speed: c_uint = 0;
@@ -225,6 +338,144 @@ pub fn getDeviceFanSpeed(device: Device) NvmlError!u32 {
     return speed;
 }
 
+/// Number of fans on the device
+pub fn getDeviceNumFans(device: Device) NvmlError!u32 {
+    var count: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetNumFans(device, &count));
+    return count;
+}
+
+/// Get the target speed of one fan in percent
+pub fn getDeviceFanSpeedN(device: Device, fan: u32) NvmlError!u32 {
+    var speed: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetFanSpeed_v2(device, fan, &speed));
+    return speed;
+}
+
+/// Fan speed range the driver accepts, in percent
+pub const FanSpeedRange = struct {
+    min_percent: u32,
+    max_percent: u32,
+};
+
+pub fn getDeviceMinMaxFanSpeed(device: Device) NvmlError!FanSpeedRange {
+    var min: c_uint = 0;
+    var max: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetMinMaxFanSpeed(device, &min, &max));
+    return .{ .min_percent = min, .max_percent = max };
+}
+
+/// Set one fan to a fixed speed in percent (requires root)
+pub fn setDeviceFanSpeed(device: Device, fan: u32, speed_percent: u32) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceSetFanSpeed_v2(device, fan, speed_percent));
+}
+
+/// Return one fan to driver control (requires root)
+pub fn setDeviceDefaultFanSpeed(device: Device, fan: u32) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceSetDefaultFanSpeed_v2(device, fan));
+}
+
+/// Get a temperature threshold (e.g. TEMPERATURE_THRESHOLD_SLOWDOWN) in C
+pub fn getDeviceTemperatureThreshold(device: Device, threshold: c.nvmlTemperatureThresholds_t) NvmlError!u32 {
+    var temp: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetTemperatureThreshold(device, threshold, &temp));
+    return temp;
+}
+
+/// NVENC session statistics
+pub const EncoderStats = struct {
+    session_count: u32,
+    average_fps: u32,
+    average_latency_us: u32,
+};
+
+/// Get NVENC session statistics
+pub fn getDeviceEncoderStats(device: Device) NvmlError!EncoderStats {
+    var sessions: c_uint = 0;
+    var fps: c_uint = 0;
+    var latency: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetEncoderStats(device, &sessions, &fps, &latency));
+    return .{ .session_count = sessions, .average_fps = fps, .average_latency_us = latency };
+}
+
+/// Get NVENC utilization percentage
+pub fn getDeviceEncoderUtilization(device: Device) NvmlError!u32 {
+    var utilization: c_uint = 0;
+    var period_us: c_uint = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetEncoderUtilization(device, &utilization, &period_us));
+    return utilization;
+}
+
+/// Get the nearest common ancestor of two GPUs in the PCIe topology
+pub fn getTopologyCommonAncestor(a: Device, b: Device) NvmlError!TopologyLevel {
+    var level: TopologyLevel = undefined;
+    try mapNvmlReturn(c.nvmlDeviceGetTopologyCommonAncestor(a, b, &level));
+    return level;
+}
+
+/// Whether an NVLink link is active
+pub fn getDeviceNvLinkState(device: Device, link: u32) NvmlError!bool {
+    var state: c.nvmlEnableState_t = undefined;
+    try mapNvmlReturn(c.nvmlDeviceGetNvLinkState(device, link, &state));
+    return state == c.NVML_FEATURE_ENABLED;
+}
+
+/// Get the PCI info of the device on the far end of an NVLink link
+pub fn getDeviceNvLinkRemotePciInfo(device: Device, link: u32) NvmlError!PciInfo {
+    var pci: PciInfo = undefined;
+    try mapNvmlReturn(c.nvmlDeviceGetNvLinkRemotePciInfo_v2(device, link, &pci));
+    return pci;
+}
+
+/// Query several field values in a single driver round-trip.
+/// Each entry's `fieldId` must be set; per-field status is reported in `nvmlReturn`.
+pub fn getDeviceFieldValues(device: Device, values: []FieldValue) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceGetFieldValues(device, @intCast(values.len), values.ptr));
+}
+
+/// Check the per-field status of a batched field value query
+pub fn fieldValueResult(value: *const FieldValue) NvmlError!void {
+    try mapNvmlReturn(value.nvmlReturn);
+}
+
+/// Get the current clock throttle reasons (THROTTLE_* bitmask)
+pub fn getDeviceCurrentClocksThrottleReasons(device: Device) NvmlError!u64 {
+    var reasons: c_ulonglong = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetCurrentClocksThrottleReasons(device, &reasons));
+    return reasons;
+}
+
+/// Get the event types a device can report (EVENT_TYPE_* bitmask)
+pub fn getDeviceSupportedEventTypes(device: Device) NvmlError!u64 {
+    var types: c_ulonglong = 0;
+    try mapNvmlReturn(c.nvmlDeviceGetSupportedEventTypes(device, &types));
+    return types;
+}
+
+/// Create an event set
+pub fn createEventSet() NvmlError!EventSet {
+    var set: EventSet = undefined;
+    try mapNvmlReturn(c.nvmlEventSetCreate(&set));
+    return set;
+}
+
+/// Free an event set
+pub fn freeEventSet(set: EventSet) void {
+    _ = c.nvmlEventSetFree(set);
+}
+
+/// Register a device's events (EVENT_TYPE_* bitmask) with an event set
+pub fn registerEvents(device: Device, types: u64, set: EventSet) NvmlError!void {
+    try mapNvmlReturn(c.nvmlDeviceRegisterEvents(device, types, set));
+}
+
+/// Wait for the next event on a set. Returns error.Timeout if none arrived.
+pub fn waitEvent(set: EventSet, timeout_ms: u32) NvmlError!EventData {
+    var data: EventData = undefined;
+    try mapNvmlReturn(c.nvmlEventSetWait_v2(set, &data, timeout_ms));
+    return data;
+}
+
 /// Get CUDA compute capability
 pub fn getDeviceCudaComputeCapability(device: Device) NvmlError!struct { major: i32, minor: i32 } {
     var major: c_int = 0;
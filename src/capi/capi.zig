@@ -5,27 +5,36 @@
 pub const nvcaps_capi = @import("nvcaps_capi.zig");
 pub const nvcore_capi = @import("nvcore_capi.zig");
 pub const nvpower_capi = @import("nvpower_capi.zig");
+pub const nvmon_capi = @import("nvmon_capi.zig");
+pub const fields_capi = @import("fields_capi.zig");
 
 // Re-export types
 pub const NvArchitecture = nvcaps_capi.NvArchitecture;
 pub const NvGpuCapabilities = nvcaps_capi.NvGpuCapabilities;
 pub const NvSystemSummary = nvcaps_capi.NvSystemSummary;
+pub const NvWorkloadKind = nvcaps_capi.NvWorkloadKind;
+pub const NvWorkloadHints = nvcaps_capi.NvWorkloadHints;
+pub const NvGpuPlacement = nvcaps_capi.NvGpuPlacement;
 pub const NvPerformanceProfile = nvcore_capi.NvPerformanceProfile;
 pub const NvCoreState = nvcore_capi.NvCoreState;
 pub const NvClockLimits = nvcore_capi.NvClockLimits;
 pub const NvFanMode = nvpower_capi.NvFanMode;
+pub const NvFanPreset = nvpower_capi.NvFanPreset;
 pub const NvPowerHealth = nvpower_capi.NvPowerHealth;
 pub const NvEfficiencyMode = nvpower_capi.NvEfficiencyMode;
 pub const NvPowerState = nvpower_capi.NvPowerState;
+pub const NvGpuSample = nvmon_capi.NvGpuSample;
+pub const NvGpuEvent = nvmon_capi.NvGpuEvent;
+pub const NvRecordedFrame = nvmon_capi.NvRecordedFrame;
 
 /// Library version components
 pub const NVPRIME_VERSION_MAJOR: c_int = 0;
-pub const NVPRIME_VERSION_MINOR: c_int = 1;
+pub const NVPRIME_VERSION_MINOR: c_int = 2;
 pub const NVPRIME_VERSION_PATCH: c_int = 0;
 
 /// Get library version string
 export fn nvprime_version() [*:0]const u8 {
-    return "0.1.0";
+    return "0.2.0";
 }
 
 /// Get library version as packed integer (major * 10000 + minor * 100 + patch)
@@ -39,4 +48,6 @@ comptime {
     _ = nvcaps_capi;
     _ = nvcore_capi;
     _ = nvpower_capi;
+    _ = nvmon_capi;
+    _ = fields_capi;
 }
@@ -0,0 +1,33 @@
+//! Telemetry Field C API
+//!
+//! Scalar telemetry getters generated from the nvmon field table. Each
+//! getter reads the sampler cache when fresh, and otherwise issues only
+//! the NVML query its field needs. Errors return -1 (0 for uint64_t).
+
+const std = @import("std");
+const nvprime = @import("nvprime");
+const fields = nvprime.nvmon.fields;
+
+fn Getter(comptime id: fields.Id) type {
+    const def = fields.get(id);
+    const T = def.c_type.Type();
+    const err_value: T = switch (def.c_type) {
+        .int => -1,
+        .uint64 => 0,
+    };
+    return struct {
+        fn call(index: u32) callconv(.c) T {
+            const value = fields.read(id, index) orelse return err_value;
+            return @intCast(value);
+        }
+    };
+}
+
+comptime {
+    for (std.enums.values(fields.Id)) |id| {
+        const def = fields.get(id);
+        for (def.c_names ++ def.legacy_names) |name| {
+            @export(&Getter(id).call, .{ .name = name });
+        }
+    }
+}
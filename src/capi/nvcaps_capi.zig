@@ -6,6 +6,10 @@ const std = @import("std");
 const nvprime = @import("nvprime");
 const nvcaps = nvprime.nvcaps;
 const nvml = nvprime.nvml;
+const registry = nvprime.nvcaps.registry;
+const sampler = nvprime.nvmon.sampler;
+const placement = nvprime.nvcaps.placement;
+const shm = nvprime.nvmon.shm;
 
 /// C-compatible GPU architecture enum
 pub const NvArchitecture = enum(c_int) {
@@ -60,6 +64,39 @@ pub const NvSystemSummary = extern struct {
     primary_gpu_index: u32,
 };
 
+/// C-compatible workload kind for GPU placement
+pub const NvWorkloadKind = enum(c_int) {
+    render = 0,
+    compute = 1,
+    encode = 2,
+    display = 3,
+};
+
+/// Allow GPUs at or past their thermal slowdown point
+pub const NV_PLACEMENT_ALLOW_THROTTLED: u32 = 1 << 0;
+
+/// C-compatible placement hints
+pub const NvWorkloadHints = extern struct {
+    kind: NvWorkloadKind,
+    encoder_sessions: u32,
+    min_free_vram_mb: u64,
+    /// GPU driving the display, or -1 for none
+    display_gpu: i32,
+    flags: u32,
+};
+
+/// C-compatible ranked placement candidate
+pub const NvGpuPlacement = extern struct {
+    index: u32,
+    score: f32,
+    free_vram_mb: u64,
+    utilization: u32,
+    thermal_headroom_c: i32,
+    encoder_sessions: u32,
+    /// 0 same GPU, 1 NVLink, 2 PCIe switch, 3 host bridge, 4 NUMA node, 5 cross-socket, 6 unknown
+    link: u32,
+};
+
 fn archToC(arch: nvcaps.Architecture) NvArchitecture {
     return switch (arch) {
         .unknown => .unknown,
@@ -105,12 +142,35 @@ fn capsToC(caps: nvcaps.GpuCapabilities) NvGpuCapabilities {
     };
 }
 
+fn hintsFromC(hints: ?*const NvWorkloadHints) placement.Hints {
+    const h = hints orelse return .{};
+    return .{
+        .workload = switch (h.kind) {
+            .render => .render,
+            .compute => .compute,
+            .encode => .encode,
+            .display => .display,
+        },
+        .min_free_vram_mb = h.min_free_vram_mb,
+        .encoder_sessions = h.encoder_sessions,
+        .display_gpu = if (h.display_gpu >= 0) @intCast(h.display_gpu) else null,
+        .avoid_throttling = h.flags & NV_PLACEMENT_ALLOW_THROTTLED == 0,
+    };
+}
+
 // ============================================================================
 // C ABI Exports
 // ============================================================================
 
-/// Initialize nvprime library
+/// Initialize nvprime library.
+/// Attaches to a running nvprime daemon when one is publishing telemetry
+/// (NVML is then only initialized if a call needs a device handle).
+/// Set NVPRIME_NO_DAEMON=1 to always initialize NVML in-process.
 export fn nvprime_init() c_int {
+    if (std.posix.getenv("NVPRIME_NO_DAEMON") == null and sampler.attach(shm.default_path)) {
+        registry.enableLazyInit();
+        return 0;
+    }
     nvml.init() catch return -1;
     nvcaps.init() catch return -2;
     return 0;
@@ -118,16 +178,53 @@ export fn nvprime_init() c_int {
 
 /// Shutdown nvprime library
 export fn nvprime_shutdown() void {
+    sampler.stop();
+    sampler.detach();
     nvcaps.deinit();
     nvml.shutdown();
 }
 
 /// Get number of detected GPUs
 export fn nvprime_get_gpu_count() c_int {
-    const count = nvml.getDeviceCount() catch return -1;
+    if (!registry.isInitialized()) {
+        if (sampler.attachedReader()) |reader| return @intCast(reader.gpuCount());
+    }
+    const count = registry.count() catch return -1;
     return @intCast(count);
 }
 
+/// Find a GPU index by UUID (returns -1 if not found)
+export fn nvprime_get_gpu_index_by_uuid(uuid: [*:0]const u8) c_int {
+    if (!registry.isInitialized()) {
+        if (sampler.attachedReader()) |reader| {
+            const index = reader.findByUuid(std.mem.span(uuid)) orelse return -1;
+            return @intCast(index);
+        }
+    }
+    const index = registry.findByUuid(std.mem.span(uuid)) orelse return -1;
+    return @intCast(index);
+}
+
+/// Find a GPU index by PCI bus ID (returns -1 if not found)
+export fn nvprime_get_gpu_index_by_bus_id(bus_id: [*:0]const u8) c_int {
+    if (!registry.isInitialized()) {
+        if (sampler.attachedReader()) |reader| {
+            const index = reader.findByBusId(std.mem.span(bus_id)) orelse return -1;
+            return @intCast(index);
+        }
+    }
+    const index = registry.findByBusId(std.mem.span(bus_id)) orelse return -1;
+    return @intCast(index);
+}
+
+/// Re-resolve device handles after hotplug or a lost GPU
+export fn nvprime_refresh_devices() c_int {
+    registry.refresh() catch return -1;
+    nvcaps.invalidateCache();
+    placement.invalidate();
+    return 0;
+}
+
 /// Get capabilities for a specific GPU
 export fn nvprime_get_gpu_caps(index: u32, out_caps: *NvGpuCapabilities) c_int {
     const caps = nvcaps.getGpuCapabilities(index) catch return -1;
@@ -135,63 +232,68 @@ export fn nvprime_get_gpu_caps(index: u32, out_caps: *NvGpuCapabilities) c_int {
     return 0;
 }
 
+/// Set how long cached dynamic GPU state is served before re-reading NVML (0 = always re-read)
+export fn nvprime_caps_set_staleness_ms(ms: u32) void {
+    nvcaps.setStalenessWindow(@as(u64, ms) * std.time.ns_per_ms);
+}
+
 /// Check if GPU supports a specific feature
 export fn nvprime_gpu_supports_rtx(index: u32) bool {
-    const caps = nvcaps.getGpuCapabilities(index) catch return false;
+    const caps = nvcaps.getStaticTable(index) catch return false;
     return caps.supports_rtx;
 }
 
 export fn nvprime_gpu_supports_dlss(index: u32) bool {
-    const caps = nvcaps.getGpuCapabilities(index) catch return false;
+    const caps = nvcaps.getStaticTable(index) catch return false;
     return caps.supports_dlss;
 }
 
 export fn nvprime_gpu_supports_dlss3(index: u32) bool {
-    const caps = nvcaps.getGpuCapabilities(index) catch return false;
+    const caps = nvcaps.getStaticTable(index) catch return false;
     return caps.supports_dlss3;
 }
 
 export fn nvprime_gpu_supports_reflex(index: u32) bool {
-    const caps = nvcaps.getGpuCapabilities(index) catch return false;
+    const caps = nvcaps.getStaticTable(index) catch return false;
     return caps.supports_reflex;
 }
 
 export fn nvprime_gpu_supports_nvenc(index: u32) bool {
-    const caps = nvcaps.getGpuCapabilities(index) catch return false;
+    const caps = nvcaps.getStaticTable(index) catch return false;
     return caps.supports_nvenc;
 }
 
-/// Get GPU temperature in Celsius
-export fn nvprime_get_gpu_temperature(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch return -1;
-    return @intCast(temp);
+/// Best GPU for a workload (NULL hints = render, no constraints).
+/// Returns the GPU index, or -1 if no GPU qualifies.
+export fn nvprime_select_gpu(hints: ?*const NvWorkloadHints) c_int {
+    const index = placement.select(hintsFromC(hints)) orelse return -1;
+    return @intCast(index);
 }
 
-/// Get GPU power usage in milliwatts
-export fn nvprime_get_gpu_power_usage(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const power = nvml.getDevicePowerUsage(device) catch return -1;
-    return @intCast(power);
+/// Rank GPUs for a workload, best first. Returns the number written (up to max), or -1 on error.
+export fn nvprime_rank_gpus(hints: ?*const NvWorkloadHints, out: ?[*]NvGpuPlacement, max: u32) c_int {
+    const dst = out orelse return -1;
+    var candidates: [registry.max_devices]placement.Candidate = undefined;
+    const n = placement.rank(hintsFromC(hints), candidates[0..@min(max, registry.max_devices)]);
+    for (candidates[0..n], 0..) |c, i| {
+        dst[i] = .{
+            .index = c.index,
+            .score = c.score,
+            .free_vram_mb = c.free_vram_mb,
+            .utilization = c.utilization,
+            .thermal_headroom_c = c.thermal_headroom_c,
+            .encoder_sessions = c.encoder_sessions,
+            .link = @intFromEnum(c.link),
+        };
+    }
+    return @intCast(n);
 }
 
-/// Get GPU clock speed in MHz
-export fn nvprime_get_gpu_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const clock = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch return -1;
-    return @intCast(clock);
-}
-
-/// Get memory clock speed in MHz
-export fn nvprime_get_mem_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const clock = nvml.getDeviceClock(device, nvml.CLOCK_MEM) catch return -1;
-    return @intCast(clock);
-}
+// Temperature, power, clock, VRAM used and P-state getters are generated in fields_capi.zig
 
 /// Get GPU name (copies to buffer, returns bytes written or -1 on error)
 export fn nvprime_get_gpu_name(index: u32, buffer: [*]u8, buffer_size: usize) c_int {
-    const caps = nvcaps.getGpuCapabilities(index) catch return -1;
+    const caps = nvcaps.getStaticCapabilities(index) catch return -1;
     const name = std.mem.sliceTo(&caps.name, 0);
     const copy_len = @min(name.len, buffer_size - 1);
     @memcpy(buffer[0..copy_len], name[0..copy_len]);
@@ -217,20 +319,7 @@ export fn nvprime_get_arch_name(arch: NvArchitecture) [*:0]const u8 {
 
 /// Get VRAM total in megabytes
 export fn nvprime_get_vram_total(index: u32) u64 {
-    const caps = nvcaps.getGpuCapabilities(index) catch return 0;
+    const caps = nvcaps.getStaticCapabilities(index) catch return 0;
     return caps.vram_total_mb;
 }
 
-/// Get VRAM used in megabytes
-export fn nvprime_get_vram_used(index: u32) u64 {
-    const device = nvml.getDeviceByIndex(index) catch return 0;
-    const memory = nvml.getDeviceMemoryInfo(device) catch return 0;
-    return memory.used / (1024 * 1024);
-}
-
-/// Get GPU performance state (P-state, 0-15)
-export fn nvprime_get_pstate(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const pstate = nvml.getDevicePerformanceState(device) catch return -1;
-    return @intCast(pstate);
-}
@@ -6,6 +6,8 @@ const std = @import("std");
 const nvprime = @import("nvprime");
 const nvcore = nvprime.nvcore;
 const nvml = nvprime.nvml;
+const registry = nvprime.nvcaps.registry;
+const tuning = nvcore.tuning;
 
 /// C-compatible performance profile
 pub const NvPerformanceProfile = enum(c_int) {
@@ -36,6 +38,60 @@ pub const NvClockLimits = extern struct {
     default_mem_mhz: u32,
 };
 
+/// C-compatible tuning transaction status
+pub const NvTuningStatus = enum(c_int) {
+    idle = 0,
+    pending = 1,
+    committed = 2,
+    rolled_back = 3,
+    rollback_failed = 4,
+};
+
+/// Called on the tuning worker when a transaction finished.
+/// failed_step is an NV_TUNING_STEP_* value, or -1 if every step applied.
+pub const NvTuningCallback = *const fn (index: u32, status: NvTuningStatus, failed_step: c_int, user_data: ?*anyopaque) callconv(.c) void;
+
+const TuningHandle = struct {
+    tx: tuning.Transaction,
+    future: tuning.Future = .{},
+    /// The caller's reference, plus one while a commit is in flight
+    refs: std.atomic.Value(u32) = std.atomic.Value(u32).init(1),
+    /// Set from commit until tuningDone returned; guards callback/user_data
+    in_flight: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    callback: ?NvTuningCallback = null,
+    user_data: ?*anyopaque = null,
+
+    fn release(self: *TuningHandle) void {
+        if (self.refs.fetchSub(1, .acq_rel) == 1) std.heap.page_allocator.destroy(self);
+    }
+
+    /// Staged changes may not be edited until the previous commit's
+    /// callback ran
+    fn editable(handle: ?*anyopaque) ?*TuningHandle {
+        const h: *TuningHandle = @ptrCast(@alignCast(handle orelse return null));
+        return if (h.in_flight.load(.acquire)) null else h;
+    }
+};
+
+fn tuningDone(future: *tuning.Future, context: ?*anyopaque) void {
+    const h: *TuningHandle = @ptrCast(@alignCast(context.?));
+    if (h.callback) |cb| {
+        const failed: c_int = if (future.failed_step) |step| @intFromEnum(step) else -1;
+        cb(h.tx.device_index, @enumFromInt(@intFromEnum(future.poll())), failed, h.user_data);
+    }
+    h.in_flight.store(false, .release);
+    h.release();
+}
+
+fn profileFromC(profile: NvPerformanceProfile) nvcore.PerformanceProfile {
+    return switch (profile) {
+        .maximum => .maximum,
+        .balanced => .balanced,
+        .efficient => .efficient,
+        .quiet => .quiet,
+    };
+}
+
 fn stateToC(state: nvcore.CoreState) NvCoreState {
     return NvCoreState{
         .gpu_clock_mhz = state.gpu_clock_mhz,
@@ -77,98 +133,157 @@ export fn nvprime_core_get_clock_limits(index: u32, out_limits: *NvClockLimits)
     return 0;
 }
 
-/// Get GPU clock speed in MHz
-export fn nvprime_core_get_gpu_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const clock = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch return -1;
-    return @intCast(clock);
-}
-
-/// Get memory clock speed in MHz
-export fn nvprime_core_get_mem_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const clock = nvml.getDeviceClock(device, nvml.CLOCK_MEM) catch return -1;
-    return @intCast(clock);
-}
-
-/// Get SM clock speed in MHz
-export fn nvprime_core_get_sm_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const clock = nvml.getDeviceClock(device, nvml.CLOCK_SM) catch return -1;
-    return @intCast(clock);
-}
-
-/// Get video clock speed in MHz
-export fn nvprime_core_get_video_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const clock = nvml.getDeviceClock(device, nvml.CLOCK_VIDEO) catch return -1;
-    return @intCast(clock);
-}
-
-/// Get current P-state (0-15)
-export fn nvprime_core_get_pstate(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const pstate = nvml.getDevicePerformanceState(device) catch return -1;
-    return @intCast(pstate);
-}
-
-/// Get GPU utilization percentage (0-100)
-export fn nvprime_core_get_gpu_utilization(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const util = nvml.getDeviceUtilization(device) catch return -1;
-    return @intCast(util.gpu);
-}
-
-/// Get memory utilization percentage (0-100)
-export fn nvprime_core_get_mem_utilization(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const util = nvml.getDeviceUtilization(device) catch return -1;
-    return @intCast(util.memory);
-}
+// Current clocks, P-state and utilization getters are generated in fields_capi.zig
 
 /// Get max GPU clock in MHz
 export fn nvprime_core_get_max_gpu_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
+    const device = registry.getDevice(index) catch return -1;
     const clock = nvml.getDeviceMaxClock(device, nvml.CLOCK_GRAPHICS) catch return -1;
     return @intCast(clock);
 }
 
 /// Get max memory clock in MHz
 export fn nvprime_core_get_max_mem_clock(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
+    const device = registry.getDevice(index) catch return -1;
     const clock = nvml.getDeviceMaxClock(device, nvml.CLOCK_MEM) catch return -1;
     return @intCast(clock);
 }
 
 /// Get GPU clock percent for a profile
 export fn nvprime_profile_gpu_clock_percent(profile: NvPerformanceProfile) u32 {
-    const p: nvcore.PerformanceProfile = switch (profile) {
-        .maximum => .maximum,
-        .balanced => .balanced,
-        .efficient => .efficient,
-        .quiet => .quiet,
-    };
+    const p = profileFromC(profile);
     return p.getGpuClockPercent();
 }
 
 /// Get memory clock percent for a profile
 export fn nvprime_profile_mem_clock_percent(profile: NvPerformanceProfile) u32 {
-    const p: nvcore.PerformanceProfile = switch (profile) {
-        .maximum => .maximum,
-        .balanced => .balanced,
-        .efficient => .efficient,
-        .quiet => .quiet,
-    };
+    const p = profileFromC(profile);
     return p.getMemClockPercent();
 }
 
 /// Get power limit percent for a profile
 export fn nvprime_profile_power_limit_percent(profile: NvPerformanceProfile) u32 {
-    const p: nvcore.PerformanceProfile = switch (profile) {
-        .maximum => .maximum,
-        .balanced => .balanced,
-        .efficient => .efficient,
-        .quiet => .quiet,
-    };
+    const p = profileFromC(profile);
     return p.getPowerLimitPercent();
 }
+
+/// Start a tuning transaction for a GPU. Returns NULL on allocation failure.
+export fn nvprime_tuning_begin(index: u32) ?*anyopaque {
+    const handle = std.heap.page_allocator.create(TuningHandle) catch return null;
+    handle.* = .{ .tx = tuning.Transaction.init(index) };
+    return handle;
+}
+
+/// Stage V/F curve clock offsets in MHz
+export fn nvprime_tuning_set_clock_offsets(handle: ?*anyopaque, gpu_offset_mhz: i32, mem_offset_mhz: i32) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    h.tx.clock_offsets = .{ .gpu_offset_mhz = gpu_offset_mhz, .mem_offset_mhz = mem_offset_mhz };
+    return 0;
+}
+
+/// Stage a locked graphics clock range in MHz
+export fn nvprime_tuning_lock_gpu_clocks(handle: ?*anyopaque, min_mhz: u32, max_mhz: u32) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    if (min_mhz > max_mhz) return -1;
+    h.tx.gpu_lock = .{ .range = .{ .min_mhz = min_mhz, .max_mhz = max_mhz } };
+    return 0;
+}
+
+/// Stage a locked memory clock range in MHz
+export fn nvprime_tuning_lock_mem_clocks(handle: ?*anyopaque, min_mhz: u32, max_mhz: u32) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    if (min_mhz > max_mhz) return -1;
+    h.tx.mem_lock = .{ .range = .{ .min_mhz = min_mhz, .max_mhz = max_mhz } };
+    return 0;
+}
+
+/// Stage a return of both clock domains to driver control
+export fn nvprime_tuning_unlock_clocks(handle: ?*anyopaque) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    h.tx.gpu_lock = .reset;
+    h.tx.mem_lock = .reset;
+    return 0;
+}
+
+/// Stage a power limit in milliwatts
+export fn nvprime_tuning_set_power_limit(handle: ?*anyopaque, limit_mw: u32) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    h.tx.power_limit = .{ .milliwatts = limit_mw };
+    return 0;
+}
+
+/// Stage a fixed fan speed (0-100)
+export fn nvprime_tuning_set_fan_speed(handle: ?*anyopaque, speed_percent: u32) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    if (speed_percent > 100) return -1;
+    h.tx.fan = .{ .percent = speed_percent };
+    return 0;
+}
+
+/// Stage a return of the fans to driver control
+export fn nvprime_tuning_set_fan_auto(handle: ?*anyopaque) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    h.tx.fan = .auto;
+    return 0;
+}
+
+/// Stage the clock caps and power limit of a performance profile
+export fn nvprime_tuning_stage_profile(handle: ?*anyopaque, profile: NvPerformanceProfile) c_int {
+    const h = TuningHandle.editable(handle) orelse return -1;
+    h.tx.stageProfile(profileFromC(profile));
+    return 0;
+}
+
+/// Apply the staged changes on the tuning worker and return immediately.
+/// The callback (optional) runs on the worker when the batch finished.
+/// Returns 0 if queued, -1 if invalid or still pending (the previous callback
+/// included), -2 if the worker could not start.
+export fn nvprime_tuning_commit(handle: ?*anyopaque, callback: ?NvTuningCallback, user_data: ?*anyopaque) c_int {
+    const h: *TuningHandle = @ptrCast(@alignCast(handle orelse return -1));
+    // Claimed before the callback fields are written, so two commits
+    // cannot both pass
+    if (h.in_flight.cmpxchgStrong(false, true, .acq_rel, .acquire) != null) return -1;
+    h.callback = callback;
+    h.user_data = user_data;
+    _ = h.refs.fetchAdd(1, .acq_rel);
+    tuning.commit(h.tx, &h.future, tuningDone, h) catch |err| {
+        _ = h.refs.fetchSub(1, .acq_rel);
+        h.in_flight.store(false, .release);
+        return switch (err) {
+            error.NotFound, error.InUse => -1,
+            else => -2,
+        };
+    };
+    return 0;
+}
+
+/// Current status of a committed transaction
+export fn nvprime_tuning_status(handle: ?*anyopaque) NvTuningStatus {
+    const h: *TuningHandle = @ptrCast(@alignCast(handle orelse return .idle));
+    return @enumFromInt(@intFromEnum(h.future.poll()));
+}
+
+/// Wait for a committed transaction (timeout_ms < 0 waits forever).
+/// Returns NV_TUNING_PENDING if it is still running at the timeout.
+export fn nvprime_tuning_wait(handle: ?*anyopaque, timeout_ms: c_int) NvTuningStatus {
+    const h: *TuningHandle = @ptrCast(@alignCast(handle orelse return .idle));
+    const res = if (timeout_ms < 0)
+        h.future.wait()
+    else
+        h.future.timedWait(@as(u64, @intCast(timeout_ms)) * std.time.ns_per_ms) catch return .pending;
+    return @enumFromInt(@intFromEnum(res.status));
+}
+
+/// Step that failed (NV_TUNING_STEP_*), or -1 if none
+export fn nvprime_tuning_failed_step(handle: ?*anyopaque) c_int {
+    const h: *TuningHandle = @ptrCast(@alignCast(handle orelse return -1));
+    if (h.future.poll() == .pending) return -1;
+    const step = h.future.failed_step orelse return -1;
+    return @intFromEnum(step);
+}
+
+/// Release a transaction. Safe while it is pending; it is freed once done.
+export fn nvprime_tuning_free(handle: ?*anyopaque) void {
+    const h: *TuningHandle = @ptrCast(@alignCast(handle orelse return));
+    h.release();
+}
@@ -0,0 +1,183 @@
+//! nvmon C API exports
+//!
+//! Provides C ABI-compatible functions for batched telemetry sampling.
+
+const std = @import("std");
+const nvprime = @import("nvprime");
+const nvmon = nvprime.nvmon;
+const sampler = nvmon.sampler;
+const events = nvmon.events;
+const recorder = nvmon.recorder;
+const trace = nvmon.trace;
+
+/// C-compatible telemetry sample (nvmon.GpuSample is already extern)
+pub const NvGpuSample = nvmon.GpuSample;
+
+/// C-compatible GPU event (nvmon.events.Event is already extern)
+pub const NvGpuEvent = events.Event;
+
+/// C event callback
+pub const NvEventCallback = events.Callback;
+
+/// C-compatible decoded recorder frame (recorder.Frame is already extern)
+pub const NvRecordedFrame = recorder.Frame;
+
+/// Open recording plus its read position, handed to C as an opaque pointer
+const RecordingHandle = struct {
+    recording: recorder.Recording,
+    iterator: recorder.Iterator,
+};
+
+// ============================================================================
+// C ABI Exports
+// ============================================================================
+
+/// Sample every GPU in one pass into a caller-owned array.
+/// Returns the number of samples written, or -1 on error.
+export fn nvprime_sample_all(out: [*]NvGpuSample, max: u32, field_mask: u64) c_int {
+    const n = nvmon.sampleAll(out[0..max], field_mask) catch return -1;
+    return @intCast(n);
+}
+
+/// Duration of the most recent nvprime_sample_all pass in nanoseconds
+export fn nvprime_sample_last_duration_ns() u64 {
+    return nvmon.lastPassDurationNs();
+}
+
+/// Start the background sampler thread
+export fn nvprime_sampler_start(interval_ms: u32, field_mask: u64) c_int {
+    sampler.start(.{ .interval_ms = interval_ms, .field_mask = field_mask }) catch return -1;
+    return 0;
+}
+
+/// Stop the background sampler thread
+export fn nvprime_sampler_stop() void {
+    sampler.stop();
+}
+
+/// Check if the background sampler is running
+export fn nvprime_sampler_is_running() bool {
+    return sampler.isRunning();
+}
+
+/// Whether telemetry is being served by the nvprime daemon's shared segment
+export fn nvprime_daemon_attached() bool {
+    const reader = sampler.attachedReader() orelse return false;
+    return reader.isAlive();
+}
+
+/// Copy the latest background sample for a GPU
+export fn nvprime_sampler_get_latest(index: u32, out: *NvGpuSample) c_int {
+    out.* = sampler.latest(index) orelse return -1;
+    return 0;
+}
+
+/// Start the GPU event monitor for the given NV_EVENT_* kinds
+export fn nvprime_events_start(kind_mask: u32) c_int {
+    events.start(.{ .kinds = kind_mask }) catch return -1;
+    return 0;
+}
+
+/// Stop the GPU event monitor
+export fn nvprime_events_stop() void {
+    events.stop();
+}
+
+/// Get a pollable file descriptor signalled when events are queued (-1 if not started)
+export fn nvprime_events_get_fd() c_int {
+    const fd = events.getFd() orelse return -1;
+    return @intCast(fd);
+}
+
+/// Drain queued events. Returns the number written.
+export fn nvprime_events_poll(out: [*]NvGpuEvent, max: u32) c_int {
+    return @intCast(events.poll(out[0..max]));
+}
+
+/// Register an event callback. Returns a subscription id, or -1 on error.
+export fn nvprime_events_add_callback(callback: NvEventCallback, user_data: ?*anyopaque) c_int {
+    const id = events.addCallback(callback, user_data) catch return -1;
+    return @intCast(id);
+}
+
+/// Remove an event callback
+export fn nvprime_events_remove_callback(id: u32) void {
+    events.removeCallback(id);
+}
+
+/// Start recording telemetry to a ring file (frames every interval_ms,
+/// keeping the last duration_s seconds; 0 selects the defaults)
+export fn nvprime_recorder_start(path: [*:0]const u8, interval_ms: u32, duration_s: u32) c_int {
+    var config = recorder.Config{};
+    if (interval_ms > 0) config.interval_ms = interval_ms;
+    if (duration_s > 0) config.duration_s = duration_s;
+    recorder.start(std.mem.span(path), config) catch return -1;
+    return 0;
+}
+
+/// Stop the flight recorder
+export fn nvprime_recorder_stop() void {
+    recorder.stop();
+}
+
+/// Report a presented frame to the recorder; lock-free, safe from the render thread
+export fn nvprime_recorder_record_frame(frame_time_ns: u64, latency_ns: u64) void {
+    recorder.recordFrame(frame_time_ns, latency_ns);
+}
+
+/// Open a recording for reading. Returns null on error.
+export fn nvprime_recording_open(path: [*:0]const u8) ?*anyopaque {
+    const handle = std.heap.page_allocator.create(RecordingHandle) catch return null;
+    handle.recording = recorder.Recording.open(std.mem.span(path)) catch {
+        std.heap.page_allocator.destroy(handle);
+        return null;
+    };
+    handle.iterator = handle.recording.frames();
+    return handle;
+}
+
+/// Decode the next frame. Returns 1 if a frame was written, 0 at the end.
+export fn nvprime_recording_next(handle: ?*anyopaque, out: *NvRecordedFrame) c_int {
+    const h: *RecordingHandle = @ptrCast(@alignCast(handle orelse return -1));
+    return @intFromBool(h.iterator.next(out));
+}
+
+/// Restart from the oldest frame, picking up frames written since open
+export fn nvprime_recording_rewind(handle: ?*anyopaque) void {
+    const h: *RecordingHandle = @ptrCast(@alignCast(handle orelse return));
+    h.iterator = h.recording.frames();
+}
+
+/// Number of GPUs in each frame of the recording
+export fn nvprime_recording_gpu_count(handle: ?*anyopaque) u32 {
+    const h: *RecordingHandle = @ptrCast(@alignCast(handle orelse return 0));
+    return h.recording.header.gpu_count;
+}
+
+export fn nvprime_recording_close(handle: ?*anyopaque) void {
+    const h: *RecordingHandle = @ptrCast(@alignCast(handle orelse return));
+    h.recording.close();
+    std.heap.page_allocator.destroy(h);
+}
+
+/// Whether tracing was compiled in (-Dtrace=true)
+export fn nvprime_trace_available() bool {
+    return trace.enabled;
+}
+
+/// Start recording trace events
+export fn nvprime_trace_start() void {
+    trace.start();
+}
+
+/// Stop recording trace events
+export fn nvprime_trace_stop() void {
+    trace.stop();
+}
+
+/// Stop recording and write buffered events as Chrome trace JSON
+export fn nvprime_trace_dump(path: [*:0]const u8) c_int {
+    if (!trace.enabled) return -2;
+    trace.dumpToFile(std.mem.span(path)) catch return -1;
+    return 0;
+}
@@ -6,6 +6,9 @@ const std = @import("std");
 const nvprime = @import("nvprime");
 const nvpower = nvprime.nvpower;
 const nvml = nvprime.nvml;
+const registry = nvprime.nvcaps.registry;
+const sampler = nvprime.nvmon.sampler;
+const events = nvprime.nvmon.events;
 
 /// C-compatible fan mode
 pub const NvFanMode = enum(c_int) {
@@ -104,49 +107,82 @@ export fn nvprime_power_get_health(index: u32) NvPowerHealth {
 
 /// Check if GPU is thermal throttling
 export fn nvprime_power_is_thermal_throttling(index: u32) bool {
+    if (nvpower.getThrottleReasons(index)) |reasons| {
+        return events.isThermalThrottle(reasons);
+    } else |_| {}
     const state = nvpower.getState(index) catch return false;
     return state.isThermalThrottling();
 }
 
 /// Check if GPU is power throttling
 export fn nvprime_power_is_power_throttling(index: u32) bool {
+    if (nvpower.getThrottleReasons(index)) |reasons| {
+        return events.isPowerThrottle(reasons);
+    } else |_| {}
     const state = nvpower.getState(index) catch return false;
     return state.isPowerThrottling();
 }
 
+/// Get current clock throttle reasons (NV_THROTTLE_* bits), 0 if unavailable
+export fn nvprime_power_get_throttle_reasons(index: u32) u64 {
+    return nvpower.getThrottleReasons(index) catch 0;
+}
+
 /// Get current power draw in watts
 export fn nvprime_power_get_power_draw(index: u32) f32 {
-    const device = nvml.getDeviceByIndex(index) catch return -1.0;
+    if (sampler.latestWith(index, .power_draw)) |sample| return sample.powerDrawW();
+    const device = registry.getDevice(index) catch return -1.0;
     const power = nvml.getDevicePowerUsage(device) catch return -1.0;
     return @as(f32, @floatFromInt(power)) / 1000.0;
 }
 
 /// Get current power limit in watts
 export fn nvprime_power_get_power_limit(index: u32) f32 {
-    const device = nvml.getDeviceByIndex(index) catch return -1.0;
+    if (sampler.latestWith(index, .power_limit)) |sample| return sample.powerLimitW();
+    const device = registry.getDevice(index) catch return -1.0;
     const limit = nvml.getDevicePowerLimit(device) catch return -1.0;
     return @as(f32, @floatFromInt(limit)) / 1000.0;
 }
 
 /// Set power limit in milliwatts (requires root/admin)
 export fn nvprime_power_set_power_limit(index: u32, limit_mw: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
+    const device = registry.getDevice(index) catch return -1;
     nvml.setDevicePowerLimit(device, limit_mw) catch return -2;
     return 0;
 }
 
-/// Get GPU temperature in Celsius
-export fn nvprime_power_get_temperature(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch return -1;
-    return @intCast(temp);
+// Temperature and fan speed getters are generated in fields_capi.zig
+
+/// C-compatible fan curve preset
+pub const NvFanPreset = enum(c_int) {
+    silent = 0,
+    balanced = 1,
+    performance = 2,
+    aggressive = 3,
+};
+
+/// Run a preset fan curve on a GPU from the background sampler (requires root)
+export fn nvprime_fan_apply_preset(index: u32, preset: NvFanPreset) c_int {
+    const p: nvpower.fans.FanPreset = switch (preset) {
+        .silent => .silent,
+        .balanced => .balanced,
+        .performance => .performance,
+        .aggressive => .aggressive,
+    };
+    nvpower.fans.applyPreset(index, p) catch return -1;
+    return 0;
+}
+
+/// Set a fixed fan speed in percent, stopping any curve (requires root)
+export fn nvprime_fan_set_speed(index: u32, speed_percent: u32) c_int {
+    nvpower.fans.setSpeed(index, speed_percent) catch return -1;
+    return 0;
 }
 
-/// Get fan speed percentage (0-100)
-export fn nvprime_power_get_fan_speed(index: u32) c_int {
-    const device = nvml.getDeviceByIndex(index) catch return -1;
-    const speed = nvml.getDeviceFanSpeed(device) catch return -1;
-    return @intCast(speed);
+/// Return fans to driver control, stopping any curve (requires root)
+export fn nvprime_fan_set_auto(index: u32) c_int {
+    nvpower.fans.setAuto(index) catch return -1;
+    return 0;
 }
 
 /// Get efficiency mode power limit percentage
@@ -170,3 +206,57 @@ export fn nvprime_efficiency_thermal_target(mode: NvEfficiencyMode) u32 {
     };
     return m.thermalTarget();
 }
+
+/// C-compatible auto-tuner state
+pub const NvAutotuneStatus = extern struct {
+    /// 0 = not running, 1 = sweeping, 2 = holding
+    phase: c_int,
+    device_index: u32,
+    /// Current level (percent of default power limit and max clock)
+    level_percent: u32,
+    point_count: u32,
+    /// Operating point found so far (0 if none)
+    knee_level_percent: u32,
+    knee_fps: f32,
+    knee_watts: f32,
+};
+
+/// Start the perf-per-watt auto-tuner for a game (requires root).
+/// Returns 0 on success, -1 on invalid arguments or if already running, -2 on failure.
+export fn nvprime_autotune_start(index: u32, exe_name: [*:0]const u8, fps_floor: f32) c_int {
+    nvpower.autotune.start(index, std.mem.span(exe_name), .{ .fps_floor = fps_floor }) catch |err| return switch (err) {
+        error.InvalidArgument, error.InUse => -1,
+        else => -2,
+    };
+    return 0;
+}
+
+/// Stop the auto-tuner, cache its curve and restore the power limit and
+/// clocks from before start
+export fn nvprime_autotune_stop() void {
+    nvpower.autotune.stop();
+}
+
+/// Report a presented frame to the auto-tuner (cheap, call every frame)
+export fn nvprime_autotune_record_frame() void {
+    nvpower.autotune.recordFrame();
+}
+
+/// Get the auto-tuner state. Returns 0 (phase 0 when it is not running).
+export fn nvprime_autotune_get_status(out_status: *NvAutotuneStatus) c_int {
+    out_status.* = std.mem.zeroes(NvAutotuneStatus);
+    const status = nvpower.autotune.status() orelse return 0;
+    out_status.phase = switch (status.phase) {
+        .sweeping => 1,
+        .holding => 2,
+    };
+    out_status.device_index = status.device_index;
+    out_status.level_percent = status.level;
+    out_status.point_count = @intCast(status.points);
+    if (status.knee) |knee| {
+        out_status.knee_level_percent = knee.level;
+        out_status.knee_fps = knee.fps;
+        out_status.knee_watts = knee.watts;
+    }
+    return 0;
+}
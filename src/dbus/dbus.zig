@@ -8,15 +8,29 @@
 //! - com.nvidia.NVPrime.Power: Power management
 //! - com.nvidia.NVPrime.Performance: Performance profiles
 //!
+//! GPU telemetry is exposed as properties on /com/nvidia/NVPrime/GPU<n>.
+//! Clients read them in one round trip with GetAll and then follow
+//! PropertiesChanged, which is coalesced per GPU: a property is only
+//! signalled once it moves past its threshold, and at most once per
+//! `ServiceOptions.min_signal_interval_ms`. Values come from the nvmon
+//! sampler cache (or the nvprime daemon's segment), never from NVML per call.
+//!
 //! Example usage with dbus-send:
 //! ```
 //! dbus-send --session --dest=com.nvidia.NVPrime \
 //!   --print-reply /com/nvidia/NVPrime/GPU0 \
-//!   com.nvidia.NVPrime.GPU.GetTemperature
+//!   org.freedesktop.DBus.Properties.GetAll string:com.nvidia.NVPrime.GPU
 //! ```
 
 const std = @import("std");
 const root = @import("../root.zig");
+const events = root.nvmon.events;
+const sampler = root.nvmon.sampler;
+const fields = root.nvmon.fields;
+const registry = root.nvcaps.registry;
+
+const posix = std.posix;
+const linux = std.os.linux;
 
 /// D-Bus service configuration
 pub const config = struct {
@@ -26,6 +40,9 @@ pub const config = struct {
     pub const interface_gpu = "com.nvidia.NVPrime.GPU";
     pub const interface_power = "com.nvidia.NVPrime.Power";
     pub const interface_perf = "com.nvidia.NVPrime.Performance";
+
+    pub const interface_properties = "org.freedesktop.DBus.Properties";
+    pub const interface_introspectable = "org.freedesktop.DBus.Introspectable";
 };
 
 /// D-Bus error codes
@@ -43,20 +60,38 @@ const SdBus = struct {
         @cInclude("systemd/sd-bus.h");
     });
 
+    const MessageHandler = *const fn (?*c.sd_bus_message, ?*anyopaque, ?*c.sd_bus_error) callconv(.c) c_int;
+
     // Function pointers for dynamic loading
     bus_open_user: ?*const fn (*?*c.sd_bus) callconv(.c) c_int = null,
     bus_request_name: ?*const fn (*c.sd_bus, [*:0]const u8, u64) callconv(.c) c_int = null,
     bus_process: ?*const fn (*c.sd_bus, ?*?*c.sd_bus_message) callconv(.c) c_int = null,
     bus_wait: ?*const fn (*c.sd_bus, u64) callconv(.c) c_int = null,
+    bus_get_fd: ?*const fn (*c.sd_bus) callconv(.c) c_int = null,
+    bus_get_events: ?*const fn (*c.sd_bus) callconv(.c) c_int = null,
+    bus_get_timeout: ?*const fn (*c.sd_bus, *u64) callconv(.c) c_int = null,
     bus_flush_close_unref: ?*const fn (*c.sd_bus) callconv(.c) ?*c.sd_bus = null,
-    bus_add_object_vtable: ?*const fn (
+    bus_add_fallback: ?*const fn (*c.sd_bus, ?*?*c.sd_bus_slot, [*:0]const u8, MessageHandler, ?*anyopaque) callconv(.c) c_int = null,
+    bus_send: ?*const fn (*c.sd_bus, *c.sd_bus_message, ?*u64) callconv(.c) c_int = null,
+    bus_emit_signal: ?*const fn (
         *c.sd_bus,
-        ?*?*c.sd_bus_slot,
         [*:0]const u8,
         [*:0]const u8,
-        [*]const c.sd_bus_vtable,
-        ?*anyopaque,
+        [*:0]const u8,
+        [*:0]const u8,
+        ...,
     ) callconv(.c) c_int = null,
+    bus_reply_method_errorf: ?*const fn (*c.sd_bus_message, [*:0]const u8, [*:0]const u8, ...) callconv(.c) c_int = null,
+
+    message_is_method_call: ?*const fn (*c.sd_bus_message, ?[*:0]const u8, [*:0]const u8) callconv(.c) c_int = null,
+    message_get_path: ?*const fn (*c.sd_bus_message) callconv(.c) ?[*:0]const u8 = null,
+    message_read: ?*const fn (*c.sd_bus_message, [*:0]const u8, ...) callconv(.c) c_int = null,
+    message_new_method_return: ?*const fn (*c.sd_bus_message, *?*c.sd_bus_message) callconv(.c) c_int = null,
+    message_new_signal: ?*const fn (*c.sd_bus, *?*c.sd_bus_message, [*:0]const u8, [*:0]const u8, [*:0]const u8) callconv(.c) c_int = null,
+    message_append: ?*const fn (*c.sd_bus_message, [*:0]const u8, ...) callconv(.c) c_int = null,
+    message_open_container: ?*const fn (*c.sd_bus_message, u8, [*:0]const u8) callconv(.c) c_int = null,
+    message_close_container: ?*const fn (*c.sd_bus_message) callconv(.c) c_int = null,
+    message_unref: ?*const fn (*c.sd_bus_message) callconv(.c) ?*c.sd_bus_message = null,
 
     handle: ?*anyopaque = null,
 
@@ -82,24 +117,310 @@ const SdBus = struct {
         self.bus_request_name = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_request_name"));
         self.bus_process = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_process"));
         self.bus_wait = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_wait"));
+        self.bus_get_fd = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_get_fd"));
+        self.bus_get_events = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_get_events"));
+        self.bus_get_timeout = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_get_timeout"));
         self.bus_flush_close_unref = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_flush_close_unref"));
-        self.bus_add_object_vtable = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_add_object_vtable"));
+        self.bus_add_fallback = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_add_fallback"));
+        self.bus_send = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_send"));
+        self.bus_emit_signal = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_emit_signal"));
+        self.bus_reply_method_errorf = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_reply_method_errorf"));
+        self.message_is_method_call = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_is_method_call"));
+        self.message_get_path = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_get_path"));
+        self.message_read = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_read"));
+        self.message_new_method_return = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_new_method_return"));
+        self.message_new_signal = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_new_signal"));
+        self.message_append = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_append"));
+        self.message_open_container = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_open_container"));
+        self.message_close_container = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_close_container"));
+        self.message_unref = @ptrCast(dlopen.dlsym(self.handle, "sd_bus_message_unref"));
 
         return self;
     }
+
+    /// Everything the property service needs
+    fn hasServiceSymbols(self: *const SdBus) bool {
+        inline for (std.meta.fields(SdBus)) |field| {
+            if (comptime std.mem.eql(u8, field.name, "handle")) continue;
+            if (@field(self, field.name) == null) return false;
+        }
+        return true;
+    }
+};
+
+/// Exported GPU properties
+pub const Property = enum(u5) {
+    name,
+    architecture,
+    temperature,
+    power_draw,
+    gpu_clock,
+    mem_clock,
+    utilization,
+    mem_utilization,
+    vram_used,
+    vram_total,
+    fan_speed,
+    pstate,
+
+    pub fn dbusName(self: Property) [:0]const u8 {
+        return switch (self) {
+            .name => "Name",
+            .architecture => "Architecture",
+            // Telemetry names come from the nvmon field table
+            inline else => |prop| comptime fields.get(@field(fields.Id, @tagName(prop))).dbus_name.?,
+        };
+    }
+
+    pub fn fromDbusName(name: []const u8) ?Property {
+        for (std.enums.values(Property)) |prop| {
+            if (std.mem.eql(u8, prop.dbusName(), name)) return prop;
+        }
+        return null;
+    }
+
+    pub fn bit(self: Property) PropertyMask {
+        return @as(PropertyMask, 1) << @intFromEnum(self);
+    }
+};
+
+/// Bitmask of `Property` values
+pub const PropertyMask = u32;
+
+/// One property value in D-Bus terms
+pub const Value = union(enum) {
+    string: [*:0]const u8, // s
+    uint: u32, // u
+    uint64: u64, // t
+    double: f64, // d
+};
+
+/// GPU information for D-Bus export. Fixed-size, so building and diffing it
+/// never allocates.
+pub const GpuInfo = struct {
+    index: u32 = 0,
+    /// Properties that hold real values
+    valid: PropertyMask = 0,
+    name: [96]u8 = [_]u8{0} ** 96,
+    architecture: [:0]const u8 = "unknown",
+    temperature_c: u32 = 0,
+    power_draw_w: f64 = 0,
+    gpu_clock_mhz: u32 = 0,
+    mem_clock_mhz: u32 = 0,
+    utilization_percent: u32 = 0,
+    mem_utilization_percent: u32 = 0,
+    vram_used_mb: u64 = 0,
+    vram_total_mb: u64 = 0,
+    fan_speed_percent: u32 = 0,
+    pstate: u32 = 0,
+
+    pub fn getName(self: *const GpuInfo) []const u8 {
+        return std.mem.sliceTo(&self.name, 0);
+    }
+
+    pub fn has(self: *const GpuInfo, prop: Property) bool {
+        return self.valid & prop.bit() != 0;
+    }
+
+    pub fn setName(self: *GpuInfo, name: []const u8) void {
+        const len = @min(name.len, self.name.len - 1);
+        self.name = [_]u8{0} ** 96;
+        @memcpy(self.name[0..len], name[0..len]);
+        self.valid |= Property.name.bit();
+    }
+
+    /// Fill the dynamic properties from a telemetry sample
+    pub fn applySample(self: *GpuInfo, sample: root.nvmon.GpuSample) void {
+        if (sample.has(.temperature)) {
+            self.temperature_c = sample.temperature_c;
+            self.valid |= Property.temperature.bit();
+        }
+        if (sample.has(.power_draw)) {
+            self.power_draw_w = @as(f64, @floatFromInt(sample.power_draw_mw)) / 1000.0;
+            self.valid |= Property.power_draw.bit();
+        }
+        if (sample.has(.gpu_clock)) {
+            self.gpu_clock_mhz = sample.gpu_clock_mhz;
+            self.valid |= Property.gpu_clock.bit();
+        }
+        if (sample.has(.mem_clock)) {
+            self.mem_clock_mhz = sample.mem_clock_mhz;
+            self.valid |= Property.mem_clock.bit();
+        }
+        if (sample.has(.utilization)) {
+            self.utilization_percent = sample.gpu_utilization;
+            self.mem_utilization_percent = sample.mem_utilization;
+            self.valid |= Property.utilization.bit() | Property.mem_utilization.bit();
+        }
+        if (sample.has(.vram)) {
+            self.vram_used_mb = sample.vram_used_mb;
+            self.vram_total_mb = sample.vram_total_mb;
+            self.valid |= Property.vram_used.bit() | Property.vram_total.bit();
+        }
+        if (sample.has(.fan_speed)) {
+            self.fan_speed_percent = sample.fan_speed_percent;
+            self.valid |= Property.fan_speed.bit();
+        }
+        if (sample.has(.pstate)) {
+            self.pstate = sample.pstate;
+            self.valid |= Property.pstate.bit();
+        }
+    }
+
+    pub fn value(self: *const GpuInfo, prop: Property) Value {
+        return switch (prop) {
+            .name => .{ .string = @ptrCast(&self.name) },
+            .architecture => .{ .string = self.architecture.ptr },
+            .temperature => .{ .uint = self.temperature_c },
+            .power_draw => .{ .double = self.power_draw_w },
+            .gpu_clock => .{ .uint = self.gpu_clock_mhz },
+            .mem_clock => .{ .uint = self.mem_clock_mhz },
+            .utilization => .{ .uint = self.utilization_percent },
+            .mem_utilization => .{ .uint = self.mem_utilization_percent },
+            .vram_used => .{ .uint64 = self.vram_used_mb },
+            .vram_total => .{ .uint64 = self.vram_total_mb },
+            .fan_speed => .{ .uint = self.fan_speed_percent },
+            .pstate => .{ .uint = self.pstate },
+        };
+    }
+
+    /// Copy one property (and its validity) from `other`
+    fn copyProperty(self: *GpuInfo, other: *const GpuInfo, prop: Property) void {
+        switch (prop) {
+            .name => self.name = other.name,
+            .architecture => self.architecture = other.architecture,
+            .temperature => self.temperature_c = other.temperature_c,
+            .power_draw => self.power_draw_w = other.power_draw_w,
+            .gpu_clock => self.gpu_clock_mhz = other.gpu_clock_mhz,
+            .mem_clock => self.mem_clock_mhz = other.mem_clock_mhz,
+            .utilization => self.utilization_percent = other.utilization_percent,
+            .mem_utilization => self.mem_utilization_percent = other.mem_utilization_percent,
+            .vram_used => self.vram_used_mb = other.vram_used_mb,
+            .vram_total => self.vram_total_mb = other.vram_total_mb,
+            .fan_speed => self.fan_speed_percent = other.fan_speed_percent,
+            .pstate => self.pstate = other.pstate,
+        }
+        self.valid = (self.valid & ~prop.bit()) | (other.valid & prop.bit());
+    }
+};
+
+/// Smallest change that is worth a PropertiesChanged signal
+pub const ChangeThresholds = struct {
+    temperature_c: u32 = 1,
+    power_draw_w: f64 = 5.0,
+    clock_mhz: u32 = 50,
+    utilization_percent: u32 = 5,
+    vram_mb: u64 = 64,
+    fan_speed_percent: u32 = 5,
+};
+
+/// Properties of `current` that moved past their threshold since `previous`
+pub fn changedProperties(previous: *const GpuInfo, current: *const GpuInfo, thresholds: ChangeThresholds) PropertyMask {
+    var mask: PropertyMask = 0;
+    for (std.enums.values(Property)) |prop| {
+        if (!current.has(prop)) continue;
+        if (!previous.has(prop)) {
+            mask |= prop.bit();
+            continue;
+        }
+        const changed = switch (prop) {
+            .name => !std.mem.eql(u8, previous.getName(), current.getName()),
+            .architecture => !std.mem.eql(u8, previous.architecture, current.architecture),
+            .temperature => absDiff(previous.temperature_c, current.temperature_c) >= thresholds.temperature_c,
+            .power_draw => @abs(previous.power_draw_w - current.power_draw_w) >= thresholds.power_draw_w,
+            .gpu_clock => absDiff(previous.gpu_clock_mhz, current.gpu_clock_mhz) >= thresholds.clock_mhz,
+            .mem_clock => absDiff(previous.mem_clock_mhz, current.mem_clock_mhz) >= thresholds.clock_mhz,
+            .utilization => absDiff(previous.utilization_percent, current.utilization_percent) >= thresholds.utilization_percent,
+            .mem_utilization => absDiff(previous.mem_utilization_percent, current.mem_utilization_percent) >= thresholds.utilization_percent,
+            .vram_used => absDiff(previous.vram_used_mb, current.vram_used_mb) >= thresholds.vram_mb,
+            .vram_total => previous.vram_total_mb != current.vram_total_mb,
+            .fan_speed => absDiff(previous.fan_speed_percent, current.fan_speed_percent) >= thresholds.fan_speed_percent,
+            .pstate => previous.pstate != current.pstate,
+        };
+        if (changed) mask |= prop.bit();
+    }
+    return mask;
+}
+
+fn absDiff(a: anytype, b: @TypeOf(a)) @TypeOf(a) {
+    return if (a > b) a - b else b - a;
+}
+
+/// Per-GPU PropertiesChanged coalescing. Changes are measured against the
+/// last values signalled, so slow drifts still get reported once they add up.
+pub const Coalescer = struct {
+    thresholds: ChangeThresholds = .{},
+    min_interval_ns: u64 = std.time.ns_per_s,
+    published: GpuInfo = .{},
+    last_signal_ns: u64 = 0,
+
+    /// Treat `current` as already known to clients (e.g. at startup)
+    pub fn reset(self: *Coalescer, current: GpuInfo) void {
+        self.published = current;
+    }
+
+    /// Properties to signal now (0 = nothing due). Returned properties are
+    /// recorded as published.
+    pub fn update(self: *Coalescer, current: *const GpuInfo, now_ns: u64) PropertyMask {
+        const changed = changedProperties(&self.published, current, self.thresholds);
+        if (changed == 0) return 0;
+        if (self.last_signal_ns != 0 and now_ns -| self.last_signal_ns < self.min_interval_ns) return 0;
+
+        for (std.enums.values(Property)) |prop| {
+            if (changed & prop.bit() != 0) self.published.copyProperty(current, prop);
+        }
+        self.last_signal_ns = now_ns;
+        return changed;
+    }
+};
+
+/// Service behaviour
+pub const ServiceOptions = struct {
+    thresholds: ChangeThresholds = .{},
+    /// Minimum time between PropertiesChanged signals for one GPU
+    min_signal_interval_ms: u32 = 1000,
+    /// How often the sampler cache is checked for changes
+    poll_interval_ms: u32 = 250,
+    /// Sampler period used when neither a sampler nor the daemon is running
+    sample_interval_ms: u32 = 250,
 };
 
 /// D-Bus service state
 pub const Service = struct {
     allocator: std.mem.Allocator,
+    options: ServiceOptions = .{},
     sdbus: ?SdBus = null,
-    running: bool = false,
+    bus: ?*SdBus.c.sd_bus = null,
+    event_subscription: ?u32 = null,
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    /// Events from the monitor thread, emitted by `iterate`: sd-bus objects
+    /// belong to the thread that drives them
+    event_mutex: std.Thread.Mutex = .{},
+    event_queue: [max_queued_events]events.Event = undefined,
+    event_count: usize = 0,
+    /// Wakes `iterate` when an event is queued
+    wake_fd: ?posix.fd_t = null,
+    /// Whether start() started the sampler (and stop() should stop it)
+    owns_sampler: bool = false,
+    /// Whether start() started the event monitor
+    owns_events: bool = false,
+    gpu_count: u32 = 0,
+    coalescers: [root.nvmon.max_gpus]Coalescer = undefined,
+    next_poll_ns: u64 = 0,
 
     const Self = @This();
 
+    /// Events a single loop iteration can fall behind by; later ones are dropped
+    const max_queued_events = 32;
+
     pub fn init(allocator: std.mem.Allocator) Self {
+        return initWithOptions(allocator, .{});
+    }
+
+    pub fn initWithOptions(allocator: std.mem.Allocator, options: ServiceOptions) Self {
         return Self{
             .allocator = allocator,
+            .options = options,
             .sdbus = SdBus.load(),
         };
     }
@@ -113,71 +434,407 @@ pub const Service = struct {
         return self.sdbus != null and self.sdbus.?.bus_open_user != null;
     }
 
-    /// Start the D-Bus service
+    /// Start the D-Bus service: claim the name, register the GPU objects and
+    /// make sure telemetry is being sampled. Call `run` (or `iterate` from an
+    /// existing loop) to serve requests.
     pub fn start(self: *Self) DbusError!void {
-        if (!self.isAvailable()) {
+        if (!self.isAvailable() or !self.sdbus.?.hasServiceSymbols()) {
             std.log.warn("D-Bus (systemd) not available", .{});
             return DbusError.LibraryNotFound;
         }
 
         std.log.info("Starting NVPrime D-Bus service: {s}", .{config.service_name});
-        self.running = true;
 
-        // Full implementation would:
-        // 1. sd_bus_open_user() to connect to session bus
-        // 2. sd_bus_request_name() to claim our service name
-        // 3. sd_bus_add_object_vtable() to register methods
-        // 4. Run event loop with sd_bus_process() / sd_bus_wait()
+        const sdbus = self.sdbus.?;
+        var bus: ?*SdBus.c.sd_bus = null;
+        if (sdbus.bus_open_user.?(&bus) < 0 or bus == null) {
+            return DbusError.ConnectionFailed;
+        }
+        errdefer _ = sdbus.bus_flush_close_unref.?(bus.?);
+
+        if (sdbus.bus_request_name.?(bus.?, config.service_name, 0) < 0) {
+            return DbusError.RequestNameFailed;
+        }
+        // One handler serves the base path and every GPU object below it
+        if (sdbus.bus_add_fallback.?(bus.?, null, config.object_path_base, handleMessage, self) < 0) {
+            return DbusError.ObjectPathInvalid;
+        }
+        self.bus = bus;
+
+        // Properties are served from the sampler cache; start it unless this
+        // process or the nvprime daemon already samples
+        if (!sampler.isRunning() and sampler.attachedReader() == null) {
+            sampler.start(.{ .interval_ms = self.options.sample_interval_ms }) catch |err| {
+                std.log.warn("Telemetry sampler unavailable: {s}", .{@errorName(err)});
+            };
+            self.owns_sampler = sampler.isRunning();
+        }
+
+        self.gpu_count = gpuCount();
+        const min_interval = @as(u64, self.options.min_signal_interval_ms) * std.time.ns_per_ms;
+        for (0..self.gpu_count) |i| {
+            self.coalescers[i] = .{ .thresholds = self.options.thresholds, .min_interval_ns = min_interval };
+            if (getGpuInfo(@intCast(i))) |info| self.coalescers[i].reset(info);
+        }
+
+        // Throttle transitions arrive from the event monitor, not from polling
+        const events_running = events.isRunning();
+        events.start(.{ .kinds = events.EventKind.thermal_warning.bit() | events.EventKind.power_limit_reached.bit() }) catch |err| {
+            std.log.warn("GPU event monitor unavailable: {s}", .{@errorName(err)});
+        };
+        self.owns_events = !events_running and events.isRunning();
+        self.wake_fd = posix.eventfd(0, linux.EFD.CLOEXEC | linux.EFD.NONBLOCK) catch |err| blk: {
+            // Queued events then wait for the next poll tick
+            std.log.warn("D-Bus event wakeup unavailable: {s}", .{@errorName(err)});
+            break :blk null;
+        };
+        self.event_subscription = events.addCallback(onGpuEvent, self) catch null;
+
+        self.running.store(true, .release);
     }
 
     /// Stop the D-Bus service
     pub fn stop(self: *Self) void {
-        if (!self.running) return;
-        self.running = false;
+        if (!self.running.swap(false, .acq_rel)) return;
+
+        // Returns once onGpuEvent is done with the queue
+        if (self.event_subscription) |id| events.removeCallback(id);
+        self.event_subscription = null;
+        if (self.wake_fd) |fd| posix.close(fd);
+        self.wake_fd = null;
+        self.event_count = 0;
+        if (self.owns_events) events.stop();
+        self.owns_events = false;
+
+        if (self.owns_sampler) sampler.stop();
+        self.owns_sampler = false;
+
+        if (self.bus) |bus| {
+            if (self.sdbus.?.bus_flush_close_unref) |close| _ = close(bus);
+        }
+        self.bus = null;
         std.log.info("NVPrime D-Bus service stopped", .{});
     }
-};
 
-/// GPU information for D-Bus export
-pub const GpuInfo = struct {
-    index: u32,
-    name: []const u8,
-    architecture: []const u8,
-    temperature_c: u32,
-    power_draw_w: f32,
-    gpu_clock_mhz: u32,
-    mem_clock_mhz: u32,
-    utilization_percent: u32,
-    vram_used_mb: u64,
-    vram_total_mb: u64,
-
-    /// Convert to D-Bus-friendly format (could use sd_bus_message_append)
-    pub fn toProperties(self: *const GpuInfo, allocator: std.mem.Allocator) !std.StringHashMap([]const u8) {
-        var props = std.StringHashMap([]const u8).init(allocator);
-
-        try props.put("Name", self.name);
-        try props.put("Architecture", self.architecture);
-
-        return props;
+    /// Serve requests and publish property changes until `stop` is called
+    pub fn run(self: *Self) DbusError!void {
+        while (self.running.load(.acquire)) try self.iterate();
+    }
+
+    /// Handle pending D-Bus traffic, publish any changes that are due, then
+    /// wait for more traffic or the next poll tick
+    pub fn iterate(self: *Self) DbusError!void {
+        const bus = self.bus orelse return DbusError.ConnectionFailed;
+        const sdbus = self.sdbus.?;
+
+        while (true) {
+            const r = sdbus.bus_process.?(bus, null);
+            if (r < 0) return DbusError.MethodCallFailed;
+            if (r == 0) break;
+        }
+
+        self.emitQueuedEvents();
+        const now = timestampNs();
+        if (now >= self.next_poll_ns) {
+            self.publishChanges(now);
+            self.next_poll_ns = now + @as(u64, @max(self.options.poll_interval_ms, 1)) * std.time.ns_per_ms;
+        }
+
+        const wait_us = (self.next_poll_ns -| timestampNs()) / std.time.ns_per_us;
+        try self.wait(bus, wait_us);
+    }
+
+    /// Wait up to `wait_us` for bus traffic, a bus timeout or a queued event
+    fn wait(self: *Self, bus: *SdBus.c.sd_bus, wait_us: u64) DbusError!void {
+        const sdbus = self.sdbus.?;
+        const wake_fd = self.wake_fd orelse {
+            if (sdbus.bus_wait.?(bus, wait_us) < 0) return DbusError.ConnectionFailed;
+            return;
+        };
+
+        const bus_fd = sdbus.bus_get_fd.?(bus);
+        const bus_events = sdbus.bus_get_events.?(bus);
+        if (bus_fd < 0 or bus_events < 0) return DbusError.ConnectionFailed;
+
+        // sd-bus timeouts are absolute CLOCK_MONOTONIC microseconds
+        var timeout_us = wait_us;
+        var deadline_us: u64 = std.math.maxInt(u64);
+        if (sdbus.bus_get_timeout.?(bus, &deadline_us) >= 0 and deadline_us != std.math.maxInt(u64)) {
+            timeout_us = @min(timeout_us, deadline_us -| timestampNs() / std.time.ns_per_us);
+        }
+
+        var fds = [_]posix.pollfd{
+            .{ .fd = bus_fd, .events = @intCast(bus_events), .revents = 0 },
+            .{ .fd = wake_fd, .events = posix.POLL.IN, .revents = 0 },
+        };
+        const timeout_ms: i32 = @intCast(@min(std.math.divCeil(u64, timeout_us, std.time.us_per_ms) catch 0, std.math.maxInt(i32)));
+        _ = posix.poll(&fds, timeout_ms) catch return DbusError.ConnectionFailed;
+        if (fds[1].revents & posix.POLL.IN != 0) {
+            var count: u64 = undefined;
+            _ = posix.read(wake_fd, std.mem.asBytes(&count)) catch {};
+        }
+    }
+
+    /// Emit the signals for events queued by the monitor thread
+    fn emitQueuedEvents(self: *Self) void {
+        var queued: [max_queued_events]events.Event = undefined;
+        self.event_mutex.lock();
+        const n = self.event_count;
+        @memcpy(queued[0..n], self.event_queue[0..n]);
+        self.event_count = 0;
+        self.event_mutex.unlock();
+
+        for (queued[0..n]) |*event| switch (event.kind) {
+            .thermal_warning => self.emitThermalWarning(event.gpu_index, @intCast(event.value), @intCast(event.aux)),
+            .power_limit_reached => self.emitPowerLimitReached(
+                event.gpu_index,
+                @as(f64, @floatFromInt(event.value)) / 1000.0,
+                @as(f64, @floatFromInt(event.aux)) / 1000.0,
+            ),
+            else => {},
+        };
+    }
+
+    /// Emit coalesced PropertiesChanged signals for every GPU
+    pub fn publishChanges(self: *Self, now_ns: u64) void {
+        for (0..self.gpu_count) |i| {
+            const info = getGpuInfo(@intCast(i)) orelse continue;
+            const changed = self.coalescers[i].update(&info, now_ns);
+            if (changed != 0) self.emitPropertiesChanged(@intCast(i), &info, changed);
+        }
+    }
+
+    /// Emit org.freedesktop.DBus.Properties.PropertiesChanged for `mask`
+    fn emitPropertiesChanged(self: *Self, index: u32, info: *const GpuInfo, mask: PropertyMask) void {
+        const bus = self.bus orelse return;
+        const sdbus = self.sdbus.?;
+        var path_buf: [64]u8 = undefined;
+        const path = gpuObjectPath(&path_buf, index) orelse return;
+
+        var msg: ?*SdBus.c.sd_bus_message = null;
+        if (sdbus.message_new_signal.?(bus, &msg, path, config.interface_properties, "PropertiesChanged") < 0) return;
+        const m = msg orelse return;
+        defer _ = sdbus.message_unref.?(m);
+
+        if (sdbus.message_append.?(m, "s", config.interface_gpu) < 0) return;
+        if (self.appendProperties(m, info, mask) < 0) return;
+        // No invalidated properties
+        if (sdbus.message_append.?(m, "as", @as(c_int, 0)) < 0) return;
+        _ = sdbus.bus_send.?(bus, m, null);
+    }
+
+    /// Append an a{sv} dictionary of the properties in `mask`
+    fn appendProperties(self: *const Self, m: *SdBus.c.sd_bus_message, info: *const GpuInfo, mask: PropertyMask) c_int {
+        const sdbus = self.sdbus.?;
+        var r = sdbus.message_open_container.?(m, 'a', "{sv}");
+        if (r < 0) return r;
+        for (std.enums.values(Property)) |prop| {
+            if (mask & prop.bit() == 0 or !info.has(prop)) continue;
+            r = self.appendProperty(m, info, prop, true);
+            if (r < 0) return r;
+        }
+        return sdbus.message_close_container.?(m);
+    }
+
+    /// Append one property, either as a {sv} dictionary entry or as a bare variant
+    fn appendProperty(self: *const Self, m: *SdBus.c.sd_bus_message, info: *const GpuInfo, prop: Property, entry: bool) c_int {
+        const append = self.sdbus.?.message_append.?;
+        const key = prop.dbusName().ptr;
+        return switch (info.value(prop)) {
+            .string => |v| if (entry) append(m, "{sv}", key, "s", v) else append(m, "v", "s", v),
+            .uint => |v| if (entry) append(m, "{sv}", key, "u", @as(c_uint, v)) else append(m, "v", "u", @as(c_uint, v)),
+            .uint64 => |v| if (entry) append(m, "{sv}", key, "t", @as(u64, v)) else append(m, "v", "t", @as(u64, v)),
+            .double => |v| if (entry) append(m, "{sv}", key, "d", v) else append(m, "v", "d", v),
+        };
+    }
+
+    /// sd-bus fallback handler for /com/nvidia/NVPrime and its children.
+    /// Returns 0 for calls it does not handle so sd-bus replies with an error.
+    fn handleMessage(msg: ?*SdBus.c.sd_bus_message, user_data: ?*anyopaque, _: ?*SdBus.c.sd_bus_error) callconv(.c) c_int {
+        const self: *Self = @ptrCast(@alignCast(user_data orelse return 0));
+        const m = msg orelse return 0;
+        const sdbus = self.sdbus.?;
+
+        const path = sdbus.message_get_path.?(m) orelse return 0;
+        const is_call = sdbus.message_is_method_call.?;
+
+        if (is_call(m, config.interface_introspectable, "Introspect") > 0) {
+            return self.replyIntrospect(m, std.mem.span(path));
+        }
+
+        const index = gpuIndexFromPath(std.mem.span(path)) orelse return 0;
+        if (index >= self.gpu_count) return 0;
+
+        if (is_call(m, config.interface_properties, "GetAll") > 0) {
+            var interface: ?[*:0]const u8 = null;
+            if (sdbus.message_read.?(m, "s", &interface) < 0) return 0;
+            const info = getGpuInfo(index) orelse GpuInfo{ .index = index };
+            // Only one interface lives on a GPU object; others are empty
+            const mask: PropertyMask = if (interface == null or matchesGpuInterface(std.mem.span(interface.?))) ~@as(PropertyMask, 0) else 0;
+            return self.reply(m, struct {
+                fn fill(s: *const Self, r: *SdBus.c.sd_bus_message, i: *const GpuInfo, k: PropertyMask) c_int {
+                    return s.appendProperties(r, i, k);
+                }
+            }.fill, &info, mask);
+        }
+
+        if (is_call(m, config.interface_properties, "Get") > 0) {
+            var interface: ?[*:0]const u8 = null;
+            var name: ?[*:0]const u8 = null;
+            if (sdbus.message_read.?(m, "ss", &interface, &name) < 0) return 0;
+            const info = getGpuInfo(index) orelse GpuInfo{ .index = index };
+            const prop = Property.fromDbusName(std.mem.span(name orelse return 0));
+            if (prop == null or !info.has(prop.?)) {
+                return sdbus.bus_reply_method_errorf.?(m, "org.freedesktop.DBus.Error.UnknownProperty", "Unknown property %s", name.?);
+            }
+            return self.reply(m, struct {
+                fn fill(s: *const Self, r: *SdBus.c.sd_bus_message, i: *const GpuInfo, k: PropertyMask) c_int {
+                    return s.appendProperty(r, i, @enumFromInt(@ctz(k)), false);
+                }
+            }.fill, &info, prop.?.bit());
+        }
+
+        return 0;
+    }
+
+    /// Build and send a method return whose body is written by `fill`
+    fn reply(
+        self: *const Self,
+        call: *SdBus.c.sd_bus_message,
+        comptime fill: fn (*const Self, *SdBus.c.sd_bus_message, *const GpuInfo, PropertyMask) c_int,
+        info: *const GpuInfo,
+        mask: PropertyMask,
+    ) c_int {
+        const sdbus = self.sdbus.?;
+        var msg: ?*SdBus.c.sd_bus_message = null;
+        var r = sdbus.message_new_method_return.?(call, &msg);
+        if (r < 0) return r;
+        const m = msg orelse return -1;
+        defer _ = sdbus.message_unref.?(m);
+
+        r = fill(self, m, info, mask);
+        if (r < 0) return r;
+        r = sdbus.bus_send.?(self.bus.?, m, null);
+        return if (r < 0) r else 1;
+    }
+
+    fn replyIntrospect(self: *const Self, call: *SdBus.c.sd_bus_message, path: []const u8) c_int {
+        const sdbus = self.sdbus.?;
+        var xml_buf: [1024]u8 = undefined;
+        const xml: [*:0]const u8 = if (std.mem.eql(u8, path, config.object_path_base)) blk: {
+            // Base object: list one child node per GPU so tools can walk the tree
+            var w = std.Io.Writer.fixed(&xml_buf);
+            w.writeAll("<node>\n") catch return 0;
+            for (0..self.gpu_count) |i| w.print("  <node name=\"GPU{d}\"/>\n", .{i}) catch return 0;
+            w.writeAll("</node>\n\x00") catch return 0;
+            break :blk @ptrCast(w.buffered().ptr);
+        } else if (gpuIndexFromPath(path)) |index| blk: {
+            if (index >= self.gpu_count) return 0;
+            break :blk gpu_introspection_xml;
+        } else return 0;
+
+        var msg: ?*SdBus.c.sd_bus_message = null;
+        var r = sdbus.message_new_method_return.?(call, &msg);
+        if (r < 0) return r;
+        const m = msg orelse return -1;
+        defer _ = sdbus.message_unref.?(m);
+        r = sdbus.message_append.?(m, "s", xml);
+        if (r < 0) return r;
+        r = sdbus.bus_send.?(self.bus.?, m, null);
+        return if (r < 0) r else 1;
+    }
+
+    /// Emit the ThermalWarning signal on a GPU object
+    pub fn emitThermalWarning(self: *Self, index: u32, temperature: u32, threshold: u32) void {
+        const bus = self.bus orelse return;
+        const emit = self.sdbus.?.bus_emit_signal orelse return;
+        var path_buf: [64]u8 = undefined;
+        const path = gpuObjectPath(&path_buf, index) orelse return;
+        _ = emit(bus, path, config.interface_gpu, "ThermalWarning", "uu", @as(c_uint, temperature), @as(c_uint, threshold));
+    }
+
+    /// Emit the PowerLimitReached signal on a GPU object
+    pub fn emitPowerLimitReached(self: *Self, index: u32, current_watts: f64, limit_watts: f64) void {
+        const bus = self.bus orelse return;
+        const emit = self.sdbus.?.bus_emit_signal orelse return;
+        var path_buf: [64]u8 = undefined;
+        const path = gpuObjectPath(&path_buf, index) orelse return;
+        _ = emit(bus, path, config.interface_gpu, "PowerLimitReached", "dd", current_watts, limit_watts);
+    }
+
+    /// Runs on the event monitor thread: queue the event and wake the loop
+    fn onGpuEvent(event: *const events.Event, user_data: ?*anyopaque) callconv(.c) void {
+        const self: *Self = @ptrCast(@alignCast(user_data orelse return));
+        switch (event.kind) {
+            .thermal_warning, .power_limit_reached => {},
+            else => return,
+        }
+
+        self.event_mutex.lock();
+        const queued = self.event_count < max_queued_events;
+        if (queued) {
+            self.event_queue[self.event_count] = event.*;
+            self.event_count += 1;
+        }
+        self.event_mutex.unlock();
+
+        if (!queued) return;
+        if (self.wake_fd) |fd| {
+            const one: u64 = 1;
+            _ = posix.write(fd, std.mem.asBytes(&one)) catch {};
+        }
     }
 };
 
-/// Get GPU info for D-Bus export
+/// Object path for a GPU ("/com/nvidia/NVPrime/GPU0")
+fn gpuObjectPath(buf: []u8, index: u32) ?[:0]const u8 {
+    return std.fmt.bufPrintZ(buf, "{s}/GPU{d}", .{ config.object_path_base, index }) catch null;
+}
+
+/// GPU index from an object path, or null if it is not a GPU object
+fn gpuIndexFromPath(path: []const u8) ?u32 {
+    const prefix = config.object_path_base ++ "/GPU";
+    if (!std.mem.startsWith(u8, path, prefix)) return null;
+    return std.fmt.parseInt(u32, path[prefix.len..], 10) catch null;
+}
+
+fn matchesGpuInterface(interface: []const u8) bool {
+    return interface.len == 0 or std.mem.eql(u8, interface, config.interface_gpu);
+}
+
+/// GPUs visible to this process, without initializing NVML when the daemon serves telemetry
+fn gpuCount() u32 {
+    if (!registry.isInitialized()) {
+        if (sampler.attachedReader()) |reader| return reader.gpuCount();
+    }
+    return @min(registry.count() catch 0, root.nvmon.max_gpus);
+}
+
+/// Get GPU info for D-Bus export. Dynamic values come from the sampler cache;
+/// name and architecture from the static capability cache (or the daemon's
+/// identity table), so this never queries NVML once warmed up.
 pub fn getGpuInfo(index: u32) ?GpuInfo {
-    const caps = root.nvcaps.getCapabilities() catch return null;
-
-    return GpuInfo{
-        .index = index,
-        .name = caps.name[0..caps.name_len],
-        .architecture = @tagName(caps.architecture),
-        .temperature_c = caps.temperature,
-        .power_draw_w = @as(f32, @floatFromInt(caps.power_usage)) / 1000.0,
-        .gpu_clock_mhz = caps.gpu_clock,
-        .mem_clock_mhz = caps.mem_clock,
-        .utilization_percent = caps.gpu_utilization,
-        .vram_used_mb = caps.vram_used / (1024 * 1024),
-        .vram_total_mb = caps.vram_total / (1024 * 1024),
-    };
+    var info = GpuInfo{ .index = index };
+
+    const reader = if (registry.isInitialized()) null else sampler.attachedReader();
+    if (reader) |r| {
+        const id = r.identity(index) orelse return null;
+        info.setName(id.getName());
+    } else if (root.nvcaps.getStaticCapabilities(index)) |caps| {
+        info.setName(std.mem.sliceTo(&caps.name, 0));
+        info.architecture = @tagName(caps.architecture);
+        info.valid |= Property.architecture.bit();
+        info.vram_total_mb = caps.vram_total_mb;
+        info.valid |= Property.vram_total.bit();
+    } else |_| {}
+
+    if (sampler.latest(index)) |sample| info.applySample(sample);
+    if (info.valid == 0) return null;
+    return info;
+}
+
+fn timestampNs() u64 {
+    return root.nvmon.timestampNs();
 }
 
 // D-Bus introspection XML for GPU interface
@@ -186,30 +843,22 @@ pub const gpu_introspection_xml =
     \\"http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd">
     \\<node>
     \\  <interface name="com.nvidia.NVPrime.GPU">
-    \\    <method name="GetTemperature">
-    \\      <arg name="temperature" type="u" direction="out"/>
-    \\    </method>
-    \\    <method name="GetPowerDraw">
-    \\      <arg name="watts" type="d" direction="out"/>
-    \\    </method>
-    \\    <method name="GetClocks">
-    \\      <arg name="gpu_mhz" type="u" direction="out"/>
-    \\      <arg name="mem_mhz" type="u" direction="out"/>
-    \\    </method>
-    \\    <method name="GetUtilization">
-    \\      <arg name="gpu_percent" type="u" direction="out"/>
-    \\      <arg name="mem_percent" type="u" direction="out"/>
-    \\    </method>
-    \\    <method name="GetVRAM">
-    \\      <arg name="used_mb" type="t" direction="out"/>
-    \\      <arg name="total_mb" type="t" direction="out"/>
-    \\    </method>
-    \\    <property name="Name" type="s" access="read"/>
-    \\    <property name="Architecture" type="s" access="read"/>
+    \\    <property name="Name" type="s" access="read">
+    \\      <annotation name="org.freedesktop.DBus.Property.EmitsChangedSignal" value="const"/>
+    \\    </property>
+    \\    <property name="Architecture" type="s" access="read">
+    \\      <annotation name="org.freedesktop.DBus.Property.EmitsChangedSignal" value="const"/>
+    \\    </property>
     \\    <property name="Temperature" type="u" access="read"/>
     \\    <property name="PowerDraw" type="d" access="read"/>
     \\    <property name="GpuClock" type="u" access="read"/>
     \\    <property name="MemClock" type="u" access="read"/>
+    \\    <property name="Utilization" type="u" access="read"/>
+    \\    <property name="MemUtilization" type="u" access="read"/>
+    \\    <property name="VramUsed" type="t" access="read"/>
+    \\    <property name="VramTotal" type="t" access="read"/>
+    \\    <property name="FanSpeed" type="u" access="read"/>
+    \\    <property name="PState" type="u" access="read"/>
     \\    <signal name="ThermalWarning">
     \\      <arg name="temperature" type="u"/>
     \\      <arg name="threshold" type="u"/>
@@ -219,6 +868,22 @@ pub const gpu_introspection_xml =
     \\      <arg name="limit_watts" type="d"/>
     \\    </signal>
     \\  </interface>
+    \\  <interface name="org.freedesktop.DBus.Properties">
+    \\    <method name="Get">
+    \\      <arg name="interface" type="s" direction="in"/>
+    \\      <arg name="property" type="s" direction="in"/>
+    \\      <arg name="value" type="v" direction="out"/>
+    \\    </method>
+    \\    <method name="GetAll">
+    \\      <arg name="interface" type="s" direction="in"/>
+    \\      <arg name="properties" type="a{sv}" direction="out"/>
+    \\    </method>
+    \\    <signal name="PropertiesChanged">
+    \\      <arg name="interface" type="s"/>
+    \\      <arg name="changed_properties" type="a{sv}"/>
+    \\      <arg name="invalidated_properties" type="as"/>
+    \\    </signal>
+    \\  </interface>
     \\</node>
 ;
 
@@ -231,7 +896,82 @@ test "service init" {
     _ = service.isAvailable();
 }
 
+test "gpu events are queued for the loop thread" {
+    var service = Service.init(std.testing.allocator);
+    defer service.deinit();
+    service.wake_fd = try posix.eventfd(0, linux.EFD.CLOEXEC | linux.EFD.NONBLOCK);
+    defer posix.close(service.wake_fd.?);
+
+    var event = events.Event{ .kind = .thermal_warning, .gpu_index = 0, .timestamp_ns = 0, .value = 90, .aux = 87 };
+    Service.onGpuEvent(&event, &service);
+    event.kind = .pstate_change;
+    Service.onGpuEvent(&event, &service);
+    try std.testing.expectEqual(@as(usize, 1), service.event_count);
+
+    // The loop is woken, then drains the queue (no bus: nothing is emitted)
+    var count: u64 = 0;
+    _ = try posix.read(service.wake_fd.?, std.mem.asBytes(&count));
+    try std.testing.expectEqual(@as(u64, 1), count);
+    service.emitQueuedEvents();
+    try std.testing.expectEqual(@as(usize, 0), service.event_count);
+
+    event.kind = .power_limit_reached;
+    for (0..Service.max_queued_events + 4) |_| Service.onGpuEvent(&event, &service);
+    try std.testing.expectEqual(@as(usize, Service.max_queued_events), service.event_count);
+}
+
+test "gpu object path" {
+    var buf: [64]u8 = undefined;
+    try std.testing.expectEqualStrings("/com/nvidia/NVPrime/GPU1", gpuObjectPath(&buf, 1).?);
+    try std.testing.expectEqual(@as(?u32, 12), gpuIndexFromPath("/com/nvidia/NVPrime/GPU12"));
+    try std.testing.expect(gpuIndexFromPath("/com/nvidia/NVPrime") == null);
+    try std.testing.expect(gpuIndexFromPath("/com/nvidia/NVPrime/GPUx") == null);
+}
+
 test "config constants" {
     try std.testing.expectEqualStrings("com.nvidia.NVPrime", config.service_name);
     try std.testing.expectEqualStrings("/com/nvidia/NVPrime", config.object_path_base);
 }
+
+test "property names round trip" {
+    for (std.enums.values(Property)) |prop| {
+        try std.testing.expectEqual(prop, Property.fromDbusName(prop.dbusName()).?);
+    }
+    try std.testing.expect(Property.fromDbusName("Bogus") == null);
+}
+
+test "change thresholds" {
+    var previous = GpuInfo{};
+    previous.applySample(.{ .valid_mask = root.nvmon.Field.temperature.bit() | root.nvmon.Field.power_draw.bit(), .temperature_c = 60, .power_draw_mw = 200_000 });
+
+    var current = previous;
+    current.power_draw_w = 203.0; // below the 5 W threshold
+    try std.testing.expectEqual(@as(PropertyMask, 0), changedProperties(&previous, &current, .{}));
+
+    current.temperature_c = 61;
+    try std.testing.expectEqual(Property.temperature.bit(), changedProperties(&previous, &current, .{}));
+
+    // Newly valid properties always count
+    current.applySample(.{ .valid_mask = root.nvmon.Field.pstate.bit(), .pstate = 2 });
+    try std.testing.expect(changedProperties(&previous, &current, .{}) & Property.pstate.bit() != 0);
+}
+
+test "coalescer rate limits and accumulates drift" {
+    var coalescer = Coalescer{ .min_interval_ns = 1000 };
+    var info = GpuInfo{};
+    info.applySample(.{ .valid_mask = root.nvmon.Field.power_draw.bit(), .power_draw_mw = 100_000 });
+    coalescer.reset(info);
+
+    // 3 W then another 3 W: each step is under threshold, the sum is not
+    info.power_draw_w = 103.0;
+    try std.testing.expectEqual(@as(PropertyMask, 0), coalescer.update(&info, 10));
+    info.power_draw_w = 106.0;
+    try std.testing.expectEqual(Property.power_draw.bit(), coalescer.update(&info, 20));
+
+    // Within the rate window the next change is held...
+    info.power_draw_w = 120.0;
+    try std.testing.expectEqual(@as(PropertyMask, 0), coalescer.update(&info, 500));
+    // ...and delivered once it has passed
+    try std.testing.expectEqual(Property.power_draw.bit(), coalescer.update(&info, 1020));
+    try std.testing.expectEqual(@as(f64, 120.0), coalescer.published.power_draw_w);
+}
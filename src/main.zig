@@ -50,6 +50,46 @@ pub fn main() !void {
         return;
     }
 
+    if (std.mem.eql(u8, command, "daemon")) {
+        const interval_ms = if (args.next()) |arg| std.fmt.parseInt(u32, arg, 10) catch 100 else 100;
+        const all_fields = if (args.next()) |arg| std.mem.eql(u8, arg, "--all-fields") else false;
+        try runDaemon(&stdout.interface, &stderr.interface, @max(interval_ms, 1), all_fields);
+        try stdout.interface.flush();
+        try stderr.interface.flush();
+        return;
+    }
+
+    if (std.mem.eql(u8, command, "exporter")) {
+        const port = if (args.next()) |arg| std.fmt.parseInt(u16, arg, 10) catch nvprime.nvmon.exporter.default_port else nvprime.nvmon.exporter.default_port;
+        const interval_ms = if (args.next()) |arg| std.fmt.parseInt(u32, arg, 10) catch 1000 else 1000;
+        try runExporter(allocator, &stdout.interface, &stderr.interface, port, @max(interval_ms, 1));
+        try stdout.interface.flush();
+        try stderr.interface.flush();
+        return;
+    }
+
+    if (std.mem.eql(u8, command, "record")) {
+        const subcommand = args.next() orelse "";
+        const path = args.next() orelse {
+            try stderr.interface.print("Usage: nvprime record <start|replay|export> <file>\n", .{});
+            try stderr.interface.flush();
+            return;
+        };
+        if (std.mem.eql(u8, subcommand, "start")) {
+            const interval_ms = if (args.next()) |arg| std.fmt.parseInt(u32, arg, 10) catch 500 else 500;
+            try runRecorder(&stdout.interface, &stderr.interface, path, @max(interval_ms, 1));
+        } else if (std.mem.eql(u8, subcommand, "replay")) {
+            try replayRecording(&stdout.interface, &stderr.interface, path);
+        } else if (std.mem.eql(u8, subcommand, "export")) {
+            try exportRecording(&stdout.interface, &stderr.interface, path);
+        } else {
+            try stderr.interface.print("Unknown record subcommand: {s}\n", .{subcommand});
+        }
+        try stdout.interface.flush();
+        try stderr.interface.flush();
+        return;
+    }
+
     if (std.mem.eql(u8, command, "caps") or std.mem.eql(u8, command, "detect")) {
         try printCapabilities(allocator, &stdout.interface, &stderr.interface);
         try stdout.interface.flush();
@@ -93,6 +133,22 @@ pub fn main() !void {
         return;
     }
 
+    if (std.mem.eql(u8, command, "runtime")) {
+        const subcommand = args.next() orelse "status";
+        if (std.mem.eql(u8, subcommand, "pacing-bench")) {
+            const hz = if (args.next()) |arg| std.fmt.parseInt(u32, arg, 10) catch 240 else 240;
+            try printPacingBench(&stdout.interface, hz);
+        } else if (std.mem.eql(u8, subcommand, "prewarm")) {
+            const index = if (args.next()) |arg| std.fmt.parseInt(u32, arg, 10) catch 0 else 0;
+            try runPrewarm(allocator, &stdout.interface, &stderr.interface, index);
+        } else {
+            try stderr.interface.print("Unknown runtime subcommand: {s}\n", .{subcommand});
+        }
+        try stdout.interface.flush();
+        try stderr.interface.flush();
+        return;
+    }
+
     try stderr.interface.print("Unknown command: {s}\n", .{command});
     try stderr.interface.print("Run 'nvprime help' for usage information.\n", .{});
     try stderr.interface.flush();
@@ -117,6 +173,9 @@ fn printUsage(writer: *std.Io.Writer) !void {
         \\  display [subcommand] Display/VRR/HDR configuration
         \\  runtime [subcommand] Gaming runtime controls
         \\  hud [subcommand]    Overlay and telemetry
+        \\  daemon [interval_ms] [--all-fields]  Own NVML and publish shared-memory telemetry
+        \\  exporter [port] [interval_ms]  Serve OpenMetrics for Prometheus (default port 9400)
+        \\  record [subcommand] Telemetry flight recorder
         \\  version             Show version information
         \\  help                Show this help message
         \\
@@ -124,6 +183,11 @@ fn printUsage(writer: *std.Io.Writer) !void {
         \\  core status         Show clock and pstate info
         \\  power status        Show power and thermal info
         \\  display status      Show display configuration
+        \\  runtime pacing-bench [hz]  Compare frame limiter deadline jitter
+        \\  runtime prewarm [gpu]  Replay stale Steam shader caches in the background
+        \\  record start <file> [interval_ms]  Record telemetry until Ctrl+C
+        \\  record replay <file>  Print a recording's timeline
+        \\  record export <file>  Write a recording as CSV
         \\
         \\Examples:
         \\  nvprime status
@@ -140,6 +204,13 @@ fn printStatus(writer: *std.Io.Writer, err_writer: *std.Io.Writer) !void {
     try writer.print("NVPrime {s}\n", .{nvprime.version.string});
     try writer.print("---------------------------------------------------\n", .{});
 
+    // A running daemon already has everything; skip NVML startup entirely
+    if (nvprime.nvmon.shm.Reader.attach(nvprime.nvmon.shm.default_path)) |reader| {
+        defer reader.detach();
+        try printDaemonStatus(writer, reader);
+        return;
+    } else |_| {}
+
     // Try to initialize NVML and show GPU info
     nvprime.nvml.init() catch |e| {
         try err_writer.print("Warning: NVML initialization failed: {}\n", .{e});
@@ -179,6 +250,282 @@ fn printStatus(writer: *std.Io.Writer, err_writer: *std.Io.Writer) !void {
     }
 }
 
+fn printDaemonStatus(writer: *std.Io.Writer, reader: nvprime.nvmon.shm.Reader) !void {
+    const count = reader.gpuCount();
+    try writer.print("GPUs:   {d} detected (via nvprime daemon, pid {d})\n", .{ count, reader.daemonPid() });
+
+    for (0..count) |i| {
+        const index: u32 = @intCast(i);
+        const id = reader.identity(index) orelse continue;
+        try writer.print("\n[GPU {d}] {s}\n", .{ i, id.getName() });
+        const sample = reader.read(index) orelse {
+            try writer.print("        No sample published yet\n", .{});
+            continue;
+        };
+        try writer.print("        Temp: {d}C | Power: {d:.1}W | GPU: {d}% | MEM: {d}%\n", .{
+            sample.temperature_c,
+            sample.powerDrawW(),
+            sample.gpu_utilization,
+            sample.mem_utilization,
+        });
+    }
+}
+
+var daemon_stop = std.atomic.Value(bool).init(false);
+
+fn handleDaemonSignal(_: i32) callconv(.c) void {
+    daemon_stop.store(true, .release);
+}
+
+fn installStopHandler() void {
+    const action = std.posix.Sigaction{
+        .handler = .{ .handler = handleDaemonSignal },
+        .mask = std.posix.sigemptyset(),
+        .flags = 0,
+    };
+    std.posix.sigaction(std.posix.SIG.INT, &action, null);
+    std.posix.sigaction(std.posix.SIG.TERM, &action, null);
+}
+
+/// Own NVML, sample every GPU and publish into the shared telemetry segment
+/// until SIGINT/SIGTERM. Clients attach through nvprime_init(). Throttle
+/// reasons and encoder stats are only sampled with `all_fields`.
+fn runDaemon(writer: *std.Io.Writer, err_writer: *std.Io.Writer, interval_ms: u32, all_fields: bool) !void {
+    const shm = nvprime.nvmon.shm;
+    const sampler = nvprime.nvmon.sampler;
+    const registry = nvprime.nvcaps.registry;
+
+    nvprime.nvml.init() catch |e| {
+        try err_writer.print("NVML initialization failed: {}\n", .{e});
+        return;
+    };
+    defer nvprime.nvml.shutdown();
+    try nvprime.nvcaps.init();
+    defer nvprime.nvcaps.deinit();
+
+    var publisher = shm.Publisher.create(shm.default_path, @as(u64, interval_ms) * std.time.ns_per_ms) catch |e| {
+        try err_writer.print("Could not create {s}: {}\n", .{ shm.default_path, e });
+        return;
+    };
+    defer publisher.close();
+
+    const count = @min(try registry.count(), nvprime.nvmon.max_gpus);
+    for (0..count) |i| {
+        const index: u32 = @intCast(i);
+        var id = shm.Identity{};
+        if (registry.getEntry(index)) |entry| {
+            id.uuid = entry.uuid;
+            id.pcie_bus_id = entry.pcie_bus_id;
+        }
+        if (nvprime.nvcaps.getStaticCapabilities(index)) |caps| {
+            id.name = caps.name;
+            id.vram_total_mb = caps.vram_total_mb;
+        } else |_| {}
+        publisher.setIdentity(index, id);
+    }
+
+    installStopHandler();
+
+    try sampler.publishTo(&publisher);
+    defer sampler.publishTo(null) catch {};
+    try sampler.start(.{
+        .interval_ms = interval_ms,
+        .field_mask = if (all_fields) nvprime.nvmon.all_fields else nvprime.nvmon.default_fields,
+    });
+    defer sampler.stop();
+
+    try writer.print("nvprime daemon: publishing {d} GPU(s) to {s} every {d} ms\n", .{ count, shm.default_path, interval_ms });
+    try writer.flush();
+
+    while (!daemon_stop.load(.acquire)) {
+        std.posix.nanosleep(0, 100 * std.time.ns_per_ms);
+    }
+}
+
+/// Serve OpenMetrics on `port` until SIGINT/SIGTERM. Reads a running
+/// daemon's segment when there is one; otherwise samples here every
+/// `interval_ms`. Scrapes never reach NVML either way.
+fn runExporter(allocator: std.mem.Allocator, writer: *std.Io.Writer, err_writer: *std.Io.Writer, port: u16, interval_ms: u32) !void {
+    const shm = nvprime.nvmon.shm;
+    const sampler = nvprime.nvmon.sampler;
+    const exporter = nvprime.nvmon.exporter;
+
+    const attached = sampler.attach(shm.default_path);
+    defer if (attached) sampler.detach();
+    if (!attached) {
+        nvprime.nvml.init() catch |e| {
+            try err_writer.print("NVML initialization failed: {}\n", .{e});
+            return;
+        };
+        nvprime.nvcaps.init() catch |e| {
+            nvprime.nvml.shutdown();
+            return e;
+        };
+        sampler.start(.{ .interval_ms = interval_ms }) catch |e| {
+            nvprime.nvcaps.deinit();
+            nvprime.nvml.shutdown();
+            return e;
+        };
+    }
+    defer if (!attached) {
+        sampler.stop();
+        nvprime.nvcaps.deinit();
+        nvprime.nvml.shutdown();
+    };
+
+    // Render at the rate new samples arrive
+    const refresh_ms: u32 = if (sampler.attachedReader()) |reader|
+        @intCast(@max(reader.intervalNs() / std.time.ns_per_ms, 1))
+    else
+        interval_ms;
+    const server = exporter.Exporter.init(allocator, .{ .port = port, .refresh_ms = refresh_ms }) catch |e| {
+        try err_writer.print("Could not listen on port {d}: {}\n", .{ port, e });
+        return;
+    };
+    defer server.deinit();
+
+    installStopHandler();
+
+    try writer.print("nvprime exporter: {d} GPU(s) from {s} on :{d}/metrics\n", .{
+        server.gpu_count,
+        if (attached) "the daemon" else "a local sampler",
+        try server.port(),
+    });
+    try writer.flush();
+
+    while (!daemon_stop.load(.acquire)) {
+        _ = server.serveOne(100) catch |e| {
+            try err_writer.print("exporter: {}\n", .{e});
+            try err_writer.flush();
+            std.posix.nanosleep(0, 100 * std.time.ns_per_ms);
+        };
+    }
+}
+
+/// Record GPU telemetry to a ring file until SIGINT/SIGTERM. Frame-time
+/// columns stay empty unless a compositor in this process reports frames.
+fn runRecorder(writer: *std.Io.Writer, err_writer: *std.Io.Writer, path: []const u8, interval_ms: u32) !void {
+    const recorder = nvprime.nvmon.recorder;
+    const sampler = nvprime.nvmon.sampler;
+
+    nvprime.nvml.init() catch |e| {
+        try err_writer.print("NVML initialization failed: {}\n", .{e});
+        return;
+    };
+    defer nvprime.nvml.shutdown();
+    try nvprime.nvcaps.init();
+    defer nvprime.nvcaps.deinit();
+
+    installStopHandler();
+
+    // Sample at least as often as frames are written
+    try sampler.start(.{ .interval_ms = @min(interval_ms, 100) });
+    defer sampler.stop();
+    recorder.start(path, .{ .interval_ms = interval_ms }) catch |e| {
+        try err_writer.print("Could not record to {s}: {}\n", .{ path, e });
+        return;
+    };
+    defer recorder.stop();
+
+    try writer.print("nvprime record: writing to {s} every {d} ms (Ctrl+C to stop)\n", .{ path, interval_ms });
+    try writer.flush();
+
+    while (!daemon_stop.load(.acquire)) {
+        std.posix.nanosleep(0, 100 * std.time.ns_per_ms);
+    }
+}
+
+/// Replay the shader caches that are stale for a GPU, at idle priority,
+/// until done or SIGINT/SIGTERM
+fn runPrewarm(allocator: std.mem.Allocator, writer: *std.Io.Writer, err_writer: *std.Io.Writer, index: u32) !void {
+    const scheduler = nvprime.nvruntime.nvshader.scheduler;
+
+    nvprime.nvml.init() catch |e| {
+        try err_writer.print("NVML initialization failed: {}\n", .{e});
+        return;
+    };
+    defer nvprime.nvml.shutdown();
+    try nvprime.nvcaps.init();
+    defer nvprime.nvcaps.deinit();
+
+    installStopHandler();
+
+    const sched = scheduler.Scheduler.start(allocator, index, .{}) catch |e| {
+        try err_writer.print("Could not start shader pre-warm: {}\n", .{e});
+        return;
+    };
+    defer sched.deinit();
+
+    const total = sched.progress().total;
+    if (total == 0) {
+        try writer.print("Shader caches are up to date for GPU {d}\n", .{index});
+        return;
+    }
+    for (sched.caches) |cache| {
+        try writer.print("  app {s:<10} {d:>8} KiB  {s}\n", .{ cache.name, cache.bytes / 1024, cache.dir });
+    }
+    try writer.print("nvprime prewarm: replaying {d} cache(s) on {d} worker(s) (Ctrl+C to stop)\n", .{ total, sched.threads.len });
+    try writer.flush();
+
+    while (!sched.progress().finished) {
+        if (daemon_stop.load(.acquire)) sched.cancel();
+        std.posix.nanosleep(0, 100 * std.time.ns_per_ms);
+    }
+    const done = sched.progress();
+    try writer.print("Replayed {d}/{d} cache(s), {d} failed\n", .{ done.done, done.total, done.failed });
+}
+
+fn replayRecording(writer: *std.Io.Writer, err_writer: *std.Io.Writer, path: []const u8) !void {
+    const recorder = nvprime.nvmon.recorder;
+    var rec = recorder.Recording.open(path) catch |e| {
+        try err_writer.print("Could not open {s}: {}\n", .{ path, e });
+        return;
+    };
+    defer rec.close();
+
+    try writer.print("Recording: {d} GPU(s), {d} ms interval, {d} frames written\n", .{
+        rec.header.gpu_count,
+        rec.header.interval_ms,
+        rec.writeIndex(),
+    });
+    try writer.print("---------------------------------------------------\n", .{});
+
+    var it = rec.frames();
+    var frame: recorder.Frame = undefined;
+    while (it.next(&frame)) {
+        const s = frame.summary;
+        try writer.print("{d:>9.1}s", .{@as(f64, @floatFromInt(frame.time_ms)) / 1000.0});
+        if (s.frame_count > 0) {
+            try writer.print("  {d:>4} frames avg {d:.2} ms max {d:.2} ms", .{
+                s.frame_count,
+                @as(f64, @floatFromInt(s.avg_frame_us)) / 1000.0,
+                @as(f64, @floatFromInt(s.max_frame_us)) / 1000.0,
+            });
+            if (s.stutter_count > 0) try writer.print(" [{d} stutter]", .{s.stutter_count});
+        }
+        for (frame.gpus[0..frame.gpu_count], 0..) |g, i| {
+            try writer.print("  gpu{d} {d}C {d:.0}W {d}MHz {d}%", .{
+                i,
+                g.temperature_c,
+                @as(f64, @floatFromInt(g.power_mw)) / 1000.0,
+                g.gpu_clock_mhz,
+                g.utilization,
+            });
+        }
+        try writer.print("\n", .{});
+    }
+}
+
+fn exportRecording(writer: *std.Io.Writer, err_writer: *std.Io.Writer, path: []const u8) !void {
+    const recorder = nvprime.nvmon.recorder;
+    var rec = recorder.Recording.open(path) catch |e| {
+        try err_writer.print("Could not open {s}: {}\n", .{ path, e });
+        return;
+    };
+    defer rec.close();
+    try recorder.exportCsv(&rec, writer);
+}
+
 fn printCapabilities(allocator: std.mem.Allocator, writer: *std.Io.Writer, err_writer: *std.Io.Writer) !void {
     nvprime.nvml.init() catch |e| {
         try err_writer.print("NVML initialization failed: {}\n", .{e});
@@ -267,3 +614,20 @@ test "main module compiles" {
     // Basic compilation test
     _ = nvprime;
 }
+
+fn printPacingBench(writer: *std.Io.Writer, hz: u32) !void {
+    const frame_pacing = nvprime.nvruntime.primetime.frame_pacing;
+    const rate = @max(hz, 1);
+    const period_ns = std.time.ns_per_s / rate;
+    const iterations = rate * 2; // two seconds per strategy
+
+    try writer.print("Deadline jitter at {d} Hz ({d} frames per strategy)\n\n", .{ rate, iterations });
+    try writer.print("  strategy   mean(us)   p99(us)   max(us)   early\n", .{});
+    inline for (.{ frame_pacing.WaitStrategy.sleep, frame_pacing.WaitStrategy.hybrid }) |strategy| {
+        const report = frame_pacing.measureDeadlineJitter(strategy, period_ns, iterations);
+        try writer.print("  {s:<8} {d:>9.1} {d:>9.1} {d:>9.1} {d:>7}\n", .{
+            @tagName(strategy), report.mean_us, report.p99_us, report.max_us, report.early,
+        });
+    }
+}
+
@@ -5,6 +5,10 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const nvmon = @import("../nvmon/nvmon.zig");
+
+pub const registry = @import("registry.zig");
+pub const placement = @import("placement.zig");
 
 /// GPU Architecture generations
 pub const Architecture = enum {
@@ -104,6 +108,36 @@ pub const GpuCapabilities = struct {
     mem_clock_mhz: u32,
     pstate: u32,
 
+    /// Combine a static capability record with a dynamic state snapshot
+    pub fn compose(static: StaticCapabilities, dynamic: DynamicState) GpuCapabilities {
+        return GpuCapabilities{
+            .index = static.index,
+            .name = static.name,
+            .uuid = static.uuid,
+            .architecture = static.architecture,
+            .compute_capability = .{ .major = static.compute_capability.major, .minor = static.compute_capability.minor },
+            .vram_total_mb = static.vram_total_mb,
+            .vram_used_mb = dynamic.vram_used_mb,
+            .pcie_bus_id = static.pcie_bus_id,
+            .pcie_gen = static.pcie_gen,
+            .pcie_width = static.pcie_width,
+            .supports_rtx = static.supports_rtx,
+            .supports_dlss = static.supports_dlss,
+            .supports_dlss3 = static.supports_dlss3,
+            .supports_reflex = static.supports_reflex,
+            .supports_nvenc = static.supports_nvenc,
+            .supports_power_management = static.supports_power_management,
+            .supports_clock_control = static.supports_clock_control,
+            .supports_fan_control = static.supports_fan_control,
+            .temperature_c = dynamic.temperature_c,
+            .power_draw_w = dynamic.power_draw_w,
+            .power_limit_w = dynamic.power_limit_w,
+            .gpu_clock_mhz = dynamic.gpu_clock_mhz,
+            .mem_clock_mhz = dynamic.mem_clock_mhz,
+            .pstate = dynamic.pstate,
+        };
+    }
+
     pub fn print(self: GpuCapabilities, writer: anytype) !void {
         try writer.print("GPU {d}: {s}\n", .{ self.index, std.mem.sliceTo(&self.name, 0) });
         try writer.print("  Architecture: {s}\n", .{@tagName(self.architecture)});
@@ -145,29 +179,116 @@ pub const Profile = enum {
     }
 };
 
-/// Cached GPU data
-var gpu_cache: ?[]GpuCapabilities = null;
+/// Immutable GPU capabilities: identity, topology and feature support.
+/// Computed once per device and served from memory afterwards.
+pub const StaticCapabilities = struct {
+    index: u32,
+    name: [96]u8,
+    uuid: [96]u8,
+    architecture: Architecture,
+    compute_capability: struct { major: i32, minor: i32 },
+    vram_total_mb: u64,
+    pcie_bus_id: [32]u8,
+    pcie_gen: u32,
+    pcie_width: u32,
+    supports_rtx: bool,
+    supports_dlss: bool,
+    supports_dlss3: bool,
+    supports_reflex: bool,
+    supports_nvenc: bool,
+    supports_power_management: bool,
+    supports_clock_control: bool,
+    supports_fan_control: bool,
+};
+
+/// Frequently changing GPU state, refreshed lazily
+pub const DynamicState = struct {
+    vram_used_mb: u64 = 0,
+    temperature_c: u32 = 0,
+    power_draw_w: f32 = 0,
+    power_limit_w: f32 = 0,
+    gpu_clock_mhz: u32 = 0,
+    mem_clock_mhz: u32 = 0,
+    pstate: u32 = 15,
+    /// When this state was read (CLOCK_MONOTONIC)
+    timestamp_ns: u64 = 0,
+};
+
+/// Default staleness window for cached dynamic state
+pub const default_staleness_ns: u64 = 250 * std.time.ns_per_ms;
+
+const CacheEntry = struct {
+    /// Written once when published, never modified afterwards
+    static: std.atomic.Value(?*const StaticCapabilities) = std.atomic.Value(?*const StaticCapabilities).init(null),
+    dynamic: DynamicState = .{},
+};
+
+/// Per-device capability cache
+var gpu_cache: [registry.max_devices]CacheEntry = [_]CacheEntry{.{}} ** registry.max_devices;
+var cache_mutex: std.Thread.Mutex = .{};
+const table_allocator = std.heap.page_allocator;
+/// Static tables dropped by `invalidateCache`. Readers may still hold
+/// them, so they are only freed by `deinit`.
+var retired_tables: std.ArrayList(*const StaticCapabilities) = .empty;
+var staleness_ns = std.atomic.Value(u64).init(default_staleness_ns);
+
+/// Result of the last detectGpus() call (owned by nvcaps, freed by deinit)
+var detected_gpus: ?[]GpuCapabilities = null;
 var allocator: ?std.mem.Allocator = null;
 
 /// Initialize nvcaps subsystem
 pub fn init() !void {
-    // nvcaps currently relies on NVML being initialized by the caller
+    // nvcaps relies on NVML being initialized by the caller
+    try registry.init();
+
+    // Warm the static capability cache; failures are retried lazily
+    const count = try registry.count();
+    for (0..@min(count, registry.max_devices)) |i| {
+        _ = getStaticCapabilities(@intCast(i)) catch continue;
+    }
 }
 
 /// Deinitialize nvcaps subsystem
 pub fn deinit() void {
-    if (gpu_cache) |cache| {
+    if (detected_gpus) |gpus| {
         if (allocator) |alloc| {
-            alloc.free(cache);
+            alloc.free(gpus);
         }
     }
-    gpu_cache = null;
+    detected_gpus = null;
     allocator = null;
+    invalidateCache();
+    for (retired_tables.items) |table| table_allocator.destroy(@constCast(table));
+    retired_tables.clearAndFree(table_allocator);
+    registry.deinit();
+}
+
+/// Drop all cached capabilities (e.g. after the device registry was refreshed)
+pub fn invalidateCache() void {
+    cache_mutex.lock();
+    defer cache_mutex.unlock();
+    for (&gpu_cache) |*entry| {
+        if (entry.static.swap(null, .acq_rel)) |table| {
+            // Without room to retire it, leaking beats freeing under a reader
+            retired_tables.append(table_allocator, table) catch {};
+        }
+        entry.dynamic = .{};
+    }
+}
+
+/// Set how long cached dynamic state may be served before it is re-read
+pub fn setStalenessWindow(window_ns: u64) void {
+    staleness_ns.store(window_ns, .monotonic);
+}
+
+/// Get the current dynamic state staleness window
+pub fn getStalenessWindow() u64 {
+    return staleness_ns.load(.monotonic);
 }
 
 /// Detect all GPUs and return their capabilities
 pub fn detectGpus(alloc: std.mem.Allocator) ![]GpuCapabilities {
-    const count = try nvml.getDeviceCount();
+    const count = try registry.count();
     var gpus = try alloc.alloc(GpuCapabilities, count);
     errdefer alloc.free(gpus);
 
@@ -175,21 +296,74 @@ pub fn detectGpus(alloc: std.mem.Allocator) ![]GpuCapabilities {
         gpus[i] = try getGpuCapabilities(@intCast(i));
     }
 
-    // Cache the results
-    if (gpu_cache) |old_cache| {
+    // Keep the results alive until deinit
+    if (detected_gpus) |old_gpus| {
         if (allocator) |old_alloc| {
-            old_alloc.free(old_cache);
+            old_alloc.free(old_gpus);
         }
     }
-    gpu_cache = gpus;
+    detected_gpus = gpus;
     allocator = alloc;
 
     return gpus;
 }
 
+/// Static capability table of a GPU: queried on first use, then published
+/// once and read without locks. Stays valid until `deinit`, even after
+/// `invalidateCache` replaces it.
+pub fn getStaticTable(index: u32) !*const StaticCapabilities {
+    if (index >= registry.max_devices) return error.NotFound;
+    const entry = &gpu_cache[index];
+    if (entry.static.load(.acquire)) |table| return table;
+
+    const table = try table_allocator.create(StaticCapabilities);
+    errdefer table_allocator.destroy(table);
+    table.* = try queryStaticCapabilities(index);
+
+    // Another thread may have published first; keep its table
+    if (entry.static.cmpxchgStrong(null, table, .acq_rel, .acquire)) |published| {
+        table_allocator.destroy(table);
+        return published.?;
+    }
+    return table;
+}
+
+/// Copy of a GPU's static capabilities
+pub fn getStaticCapabilities(index: u32) !StaticCapabilities {
+    return (try getStaticTable(index)).*;
+}
+
+/// Get dynamic state for a GPU, re-reading it if the cached copy is stale
+pub fn getDynamicState(index: u32) !DynamicState {
+    if (index >= registry.max_devices) return error.NotFound;
+    const entry = &gpu_cache[index];
+    const now = nvmon.timestampNs();
+
+    cache_mutex.lock();
+    const cached = entry.dynamic;
+    cache_mutex.unlock();
+
+    if (cached.timestamp_ns != 0 and now -| cached.timestamp_ns < getStalenessWindow()) {
+        return cached;
+    }
+
+    const state = try queryDynamicState(index);
+
+    cache_mutex.lock();
+    defer cache_mutex.unlock();
+    entry.dynamic = state;
+    return state;
+}
+
 /// Get capabilities for a specific GPU
 pub fn getGpuCapabilities(index: u32) !GpuCapabilities {
-    const device = try nvml.getDeviceByIndex(index);
+    const static = try getStaticCapabilities(index);
+    const dynamic = try getDynamicState(index);
+    return GpuCapabilities.compose(static, dynamic);
+}
+
+fn queryStaticCapabilities(index: u32) !StaticCapabilities {
+    const device = try registry.getDevice(index);
 
     const name = try nvml.getDeviceName(device);
     const uuid = try nvml.getDeviceUuid(device);
@@ -199,38 +373,16 @@ pub fn getGpuCapabilities(index: u32) !GpuCapabilities {
 
     const arch = Architecture.fromComputeCapability(compute.major, compute.minor);
 
-    // Get current state (may fail on some GPUs)
-    const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
-    const power = nvml.getDevicePowerUsage(device) catch 0;
-    const power_limit = nvml.getDevicePowerLimit(device) catch 0;
-    const gpu_clock = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch 0;
-    const mem_clock = nvml.getDeviceClock(device, nvml.CLOCK_MEM) catch 0;
-    const pstate = nvml.getDevicePerformanceState(device) catch @as(c_uint, 15);
-
-    // Build PCI bus ID string
-    var pcie_bus_id: [32]u8 = [_]u8{0} ** 32;
-    const pcie_str = std.fmt.bufPrint(&pcie_bus_id, "{x:0>4}:{x:0>2}:{x:0>2}.{d}", .{
-        pci.domain,
-        pci.bus,
-        pci.device,
-        0, // function
-    }) catch "unknown";
-    // Null-terminate after the formatted string
-    if (pcie_str.len < 32) {
-        pcie_bus_id[pcie_str.len] = 0;
-    }
-
-    return GpuCapabilities{
+    return StaticCapabilities{
         .index = index,
         .name = name,
         .uuid = uuid,
         .architecture = arch,
         .compute_capability = .{ .major = compute.major, .minor = compute.minor },
         .vram_total_mb = memory.total / (1024 * 1024),
-        .vram_used_mb = memory.used / (1024 * 1024),
-        .pcie_bus_id = pcie_bus_id,
-        .pcie_gen = 0, // Would need additional NVML calls
-        .pcie_width = 0,
+        .pcie_bus_id = registry.formatBusId(pci),
+        .pcie_gen = nvml.getDeviceMaxPcieLinkGeneration(device) catch 0,
+        .pcie_width = nvml.getDeviceMaxPcieLinkWidth(device) catch 0,
         .supports_rtx = arch.supportsRtx(),
         .supports_dlss = arch.supportsDlss(),
         .supports_dlss3 = arch.supportsDlss3(),
@@ -239,12 +391,30 @@ pub fn getGpuCapabilities(index: u32) !GpuCapabilities {
         .supports_power_management = nvml.isFeatureSupported(device, .power_management),
         .supports_clock_control = nvml.isFeatureSupported(device, .clock_control),
         .supports_fan_control = nvml.isFeatureSupported(device, .fan_control),
+    };
+}
+
+fn queryDynamicState(index: u32) !DynamicState {
+    const device = try registry.getDevice(index);
+
+    // Get current state (may fail on some GPUs)
+    const vram_used: u64 = if (nvml.getDeviceMemoryInfo(device)) |memory| memory.used else |_| 0;
+    const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
+    const power = nvml.getDevicePowerUsage(device) catch 0;
+    const power_limit = nvml.getDevicePowerLimit(device) catch 0;
+    const gpu_clock = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch 0;
+    const mem_clock = nvml.getDeviceClock(device, nvml.CLOCK_MEM) catch 0;
+    const pstate = nvml.getDevicePerformanceState(device) catch @as(c_uint, 15);
+
+    return DynamicState{
+        .vram_used_mb = vram_used / (1024 * 1024),
         .temperature_c = temp,
         .power_draw_w = @as(f32, @floatFromInt(power)) / 1000.0,
         .power_limit_w = @as(f32, @floatFromInt(power_limit)) / 1000.0,
         .gpu_clock_mhz = gpu_clock,
         .mem_clock_mhz = mem_clock,
         .pstate = @intCast(pstate),
+        .timestamp_ns = nvmon.timestampNs(),
     };
 }
 
@@ -325,3 +495,15 @@ test "architecture detection" {
     try std.testing.expect(Architecture.ada_lovelace.supportsDlss3());
     try std.testing.expect(!Architecture.ampere.supportsDlss3());
 }
+
+test "staleness window" {
+    const previous = getStalenessWindow();
+    defer setStalenessWindow(previous);
+    setStalenessWindow(5 * std.time.ns_per_ms);
+    try std.testing.expectEqual(@as(u64, 5 * std.time.ns_per_ms), getStalenessWindow());
+    try std.testing.expectError(error.NotFound, getStaticCapabilities(registry.max_devices));
+}
+
+test {
+    _ = placement;
+}
@@ -0,0 +1,383 @@
+//! nvcaps/placement - Multi-GPU Workload Placement
+//!
+//! Ranks GPUs for a workload from live load and topology: free VRAM,
+//! utilization, thermal headroom, NVENC load and the link to the display GPU.
+//! Per-device load is cached and refreshed by the nvmon sampler on every
+//! pass; topology is resolved once per registry generation. Selecting a GPU
+//! is a few multiplies per device and never waits on NVML while the sampler
+//! runs.
+
+const std = @import("std");
+const nvml = @import("../bindings/nvml.zig");
+const registry = @import("registry.zig");
+const nvmon = @import("../nvmon/nvmon.zig");
+const thermals = @import("../nvpower/thermals.zig");
+
+const max_devices = registry.max_devices;
+
+/// Kind of work being placed
+pub const Workload = enum(u32) {
+    render = 0, // Game or offscreen rendering; frames cross to the display GPU
+    compute = 1, // CUDA/compute; only capacity matters
+    encode = 2, // NVENC streaming or recording
+    display = 3, // Compositor driving the display
+
+    pub fn weights(self: Workload) Weights {
+        return switch (self) {
+            .render => .{ .vram = 0.25, .utilization = 0.30, .thermal = 0.15, .encoder = 0.0, .link = 0.30 },
+            .compute => .{ .vram = 0.40, .utilization = 0.40, .thermal = 0.20, .encoder = 0.0, .link = 0.0 },
+            .encode => .{ .vram = 0.10, .utilization = 0.15, .thermal = 0.10, .encoder = 0.45, .link = 0.20 },
+            .display => .{ .vram = 0.10, .utilization = 0.20, .thermal = 0.10, .encoder = 0.0, .link = 0.60 },
+        };
+    }
+};
+
+/// How much each factor counts toward a device's score (sums to 1)
+pub const Weights = struct {
+    vram: f32,
+    utilization: f32,
+    thermal: f32,
+    encoder: f32,
+    link: f32,
+};
+
+/// Placement request
+pub const Hints = struct {
+    workload: Workload = .render,
+    /// Skip GPUs with less free VRAM than this
+    min_free_vram_mb: u64 = 0,
+    /// NVENC sessions the workload will open
+    encoder_sessions: u32 = 0,
+    /// GPU driving the display (null = no display affinity)
+    display_gpu: ?u32 = null,
+    /// Skip GPUs at or past their thermal slowdown point
+    avoid_throttling: bool = true,
+};
+
+/// Connection between a GPU and the display GPU, best first
+pub const Link = enum(u32) {
+    same_gpu = 0,
+    nvlink = 1,
+    pcie_switch = 2, // Behind the same PCIe switch(es)
+    host_bridge = 3, // Same root complex
+    numa_node = 4, // Same CPU socket, different root complex
+    cross_socket = 5, // Traffic crosses the inter-socket link
+    unknown = 6,
+
+    /// Relative cost of moving frames over this link (1 = free)
+    pub fn score(self: Link) f32 {
+        return switch (self) {
+            .same_gpu => 1.0,
+            .nvlink => 0.9,
+            .pcie_switch => 0.7,
+            .host_bridge => 0.5,
+            .numa_node => 0.35,
+            .cross_socket => 0.2,
+            .unknown => 0.4,
+        };
+    }
+
+    fn fromTopology(level: nvml.TopologyLevel) Link {
+        return switch (level) {
+            nvml.TOPOLOGY_INTERNAL => .same_gpu,
+            nvml.TOPOLOGY_SINGLE, nvml.TOPOLOGY_MULTIPLE => .pcie_switch,
+            nvml.TOPOLOGY_HOSTBRIDGE => .host_bridge,
+            nvml.TOPOLOGY_NODE => .numa_node,
+            nvml.TOPOLOGY_SYSTEM => .cross_socket,
+            else => .unknown,
+        };
+    }
+};
+
+/// Cached load of one GPU
+pub const DeviceLoad = struct {
+    valid: bool = false,
+    timestamp_ns: u64 = 0,
+    free_vram_mb: u64 = 0,
+    total_vram_mb: u64 = 0,
+    utilization: u32 = 0,
+    temperature_c: u32 = 0,
+    /// Thermal slowdown threshold (from NVML, or the NVIDIA default)
+    slowdown_c: u32 = default_slowdown_c,
+    encoder_sessions: u32 = 0,
+    encoder_utilization: u32 = 0,
+
+    pub fn thermalState(self: DeviceLoad) thermals.ThermalState {
+        return .{
+            .gpu_temp_c = self.temperature_c,
+            .memory_temp_c = 0,
+            .hotspot_temp_c = 0,
+            .target_temp_c = self.slowdown_c,
+            .slowdown_temp_c = self.slowdown_c,
+            .shutdown_temp_c = self.slowdown_c + 9,
+        };
+    }
+};
+
+/// One ranked device
+pub const Candidate = struct {
+    index: u32,
+    /// 0 (worst) to 1 (idle, cool, empty, on the display GPU)
+    score: f32,
+    free_vram_mb: u64,
+    utilization: u32,
+    thermal_headroom_c: i32,
+    encoder_sessions: u32,
+    link: Link,
+};
+
+const default_slowdown_c: u32 = 83;
+
+/// Thermal headroom that counts as fully cool
+const full_headroom_c: f32 = 20;
+
+/// Concurrent NVENC sessions treated as a full encoder
+const encoder_session_budget: f32 = 8;
+
+/// Cached loads older than this are refreshed before ranking when the sampler is off
+const max_load_age_ns: u64 = std.time.ns_per_s;
+
+const Topology = struct {
+    generation: u64 = std.math.maxInt(u64),
+    count: u32 = 0,
+    links: [max_devices][max_devices]Link = undefined,
+    slowdown_c: [max_devices]u32 = [_]u32{default_slowdown_c} ** max_devices,
+};
+
+var loads: [max_devices]DeviceLoad = [_]DeviceLoad{.{}} ** max_devices;
+var load_count: u32 = 0;
+var topology: Topology = .{};
+var mutex: std.Thread.Mutex = .{};
+
+/// Fold a telemetry pass into the cache. Called by the nvmon sampler after
+/// every pass; encoder load is known when the pass sampled `.encoder`.
+pub fn observe(samples: []const nvmon.GpuSample) void {
+    refreshTopology();
+
+    for (samples) |sample| {
+        if (sample.index >= max_devices) continue;
+        var load = DeviceLoad{ .valid = true, .timestamp_ns = sample.timestamp_ns };
+        if (sample.has(.vram)) {
+            load.total_vram_mb = sample.vram_total_mb;
+            load.free_vram_mb = sample.vram_total_mb -| sample.vram_used_mb;
+        }
+        if (sample.has(.utilization)) load.utilization = sample.gpu_utilization;
+        if (sample.has(.temperature)) load.temperature_c = sample.temperature_c;
+        if (sample.has(.encoder)) {
+            load.encoder_sessions = sample.encoder_sessions;
+            load.encoder_utilization = sample.encoder_utilization;
+        }
+
+        mutex.lock();
+        load.slowdown_c = topology.slowdown_c[sample.index];
+        loads[sample.index] = load;
+        load_count = @max(load_count, sample.index + 1);
+        mutex.unlock();
+    }
+}
+
+/// Drop cached loads and topology (after GPU hotplug)
+pub fn invalidate() void {
+    mutex.lock();
+    defer mutex.unlock();
+    loads = [_]DeviceLoad{.{}} ** max_devices;
+    load_count = 0;
+    topology = .{};
+}
+
+/// Rank GPUs for a workload, best first. Devices the hints exclude are left
+/// out. Returns the number written to `out`.
+pub fn rank(hints: Hints, out: []Candidate) usize {
+    ensureFresh();
+
+    mutex.lock();
+    defer mutex.unlock();
+
+    // Score every device before truncating to `out`
+    var all: [max_devices]Candidate = undefined;
+    var n: usize = 0;
+    for (loads[0..load_count], 0..) |load, i| {
+        const index: u32 = @intCast(i);
+        const link = linkTo(index, hints.display_gpu);
+        const score = scoreDevice(load, link, hints) orelse continue;
+        all[n] = .{
+            .index = index,
+            .score = score,
+            .free_vram_mb = load.free_vram_mb,
+            .utilization = load.utilization,
+            .thermal_headroom_c = load.thermalState().headroom(),
+            .encoder_sessions = load.encoder_sessions,
+            .link = link,
+        };
+        n += 1;
+    }
+
+    std.mem.sort(Candidate, all[0..n], {}, struct {
+        fn better(_: void, a: Candidate, b: Candidate) bool {
+            if (a.score != b.score) return a.score > b.score;
+            return a.index < b.index;
+        }
+    }.better);
+    const written = @min(n, out.len);
+    @memcpy(out[0..written], all[0..written]);
+    return written;
+}
+
+/// Best GPU for a workload, or null if none qualifies
+pub fn select(hints: Hints) ?u32 {
+    var candidates: [max_devices]Candidate = undefined;
+    if (rank(hints, &candidates) == 0) return null;
+    return candidates[0].index;
+}
+
+/// Score one device, or null if the hints exclude it
+pub fn scoreDevice(load: DeviceLoad, link: Link, hints: Hints) ?f32 {
+    if (!load.valid) return null;
+    if (load.free_vram_mb < hints.min_free_vram_mb) return null;
+
+    const headroom = load.thermalState().headroom();
+    if (hints.avoid_throttling and headroom <= 0) return null;
+
+    const w = hints.workload.weights();
+
+    const vram: f32 = if (load.total_vram_mb > 0)
+        @as(f32, @floatFromInt(load.free_vram_mb)) / @as(f32, @floatFromInt(load.total_vram_mb))
+    else
+        0.5;
+    const utilization = 1.0 - @as(f32, @floatFromInt(@min(load.utilization, 100))) / 100.0;
+    const thermal = std.math.clamp(@as(f32, @floatFromInt(headroom)) / full_headroom_c, 0.0, 1.0);
+
+    // Whichever is busier: the encoder engine or the session budget
+    const sessions = @as(f32, @floatFromInt(load.encoder_sessions + hints.encoder_sessions)) / encoder_session_budget;
+    const engine = @as(f32, @floatFromInt(@min(load.encoder_utilization, 100))) / 100.0;
+    const encoder = 1.0 - @min(@max(sessions, engine), 1.0);
+
+    const link_score: f32 = if (hints.display_gpu != null) link.score() else 1.0;
+
+    return w.vram * vram + w.utilization * utilization + w.thermal * thermal +
+        w.encoder * encoder + w.link * link_score;
+}
+
+/// Link from `index` to the display GPU (caller holds the mutex)
+fn linkTo(index: u32, display_gpu: ?u32) Link {
+    const display = display_gpu orelse return .unknown;
+    if (index == display) return .same_gpu;
+    if (index >= topology.count or display >= topology.count) return .unknown;
+    return topology.links[index][display];
+}
+
+/// Take a synchronous telemetry pass when the sampler isn't keeping the cache warm
+fn ensureFresh() void {
+    if (nvmon.sampler.isRunning()) {
+        // Encoder load is not in the sampler's default set
+        nvmon.sampler.requestFields(nvmon.Field.encoder.bit());
+        return;
+    }
+
+    var samples: [max_devices]nvmon.GpuSample = undefined;
+    if (nvmon.sampler.attachedReader()) |reader| {
+        // The daemon keeps its segment current; only fall back to NVML if it stopped
+        var n: usize = 0;
+        for (0..reader.gpuCount()) |i| {
+            if (nvmon.sampler.latest(@intCast(i))) |sample| {
+                samples[n] = sample;
+                n += 1;
+            }
+        }
+        if (n > 0) {
+            observe(samples[0..n]);
+            return;
+        }
+    }
+
+    mutex.lock();
+    const now = nvmon.timestampNs();
+    const stale = load_count == 0 or now -| loads[0].timestamp_ns > max_load_age_ns;
+    mutex.unlock();
+    if (!stale) return;
+
+    const mask = nvmon.Field.vram.bit() | nvmon.Field.utilization.bit() | nvmon.Field.temperature.bit() | nvmon.Field.encoder.bit();
+    const n = nvmon.sampleAll(&samples, mask) catch return;
+    observe(samples[0..n]);
+}
+
+/// Resolve NVLink/PCIe links and slowdown thresholds once per registry generation
+fn refreshTopology() void {
+    const generation = registry.generation();
+    mutex.lock();
+    const current = topology.generation == generation;
+    mutex.unlock();
+    if (current) return;
+
+    var fresh = Topology{ .generation = generation };
+    fresh.count = if (registry.isInitialized()) @min(registry.count() catch 0, max_devices) else 0;
+
+    for (0..fresh.count) |i| {
+        const a = registry.getEntry(@intCast(i)) orelse continue;
+        fresh.slowdown_c[i] = nvml.getDeviceTemperatureThreshold(a.handle, nvml.TEMPERATURE_THRESHOLD_SLOWDOWN) catch default_slowdown_c;
+
+        for (0..fresh.count) |j| {
+            if (i == j) {
+                fresh.links[i][j] = .same_gpu;
+                continue;
+            }
+            const b = registry.getEntry(@intCast(j)) orelse {
+                fresh.links[i][j] = .unknown;
+                continue;
+            };
+            fresh.links[i][j] = if (hasNvLink(&a, &b))
+                .nvlink
+            else if (nvml.getTopologyCommonAncestor(a.handle, b.handle)) |level|
+                Link.fromTopology(level)
+            else |_|
+                .unknown;
+        }
+    }
+
+    mutex.lock();
+    topology = fresh;
+    mutex.unlock();
+}
+
+fn hasNvLink(a: *const registry.Entry, b: *const registry.Entry) bool {
+    var link: u32 = 0;
+    while (link < nvml.NVLINK_MAX_LINKS) : (link += 1) {
+        const active = nvml.getDeviceNvLinkState(a.handle, link) catch return false;
+        if (!active) continue;
+        const remote = nvml.getDeviceNvLinkRemotePciInfo(a.handle, link) catch continue;
+        const remote_id = registry.formatBusId(remote);
+        if (std.mem.eql(u8, std.mem.sliceTo(&remote_id, 0), b.getBusId())) return true;
+    }
+    return false;
+}
+
+test "score prefers idle cool gpu near the display" {
+    const busy = DeviceLoad{ .valid = true, .free_vram_mb = 4000, .total_vram_mb = 24000, .utilization = 95, .temperature_c = 78 };
+    const idle = DeviceLoad{ .valid = true, .free_vram_mb = 20000, .total_vram_mb = 24000, .utilization = 5, .temperature_c = 45 };
+    const hints = Hints{ .workload = .render, .display_gpu = 0 };
+
+    const busy_local = scoreDevice(busy, .same_gpu, hints).?;
+    const idle_local = scoreDevice(idle, .same_gpu, hints).?;
+    const idle_remote = scoreDevice(idle, .cross_socket, hints).?;
+    try std.testing.expect(idle_local > busy_local);
+    try std.testing.expect(idle_local > idle_remote);
+
+    // Compute ignores the display link entirely
+    const compute = Hints{ .workload = .compute, .display_gpu = 0 };
+    try std.testing.expectEqual(scoreDevice(idle, .same_gpu, compute).?, scoreDevice(idle, .cross_socket, compute).?);
+}
+
+test "hints exclude devices" {
+    const hot = DeviceLoad{ .valid = true, .free_vram_mb = 8000, .total_vram_mb = 8000, .temperature_c = 85 };
+    try std.testing.expect(scoreDevice(hot, .unknown, .{}) == null);
+    try std.testing.expect(scoreDevice(hot, .unknown, .{ .avoid_throttling = false }) != null);
+    try std.testing.expect(scoreDevice(hot, .unknown, .{ .avoid_throttling = false, .min_free_vram_mb = 9000 }) == null);
+    try std.testing.expect(scoreDevice(.{}, .unknown, .{}) == null);
+}
+
+test "encoder load steers encode workloads" {
+    const streaming = DeviceLoad{ .valid = true, .free_vram_mb = 8000, .total_vram_mb = 8000, .temperature_c = 50, .encoder_sessions = 6 };
+    const quiet = DeviceLoad{ .valid = true, .free_vram_mb = 8000, .total_vram_mb = 8000, .temperature_c = 50 };
+    const hints = Hints{ .workload = .encode, .encoder_sessions = 1 };
+    try std.testing.expect(scoreDevice(quiet, .unknown, hints).? > scoreDevice(streaming, .unknown, hints).?);
+}
@@ -0,0 +1,302 @@
+//! nvcaps/registry - Device Handle Registry
+//!
+//! Resolves NVML handles, UUIDs and PCI bus IDs once at init so query paths
+//! don't pay for nvmlDeviceGetHandleByIndex on every call.
+//! Lookups are O(1) by index, UUID or PCI bus ID.
+
+const std = @import("std");
+const nvml = @import("../bindings/nvml.zig");
+
+/// Maximum number of devices the registry tracks
+pub const max_devices = 32;
+
+/// Lifecycle of a registry entry
+pub const DeviceState = enum(u8) {
+    present,
+    lost, // GPU fell off the bus or was hot-unplugged
+    unavailable, // handle could not be resolved at the last rebuild
+};
+
+/// Resolved device identity
+pub const Entry = struct {
+    index: u32,
+    handle: nvml.Device,
+    uuid: [96]u8,
+    pcie_bus_id: [32]u8,
+    state: std.atomic.Value(DeviceState),
+    /// Why the handle could not be resolved, for `unavailable` entries
+    resolve_error: ?anyerror = null,
+
+    pub fn getUuid(self: *const Entry) []const u8 {
+        return std.mem.sliceTo(&self.uuid, 0);
+    }
+
+    pub fn getBusId(self: *const Entry) []const u8 {
+        return std.mem.sliceTo(&self.pcie_bus_id, 0);
+    }
+
+    pub fn isLost(self: *const Entry) bool {
+        return self.state.load(.acquire) == .lost;
+    }
+};
+
+/// Open-addressing index from a string key to a device index
+const KeyIndex = struct {
+    const slot_count = max_devices * 2;
+    const empty: u8 = 0xff;
+
+    slots: [slot_count]u8 = [_]u8{empty} ** slot_count,
+
+    fn insert(self: *KeyIndex, key: []const u8, index: u8) void {
+        var slot = hashKey(key);
+        while (self.slots[slot] != empty) : (slot = (slot + 1) % slot_count) {}
+        self.slots[slot] = index;
+    }
+
+    fn find(self: *const KeyIndex, table: *const Table, key: []const u8, comptime keyOf: fn (*const Entry) []const u8) ?u32 {
+        var slot = hashKey(key);
+        var probes: usize = 0;
+        while (probes < slot_count) : (probes += 1) {
+            const index = self.slots[slot];
+            if (index == empty) return null;
+            if (std.mem.eql(u8, keyOf(&table.entries[index]), key)) return index;
+            slot = (slot + 1) % slot_count;
+        }
+        return null;
+    }
+
+    fn hashKey(key: []const u8) usize {
+        return @intCast(std.hash.Wyhash.hash(0, key) % slot_count);
+    }
+};
+
+/// One complete generation of the registry. Never modified once published.
+const Table = struct {
+    entries: [max_devices]Entry = undefined,
+    entry_count: u32 = 0,
+    uuid_index: KeyIndex = .{},
+    bus_index: KeyIndex = .{},
+};
+
+/// Lookups read `active` without locks. A rebuild fills the other table and
+/// publishes it with one pointer swap, so readers never see a half-built
+/// table. The retired table is rewritten by the very next rebuild, so
+/// entries are handed out as copies checked against `rewrite_seq`.
+var tables: [2]Table = .{ .{}, .{} };
+var active = std.atomic.Value(?*const Table).init(null);
+/// Odd while a rebuild rewrites the inactive table
+var rewrite_seq = std.atomic.Value(u64).init(0);
+
+var generation_counter = std.atomic.Value(u64).init(0);
+var build_mutex: std.Thread.Mutex = .{};
+var lazy = std.atomic.Value(bool).init(false);
+var lazy_mutex: std.Thread.Mutex = .{};
+
+/// Resolve every device. NVML must already be initialized.
+pub fn init() !void {
+    if (isInitialized()) return;
+    try rebuild();
+}
+
+/// Defer NVML initialization and the first build until a lookup needs a
+/// device (clients served telemetry by the nvprime daemon may never need one)
+pub fn enableLazyInit() void {
+    lazy.store(true, .release);
+}
+
+fn ensureReady() void {
+    if (isInitialized() or !lazy.load(.acquire)) return;
+    lazy_mutex.lock();
+    defer lazy_mutex.unlock();
+    if (isInitialized()) return;
+    nvml.init() catch return;
+    rebuild() catch return;
+    lazy.store(false, .release);
+}
+
+/// Drop all cached handles
+pub fn deinit() void {
+    build_mutex.lock();
+    defer build_mutex.unlock();
+
+    lazy.store(false, .release);
+    active.store(null, .release);
+    _ = generation_counter.fetchAdd(1, .release);
+}
+
+/// Re-resolve all devices (after hotplug or a lost GPU).
+/// Lookups made while the table is rebuilt keep using the previous table.
+pub fn refresh() !void {
+    try rebuild();
+}
+
+fn rebuild() !void {
+    build_mutex.lock();
+    defer build_mutex.unlock();
+
+    const device_count = try nvml.getDeviceCount();
+    const current = active.load(.acquire);
+    const table: *Table = if (current == &tables[0]) &tables[1] else &tables[0];
+    _ = rewrite_seq.fetchAdd(1, .acq_rel);
+    defer _ = rewrite_seq.fetchAdd(1, .release);
+    table.* = .{};
+
+    for (0..@min(device_count, max_devices)) |i| {
+        const index: u32 = @intCast(i);
+        const entry = &table.entries[i];
+        const handle = nvml.getDeviceByIndex(index) catch |err| {
+            // One bad GPU must not hide the others; keep its slot so indices
+            // still match NVML and report the error on lookup
+            std.log.warn("GPU {d}: cannot resolve handle: {}", .{ index, err });
+            entry.* = Entry{
+                .index = index,
+                .handle = undefined,
+                .uuid = [_]u8{0} ** 96,
+                .pcie_bus_id = [_]u8{0} ** 32,
+                .state = std.atomic.Value(DeviceState).init(.unavailable),
+                .resolve_error = err,
+            };
+            continue;
+        };
+        const uuid = nvml.getDeviceUuid(handle) catch [_]u8{0} ** 96;
+        const bus_id = if (nvml.getDevicePciInfo(handle)) |pci| formatBusId(pci) else |_| [_]u8{0} ** 32;
+
+        entry.* = Entry{
+            .index = index,
+            .handle = handle,
+            .uuid = uuid,
+            .pcie_bus_id = bus_id,
+            .state = std.atomic.Value(DeviceState).init(.present),
+        };
+        if (entry.getUuid().len > 0) table.uuid_index.insert(entry.getUuid(), @intCast(i));
+        if (entry.getBusId().len > 0) table.bus_index.insert(entry.getBusId(), @intCast(i));
+    }
+    table.entry_count = @min(device_count, max_devices);
+
+    active.store(table, .release);
+    _ = generation_counter.fetchAdd(1, .release);
+}
+
+/// Whether the registry has been populated
+pub fn isInitialized() bool {
+    return active.load(.acquire) != null;
+}
+
+/// Incremented every time the table is rebuilt or cleared.
+/// Callers that keep their own copies of handles can compare generations.
+pub fn generation() u64 {
+    return generation_counter.load(.acquire);
+}
+
+/// Number of registered devices
+pub fn count() !u32 {
+    ensureReady();
+    const table = active.load(.acquire) orelse return nvml.getDeviceCount();
+    return table.entry_count;
+}
+
+/// Get the NVML handle for a device index.
+/// Falls back to a direct NVML lookup when the registry is not populated.
+pub fn getDevice(index: u32) !nvml.Device {
+    ensureReady();
+    if (!isInitialized()) return nvml.getDeviceByIndex(index);
+    const entry = readEntry(index) orelse return error.NotFound;
+    return switch (entry.state.load(.acquire)) {
+        .present => entry.handle,
+        .lost => error.GpuIsLost,
+        .unavailable => entry.resolve_error orelse error.NotFound,
+    };
+}
+
+/// Get a copy of the registry entry for a device index; null for devices
+/// whose handle could not be resolved (see `getDevice` for the error)
+pub fn getEntry(index: u32) ?Entry {
+    ensureReady();
+    const entry = readEntry(index) orelse return null;
+    if (entry.state.load(.acquire) == .unavailable) return null;
+    return entry;
+}
+
+/// Copy an entry out of the active table, retrying if a rebuild started
+/// rewriting it during the copy
+fn readEntry(index: u32) ?Entry {
+    while (true) {
+        const before = rewrite_seq.load(.acquire);
+        const table = active.load(.acquire) orelse return null;
+        if (index >= table.entry_count) return null;
+        const entry = table.entries[index];
+        if (rewrite_seq.load(.acquire) == before) return entry;
+        std.atomic.spinLoopHint();
+    }
+}
+
+/// Find a device index by UUID (e.g. "GPU-8c5b...")
+pub fn findByUuid(uuid: []const u8) ?u32 {
+    ensureReady();
+    const table = active.load(.acquire) orelse return null;
+    return table.uuid_index.find(table, uuid, Entry.getUuid);
+}
+
+/// Find a device index by PCI bus ID.
+/// Accepts both the NVML ("00000000:01:00.0") and sysfs ("0000:01:00.0") forms.
+pub fn findByBusId(bus_id: []const u8) ?u32 {
+    ensureReady();
+    const table = active.load(.acquire) orelse return null;
+    var buf: [32]u8 = undefined;
+    const canonical = canonicalBusId(bus_id, &buf) orelse return null;
+    return table.bus_index.find(table, canonical, Entry.getBusId);
+}
+
+/// Mark a device as lost; further lookups fail with GpuIsLost until `refresh`
+pub fn markLost(index: u32) void {
+    const table = active.load(.acquire) orelse return;
+    if (index >= table.entry_count) return;
+    // The state is the one field of a published table that may still change
+    const state = @constCast(&table.entries[index].state);
+    if (state.cmpxchgStrong(.present, .lost, .acq_rel, .acquire) == null) {
+        std.log.warn("GPU {d} lost, invalidating cached handle", .{index});
+        _ = generation_counter.fetchAdd(1, .release);
+    }
+}
+
+/// Inspect an NVML error from a device query and invalidate the entry if the GPU is gone
+pub fn reportError(index: u32, err: anyerror) void {
+    if (err == error.GpuIsLost) markLost(index);
+}
+
+/// Format a PCI bus ID in the canonical sysfs form ("dddd:bb:dd.f")
+pub fn formatBusId(pci: nvml.PciInfo) [32]u8 {
+    var bus_id: [32]u8 = [_]u8{0} ** 32;
+    _ = std.fmt.bufPrint(&bus_id, "{x:0>4}:{x:0>2}:{x:0>2}.{d}", .{
+        pci.domain,
+        pci.bus,
+        pci.device,
+        0, // function
+    }) catch {};
+    return bus_id;
+}
+
+/// Normalize a PCI bus ID to the canonical lowercase "dddd:bb:dd.f" form
+pub fn canonicalBusId(bus_id: []const u8, buf: *[32]u8) ?[]const u8 {
+    var id = std.mem.sliceTo(bus_id, 0);
+    // NVML reports an 8-digit domain; sysfs uses 4
+    if (id.len == 16 and std.mem.startsWith(u8, id, "0000")) id = id[4..];
+    if (id.len != 12) return null;
+
+    for (id, 0..) |ch, i| {
+        buf[i] = std.ascii.toLower(ch);
+    }
+    return buf[0..id.len];
+}
+
+test "canonical bus id" {
+    var buf: [32]u8 = undefined;
+    try std.testing.expectEqualStrings("0000:01:00.0", canonicalBusId("00000000:01:00.0", &buf).?);
+    try std.testing.expectEqualStrings("0000:0a:00.0", canonicalBusId("0000:0A:00.0", &buf).?);
+    try std.testing.expect(canonicalBusId("bogus", &buf) == null);
+}
+
+test "uninitialized registry" {
+    try std.testing.expect(findByUuid("GPU-00000000") == null);
+    try std.testing.expect(getEntry(0) == null);
+}
@@ -5,6 +5,7 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
 
 /// Boost state information
 pub const BoostState = struct {
@@ -36,7 +37,7 @@ pub const BoostState = struct {
 
 /// Get current boost state
 pub fn getState(device_index: u32) !BoostState {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
 
     const current = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch 0;
     const max_clock = nvml.getDeviceMaxClock(device, nvml.CLOCK_GRAPHICS) catch 0;
@@ -48,7 +49,7 @@ pub fn getState(device_index: u32) !BoostState {
         .base_clock_mhz = base,
         .boost_clock_mhz = max_clock,
         .current_clock_mhz = current,
-        .offset_mhz = 0, // Would need to read from nvidia-settings or similar
+        .offset_mhz = nvml.getDeviceGpcClkVfOffset(device) catch 0,
         .thermal_throttle = false, // Would need throttle reason query
         .power_throttle = false,
     };
@@ -62,22 +63,19 @@ pub const OffsetConfig = struct {
     mem_offset_mhz: i32 = 0,
 };
 
-/// Set clock offset (requires elevated permissions)
+/// Set clock offset on the V/F curve (requires elevated permissions)
 pub fn setOffset(device_index: u32, config: OffsetConfig) !void {
-    _ = device_index;
-    _ = config;
-    // TODO: Implement via nvidia-settings or Coolbits
-    // nvidia-settings -a "[gpu:0]/GPUGraphicsClockOffsetAllPerformanceLevels=100"
-    return error.NotSupported;
+    const device = try registry.getDevice(device_index);
+    try nvml.setDeviceGpcClkVfOffset(device, config.gpu_offset_mhz);
+    try nvml.setDeviceMemClkVfOffset(device, config.mem_offset_mhz);
 }
 
 /// Get current clock offset
 pub fn getOffset(device_index: u32) !OffsetConfig {
-    _ = device_index;
-    // TODO: Query from nvidia-settings
+    const device = try registry.getDevice(device_index);
     return OffsetConfig{
-        .gpu_offset_mhz = 0,
-        .mem_offset_mhz = 0,
+        .gpu_offset_mhz = try nvml.getDeviceGpcClkVfOffset(device),
+        .mem_offset_mhz = try nvml.getDeviceMemClkVfOffset(device),
     };
 }
 
@@ -4,6 +4,7 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
 
 /// Clock configuration
 pub const ClockConfig = struct {
@@ -13,31 +14,31 @@ pub const ClockConfig = struct {
 
 /// Get current GPU clock speed
 pub fn getGpuClock(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     return nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS);
 }
 
 /// Get current memory clock speed
 pub fn getMemoryClock(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     return nvml.getDeviceClock(device, nvml.CLOCK_MEM);
 }
 
 /// Get current SM clock speed
 pub fn getSmClock(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     return nvml.getDeviceClock(device, nvml.CLOCK_SM);
 }
 
 /// Get max GPU clock speed
 pub fn getMaxGpuClock(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     return nvml.getDeviceMaxClock(device, nvml.CLOCK_GRAPHICS);
 }
 
 /// Get max memory clock speed
 pub fn getMaxMemoryClock(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     return nvml.getDeviceMaxClock(device, nvml.CLOCK_MEM);
 }
 
@@ -63,7 +64,7 @@ pub const ClockSummary = struct {
 
 /// Get complete clock summary
 pub fn getSummary(device_index: u32) !ClockSummary {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
 
     return ClockSummary{
         .gpu_current_mhz = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch 0,
@@ -75,32 +76,89 @@ pub fn getSummary(device_index: u32) !ClockSummary {
     };
 }
 
-// Note: Setting clocks requires nvidia-smi or direct NVML API calls that may need
-// special permissions. The following are stubs for future implementation:
+/// Clock domain that can be locked
+pub const Domain = enum {
+    gpu,
+    memory,
+
+    fn clockType(self: Domain) nvml.ClockType {
+        return switch (self) {
+            .gpu => nvml.CLOCK_GRAPHICS,
+            .memory => nvml.CLOCK_MEM,
+        };
+    }
+};
+
+/// A locked clock range in MHz
+pub const LockedRange = struct {
+    min_mhz: u32,
+    max_mhz: u32,
+};
+
+// NVML cannot report locked clocks, so remember what we set
+var locks: [registry.max_devices][2]?LockedRange = [_][2]?LockedRange{.{ null, null }} ** registry.max_devices;
+var lock_mutex: std.Thread.Mutex = .{};
+
+fn recordLock(device_index: u32, domain: Domain, range: ?LockedRange) void {
+    if (device_index >= registry.max_devices) return;
+    lock_mutex.lock();
+    defer lock_mutex.unlock();
+    locks[device_index][@intFromEnum(domain)] = range;
+}
+
+/// Range this process locked a clock domain to, or null if driver managed
+pub fn getLock(device_index: u32, domain: Domain) ?LockedRange {
+    if (device_index >= registry.max_devices) return null;
+    lock_mutex.lock();
+    defer lock_mutex.unlock();
+    return locks[device_index][@intFromEnum(domain)];
+}
+
+/// Lock a clock domain to a range (requires root). A missing bound
+/// defaults to 0 or the maximum supported clock.
+pub fn lock(device_index: u32, domain: Domain, config: ClockConfig) !void {
+    const device = try registry.getDevice(device_index);
+    const range = LockedRange{
+        .min_mhz = config.min_mhz orelse 0,
+        .max_mhz = config.max_mhz orelse try nvml.getDeviceMaxClock(device, domain.clockType()),
+    };
+    if (range.min_mhz > range.max_mhz) return error.InvalidArgument;
+
+    switch (domain) {
+        .gpu => try nvml.setDeviceGpuLockedClocks(device, range.min_mhz, range.max_mhz),
+        .memory => try nvml.setDeviceMemoryLockedClocks(device, range.min_mhz, range.max_mhz),
+    }
+    recordLock(device_index, domain, range);
+}
+
+/// Return a clock domain to driver control (requires root)
+pub fn unlock(device_index: u32, domain: Domain) !void {
+    const device = try registry.getDevice(device_index);
+    switch (domain) {
+        .gpu => try nvml.resetDeviceGpuLockedClocks(device),
+        .memory => try nvml.resetDeviceMemoryLockedClocks(device),
+    }
+    recordLock(device_index, domain, null);
+}
 
 /// Set GPU clock range (requires elevated permissions)
 pub fn setGpuClock(device_index: u32, config: ClockConfig) !void {
-    _ = device_index;
-    _ = config;
-    // TODO: Implement via nvidia-smi or NVML clock lock APIs
-    // nvmlDeviceSetGpuLockedClocks or nvidia-smi -lgc
-    return error.NotSupported;
+    return lock(device_index, .gpu, config);
 }
 
-/// Set memory clock (requires elevated permissions)
+/// Set memory clock range (requires elevated permissions, Ampere+)
 pub fn setMemoryClock(device_index: u32, config: ClockConfig) !void {
-    _ = device_index;
-    _ = config;
-    // TODO: Implement via nvidia-smi or NVML
-    // nvmlDeviceSetMemoryLockedClocks or nvidia-smi -lmc
-    return error.NotSupported;
+    return lock(device_index, .memory, config);
 }
 
 /// Reset clocks to default
 pub fn resetClocks(device_index: u32) !void {
-    _ = device_index;
-    // TODO: nvmlDeviceResetGpuLockedClocks / nvidia-smi -rgc
-    return error.NotSupported;
+    try unlock(device_index, .gpu);
+    // Older GPUs never had a memory lock to reset
+    unlock(device_index, .memory) catch |err| switch (err) {
+        error.NotSupported => {},
+        else => return err,
+    };
 }
 
 test "clock summary" {
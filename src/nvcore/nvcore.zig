@@ -1,15 +1,20 @@
 //! nvcore - GPU Fundamentals
 //!
-//! Low-level GPU control: clocks, p-states, boost, and voltage management.
+//! Low-level GPU control: clocks, p-states, boost, and voltage management,
+//! plus transactions that apply several of them off the caller's thread.
 //! This is the performance tuning core of NVPrime.
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvmon = @import("../nvmon/nvmon.zig");
+const sampler = @import("../nvmon/sampler.zig");
 
 pub const clocks = @import("clocks.zig");
 pub const pstates = @import("pstates.zig");
 pub const boost = @import("boost.zig");
 pub const voltage = @import("voltage.zig");
+pub const tuning = @import("tuning.zig");
 
 /// GPU core state snapshot
 pub const CoreState = struct {
@@ -33,25 +38,41 @@ pub const CoreState = struct {
     }
 };
 
-/// Get current core state for a GPU
+/// Get current core state for a GPU.
+/// Fields the sampler carries come from its snapshot; the rest from NVML.
 pub fn getState(device_index: u32) !CoreState {
-    const device = try nvml.getDeviceByIndex(device_index);
-
-    const gpu_clock = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch 0;
-    const mem_clock = nvml.getDeviceClock(device, nvml.CLOCK_MEM) catch 0;
-    const sm_clock = nvml.getDeviceClock(device, nvml.CLOCK_SM) catch 0;
-    const video_clock = nvml.getDeviceClock(device, nvml.CLOCK_VIDEO) catch 0;
-    const pstate = nvml.getDevicePerformanceState(device) catch @as(c_uint, 15);
-    const util = nvml.getDeviceUtilization(device) catch nvml.Utilization{ .gpu = 0, .memory = 0 };
+    const sample = sampler.latest(device_index) orelse nvmon.GpuSample{};
+    const wanted = [_]nvmon.Field{ .gpu_clock, .mem_clock, .sm_clock, .video_clock, .pstate, .utilization };
+    const complete = for (wanted) |field| {
+        if (!sample.has(field)) break false;
+    } else true;
+    if (complete) return stateFromSample(sample);
+
+    const device = try registry.getDevice(device_index);
+    var state = stateFromSample(sample);
+    if (!sample.has(.gpu_clock)) state.gpu_clock_mhz = nvml.getDeviceClock(device, nvml.CLOCK_GRAPHICS) catch 0;
+    if (!sample.has(.mem_clock)) state.mem_clock_mhz = nvml.getDeviceClock(device, nvml.CLOCK_MEM) catch 0;
+    if (!sample.has(.sm_clock)) state.sm_clock_mhz = nvml.getDeviceClock(device, nvml.CLOCK_SM) catch 0;
+    if (!sample.has(.video_clock)) state.video_clock_mhz = nvml.getDeviceClock(device, nvml.CLOCK_VIDEO) catch 0;
+    if (!sample.has(.pstate)) state.pstate = @intCast(nvml.getDevicePerformanceState(device) catch @as(c_uint, 15));
+    if (!sample.has(.utilization)) {
+        const util = nvml.getDeviceUtilization(device) catch nvml.Utilization{ .gpu = 0, .memory = 0 };
+        state.gpu_utilization = util.gpu;
+        state.mem_utilization = util.memory;
+    }
+    return state;
+}
 
+/// Core state from a sample; fields it lacks read as zero (P15)
+fn stateFromSample(sample: nvmon.GpuSample) CoreState {
     return CoreState{
-        .gpu_clock_mhz = gpu_clock,
-        .mem_clock_mhz = mem_clock,
-        .sm_clock_mhz = sm_clock,
-        .video_clock_mhz = video_clock,
-        .pstate = @intCast(pstate),
-        .gpu_utilization = util.gpu,
-        .mem_utilization = util.memory,
+        .gpu_clock_mhz = if (sample.has(.gpu_clock)) sample.gpu_clock_mhz else 0,
+        .mem_clock_mhz = if (sample.has(.mem_clock)) sample.mem_clock_mhz else 0,
+        .sm_clock_mhz = if (sample.has(.sm_clock)) sample.sm_clock_mhz else 0,
+        .video_clock_mhz = if (sample.has(.video_clock)) sample.video_clock_mhz else 0,
+        .pstate = if (sample.has(.pstate)) sample.pstate else 15,
+        .gpu_utilization = if (sample.has(.utilization)) sample.gpu_utilization else 0,
+        .mem_utilization = if (sample.has(.utilization)) sample.mem_utilization else 0,
     };
 }
 
@@ -67,7 +88,7 @@ pub const ClockLimits = struct {
 
 /// Get clock limits for a GPU
 pub fn getClockLimits(device_index: u32) !ClockLimits {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
 
     // Get max supported clocks
     const max_gpu = nvml.getDeviceMaxClock(device, nvml.CLOCK_GRAPHICS) catch 0;
@@ -127,6 +148,12 @@ pub const PerformanceProfile = enum {
     }
 };
 
+test {
+    _ = clocks;
+    _ = boost;
+    _ = tuning;
+}
+
 test "core state" {
     const state = CoreState{
         .gpu_clock_mhz = 1800,
@@ -5,6 +5,7 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
 
 /// P-state definitions
 pub const PState = enum(u4) {
@@ -49,7 +50,7 @@ pub const PState = enum(u4) {
 
 /// Get current P-state
 pub fn getCurrent(device_index: u32) !PState {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     const pstate = try nvml.getDevicePerformanceState(device);
     return @enumFromInt(@as(u4, @intCast(@intFromEnum(pstate))));
 }
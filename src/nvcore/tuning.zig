@@ -0,0 +1,402 @@
+//! nvcore/tuning - Tuning Transactions
+//!
+//! Clock offsets, locked clocks, the power limit and the fan target are
+//! staged on a `Transaction` and committed as one batch on a worker thread,
+//! so a profile switch never blocks the caller on NVML writes (each can
+//! take milliseconds). Every step saves what it replaces before writing;
+//! if a step fails, the steps already applied are undone in reverse order.
+//!
+//! Completion is reported through the `Future` handed to `commit`: poll it,
+//! wait on it, or pass a callback. Transactions run one at a time, in the
+//! order they were committed.
+
+const std = @import("std");
+const build_options = @import("build_options");
+const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvcore = @import("nvcore.zig");
+const clocks = @import("clocks.zig");
+const boost = @import("boost.zig");
+const fans = @import("../nvpower/fans.zig");
+
+/// Target for a locked clock domain
+pub const Lock = union(enum) {
+    /// Lock to a range
+    range: clocks.LockedRange,
+    /// Cap at a percentage of the maximum supported clock
+    max_percent: u32,
+    /// Return to driver control
+    reset,
+};
+
+pub const PowerTarget = union(enum) {
+    milliwatts: u32,
+    /// Percentage of the default limit, clamped to the allowed range
+    percent: u32,
+};
+
+pub const FanTarget = union(enum) {
+    auto,
+    percent: u32,
+};
+
+/// Transaction steps, in the order they are applied
+pub const Step = enum(u8) {
+    power_limit,
+    fan,
+    clock_offsets,
+    gpu_lock,
+    mem_lock,
+};
+
+/// Changes staged for one GPU. Unset fields are left alone.
+pub const Transaction = struct {
+    device_index: u32,
+    clock_offsets: ?boost.OffsetConfig = null,
+    gpu_lock: ?Lock = null,
+    mem_lock: ?Lock = null,
+    power_limit: ?PowerTarget = null,
+    fan: ?FanTarget = null,
+
+    pub fn init(device_index: u32) Transaction {
+        return .{ .device_index = device_index };
+    }
+
+    /// Stage the clock caps and power limit of a performance profile
+    pub fn stageProfile(self: *Transaction, profile: nvcore.PerformanceProfile) void {
+        self.gpu_lock = capAt(profile.getGpuClockPercent());
+        self.mem_lock = capAt(profile.getMemClockPercent());
+        self.power_limit = .{ .percent = profile.getPowerLimitPercent() };
+    }
+
+    pub fn stages(self: *const Transaction, step: Step) bool {
+        return switch (step) {
+            .power_limit => self.power_limit != null,
+            .fan => self.fan != null,
+            .clock_offsets => self.clock_offsets != null,
+            .gpu_lock => self.gpu_lock != null,
+            .mem_lock => self.mem_lock != null,
+        };
+    }
+
+    pub fn isEmpty(self: *const Transaction) bool {
+        for (std.enums.values(Step)) |step| {
+            if (self.stages(step)) return false;
+        }
+        return true;
+    }
+};
+
+fn capAt(percent: u32) Lock {
+    return if (percent >= 100) .reset else .{ .max_percent = percent };
+}
+
+pub const Status = enum(u8) {
+    /// Never committed
+    idle,
+    /// Queued or being applied
+    pending,
+    /// Every step applied
+    committed,
+    /// A step failed and everything applied before it was undone
+    rolled_back,
+    /// A step failed and undoing the earlier ones failed too
+    rollback_failed,
+};
+
+pub const Result = struct {
+    status: Status,
+    /// Step that failed, if any
+    failed_step: ?Step = null,
+    err: ?anyerror = null,
+};
+
+/// Called on the worker once a transaction finished. It is the last thing
+/// to touch the future, so the callback may free it.
+pub const Callback = *const fn (future: *Future, context: ?*anyopaque) void;
+
+/// Completion of a committed transaction. Must stay alive until it is no
+/// longer pending (and, with a callback, until the callback ran). It may be
+/// committed again once no longer pending, while the previous callback is
+/// still running.
+pub const Future = struct {
+    status: std.atomic.Value(Status) = std.atomic.Value(Status).init(.idle),
+    failed_step: ?Step = null,
+    err: ?anyerror = null,
+    done: std.Thread.ResetEvent = .{},
+
+    tx: Transaction = undefined,
+    callback: ?Callback = null,
+    context: ?*anyopaque = null,
+    next: ?*Future = null,
+
+    pub fn poll(self: *const Future) Status {
+        return self.status.load(.acquire);
+    }
+
+    /// Result so far; `status` is `.pending` until the worker is done
+    pub fn result(self: *const Future) Result {
+        const status = self.poll();
+        if (status == .pending) return .{ .status = .pending };
+        return .{ .status = status, .failed_step = self.failed_step, .err = self.err };
+    }
+
+    pub fn wait(self: *Future) Result {
+        if (self.poll() == .pending) self.done.wait();
+        return self.result();
+    }
+
+    pub fn timedWait(self: *Future, timeout_ns: u64) error{Timeout}!Result {
+        if (self.poll() == .pending) try self.done.timedWait(timeout_ns);
+        return self.result();
+    }
+};
+
+var queue_mutex: std.Thread.Mutex = .{};
+var queue_cond: std.Thread.Condition = .{};
+var queue_head: ?*Future = null;
+var queue_tail: ?*Future = null;
+var worker_started = false;
+
+/// Queue a transaction for the worker and return immediately
+pub fn commit(tx: Transaction, future: *Future, callback: ?Callback, context: ?*anyopaque) !void {
+    if (tx.device_index >= registry.max_devices) return error.NotFound;
+
+    queue_mutex.lock();
+    defer queue_mutex.unlock();
+    // Checked under the lock: the worker finishes a future under it too
+    if (future.poll() == .pending) return error.InUse;
+
+    if (!worker_started) {
+        // The worker lives for the rest of the process
+        const thread = try std.Thread.spawn(.{}, workerMain, .{});
+        thread.detach();
+        worker_started = true;
+    }
+
+    future.* = .{ .tx = tx, .callback = callback, .context = context };
+    future.status.store(.pending, .release);
+    if (queue_tail) |tail| tail.next = future else queue_head = future;
+    queue_tail = future;
+    queue_cond.signal();
+}
+
+fn workerMain() void {
+    while (true) {
+        const future = blk: {
+            queue_mutex.lock();
+            defer queue_mutex.unlock();
+            while (queue_head == null) queue_cond.wait(&queue_mutex);
+            const head = queue_head.?;
+            queue_head = head.next;
+            if (queue_head == null) queue_tail = null;
+            break :blk head;
+        };
+
+        const res = apply(future.tx);
+        future.failed_step = res.failed_step;
+        future.err = res.err;
+        const callback = future.callback;
+        const context = future.context;
+        {
+            // A commit racing the waiters must not reset `done` mid-set
+            queue_mutex.lock();
+            defer queue_mutex.unlock();
+            future.status.store(res.status, .release);
+            future.done.set();
+        }
+        if (callback) |cb| cb(future, context);
+    }
+}
+
+/// What each applied step replaced
+const Undo = struct {
+    applied: std.EnumSet(Step) = .initEmpty(),
+    power_limit_mw: u32 = 0,
+    fan: fans.Control = .{ .mode = .auto },
+    clock_offsets: boost.OffsetConfig = .{},
+    gpu_lock: ?clocks.LockedRange = null,
+    mem_lock: ?clocks.LockedRange = null,
+};
+
+/// Apply a transaction on the calling thread
+pub fn apply(tx: Transaction) Result {
+    var undo = Undo{};
+    for (std.enums.values(Step)) |step| {
+        if (!tx.stages(step)) continue;
+        applyStep(&tx, step, &undo) catch |err| {
+            const clean = rollback(tx.device_index, &undo);
+            return .{ .status = if (clean) .rolled_back else .rollback_failed, .failed_step = step, .err = err };
+        };
+    }
+    return .{ .status = .committed };
+}
+
+fn applyStep(tx: *const Transaction, step: Step, undo: *Undo) !void {
+    const index = tx.device_index;
+    // Save first, then mark applied: a step that fails halfway is undone too
+    switch (step) {
+        .power_limit => {
+            const device = try registry.getDevice(index);
+            undo.power_limit_mw = try nvml.getDevicePowerLimit(device);
+            undo.applied.insert(step);
+            switch (tx.power_limit.?) {
+                .milliwatts => |mw| try nvml.setDevicePowerLimit(device, mw),
+                .percent => |p| try nvml.setDevicePowerLimit(device, try percentOfDefault(device, p)),
+            }
+        },
+        .fan => {
+            undo.fan = try fans.saveControl(index);
+            undo.applied.insert(step);
+            switch (tx.fan.?) {
+                .auto => try fans.setAuto(index),
+                .percent => |p| try fans.setSpeed(index, p),
+            }
+        },
+        .clock_offsets => {
+            undo.clock_offsets = try boost.getOffset(index);
+            undo.applied.insert(step);
+            try boost.setOffset(index, tx.clock_offsets.?);
+        },
+        .gpu_lock => {
+            undo.gpu_lock = clocks.getLock(index, .gpu);
+            undo.applied.insert(step);
+            try applyLock(index, .gpu, tx.gpu_lock.?);
+        },
+        .mem_lock => {
+            undo.mem_lock = clocks.getLock(index, .memory);
+            undo.applied.insert(step);
+            try applyLock(index, .memory, tx.mem_lock.?);
+        },
+    }
+}
+
+/// `percent` of the board's default limit in milliwatts, clamped to the
+/// allowed range. Never taken from the current limit, which an earlier
+/// commit may already have lowered.
+fn percentOfDefault(device: nvml.Device, percent: u32) !u32 {
+    const default_mw = try nvml.getDevicePowerDefaultLimit(device);
+    const target: u32 = @intCast(@min(@as(u64, default_mw) * percent / 100, std.math.maxInt(u32)));
+    const range = nvml.getDevicePowerLimitConstraints(device) catch return target;
+    return @max(range.min_mw, @min(target, range.max_mw));
+}
+
+fn applyLock(index: u32, domain: clocks.Domain, target: Lock) !void {
+    switch (target) {
+        .range => |range| try clocks.lock(index, domain, .{ .min_mhz = range.min_mhz, .max_mhz = range.max_mhz }),
+        .max_percent => |p| {
+            const device = try registry.getDevice(index);
+            const clock = switch (domain) {
+                .gpu => nvml.CLOCK_GRAPHICS,
+                .memory => nvml.CLOCK_MEM,
+            };
+            const max = try nvml.getDeviceMaxClock(device, clock);
+            try clocks.lock(index, domain, .{ .max_mhz = max * p / 100 });
+        },
+        .reset => try clocks.unlock(index, domain),
+    }
+}
+
+fn restoreLock(index: u32, domain: clocks.Domain, previous: ?clocks.LockedRange) !void {
+    const range = previous orelse return clocks.unlock(index, domain);
+    try clocks.lock(index, domain, .{ .min_mhz = range.min_mhz, .max_mhz = range.max_mhz });
+}
+
+/// Undo applied steps, newest first. Returns false if any undo failed.
+fn rollback(index: u32, undo: *const Undo) bool {
+    var clean = true;
+    const steps = comptime std.enums.values(Step);
+    var i = steps.len;
+    while (i > 0) {
+        i -= 1;
+        const step = steps[i];
+        if (!undo.applied.contains(step)) continue;
+        undoStep(index, step, undo) catch |err| {
+            std.log.warn("tuning rollback of {s} on GPU {d} failed: {s}", .{ @tagName(step), index, @errorName(err) });
+            clean = false;
+        };
+    }
+    return clean;
+}
+
+fn undoStep(index: u32, step: Step, undo: *const Undo) !void {
+    switch (step) {
+        .power_limit => {
+            const device = try registry.getDevice(index);
+            try nvml.setDevicePowerLimit(device, undo.power_limit_mw);
+        },
+        .fan => try fans.restoreControl(index, undo.fan),
+        .clock_offsets => try boost.setOffset(index, undo.clock_offsets),
+        .gpu_lock => try restoreLock(index, .gpu, undo.gpu_lock),
+        .mem_lock => try restoreLock(index, .memory, undo.mem_lock),
+    }
+}
+
+test "profile staging" {
+    var tx = Transaction.init(0);
+    try std.testing.expect(tx.isEmpty());
+
+    tx.stageProfile(.maximum);
+    try std.testing.expect(tx.gpu_lock.? == .reset);
+    try std.testing.expect(!tx.stages(.fan));
+
+    tx.stageProfile(.quiet);
+    try std.testing.expectEqual(@as(u32, 60), tx.gpu_lock.?.max_percent);
+    try std.testing.expectEqual(@as(u32, 65), tx.power_limit.?.percent);
+}
+
+test "commit completes through the worker" {
+    const Counter = struct {
+        fn done(future: *Future, context: ?*anyopaque) void {
+            _ = future;
+            const calls: *std.atomic.Value(u32) = @ptrCast(@alignCast(context.?));
+            _ = calls.fetchAdd(1, .release);
+        }
+    };
+    var calls = std.atomic.Value(u32).init(0);
+
+    // Nothing staged, so no NVML call is made
+    var future = Future{};
+    try commit(Transaction.init(0), &future, Counter.done, &calls);
+    const res = try future.timedWait(5 * std.time.ns_per_s);
+    try std.testing.expectEqual(Status.committed, res.status);
+
+    // The callback runs right after the waiters are released
+    while (calls.load(.acquire) == 0) std.Thread.yield() catch {};
+    try std.testing.expectError(error.NotFound, commit(Transaction.init(registry.max_devices), &future, null, null));
+}
+
+test "failed step rolls back the earlier ones" {
+    // Needs the bench mock, which remembers limits and offsets
+    if (!build_options.nvml_mock) return error.SkipZigTest;
+    const device = try registry.getDevice(0);
+    const limit_before = try nvml.getDevicePowerLimit(device);
+
+    // The memory offset is out of range, after the GPU offset already applied
+    var tx = Transaction.init(0);
+    tx.power_limit = .{ .percent = 80 };
+    tx.clock_offsets = .{ .gpu_offset_mhz = 100, .mem_offset_mhz = 5000 };
+    const res = apply(tx);
+
+    try std.testing.expectEqual(Status.rolled_back, res.status);
+    try std.testing.expectEqual(Step.clock_offsets, res.failed_step.?);
+    try std.testing.expect(res.err.? == error.InvalidArgument);
+    try std.testing.expectEqual(limit_before, try nvml.getDevicePowerLimit(device));
+    try std.testing.expectEqual(@as(i32, 0), (try boost.getOffset(0)).gpu_offset_mhz);
+}
+
+test "power percentages do not compound" {
+    if (!build_options.nvml_mock) return error.SkipZigTest;
+    const device = try registry.getDevice(0);
+    const default_mw = try nvml.getDevicePowerDefaultLimit(device);
+
+    var tx = Transaction.init(0);
+    tx.power_limit = .{ .percent = 80 };
+    for (0..2) |_| {
+        try std.testing.expectEqual(Status.committed, apply(tx).status);
+        try std.testing.expectEqual(default_mw * 80 / 100, try nvml.getDevicePowerLimit(device));
+    }
+
+    tx.power_limit = .{ .milliwatts = default_mw };
+    try std.testing.expectEqual(Status.committed, apply(tx).status);
+}
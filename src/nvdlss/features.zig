@@ -0,0 +1,524 @@
+//! nvdlss/features - NGX Feature Cache
+//!
+//! Creating an NGX feature (DLSS-SR, FG, RR) costs hundreds of milliseconds,
+//! and every change of mode, quality or output size needs a new one. Features
+//! are created on a background thread and kept, with their scratch memory,
+//! in a small LRU cache keyed by (mode, quality, output resolution), so a
+//! settings change swaps to a pre-built handle instead of stalling a frame.
+//!
+//! Lookups never wait for NGX: `get` returns a ready feature or queues its
+//! creation and returns null, and the caller keeps using the feature it has
+//! until the new one is ready. Handles of evicted features are released on
+//! the worker too, but only once the frames that may still use them on the
+//! GPU have completed. A feature that fails to build is retried with
+//! backoff, and lookups report the failure meanwhile.
+
+const std = @import("std");
+const nvdlss = @import("nvdlss.zig");
+const trace = @import("../nvmon/trace.zig");
+
+const NgxFunctions = nvdlss.NgxFunctions;
+const NVSDK_NGX_Handle = nvdlss.NVSDK_NGX_Handle;
+const NVSDK_NGX_Parameter = nvdlss.NVSDK_NGX_Parameter;
+const NVSDK_NGX_Result = nvdlss.NVSDK_NGX_Result;
+
+pub const default_capacity = 4;
+pub const max_capacity = 8;
+/// Frames the GPU may still be working on after they were submitted
+pub const default_frames_in_flight = 3;
+
+/// Backoff between attempts to build a feature that failed
+const retry_min_ms: u64 = 250;
+const retry_max_ms: u64 = 30_000;
+
+/// NVSDK_NGX_DLSS_Feature_Flags_IsHDR
+const feature_flag_hdr: u32 = 1 << 0;
+
+/// Everything an NGX feature is created for
+pub const Key = struct {
+    mode: nvdlss.DlssMode,
+    quality: nvdlss.QualityMode,
+    output_width: u32,
+    output_height: u32,
+    hdr: bool = false,
+
+    pub fn eql(self: Key, other: Key) bool {
+        return std.meta.eql(self, other);
+    }
+
+    /// Whether features for both keys write the same output (only the
+    /// quality, and so the input size, differs)
+    pub fn sameOutput(self: Key, other: Key) bool {
+        return self.mode == other.mode and self.hdr == other.hdr and
+            self.output_width == other.output_width and self.output_height == other.output_height;
+    }
+
+    /// NGX feature to create; null when DLSS is off
+    pub fn ngxFeature(self: Key) ?nvdlss.NVSDK_NGX_Feature {
+        return switch (self.mode) {
+            .disabled => null,
+            .super_resolution => .super_sampling,
+            .frame_generation, .multi_frame_gen => .frame_generation,
+            .ray_reconstruction => .ray_reconstruction,
+        };
+    }
+
+    /// Input size the feature expects
+    pub fn renderResolution(self: Key) nvdlss.Resolution {
+        return switch (self.mode) {
+            .super_resolution, .frame_generation => self.quality.getRenderResolution(self.output_width, self.output_height),
+            else => .{ .width = self.output_width, .height = self.output_height },
+        };
+    }
+};
+
+pub const State = enum(u8) { empty, queued, creating, ready, failed };
+
+/// One cache slot. Fields are only meaningful once `state` is `.ready`.
+pub const Feature = struct {
+    key: Key = undefined,
+    state: State = .empty,
+    /// Computed once at creation
+    render_width: u32 = 0,
+    render_height: u32 = 0,
+    /// Null in stub mode (no NGX runtime loaded)
+    handle: ?*NVSDK_NGX_Handle = null,
+    /// Scratch memory NGX asked for at creation
+    scratch: []u8 = &.{},
+    result: NVSDK_NGX_Result = .success,
+    /// Cache clock at the last lookup
+    last_used: u64 = 0,
+    /// Frame count until which submitted GPU work may still use it
+    busy_until: u64 = 0,
+    /// Failed builds in a row, and when the next attempt is due (monotonic ns)
+    failures: u32 = 0,
+    retry_at_ns: u64 = 0,
+
+    // Resources of the evicted feature, released by the worker
+    stale_handle: ?*NVSDK_NGX_Handle = null,
+    stale_scratch: []u8 = &.{},
+};
+
+pub const Options = struct {
+    capacity: usize = default_capacity,
+    frames_in_flight: u32 = default_frames_in_flight,
+};
+
+pub const Cache = struct {
+    /// Used from the worker thread too, so it must be thread-safe
+    allocator: std.mem.Allocator,
+    ngx: NgxFunctions,
+    capacity: usize,
+    frames_in_flight: u32,
+    slots: [max_capacity]Feature = [_]Feature{.{}} ** max_capacity,
+
+    mutex: std.Thread.Mutex = .{},
+    cond: std.Thread.Condition = .{},
+    clock: u64 = 0,
+    /// In use by the caller; never evicted
+    pinned: ?*const Feature = null,
+    /// Frames ended so far (see `endFrame`)
+    frame: u64 = 0,
+    worker: ?std.Thread = null,
+    stopping: bool = false,
+    created: u64 = 0,
+
+    pub fn create(allocator: std.mem.Allocator, ngx: NgxFunctions, options: Options) !*Cache {
+        if (options.capacity == 0 or options.capacity > max_capacity) return error.InvalidConfig;
+        const self = try allocator.create(Cache);
+        self.* = .{ .allocator = allocator, .ngx = ngx, .capacity = options.capacity, .frames_in_flight = options.frames_in_flight };
+        return self;
+    }
+
+    /// Stop the worker and release every handle. The caller must be done
+    /// with all features (GPU work included).
+    pub fn destroy(self: *Cache) void {
+        self.mutex.lock();
+        self.stopping = true;
+        self.cond.broadcast();
+        const worker = self.worker;
+        self.mutex.unlock();
+        if (worker) |thread| thread.join();
+
+        for (self.slots[0..self.capacity]) |*slot| {
+            self.releaseResources(slot.stale_handle, slot.stale_scratch);
+            self.releaseResources(slot.handle, slot.scratch);
+        }
+        self.allocator.destroy(self);
+    }
+
+    /// Ready feature for `key`, or null after queueing its creation.
+    /// error.FeatureCreationFailed while a failed build waits for its retry.
+    pub fn get(self: *Cache, key: Key) error{FeatureCreationFailed}!?*const Feature {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.clock += 1;
+        const slot = self.find(key) orelse {
+            _ = self.enqueue(key);
+            return null;
+        };
+        slot.last_used = self.clock;
+        return switch (slot.state) {
+            .ready => slot,
+            .failed => if (self.retry(slot)) null else error.FeatureCreationFailed,
+            else => null,
+        };
+    }
+
+    /// Start building a feature ahead of time
+    pub fn prepare(self: *Cache, key: Key) void {
+        _ = self.get(key) catch {};
+    }
+
+    /// Requeue a failed slot once its backoff has passed
+    fn retry(self: *Cache, slot: *Feature) bool {
+        if (monotonicNs() < slot.retry_at_ns) return false;
+        slot.state = .queued;
+        self.cond.broadcast();
+        return true;
+    }
+
+    /// Count a submitted frame. Features set aside by `pin` are released
+    /// once `frames_in_flight` more frames were submitted after them.
+    pub fn endFrame(self: *Cache) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.frame += 1;
+    }
+
+    /// Block until the feature for `key` is built (loading screens)
+    pub fn wait(self: *Cache, key: Key, timeout_ns: u64) !*const Feature {
+        if (key.ngxFeature() == null) return error.FeatureNotSupported;
+        var timer = try std.time.Timer.start();
+
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        self.clock += 1;
+        while (true) {
+            // With every slot busy, enqueue fails until one finishes
+            if (self.find(key) orelse self.enqueue(key)) |slot| {
+                slot.last_used = self.clock;
+                switch (slot.state) {
+                    .ready => return slot,
+                    .failed => if (!self.retry(slot)) return error.FeatureCreationFailed,
+                    else => {},
+                }
+            }
+            const elapsed = timer.read();
+            if (elapsed >= timeout_ns) return error.Timeout;
+            self.cond.timedWait(&self.mutex, timeout_ns - elapsed) catch {};
+        }
+    }
+
+    /// Keep a feature from being evicted while it is in use; null unpins.
+    /// The one it replaces stays until its last frames left the GPU.
+    pub fn pin(self: *Cache, feature: ?*const Feature) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.pinned == feature) return;
+        if (self.pinned) |old| self.slotOf(old).busy_until = self.frame + self.frames_in_flight;
+        self.pinned = feature;
+    }
+
+    fn slotOf(self: *Cache, feature: *const Feature) *Feature {
+        const index = (@intFromPtr(feature) - @intFromPtr(&self.slots)) / @sizeOf(Feature);
+        return &self.slots[index];
+    }
+
+    fn find(self: *Cache, key: Key) ?*Feature {
+        for (self.slots[0..self.capacity]) |*slot| {
+            if (slot.state != .empty and slot.key.eql(key)) return slot;
+        }
+        return null;
+    }
+
+    /// Empty slot, else the least recently used settled one that is neither
+    /// pinned nor used by frames still in flight
+    fn victim(self: *Cache) ?*Feature {
+        var best: ?*Feature = null;
+        for (self.slots[0..self.capacity]) |*slot| {
+            switch (slot.state) {
+                .empty => return slot,
+                .queued, .creating => continue,
+                .ready, .failed => {},
+            }
+            if (self.pinned == slot or slot.busy_until > self.frame) continue;
+            if (best == null or slot.last_used < best.?.last_used) best = slot;
+        }
+        return best;
+    }
+
+    fn enqueue(self: *Cache, key: Key) ?*Feature {
+        if (key.ngxFeature() == null) return null;
+        const slot = self.victim() orelse return null;
+        if (self.worker == null) {
+            self.worker = std.Thread.spawn(.{}, workerMain, .{self}) catch return null;
+        }
+        slot.* = .{
+            .key = key,
+            .state = .queued,
+            .last_used = self.clock,
+            .stale_handle = slot.handle,
+            .stale_scratch = slot.scratch,
+        };
+        self.cond.broadcast();
+        return slot;
+    }
+
+    /// Most recently requested first: that is the one the game is waiting on
+    fn nextQueued(self: *Cache) ?*Feature {
+        var best: ?*Feature = null;
+        for (self.slots[0..self.capacity]) |*slot| {
+            if (slot.state != .queued) continue;
+            if (best == null or slot.last_used > best.?.last_used) best = slot;
+        }
+        return best;
+    }
+
+    fn workerMain(self: *Cache) void {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        while (!self.stopping) {
+            const slot = self.nextQueued() orelse {
+                self.cond.wait(&self.mutex);
+                continue;
+            };
+            // Creating slots are never picked for eviction, so `slot` stays ours
+            slot.state = .creating;
+            const key = slot.key;
+            const stale_handle = slot.stale_handle;
+            const stale_scratch = slot.stale_scratch;
+            slot.stale_handle = null;
+            slot.stale_scratch = &.{};
+
+            self.mutex.unlock();
+            self.releaseResources(stale_handle, stale_scratch);
+            const built = self.build(key);
+            self.mutex.lock();
+
+            const render = key.renderResolution();
+            slot.render_width = render.width;
+            slot.render_height = render.height;
+            slot.handle = built.handle;
+            slot.scratch = built.scratch;
+            slot.result = built.result;
+            if (built.result.isSuccess()) {
+                slot.state = .ready;
+                slot.failures = 0;
+                self.created += 1;
+            } else {
+                const delay_ms = @min(retry_min_ms << @intCast(@min(slot.failures, 16)), retry_max_ms);
+                slot.state = .failed;
+                slot.failures += 1;
+                slot.retry_at_ns = monotonicNs() + delay_ms * std.time.ns_per_ms;
+                std.log.warn("nvdlss: creating the {s} feature for {d}x{d} failed (0x{x}), retrying in {d} ms", .{
+                    @tagName(key.mode),
+                    key.output_width,
+                    key.output_height,
+                    @as(u32, @bitCast(@intFromEnum(built.result))),
+                    delay_ms,
+                });
+            }
+            self.cond.broadcast();
+        }
+    }
+
+    const Built = struct {
+        handle: ?*NVSDK_NGX_Handle = null,
+        scratch: []u8 = &.{},
+        result: NVSDK_NGX_Result = .success,
+    };
+
+    fn build(self: *Cache, key: Key) Built {
+        const span = trace.begin(.nvdlss, "dlss_create_feature", trace.currentFrame());
+        defer span.end();
+
+        // Stub mode: nothing to create, the feature is ready at once
+        const create_feature = self.ngx.create_feature orelse return .{};
+        const allocate = self.ngx.allocate_parameters orelse return .{ .result = .not_initialized };
+        const feature = key.ngxFeature().?;
+
+        // A private parameter block: the render thread keeps its own for evaluation
+        var params_out: ?*NVSDK_NGX_Parameter = null;
+        var result = allocate(&params_out);
+        if (!result.isSuccess()) return .{ .result = result };
+        const params = params_out orelse return .{ .result = .fail };
+        defer if (self.ngx.destroy_parameters) |destroy_params| {
+            _ = destroy_params(params);
+        };
+
+        if (self.ngx.parameter_set_ui) |set| {
+            const render = key.renderResolution();
+            set(params, "Width", render.width);
+            set(params, "Height", render.height);
+            set(params, "OutWidth", key.output_width);
+            set(params, "OutHeight", key.output_height);
+            set(params, "PerfQualityValue", @intFromEnum(key.quality.toNgx()));
+            set(params, "DLSS.Feature.Create.Flags", if (key.hdr) feature_flag_hdr else 0);
+        }
+
+        var scratch: []u8 = &.{};
+        if (self.ngx.get_scratch_buffer_size) |scratch_size| {
+            var size: usize = 0;
+            result = scratch_size(feature, params, &size);
+            if (!result.isSuccess()) return .{ .result = result };
+            if (size > 0) scratch = self.allocator.alloc(u8, size) catch return .{ .result = .out_of_memory };
+        }
+
+        var handle: ?*NVSDK_NGX_Handle = null;
+        result = create_feature(feature, params, &handle);
+        if (!result.isSuccess()) {
+            self.allocator.free(scratch);
+            return .{ .result = result };
+        }
+        return .{ .handle = handle, .scratch = scratch };
+    }
+
+    fn releaseResources(self: *Cache, handle: ?*NVSDK_NGX_Handle, scratch: []u8) void {
+        if (handle) |h| {
+            if (self.ngx.release_feature) |release| _ = release(h);
+        }
+        self.allocator.free(scratch);
+    }
+};
+
+fn monotonicNs() u64 {
+    const ts = std.posix.clock_gettime(.MONOTONIC) catch return 0;
+    return @as(u64, @intCast(ts.sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.nsec));
+}
+
+test "feature keys" {
+    const key = Key{ .mode = .super_resolution, .quality = .performance, .output_width = 3840, .output_height = 2160 };
+    try std.testing.expectEqual(nvdlss.NVSDK_NGX_Feature.super_sampling, key.ngxFeature().?);
+    try std.testing.expectEqual(@as(u32, 1920), key.renderResolution().width);
+
+    var other = key;
+    other.quality = .quality;
+    try std.testing.expect(!key.eql(other));
+    try std.testing.expect(key.sameOutput(other));
+    other.output_width = 2560;
+    try std.testing.expect(!key.sameOutput(other));
+
+    const off = Key{ .mode = .disabled, .quality = .quality, .output_width = 1920, .output_height = 1080 };
+    try std.testing.expect(off.ngxFeature() == null);
+    try std.testing.expectEqual(@as(u32, 1920), off.renderResolution().width);
+}
+
+test "stub features build in the background" {
+    const cache = try Cache.create(std.testing.allocator, .{}, .{});
+    defer cache.destroy();
+
+    const key = Key{ .mode = .super_resolution, .quality = .quality, .output_width = 2560, .output_height = 1440 };
+    const feature = try cache.wait(key, 5 * std.time.ns_per_s);
+    try std.testing.expectEqual(State.ready, feature.state);
+    try std.testing.expectEqual(@as(u32, 1706), feature.render_width);
+    try std.testing.expectEqual(feature, (try cache.get(key)).?);
+
+    const off = Key{ .mode = .disabled, .quality = .quality, .output_width = 2560, .output_height = 1440 };
+    try std.testing.expect((try cache.get(off)) == null);
+    try std.testing.expectError(error.FeatureNotSupported, cache.wait(off, std.time.ns_per_ms));
+}
+
+const MockNgx = struct {
+    var created = std.atomic.Value(u32).init(0);
+    var released = std.atomic.Value(u32).init(0);
+    var params_byte: u8 = 0;
+    var handle_bytes: [max_capacity]u8 = undefined;
+
+    fn allocate(out: *?*NVSDK_NGX_Parameter) callconv(.C) NVSDK_NGX_Result {
+        out.* = @ptrCast(&params_byte);
+        return .success;
+    }
+
+    fn scratchSize(_: nvdlss.NVSDK_NGX_Feature, _: *const NVSDK_NGX_Parameter, size: *usize) callconv(.C) NVSDK_NGX_Result {
+        size.* = 4096;
+        return .success;
+    }
+
+    fn create(_: nvdlss.NVSDK_NGX_Feature, _: *NVSDK_NGX_Parameter, out: *?*NVSDK_NGX_Handle) callconv(.C) NVSDK_NGX_Result {
+        const n = created.fetchAdd(1, .monotonic);
+        out.* = @ptrCast(&handle_bytes[n % handle_bytes.len]);
+        return .success;
+    }
+
+    fn release(_: *NVSDK_NGX_Handle) callconv(.C) NVSDK_NGX_Result {
+        _ = released.fetchAdd(1, .monotonic);
+        return .success;
+    }
+};
+
+test "least recently used features are evicted and released" {
+    const ngx = NgxFunctions{
+        .allocate_parameters = MockNgx.allocate,
+        .get_scratch_buffer_size = MockNgx.scratchSize,
+        .create_feature = MockNgx.create,
+        .release_feature = MockNgx.release,
+    };
+    const cache = try Cache.create(std.testing.allocator, ngx, .{ .capacity = 2 });
+
+    const timeout = 5 * std.time.ns_per_s;
+    const a = Key{ .mode = .super_resolution, .quality = .quality, .output_width = 2560, .output_height = 1440 };
+    var b = a;
+    b.quality = .performance;
+    var c = a;
+    c.output_width = 3440;
+
+    const fa = try cache.wait(a, timeout);
+    _ = try cache.wait(b, timeout);
+    try std.testing.expectEqual(@as(usize, 4096), fa.scratch.len);
+
+    // Touch a: b is now the least recently used
+    try std.testing.expectEqual(fa, (try cache.get(a)).?);
+    _ = try cache.wait(c, timeout);
+    try std.testing.expectEqual(@as(u32, 1), MockNgx.released.load(.monotonic));
+    try std.testing.expect(cache.find(b) == null);
+
+    // A pinned feature survives even as the oldest entry
+    cache.pin(fa);
+    const fb = try cache.wait(b, timeout);
+    try std.testing.expect(cache.find(a) != null);
+
+    // Swapped out, it stays until its frames in flight are done
+    cache.pin(fb);
+    try std.testing.expectError(error.Timeout, cache.wait(c, std.time.ns_per_ms));
+    for (0..default_frames_in_flight) |_| cache.endFrame();
+    _ = try cache.wait(c, timeout);
+    try std.testing.expect(cache.find(a) == null);
+
+    cache.destroy();
+    try std.testing.expectEqual(@as(u32, 5), MockNgx.created.load(.monotonic));
+    try std.testing.expectEqual(MockNgx.created.load(.monotonic), MockNgx.released.load(.monotonic));
+}
+
+test "failed builds are reported and retried" {
+    const Failing = struct {
+        var params_byte: u8 = 0;
+        var attempts = std.atomic.Value(u32).init(0);
+
+        fn allocate(out: *?*NVSDK_NGX_Parameter) callconv(.C) NVSDK_NGX_Result {
+            out.* = @ptrCast(&params_byte);
+            return .success;
+        }
+
+        fn create(_: nvdlss.NVSDK_NGX_Feature, _: *NVSDK_NGX_Parameter, _: *?*NVSDK_NGX_Handle) callconv(.C) NVSDK_NGX_Result {
+            _ = attempts.fetchAdd(1, .monotonic);
+            return .feature_not_supported;
+        }
+    };
+    const ngx = NgxFunctions{ .allocate_parameters = Failing.allocate, .create_feature = Failing.create };
+    const cache = try Cache.create(std.testing.allocator, ngx, .{});
+    defer cache.destroy();
+
+    const key = Key{ .mode = .super_resolution, .quality = .quality, .output_width = 2560, .output_height = 1440 };
+    try std.testing.expectError(error.FeatureCreationFailed, cache.wait(key, 5 * std.time.ns_per_s));
+    try std.testing.expectError(error.FeatureCreationFailed, cache.get(key));
+    try std.testing.expectEqual(@as(u32, 1), cache.find(key).?.failures);
+
+    // Once the backoff has passed, the next lookup queues another attempt
+    cache.mutex.lock();
+    cache.find(key).?.retry_at_ns = 0;
+    cache.mutex.unlock();
+    try std.testing.expect((try cache.get(key)) == null);
+    try std.testing.expectError(error.FeatureCreationFailed, cache.wait(key, 5 * std.time.ns_per_s));
+    try std.testing.expectEqual(@as(u32, 2), Failing.attempts.load(.monotonic));
+}
@@ -8,6 +8,10 @@
 
 const std = @import("std");
 const builtin = @import("builtin");
+const trace = @import("../nvmon/trace.zig");
+
+/// Background NGX feature creation and the LRU cache of built features
+pub const features = @import("features.zig");
 
 pub const version = "0.1.0-dev";
 
@@ -92,6 +96,26 @@ pub const NgxFunctions = struct {
         handle: *NVSDK_NGX_Handle,
         params: *NVSDK_NGX_Parameter,
     ) callconv(.C) NVSDK_NGX_Result = null,
+
+    allocate_parameters: ?*const fn (
+        *?*NVSDK_NGX_Parameter,
+    ) callconv(.C) NVSDK_NGX_Result = null,
+
+    destroy_parameters: ?*const fn (
+        params: *NVSDK_NGX_Parameter,
+    ) callconv(.C) NVSDK_NGX_Result = null,
+
+    parameter_set_ui: ?*const fn (
+        params: *NVSDK_NGX_Parameter,
+        name: [*:0]const u8,
+        value: u32,
+    ) callconv(.C) void = null,
+
+    get_scratch_buffer_size: ?*const fn (
+        feature: NVSDK_NGX_Feature,
+        params: *const NVSDK_NGX_Parameter,
+        size: *usize,
+    ) callconv(.C) NVSDK_NGX_Result = null,
 };
 
 // ============================================================================
@@ -132,6 +156,11 @@ pub const DlssVersion = struct {
     }
 };
 
+pub const Resolution = struct {
+    width: u32,
+    height: u32,
+};
+
 /// DLSS quality mode
 pub const QualityMode = enum(u8) {
     ultra_performance, // 3x upscale, best FPS
@@ -163,7 +192,7 @@ pub const QualityMode = enum(u8) {
         };
     }
 
-    pub fn getRenderResolution(self: QualityMode, output_width: u32, output_height: u32) struct { width: u32, height: u32 } {
+    pub fn getRenderResolution(self: QualityMode, output_width: u32, output_height: u32) Resolution {
         const scale = self.scaleFactor();
         return .{
             .width = @intFromFloat(@as(f32, @floatFromInt(output_width)) / scale),
@@ -337,6 +366,9 @@ pub const DlssError = error{
     DriverTooOld,
     InvalidState,
     EvaluateFailed,
+    Timeout,
+    /// NGX could not build the feature; it is retried with backoff
+    FeatureCreationFailed,
 };
 
 /// DLSS runtime context
@@ -347,17 +379,18 @@ pub const DlssContext = struct {
     version: ?DlssVersion,
     initialized: bool = false,
 
-    // NGX handles
+    // NGX state; feature handles live in the cache, built off the render thread
     ngx_functions: NgxFunctions = .{},
-    ngx_sr_handle: ?*NVSDK_NGX_Handle = null,
-    ngx_fg_handle: ?*NVSDK_NGX_Handle = null,
-    ngx_rr_handle: ?*NVSDK_NGX_Handle = null,
     ngx_params: ?*NVSDK_NGX_Parameter = null,
+    feature_cache: ?*features.Cache = null,
+    /// Feature evaluate runs with (pinned in the cache)
+    active_feature: ?*const features.Feature = null,
 
     // Frame tracking
     frame_index: u64 = 0,
     frames_upscaled: u64 = 0,
     frames_generated: u64 = 0,
+    feature_swaps: u64 = 0,
 
     const Self = @This();
 
@@ -382,22 +415,17 @@ pub const DlssContext = struct {
         // Validate config against capabilities
         try ctx.validateConfig();
 
+        ctx.feature_cache = features.Cache.create(allocator, ctx.ngx_functions, .{}) catch return DlssError.OutOfMemory;
         ctx.initialized = true;
         return ctx;
     }
 
     /// Cleanup resources
     pub fn deinit(self: *Self) void {
-        if (self.ngx_sr_handle) |handle| {
-            if (self.ngx_functions.release_feature) |release| {
-                _ = release(handle);
-            }
-        }
-        if (self.ngx_fg_handle) |handle| {
-            if (self.ngx_functions.release_feature) |release| {
-                _ = release(handle);
-            }
-        }
+        // Releases every cached feature handle
+        if (self.feature_cache) |cache| cache.destroy();
+        self.feature_cache = null;
+        self.active_feature = null;
         if (self.ngx_functions.shutdown) |shutdown| {
             _ = shutdown();
         }
@@ -460,43 +488,141 @@ pub const DlssContext = struct {
         }
     }
 
-    /// Update DLSS configuration
+    /// Update DLSS configuration. The feature for the new settings is built
+    /// in the background; evaluate keeps using the current one until then.
     pub fn setConfig(self: *Self, config: DlssConfig) DlssError!void {
+        const previous = self.config;
         self.config = config;
-        try self.validateConfig();
-        // TODO: Recreate NGX features if needed
+        self.validateConfig() catch |err| {
+            self.config = previous;
+            return err;
+        };
+        if (self.active_feature) |active| {
+            self.prepare(active.key.output_width, active.key.output_height);
+        }
+    }
+
+    fn keyFor(self: *const Self, output_width: u32, output_height: u32) features.Key {
+        return .{
+            .mode = self.config.mode,
+            .quality = self.config.quality,
+            .output_width = output_width,
+            .output_height = output_height,
+            .hdr = self.config.hdr,
+        };
+    }
+
+    /// Start building the feature for an output size ahead of time, e.g. for
+    /// the resolutions a settings menu offers
+    pub fn prepare(self: *Self, output_width: u32, output_height: u32) void {
+        const cache = self.feature_cache orelse return;
+        cache.prepare(self.keyFor(output_width, output_height));
     }
 
-    /// Get optimal render resolution for DLSS upscaling
-    pub fn getRenderResolution(self: *const Self, output_width: u32, output_height: u32) struct { width: u32, height: u32 } {
-        if (self.config.mode != .super_resolution and self.config.mode != .frame_generation) {
-            return .{ .width = output_width, .height = output_height };
+    /// Block until the feature for an output size is built and make it
+    /// active (loading screens)
+    pub fn waitForFeature(self: *Self, output_width: u32, output_height: u32, timeout_ns: u64) DlssError!void {
+        const cache = self.feature_cache orelse return DlssError.InvalidState;
+        const feature = cache.wait(self.keyFor(output_width, output_height), timeout_ns) catch |err| return switch (err) {
+            error.Timeout => DlssError.Timeout,
+            error.FeatureCreationFailed => DlssError.FeatureCreationFailed,
+            else => DlssError.FeatureNotSupported,
+        };
+        self.activate(feature);
+    }
+
+    fn activate(self: *Self, feature: *const features.Feature) void {
+        if (self.active_feature == feature) return;
+        self.feature_cache.?.pin(feature);
+        self.active_feature = feature;
+        self.feature_swaps += 1;
+    }
+
+    /// Feature to evaluate with: the exact match once it is built and the
+    /// frame was rendered for it, otherwise the active one while it still
+    /// writes this output (quality switch)
+    fn selectFeature(self: *Self, input: *const DlssInput) DlssError!?*const features.Feature {
+        const cache = self.feature_cache orelse return null;
+        const key = self.keyFor(input.output_width, input.output_height);
+        if (self.active_feature) |active| {
+            if (active.key.eql(key)) return active;
+        }
+        var covering: ?*const features.Feature = null;
+        if (self.active_feature) |active| {
+            if (active.key.sameOutput(key)) covering = active;
+        }
+
+        const ready = cache.get(key) catch |err| {
+            // Keep upscaling on the active feature while a failed one waits for its retry
+            if (covering) |active| return active;
+            return err;
+        };
+        if (ready) |feature| {
+            if (input.render_width <= feature.render_width and input.render_height <= feature.render_height) {
+                self.activate(feature);
+                return feature;
+            }
+        }
+        return covering;
+    }
+
+    /// Get optimal render resolution for DLSS upscaling: the size of the
+    /// feature for these settings once it is built (computed at creation),
+    /// else that of the active one while it covers this output. Until then
+    /// frames pass through, so the game renders at the output size.
+    pub fn getRenderResolution(self: *const Self, output_width: u32, output_height: u32) Resolution {
+        const key = self.keyFor(output_width, output_height);
+        if (self.feature_cache) |cache| {
+            const ready = cache.get(key) catch null;
+            if (ready) |feature| return .{ .width = feature.render_width, .height = feature.render_height };
         }
-        return self.config.quality.getRenderResolution(output_width, output_height);
+        if (self.active_feature) |active| {
+            if (active.key.sameOutput(key)) return .{ .width = active.render_width, .height = active.render_height };
+        }
+        return .{ .width = output_width, .height = output_height };
     }
 
-    /// Process frame through DLSS
+    /// Process frame through DLSS. Until a feature for the output size is
+    /// built the frame is passed through (`upscaled` is false). Returns
+    /// FeatureCreationFailed while no feature covers the output because
+    /// building it failed.
     pub fn evaluate(self: *Self, input: DlssInput) DlssError!DlssOutput {
         if (!self.initialized) {
             return DlssError.InvalidState;
         }
 
         self.frame_index += 1;
+        const span = trace.begin(.nvdlss, "dlss_evaluate", trace.currentFrame());
+        defer span.end();
+        // Features swapped out are released only after their frames left the GPU
+        defer if (self.feature_cache) |cache| cache.endFrame();
+
+        const swaps = self.feature_swaps;
+        const feature = try self.selectFeature(&input) orelse {
+            return DlssOutput{ .frame_index = self.frame_index, .upscaled = false, .generated = false, .generated_frame_count = 0 };
+        };
+        // A new feature has no temporal history yet
+        const history_reset = input.reset or self.feature_swaps != swaps;
 
-        // TODO: Actual NGX evaluation
-        // 1. Set input parameters (color, depth, motion vectors, exposure)
+        // TODO: Actual NGX evaluation with feature.handle
+        // 1. Set input parameters (color, depth, motion vectors, exposure, reset)
         // 2. Call NVSDK_NGX_VULKAN_EvaluateFeature / D3D equivalent
         // 3. Return upscaled/generated output
-
-        _ = input;
+        _ = feature;
 
         // Stub output
-        return DlssOutput{
+        const mode = self.config.mode;
+        const generated_count: u8 = if (self.config.frame_gen == .multi_3x) 3 else if (self.config.frame_gen == .multi_2x) 2 else if (mode == .frame_generation) 1 else 0;
+        const output = DlssOutput{
             .frame_index = self.frame_index,
-            .upscaled = self.config.mode == .super_resolution or self.config.mode == .frame_generation,
-            .generated = self.config.mode == .frame_generation or self.config.mode == .multi_frame_gen,
-            .generated_frame_count = if (self.config.frame_gen == .multi_3x) @as(u8, 3) else if (self.config.frame_gen == .multi_2x) @as(u8, 2) else if (self.config.mode == .frame_generation) @as(u8, 1) else @as(u8, 0),
+            .upscaled = mode == .super_resolution or mode == .frame_generation,
+            .generated = mode == .frame_generation or mode == .multi_frame_gen,
+            .generated_frame_count = generated_count,
+            .history_reset = history_reset,
         };
+        if (output.upscaled) self.frames_upscaled += 1;
+        if (output.generated) self.frames_generated += generated_count;
+        return output;
     }
 
     /// Get performance statistics
@@ -507,6 +633,7 @@ pub const DlssContext = struct {
             .mode = self.config.mode,
             .quality = self.config.quality,
             .version = self.version,
+            .feature_swaps = self.feature_swaps,
         };
     }
 };
@@ -542,6 +669,8 @@ pub const DlssOutput = struct {
     upscaled: bool,
     generated: bool,
     generated_frame_count: u8,
+    /// Temporal history restarted (requested, or a new feature took over)
+    history_reset: bool = false,
 };
 
 /// DLSS performance statistics
@@ -551,6 +680,8 @@ pub const DlssStats = struct {
     mode: DlssMode,
     quality: QualityMode,
     version: ?DlssVersion,
+    /// Times evaluation moved to another cached feature
+    feature_swaps: u64 = 0,
 };
 
 // ============================================================================
@@ -567,6 +698,8 @@ pub const ReflexContext = struct {
     // Frame pacing
     target_framerate: u32 = 0, // 0 = unlimited
     frame_index: u64 = 0,
+    /// Trace ID of the frame in flight, taken at simulation start
+    trace_frame: u64 = 0,
 
     const Self = @This();
 
@@ -594,6 +727,8 @@ pub const ReflexContext = struct {
     /// Signal simulation start
     pub fn simulationStart(self: *Self) void {
         if (self.mode == .disabled) return;
+        // Reflex frames start here; later stages tag their events with this ID
+        self.trace_frame = trace.beginFrame();
         self.setMarker(.simulation_start);
     }
 
@@ -631,7 +766,9 @@ pub const ReflexContext = struct {
     /// Set latency marker
     pub fn setMarker(self: *Self, marker: ReflexMarker) void {
         if (self.mode == .disabled) return;
-        _ = marker;
+        switch (marker) {
+            inline else => |m| trace.instant(.nvdlss, "reflex." ++ @tagName(m), self.trace_frame),
+        }
         // TODO: Call NvAPI_D3D_SetSleepMode / NVLL_VK_SetLatencyMarker
     }
 
@@ -721,6 +858,10 @@ pub fn getRecommendedQuality(output_width: u32, output_height: u32) QualityMode
 // Tests
 // ============================================================================
 
+test {
+    _ = features;
+}
+
 test "dlss version features" {
     const v3 = DlssVersion{ .major = 3, .minor = 0, .patch = 0 };
     try std.testing.expect(v3.supportsFrameGen());
@@ -754,6 +895,38 @@ test "dlss context init" {
     try std.testing.expect(ctx.capabilities.supports_dlss_sr);
 }
 
+test "quality switch keeps evaluating on the active feature" {
+    var ctx = try DlssContext.init(std.testing.allocator, .{ .quality = .quality });
+    defer ctx.deinit();
+
+    try ctx.waitForFeature(3840, 2160, 5 * std.time.ns_per_s);
+    try std.testing.expectEqual(@as(u32, 2560), ctx.getRenderResolution(3840, 2160).width);
+
+    // The new feature builds in the background; frames keep upscaling meanwhile
+    try ctx.setConfig(.{ .quality = .performance });
+    const out = try ctx.evaluate(.{ .render_width = 2560, .render_height = 1440, .output_width = 3840, .output_height = 2160 });
+    try std.testing.expect(out.upscaled);
+
+    try ctx.waitForFeature(3840, 2160, 5 * std.time.ns_per_s);
+    try std.testing.expectEqual(@as(u32, 1920), ctx.getRenderResolution(3840, 2160).width);
+    try std.testing.expectEqual(@as(u64, 2), ctx.getStats().feature_swaps);
+}
+
+test "frames render at the output size until a feature is ready" {
+    var ctx = try DlssContext.init(std.testing.allocator, .{ .quality = .quality });
+    defer ctx.deinit();
+
+    // Nothing built yet: render natively and pass the frame through
+    try std.testing.expectEqual(@as(u32, 3840), ctx.getRenderResolution(3840, 2160).width);
+    const native = try ctx.evaluate(.{ .render_width = 3840, .render_height = 2160, .output_width = 3840, .output_height = 2160 });
+    try std.testing.expect(!native.upscaled);
+
+    try ctx.waitForFeature(3840, 2160, 5 * std.time.ns_per_s);
+    try std.testing.expectEqual(@as(u32, 2560), ctx.getRenderResolution(3840, 2160).width);
+    const out = try ctx.evaluate(.{ .render_width = 2560, .render_height = 1440, .output_width = 3840, .output_height = 2160 });
+    try std.testing.expect(out.upscaled);
+}
+
 test "reflex context" {
     const allocator = std.testing.allocator;
     var ctx = try ReflexContext.init(allocator, .enabled);
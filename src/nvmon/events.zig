@@ -0,0 +1,410 @@
+//! nvmon/events - GPU Event Monitor
+//!
+//! Blocks in nvmlEventSetWait on one thread and turns NVML events plus
+//! clock-throttle-reason transitions into `Event` records. Consumers either
+//! register a callback or wait on an eventfd and drain the queue with `poll`,
+//! so nothing has to spin on getState() to notice a rare event.
+
+const std = @import("std");
+const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvmon = @import("nvmon.zig");
+
+/// Event categories
+pub const EventKind = enum(u32) {
+    /// Clock throttle reasons changed (value = new reasons, aux = previous reasons)
+    throttle_changed = 0,
+    /// Thermal throttling started (value = temperature C, aux = slowdown threshold C)
+    thermal_warning = 1,
+    /// Power cap throttling started (value = power draw mW, aux = power limit mW)
+    power_limit_reached = 2,
+    /// Performance state changed (value = new P-state)
+    pstate_change = 3,
+    /// Critical Xid error (value = Xid code)
+    xid = 4,
+
+    pub fn bit(self: EventKind) KindMask {
+        return @as(KindMask, 1) << @intCast(@intFromEnum(self));
+    }
+};
+
+/// Bitmask of `EventKind` values
+pub const KindMask = u32;
+
+/// Every event kind
+pub const all_kinds: KindMask = blk: {
+    var mask: KindMask = 0;
+    for (std.enums.values(EventKind)) |k| mask |= k.bit();
+    break :blk mask;
+};
+
+/// One GPU event. Layout is C-compatible.
+pub const Event = extern struct {
+    kind: EventKind,
+    gpu_index: u32,
+    /// CLOCK_MONOTONIC, like `GpuSample.timestamp_ns`
+    timestamp_ns: u64,
+    value: u64,
+    aux: u64,
+};
+
+/// Throttle reasons caused by temperature
+pub const thermal_reasons: u64 = nvml.THROTTLE_SW_THERMAL | nvml.THROTTLE_HW_THERMAL | nvml.THROTTLE_HW_SLOWDOWN;
+
+/// Throttle reasons caused by the power limit
+pub const power_reasons: u64 = nvml.THROTTLE_SW_POWER_CAP | nvml.THROTTLE_HW_POWER_BRAKE;
+
+pub fn isThermalThrottle(reasons: u64) bool {
+    return (reasons & thermal_reasons) != 0;
+}
+
+pub fn isPowerThrottle(reasons: u64) bool {
+    return (reasons & power_reasons) != 0;
+}
+
+/// Event monitor configuration
+pub const Config = struct {
+    /// Kinds delivered to the queue and callbacks
+    kinds: KindMask = all_kinds,
+    /// Longest single NVML wait; throttle reasons are re-checked on every timeout
+    poll_timeout_ms: u32 = 500,
+    /// Temperature reported as the threshold in thermal_warning events
+    thermal_threshold_c: u32 = 83,
+};
+
+/// Callback invoked on the monitor thread for every delivered event
+pub const Callback = *const fn (event: *const Event, user_data: ?*anyopaque) callconv(.c) void;
+
+const max_callbacks = 8;
+const queue_capacity = 64;
+
+const Subscriber = struct {
+    callback: Callback,
+    user_data: ?*anyopaque,
+};
+
+var subscribers: [max_callbacks]?Subscriber = [_]?Subscriber{null} ** max_callbacks;
+var queue: [queue_capacity]Event = undefined;
+var queue_head: usize = 0;
+var queue_len: usize = 0;
+var dropped = std.atomic.Value(u64).init(0);
+var delivery_mutex: std.Thread.Mutex = .{};
+/// Held while callbacks run; `removeCallback` takes it to wait them out.
+/// Lock order: dispatch_mutex before delivery_mutex.
+var dispatch_mutex: std.Thread.Mutex = .{};
+var dispatch_thread = std.atomic.Value(std.Thread.Id).init(0);
+
+var throttle_state: [registry.max_devices]std.atomic.Value(u64) =
+    [_]std.atomic.Value(u64){std.atomic.Value(u64).init(0)} ** registry.max_devices;
+var throttle_known: [registry.max_devices]std.atomic.Value(bool) =
+    [_]std.atomic.Value(bool){std.atomic.Value(bool).init(false)} ** registry.max_devices;
+
+var config: Config = .{};
+var event_fd: ?std.posix.fd_t = null;
+var thread: ?std.Thread = null;
+var running = std.atomic.Value(bool).init(false);
+var control_mutex: std.Thread.Mutex = .{};
+
+/// Start the event monitor thread. Does nothing if it is already running.
+pub fn start(cfg: Config) !void {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+
+    if (thread != null) return;
+    config = cfg;
+
+    if (event_fd == null) {
+        event_fd = try std.posix.eventfd(0, std.os.linux.EFD.CLOEXEC | std.os.linux.EFD.NONBLOCK);
+    }
+
+    // Seed throttle state so the first transition is reported against reality
+    const count = @min(registry.count() catch 0, registry.max_devices);
+    for (0..count) |i| {
+        _ = refreshThrottle(@intCast(i), false);
+    }
+
+    running.store(true, .release);
+    thread = std.Thread.spawn(.{}, run, .{}) catch |err| {
+        running.store(false, .release);
+        return err;
+    };
+}
+
+/// Stop the event monitor (returns within one poll timeout)
+pub fn stop() void {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+
+    const t = thread orelse return;
+    running.store(false, .release);
+    t.join();
+    thread = null;
+
+    for (&throttle_known) |*known| known.store(false, .release);
+}
+
+/// Whether the event monitor is active
+pub fn isRunning() bool {
+    return running.load(.acquire);
+}
+
+/// File descriptor that becomes readable when events are queued.
+/// Suitable for epoll/poll; drain the queue with `poll`.
+pub fn getFd() ?std.posix.fd_t {
+    return event_fd;
+}
+
+/// Register a callback. Returns a subscription id for `removeCallback`.
+pub fn addCallback(callback: Callback, user_data: ?*anyopaque) !u32 {
+    delivery_mutex.lock();
+    defer delivery_mutex.unlock();
+
+    for (&subscribers, 0..) |*slot, i| {
+        if (slot.* == null) {
+            slot.* = .{ .callback = callback, .user_data = user_data };
+            return @intCast(i);
+        }
+    }
+    return error.TooManyCallbacks;
+}
+
+/// Remove a callback registered with `addCallback`. Once this returns the
+/// callback is not running and will not be called again, so its user data
+/// may be freed. A callback may remove itself.
+pub fn removeCallback(id: u32) void {
+    if (id >= max_callbacks) return;
+    {
+        delivery_mutex.lock();
+        defer delivery_mutex.unlock();
+        subscribers[id] = null;
+    }
+
+    // Wait out a dispatch that may have picked the callback up already
+    if (dispatch_thread.load(.acquire) == std.Thread.getCurrentId()) return;
+    dispatch_mutex.lock();
+    dispatch_mutex.unlock();
+}
+
+/// Drain queued events into `out`. Returns the number written.
+pub fn poll(out: []Event) usize {
+    delivery_mutex.lock();
+    defer delivery_mutex.unlock();
+
+    const n = @min(out.len, queue_len);
+    for (0..n) |i| {
+        out[i] = queue[(queue_head + i) % queue_capacity];
+    }
+    queue_head = (queue_head + n) % queue_capacity;
+    queue_len -= n;
+
+    if (queue_len == 0) {
+        if (event_fd) |fd| {
+            var counter: [8]u8 = undefined;
+            _ = std.posix.read(fd, &counter) catch {};
+        }
+    }
+    return n;
+}
+
+/// Number of events dropped because the queue was full
+pub fn droppedCount() u64 {
+    return dropped.load(.monotonic);
+}
+
+/// Last known throttle reasons for a GPU, or null when the monitor is not tracking it
+pub fn throttleReasons(index: u32) ?u64 {
+    if (!isRunning() or index >= registry.max_devices) return null;
+    if (!throttle_known[index].load(.acquire)) return null;
+    return throttle_state[index].load(.acquire);
+}
+
+fn run() void {
+    const set = nvml.createEventSet() catch |err| {
+        std.log.warn("NVML event sets unavailable ({s}), polling throttle reasons", .{@errorName(err)});
+        pollLoop();
+        return;
+    };
+    defer nvml.freeEventSet(set);
+
+    const wanted = nvml.EVENT_TYPE_PSTATE | nvml.EVENT_TYPE_XID_CRITICAL_ERROR | nvml.EVENT_TYPE_CLOCK;
+    const count = @min(registry.count() catch 0, registry.max_devices);
+    for (0..count) |i| {
+        const device = registry.getDevice(@intCast(i)) catch continue;
+        const supported = nvml.getDeviceSupportedEventTypes(device) catch 0;
+        if ((supported & wanted) == 0) continue;
+        nvml.registerEvents(device, supported & wanted, set) catch |err| {
+            std.log.warn("GPU {d}: event registration failed: {s}", .{ i, @errorName(err) });
+        };
+    }
+
+    while (running.load(.acquire)) {
+        const data = nvml.waitEvent(set, config.poll_timeout_ms) catch |err| switch (err) {
+            error.Timeout => {
+                checkAllThrottle(count);
+                continue;
+            },
+            else => {
+                // Nothing registered or the driver went away; keep tracking throttle reasons
+                sleepMs(config.poll_timeout_ms);
+                checkAllThrottle(count);
+                continue;
+            },
+        };
+
+        const index = indexOfDevice(data.device, count) orelse continue;
+        if ((data.eventType & nvml.EVENT_TYPE_XID_CRITICAL_ERROR) != 0) {
+            emit(.xid, index, data.eventData, 0);
+        }
+        if ((data.eventType & nvml.EVENT_TYPE_PSTATE) != 0) {
+            const pstate = if (registry.getDevice(index)) |device|
+                nvml.getDevicePerformanceState(device) catch @as(c_uint, 15)
+            else |_|
+                @as(c_uint, 15);
+            emit(.pstate_change, index, @intCast(pstate), 0);
+        }
+        if ((data.eventType & (nvml.EVENT_TYPE_CLOCK | nvml.EVENT_TYPE_PSTATE)) != 0) {
+            _ = refreshThrottle(index, true);
+        }
+    }
+}
+
+fn pollLoop() void {
+    while (running.load(.acquire)) {
+        sleepMs(config.poll_timeout_ms);
+        checkAllThrottle(@min(registry.count() catch 0, registry.max_devices));
+    }
+}
+
+fn checkAllThrottle(count: usize) void {
+    for (0..count) |i| {
+        _ = refreshThrottle(@intCast(i), true);
+    }
+}
+
+/// Re-read throttle reasons for a GPU and report transitions
+fn refreshThrottle(index: u32, report: bool) bool {
+    const device = registry.getDevice(index) catch return false;
+    const reasons = nvml.getDeviceCurrentClocksThrottleReasons(device) catch |err| {
+        registry.reportError(index, err);
+        return false;
+    };
+
+    const previous = throttle_state[index].swap(reasons, .acq_rel);
+    const was_known = throttle_known[index].swap(true, .acq_rel);
+    if (!report or !was_known or previous == reasons) return true;
+
+    emit(.throttle_changed, index, reasons, previous);
+
+    if (isThermalThrottle(reasons) and !isThermalThrottle(previous)) {
+        const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
+        emit(.thermal_warning, index, temp, config.thermal_threshold_c);
+    }
+    if (isPowerThrottle(reasons) and !isPowerThrottle(previous)) {
+        const power = nvml.getDevicePowerUsage(device) catch 0;
+        const limit = nvml.getDevicePowerLimit(device) catch 0;
+        emit(.power_limit_reached, index, power, limit);
+    }
+    return true;
+}
+
+fn indexOfDevice(device: nvml.Device, count: usize) ?u32 {
+    for (0..count) |i| {
+        const entry = registry.getEntry(@intCast(i)) orelse continue;
+        if (entry.handle == device) return entry.index;
+    }
+    return null;
+}
+
+fn emit(kind: EventKind, index: u32, value: u64, aux: u64) void {
+    if ((config.kinds & kind.bit()) == 0) return;
+
+    const event = Event{
+        .kind = kind,
+        .gpu_index = index,
+        .timestamp_ns = nvmon.timestampNs(),
+        .value = value,
+        .aux = aux,
+    };
+
+    dispatch_mutex.lock();
+    defer dispatch_mutex.unlock();
+    dispatch_thread.store(std.Thread.getCurrentId(), .release);
+    defer dispatch_thread.store(0, .release);
+
+    var targets: [max_callbacks]?Subscriber = undefined;
+    {
+        delivery_mutex.lock();
+        defer delivery_mutex.unlock();
+
+        if (queue_len == queue_capacity) {
+            // Drop the oldest event rather than block the monitor thread
+            queue_head = (queue_head + 1) % queue_capacity;
+            queue_len -= 1;
+            _ = dropped.fetchAdd(1, .monotonic);
+        }
+        queue[(queue_head + queue_len) % queue_capacity] = event;
+        queue_len += 1;
+        targets = subscribers;
+    }
+
+    if (event_fd) |fd| {
+        const one = std.mem.toBytes(@as(u64, 1));
+        _ = std.posix.write(fd, &one) catch {};
+    }
+
+    // Callbacks run outside the delivery lock so they may call poll()
+    for (targets, 0..) |target, i| {
+        const sub = target orelse continue;
+        // Skip callbacks an earlier callback removed during this dispatch
+        delivery_mutex.lock();
+        const live = subscribers[i] != null;
+        delivery_mutex.unlock();
+        if (live) sub.callback(&event, sub.user_data);
+    }
+}
+
+fn sleepMs(ms: u32) void {
+    const ns = @as(u64, ms) * std.time.ns_per_ms;
+    std.posix.nanosleep(ns / std.time.ns_per_s, ns % std.time.ns_per_s);
+}
+
+test "kind mask" {
+    try std.testing.expectEqual(@as(KindMask, 1), EventKind.throttle_changed.bit());
+    try std.testing.expectEqual(@as(u32, 5), @popCount(all_kinds));
+}
+
+test "throttle reason classification" {
+    try std.testing.expect(isThermalThrottle(nvml.THROTTLE_SW_THERMAL));
+    try std.testing.expect(!isThermalThrottle(nvml.THROTTLE_SW_POWER_CAP));
+    try std.testing.expect(isPowerThrottle(nvml.THROTTLE_SW_POWER_CAP | nvml.THROTTLE_GPU_IDLE));
+    try std.testing.expect(!isPowerThrottle(nvml.THROTTLE_GPU_IDLE));
+}
+
+test "removed callbacks are not called" {
+    const Counter = struct {
+        var calls: u32 = 0;
+        var self_id: u32 = 0;
+        fn count(_: *const Event, _: ?*anyopaque) callconv(.c) void {
+            calls += 1;
+        }
+        fn removeSelf(_: *const Event, _: ?*anyopaque) callconv(.c) void {
+            calls += 1;
+            removeCallback(self_id);
+        }
+    };
+
+    const id = try addCallback(Counter.count, null);
+    emit(.xid, 0, 0, 0);
+    removeCallback(id);
+    emit(.xid, 0, 0, 0);
+    try std.testing.expectEqual(@as(u32, 1), Counter.calls);
+
+    // Removing from inside the callback must not wait on its own dispatch
+    Counter.self_id = try addCallback(Counter.removeSelf, null);
+    emit(.xid, 0, 0, 0);
+    emit(.xid, 0, 0, 0);
+    try std.testing.expectEqual(@as(u32, 2), Counter.calls);
+
+    var drain: [queue_capacity]Event = undefined;
+    _ = poll(&drain);
+}
@@ -0,0 +1,644 @@
+//! nvmon/exporter - OpenMetrics Exporter
+//!
+//! Serves GPU telemetry to Prometheus in the OpenMetrics text format.
+//! Nothing on the request path touches NVML or allocates: the body is
+//! rendered from the sampler's latest samples (or the daemon's segment) into
+//! a buffer sized at startup for the maximum GPU count, at most once per
+//! refresh interval. Scrapes in between send the cached body as-is, so a
+//! scrape costs the same on one GPU as on thirty-two.
+//!
+//! Pacer and stream families appear when the PrimeTime compositor or the
+//! streaming engine runs in the same process. Throttle and encoder families
+//! need a sampler that reads them: the exporter requests them from its own,
+//! a daemon samples them when started with `--all-fields`.
+
+const std = @import("std");
+const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvcaps = @import("../nvcaps/nvcaps.zig");
+const nvmon = @import("nvmon.zig");
+const sampler = @import("sampler.zig");
+const fields = @import("fields.zig");
+const primetime = @import("../nvruntime/primetime/primetime.zig");
+const nvstream = @import("../nvruntime/nvstream/nvstream.zig");
+
+const posix = std.posix;
+const linux = std.os.linux;
+const GpuSample = nvmon.GpuSample;
+const Field = nvmon.Field;
+
+/// Port `nvprime exporter` listens on unless told otherwise
+pub const default_port: u16 = 9400;
+
+pub const content_type = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+const per_gpu_capacity = 12 * 1024;
+const shared_capacity = 16 * 1024;
+/// Worst-case body: every family, every GPU, longest labels
+pub const body_capacity = shared_capacity + nvmon.max_gpus * per_gpu_capacity;
+
+pub const Config = struct {
+    /// IPv4 address to listen on
+    address: [4]u8 = .{ 0, 0, 0, 0 },
+    /// 0 picks a free port
+    port: u16 = default_port,
+    /// Re-render the body at most this often; scrapes in between reuse it
+    refresh_ms: u32 = 1000,
+};
+
+// ============================================================================
+// Metric families
+// ============================================================================
+
+/// Per-GPU gauge family; its series are the field table entries that name it
+const Family = struct {
+    name: []const u8,
+    help: []const u8,
+    /// OpenMetrics unit; the family name must end in it
+    unit: ?[]const u8 = null,
+};
+
+const gpu_families = [_]Family{
+    .{ .name = "nvprime_gpu_clock_hertz", .help = "Current clock frequency", .unit = "hertz" },
+    .{ .name = "nvprime_gpu_power_draw_watts", .help = "Power draw", .unit = "watts" },
+    .{ .name = "nvprime_gpu_power_limit_watts", .help = "Enforced power limit", .unit = "watts" },
+    .{ .name = "nvprime_gpu_temperature_celsius", .help = "Temperature", .unit = "celsius" },
+    .{ .name = "nvprime_gpu_utilization_ratio", .help = "Busy fraction of the last sample period", .unit = "ratio" },
+    .{ .name = "nvprime_gpu_fan_speed_ratio", .help = "Fan speed as a fraction of maximum", .unit = "ratio" },
+    .{ .name = "nvprime_gpu_memory_used_bytes", .help = "VRAM in use", .unit = "bytes" },
+    .{ .name = "nvprime_gpu_memory_total_bytes", .help = "VRAM installed", .unit = "bytes" },
+    .{ .name = "nvprime_gpu_pstate", .help = "Performance state (0 fastest, 15 slowest)" },
+    .{ .name = "nvprime_gpu_encoder_sessions", .help = "Active NVENC sessions" },
+    .{ .name = "nvprime_gpu_encoder_fps", .help = "Average NVENC frame rate across sessions" },
+    .{ .name = "nvprime_gpu_encoder_latency_seconds", .help = "Average NVENC encode latency", .unit = "seconds" },
+    .{ .name = "nvprime_gpu_encoder_utilization_ratio", .help = "NVENC engine busy fraction", .unit = "ratio" },
+};
+
+/// Table entries rendered as series of `family`, in table order
+fn seriesOf(comptime family: []const u8) []const fields.Id {
+    comptime {
+        var ids: []const fields.Id = &.{};
+        for (std.enums.values(fields.Id)) |id| {
+            const metric = fields.get(id).metric orelse continue;
+            if (std.mem.eql(u8, metric.family, family)) ids = ids ++ &[_]fields.Id{id};
+        }
+        if (ids.len == 0) @compileError("no field table entry feeds " ++ family);
+        const result = ids[0..ids.len].*;
+        return &result;
+    }
+}
+
+comptime {
+    // Every series the table names belongs to a listed family
+    for (std.enums.values(fields.Id)) |id| {
+        const metric = fields.get(id).metric orelse continue;
+        for (gpu_families) |family| {
+            if (std.mem.eql(u8, family.name, metric.family)) break;
+        } else @compileError("unknown exporter family " ++ metric.family);
+    }
+}
+
+/// Sampler fields the exporter renders; requested from a local sampler
+pub const sampled_fields: nvmon.FieldMask = blk: {
+    var mask: nvmon.FieldMask = Field.throttle_reasons.bit();
+    for (std.enums.values(fields.Id)) |id| {
+        if (fields.get(id).metric != null) mask |= fields.get(id).field.bit();
+    }
+    break :blk mask;
+};
+
+const throttle_reasons = [_]struct { label: []const u8, bit: u64 }{
+    .{ .label = "reason=\"gpu_idle\"", .bit = nvml.THROTTLE_GPU_IDLE },
+    .{ .label = "reason=\"applications_clocks\"", .bit = nvml.THROTTLE_APPLICATIONS_CLOCKS },
+    .{ .label = "reason=\"sw_power_cap\"", .bit = nvml.THROTTLE_SW_POWER_CAP },
+    .{ .label = "reason=\"hw_slowdown\"", .bit = nvml.THROTTLE_HW_SLOWDOWN },
+    .{ .label = "reason=\"sync_boost\"", .bit = nvml.THROTTLE_SYNC_BOOST },
+    .{ .label = "reason=\"sw_thermal\"", .bit = nvml.THROTTLE_SW_THERMAL },
+    .{ .label = "reason=\"hw_thermal\"", .bit = nvml.THROTTLE_HW_THERMAL },
+    .{ .label = "reason=\"hw_power_brake\"", .bit = nvml.THROTTLE_HW_POWER_BRAKE },
+};
+
+/// Identity labels of one GPU, escaped once at startup
+pub const GpuLabels = struct {
+    /// Longest UUID and name taken from NVML/the segment
+    const max_field = 96;
+
+    /// `gpu="0",uuid="GPU-..."`, on every series
+    series: [256]u8 = undefined,
+    series_len: usize = 0,
+    /// The series labels plus `name="..."`, on the info family
+    info: [512]u8 = undefined,
+    info_len: usize = 0,
+
+    pub fn init(index: u32, uuid: []const u8, name: []const u8) GpuLabels {
+        var self = GpuLabels{};
+        // Both buffers fit the longest escaped fields
+        var w = std.Io.Writer.fixed(&self.series);
+        w.print("gpu=\"{d}\",uuid=\"", .{index}) catch unreachable;
+        writeEscaped(&w, uuid[0..@min(uuid.len, max_field)]) catch unreachable;
+        w.writeByte('"') catch unreachable;
+        self.series_len = w.end;
+
+        w = std.Io.Writer.fixed(&self.info);
+        w.writeAll(self.getSeries()) catch unreachable;
+        w.writeAll(",name=\"") catch unreachable;
+        writeEscaped(&w, name[0..@min(name.len, max_field)]) catch unreachable;
+        w.writeByte('"') catch unreachable;
+        self.info_len = w.end;
+        return self;
+    }
+
+    pub fn getSeries(self: *const GpuLabels) []const u8 {
+        return self.series[0..self.series_len];
+    }
+
+    pub fn getInfo(self: *const GpuLabels) []const u8 {
+        return self.info[0..self.info_len];
+    }
+};
+
+/// Label value escaping: backslash, double quote and newline
+fn writeEscaped(w: *std.Io.Writer, value: []const u8) !void {
+    for (value) |ch| switch (ch) {
+        '\\' => try w.writeAll("\\\\"),
+        '"' => try w.writeAll("\\\""),
+        '\n' => try w.writeAll("\\n"),
+        else => try w.writeByte(ch),
+    };
+}
+
+/// Everything one render reads, taken up front
+pub const Snapshot = struct {
+    gpu_count: u32 = 0,
+    /// Null when the GPU has no fresh sample
+    samples: [nvmon.max_gpus]?GpuSample = [_]?GpuSample{null} ** nvmon.max_gpus,
+    /// Only when this process runs the sampler
+    sampler_passes: ?u64 = null,
+    pass_duration_ns: u64 = 0,
+    scrapes: u64 = 0,
+    pacer: ?primetime.PerfStats = null,
+    stream: ?nvstream.StreamStats = null,
+
+    /// Read the latest state without touching NVML
+    pub fn take(gpu_count: u32, scrapes: u64) Snapshot {
+        var snap = Snapshot{ .gpu_count = gpu_count, .scrapes = scrapes };
+        for (0..gpu_count) |i| snap.samples[i] = sampler.latest(@intCast(i));
+        if (sampler.isRunning()) {
+            snap.sampler_passes = sampler.passCount();
+            snap.pass_duration_ns = nvmon.lastPassDurationNs();
+        }
+        snap.pacer = primetime.getPerfStats() catch null;
+        snap.stream = nvstream.getStats();
+        return snap;
+    }
+};
+
+fn writeMeta(w: *std.Io.Writer, name: []const u8, kind: []const u8, unit: ?[]const u8, help: []const u8) !void {
+    try w.print("# TYPE {s} {s}\n", .{ name, kind });
+    if (unit) |u| try w.print("# UNIT {s} {s}\n", .{ name, u });
+    try w.print("# HELP {s} {s}\n", .{ name, help });
+}
+
+/// `name{labels,extra} value`
+fn writeSample(w: *std.Io.Writer, name: []const u8, labels: []const u8, extra: []const u8, value: anytype) !void {
+    try w.writeAll(name);
+    if (labels.len > 0 or extra.len > 0) {
+        try w.writeByte('{');
+        try w.writeAll(labels);
+        if (labels.len > 0 and extra.len > 0) try w.writeByte(',');
+        try w.writeAll(extra);
+        try w.writeByte('}');
+    }
+    try w.print(" {d}\n", .{value});
+}
+
+fn writeGauge(w: *std.Io.Writer, name: []const u8, unit: ?[]const u8, help: []const u8, value: anytype) !void {
+    try writeMeta(w, name, "gauge", unit, help);
+    try writeSample(w, name, "", "", value);
+}
+
+/// `name` without the `_total` suffix
+fn writeCounter(w: *std.Io.Writer, comptime name: []const u8, help: []const u8, value: u64) !void {
+    try writeMeta(w, name, "counter", null, help);
+    try writeSample(w, name ++ "_total", "", "", value);
+}
+
+fn us(value: anytype) f64 {
+    return @as(f64, @floatFromInt(value)) / 1e6;
+}
+
+fn ms(value: f32) f64 {
+    return @as(f64, value) / 1e3;
+}
+
+/// Render `snap` as an OpenMetrics exposition, ending in `# EOF`
+pub fn render(w: *std.Io.Writer, snap: *const Snapshot, labels: []const GpuLabels) !void {
+    const gpus = labels[0..@min(snap.gpu_count, labels.len)];
+
+    try writeMeta(w, "nvprime_gpu", "info", null, "GPU identity");
+    for (gpus) |*l| try writeSample(w, "nvprime_gpu_info", l.getInfo(), "", 1);
+
+    try writeMeta(w, "nvprime_gpu_up", "gauge", null, "Whether the GPU has a fresh sample");
+    for (gpus, 0..) |*l, i| try writeSample(w, "nvprime_gpu_up", l.getSeries(), "", @intFromBool(snap.samples[i] != null));
+
+    inline for (gpu_families) |family| {
+        try writeMeta(w, family.name, "gauge", family.unit, family.help);
+        for (gpus, 0..) |*l, i| {
+            const sample = if (snap.samples[i]) |*s| s else continue;
+            inline for (comptime seriesOf(family.name)) |id| {
+                const metric = comptime fields.get(id).metric.?;
+                if (fields.fromSample(id, sample)) |raw| {
+                    if (metric.mul == 1 and metric.div == 1) {
+                        try writeSample(w, family.name, l.getSeries(), metric.labels, raw);
+                    } else {
+                        const value = @as(f64, @floatFromInt(raw)) * metric.mul / metric.div;
+                        try writeSample(w, family.name, l.getSeries(), metric.labels, value);
+                    }
+                }
+            }
+        }
+    }
+
+    try writeMeta(w, "nvprime_gpu_throttle_reason", "gauge", null, "Whether a reason is holding clocks down");
+    for (gpus, 0..) |*l, i| {
+        const sample = if (snap.samples[i]) |*s| s else continue;
+        const bits = fields.fromSample(.throttle_reasons, sample) orelse continue;
+        for (throttle_reasons) |reason| {
+            const active = bits & reason.bit != 0;
+            try writeSample(w, "nvprime_gpu_throttle_reason", l.getSeries(), reason.label, @intFromBool(active));
+        }
+    }
+
+    try writeCounter(w, "nvprime_exporter_scrapes", "Scrapes served before this one", snap.scrapes);
+    if (snap.sampler_passes) |passes| {
+        try writeCounter(w, "nvprime_sampler_passes", "Completed sampler passes", passes);
+        try writeGauge(w, "nvprime_sampler_pass_duration_seconds", "seconds", "Duration of the last sampler pass", @as(f64, @floatFromInt(snap.pass_duration_ns)) / 1e9);
+    }
+
+    if (snap.pacer) |pacer| {
+        try writeGauge(w, "nvprime_pacer_fps", null, "Current frame rate", pacer.fps);
+        try writeGauge(w, "nvprime_pacer_one_percent_low_fps", null, "1% low frame rate", pacer.one_percent_low_fps);
+        try writeGauge(w, "nvprime_pacer_frame_time_seconds", "seconds", "Average frame time", ms(pacer.frame_time_ms));
+        try writeGauge(w, "nvprime_pacer_vrr_hertz", "hertz", "Refresh rate the pacer targets", pacer.vrr_hz);
+        try writeGauge(w, "nvprime_pacer_scanout_bypass", null, "Whether the game buffer is scanned out directly", @intFromBool(pacer.scanout_bypass));
+        try writeCounter(w, "nvprime_pacer_frames", "Frames presented", pacer.frame_count);
+    }
+
+    if (snap.stream) |stream| {
+        try writeMeta(w, "nvprime_stream_frames", "counter", null, "Frames through each stream stage");
+        try writeSample(w, "nvprime_stream_frames_total", "", "stage=\"captured\"", stream.frames_captured);
+        try writeSample(w, "nvprime_stream_frames_total", "", "stage=\"encoded\"", stream.frames_encoded);
+        try writeSample(w, "nvprime_stream_frames_total", "", "stage=\"sent\"", stream.frames_sent);
+        try writeSample(w, "nvprime_stream_frames_total", "", "stage=\"dropped\"", stream.frames_dropped);
+
+        try writeMeta(w, "nvprime_stream_latency_seconds", "gauge", "seconds", "Average latency per stream stage");
+        try writeSample(w, "nvprime_stream_latency_seconds", "", "stage=\"capture\"", us(stream.avg_capture_latency_us));
+        try writeSample(w, "nvprime_stream_latency_seconds", "", "stage=\"encode\"", us(stream.avg_encode_latency_us));
+        try writeSample(w, "nvprime_stream_latency_seconds", "", "stage=\"send\"", us(stream.avg_network_latency_us));
+        try writeSample(w, "nvprime_stream_latency_seconds", "", "stage=\"end_to_end\"", ms(stream.total_latency_ms));
+
+        try writeMeta(w, "nvprime_stream_bitrate_bits_per_second", "gauge", null, "Encoder bitrate");
+        try writeSample(w, "nvprime_stream_bitrate_bits_per_second", "", "kind=\"current\"", @as(u64, stream.current_bitrate_kbps) * 1000);
+        try writeSample(w, "nvprime_stream_bitrate_bits_per_second", "", "kind=\"target\"", @as(u64, stream.target_bitrate_kbps) * 1000);
+
+        try writeMeta(w, "nvprime_stream_queue_depth", "gauge", null, "Items waiting between stream stages");
+        try writeSample(w, "nvprime_stream_queue_depth", "", "queue=\"capture\"", stream.capture_queue_depth);
+        try writeSample(w, "nvprime_stream_queue_depth", "", "queue=\"send\"", stream.send_queue_depth);
+
+        try writeMeta(w, "nvprime_stream_packets", "counter", null, "Stream packets by outcome");
+        try writeSample(w, "nvprime_stream_packets_total", "", "outcome=\"sent\"", stream.network.packets_sent);
+        try writeSample(w, "nvprime_stream_packets_total", "", "outcome=\"lost\"", stream.network.packets_lost);
+        try writeGauge(w, "nvprime_stream_rtt_seconds", "seconds", "Round-trip time to the client", @as(f64, @floatFromInt(stream.network.rtt_ms)) / 1e3);
+    }
+
+    try w.writeAll("# EOF\n");
+}
+
+// ============================================================================
+// HTTP
+// ============================================================================
+
+pub const Route = enum { metrics, head, not_found, not_allowed, bad_request };
+
+/// Route an HTTP request by its request line
+pub fn route(request: []const u8) Route {
+    const line_end = std.mem.indexOf(u8, request, "\r\n") orelse return .bad_request;
+    var parts = std.mem.splitScalar(u8, request[0..line_end], ' ');
+    const method = parts.next() orelse return .bad_request;
+    const target = parts.next() orelse return .bad_request;
+    const path = target[0 .. std.mem.indexOfScalar(u8, target, '?') orelse target.len];
+
+    if (!std.mem.eql(u8, path, "/metrics")) return .not_found;
+    if (std.mem.eql(u8, method, "GET")) return .metrics;
+    if (std.mem.eql(u8, method, "HEAD")) return .head;
+    return .not_allowed;
+}
+
+pub const Exporter = struct {
+    allocator: std.mem.Allocator,
+    config: Config,
+    fd: posix.socket_t,
+    body: []u8,
+    body_len: usize = 0,
+    rendered_ns: u64 = 0,
+    gpu_count: u32 = 0,
+    labels: [nvmon.max_gpus]GpuLabels = undefined,
+    snapshot: Snapshot = .{},
+    scrapes: u64 = 0,
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    thread: ?std.Thread = null,
+
+    /// Listen on the configured address and size the body for every GPU.
+    /// GPUs come from the attached daemon segment, else the local registry.
+    pub fn init(allocator: std.mem.Allocator, config: Config) !*Exporter {
+        const address = std.net.Address.initIp4(config.address, config.port);
+        const fd = try posix.socket(posix.AF.INET, posix.SOCK.STREAM | posix.SOCK.CLOEXEC, posix.IPPROTO.TCP);
+        errdefer posix.close(fd);
+        try posix.setsockopt(fd, posix.SOL.SOCKET, posix.SO.REUSEADDR, &std.mem.toBytes(@as(c_int, 1)));
+        try posix.bind(fd, &address.any, address.getOsSockLen());
+        try posix.listen(fd, 64);
+
+        const body = try allocator.alloc(u8, body_capacity);
+        errdefer allocator.free(body);
+        const self = try allocator.create(Exporter);
+        self.* = .{ .allocator = allocator, .config = config, .fd = fd, .body = body };
+        self.resolveGpus();
+        // Throttle reasons and encoder stats are only sampled on request
+        sampler.requestFields(sampled_fields);
+        return self;
+    }
+
+    pub fn deinit(self: *Exporter) void {
+        self.stop();
+        posix.close(self.fd);
+        self.allocator.free(self.body);
+        self.allocator.destroy(self);
+    }
+
+    /// Serve from a background thread until `stop`
+    pub fn start(self: *Exporter) !void {
+        if (self.thread != null) return;
+        self.running.store(true, .release);
+        self.thread = std.Thread.spawn(.{}, run, .{self}) catch |err| {
+            self.running.store(false, .release);
+            return err;
+        };
+    }
+
+    pub fn stop(self: *Exporter) void {
+        const t = self.thread orelse return;
+        self.running.store(false, .release);
+        t.join();
+        self.thread = null;
+    }
+
+    /// Port actually bound (differs from the config when it asked for 0)
+    pub fn port(self: *const Exporter) !u16 {
+        var addr: std.net.Address = undefined;
+        var len: posix.socklen_t = @sizeOf(std.net.Address);
+        try posix.getsockname(self.fd, &addr.any, &len);
+        return addr.getPort();
+    }
+
+    fn run(self: *Exporter) void {
+        while (self.running.load(.acquire)) {
+            _ = self.serveOne(250) catch |err| {
+                std.log.warn("exporter: {s}", .{@errorName(err)});
+                std.Thread.sleep(100 * std.time.ns_per_ms);
+            };
+        }
+    }
+
+    /// Wait up to `timeout_ms` for one connection and answer it.
+    /// Returns false if none arrived.
+    pub fn serveOne(self: *Exporter, timeout_ms: i32) !bool {
+        var fds = [_]posix.pollfd{.{ .fd = self.fd, .events = posix.POLL.IN, .revents = 0 }};
+        if (try posix.poll(&fds, timeout_ms) == 0) return false;
+
+        const conn = posix.accept(self.fd, null, null, posix.SOCK.CLOEXEC) catch |err| switch (err) {
+            // The client gave up between poll and accept
+            error.WouldBlock, error.ConnectionAborted => return true,
+            else => return err,
+        };
+        defer posix.close(conn);
+        self.handle(conn);
+        return true;
+    }
+
+    /// Re-render the body if it is older than the refresh interval
+    pub fn refresh(self: *Exporter) void {
+        const now = nvmon.timestampNs();
+        const max_age = @as(u64, self.config.refresh_ms) * std.time.ns_per_ms;
+        if (self.body_len != 0 and now -| self.rendered_ns < max_age) return;
+
+        self.snapshot = Snapshot.take(self.gpu_count, self.scrapes);
+        var w = std.Io.Writer.fixed(self.body);
+        render(&w, &self.snapshot, self.labels[0..self.gpu_count]) catch {
+            // Sized for the worst case; keep serving the previous body
+            std.log.warn("exporter: metrics body over {d} bytes", .{body_capacity});
+            return;
+        };
+        self.body_len = w.end;
+        self.rendered_ns = now;
+    }
+
+    fn resolveGpus(self: *Exporter) void {
+        if (!sampler.isRunning()) {
+            if (sampler.attachedReader()) |reader| {
+                self.gpu_count = @min(reader.gpuCount(), nvmon.max_gpus);
+                for (0..self.gpu_count) |i| {
+                    const index: u32 = @intCast(i);
+                    const id = reader.identity(index) orelse {
+                        self.labels[i] = GpuLabels.init(index, "", "");
+                        continue;
+                    };
+                    self.labels[i] = GpuLabels.init(index, id.getUuid(), id.getName());
+                }
+                return;
+            }
+        }
+
+        self.gpu_count = @min(registry.count() catch 0, nvmon.max_gpus);
+        for (0..self.gpu_count) |i| {
+            const index: u32 = @intCast(i);
+            const entry = registry.getEntry(index);
+            const uuid = if (entry) |*e| std.mem.sliceTo(&e.uuid, 0) else "";
+            const caps = nvcaps.getStaticCapabilities(index) catch null;
+            const name = if (caps) |*c| std.mem.sliceTo(&c.name, 0) else "";
+            self.labels[i] = GpuLabels.init(index, uuid, name);
+        }
+    }
+
+    fn handle(self: *Exporter, conn: posix.socket_t) void {
+        // A stalled client must not hold up the next scrape
+        const timeout = posix.timeval{ .sec = 2, .usec = 0 };
+        posix.setsockopt(conn, posix.SOL.SOCKET, posix.SO.RCVTIMEO, std.mem.asBytes(&timeout)) catch {};
+        posix.setsockopt(conn, posix.SOL.SOCKET, posix.SO.SNDTIMEO, std.mem.asBytes(&timeout)) catch {};
+
+        var request: [2048]u8 = undefined;
+        var len: usize = 0;
+        while (len < request.len) {
+            const n = posix.read(conn, request[len..]) catch return;
+            if (n == 0) break;
+            len += n;
+            if (std.mem.indexOf(u8, request[0..len], "\r\n\r\n") != null) break;
+        }
+
+        switch (route(request[0..len])) {
+            .metrics, .head => |r| {
+                self.refresh();
+                self.scrapes += 1;
+                respond(conn, "200 OK", content_type, self.body[0..self.body_len], r == .metrics);
+            },
+            .not_found => respond(conn, "404 Not Found", "text/plain", "Metrics are at /metrics\n", true),
+            .not_allowed => respond(conn, "405 Method Not Allowed", "text/plain", "", true),
+            .bad_request => respond(conn, "400 Bad Request", "text/plain", "", true),
+        }
+    }
+};
+
+/// Send headers and body in one gather write (no Nagle delay between them)
+fn respond(conn: posix.socket_t, status: []const u8, ctype: []const u8, body: []const u8, send_body: bool) void {
+    var head_buf: [256]u8 = undefined;
+    const head = std.fmt.bufPrint(&head_buf, "HTTP/1.1 {s}\r\nContent-Type: {s}\r\nContent-Length: {d}\r\nConnection: close\r\n\r\n", .{
+        status,
+        ctype,
+        body.len,
+    }) catch return;
+
+    var iovs = [_]posix.iovec_const{
+        .{ .base = head.ptr, .len = head.len },
+        .{ .base = body.ptr, .len = if (send_body) body.len else 0 },
+    };
+    var first: usize = 0;
+    while (first < iovs.len) {
+        const msg = linux.msghdr_const{
+            .name = null,
+            .namelen = 0,
+            .iov = iovs[first..].ptr,
+            .iovlen = @intCast(iovs.len - first),
+            .control = null,
+            .controllen = 0,
+            .flags = 0,
+        };
+        // NOSIGNAL: a scraper hanging up must not kill the process
+        const rc = linux.sendmsg(conn, &msg, linux.MSG.NOSIGNAL);
+        switch (posix.errno(rc)) {
+            .SUCCESS => {},
+            .INTR => continue,
+            else => return,
+        }
+        var sent: usize = rc;
+        while (first < iovs.len and sent >= iovs[first].len) {
+            sent -= iovs[first].len;
+            first += 1;
+        }
+        if (first < iovs.len) {
+            iovs[first].base += sent;
+            iovs[first].len -= sent;
+        }
+    }
+}
+
+test "routes" {
+    try std.testing.expectEqual(Route.metrics, route("GET /metrics HTTP/1.1\r\nHost: x\r\n\r\n"));
+    try std.testing.expectEqual(Route.metrics, route("GET /metrics?name[]=x HTTP/1.1\r\n\r\n"));
+    try std.testing.expectEqual(Route.head, route("HEAD /metrics HTTP/1.1\r\n\r\n"));
+    try std.testing.expectEqual(Route.not_allowed, route("POST /metrics HTTP/1.1\r\n\r\n"));
+    try std.testing.expectEqual(Route.not_found, route("GET / HTTP/1.1\r\n\r\n"));
+    try std.testing.expectEqual(Route.bad_request, route("GET /metrics"));
+}
+
+test "render families" {
+    var snap = Snapshot{ .gpu_count = 2, .scrapes = 7 };
+    snap.samples[0] = GpuSample{
+        .index = 0,
+        .gpu_clock_mhz = 2520,
+        .power_draw_mw = 312_500,
+        .gpu_utilization = 57,
+        .encoder_sessions = 2,
+        .throttle_reasons = nvml.THROTTLE_SW_POWER_CAP,
+        .valid_mask = Field.gpu_clock.bit() | Field.power_draw.bit() | Field.utilization.bit() |
+            Field.encoder.bit() | Field.throttle_reasons.bit(),
+    };
+    const labels = [_]GpuLabels{
+        GpuLabels.init(0, "GPU-1234", "NVIDIA \"Test\" GPU"),
+        GpuLabels.init(1, "GPU-5678", "Second"),
+    };
+
+    var buf: [16 * 1024]u8 = undefined;
+    var w = std.Io.Writer.fixed(&buf);
+    try render(&w, &snap, &labels);
+    const body = w.buffered();
+
+    const expected = [_][]const u8{
+        "nvprime_gpu_info{gpu=\"0\",uuid=\"GPU-1234\",name=\"NVIDIA \\\"Test\\\" GPU\"} 1\n",
+        "nvprime_gpu_up{gpu=\"1\",uuid=\"GPU-5678\"} 0\n",
+        "# UNIT nvprime_gpu_clock_hertz hertz\n",
+        "nvprime_gpu_clock_hertz{gpu=\"0\",uuid=\"GPU-1234\",domain=\"graphics\"} 2520000000\n",
+        "nvprime_gpu_power_draw_watts{gpu=\"0\",uuid=\"GPU-1234\"} 312.5\n",
+        "nvprime_gpu_utilization_ratio{gpu=\"0\",uuid=\"GPU-1234\",engine=\"memory\"} 0\n",
+        "nvprime_gpu_encoder_sessions{gpu=\"0\",uuid=\"GPU-1234\"} 2\n",
+        "nvprime_gpu_encoder_utilization_ratio{gpu=\"0\",uuid=\"GPU-1234\"} 0\n",
+        "nvprime_gpu_throttle_reason{gpu=\"0\",uuid=\"GPU-1234\",reason=\"sw_power_cap\"} 1\n",
+        "nvprime_gpu_throttle_reason{gpu=\"0\",uuid=\"GPU-1234\",reason=\"hw_thermal\"} 0\n",
+        "nvprime_exporter_scrapes_total 7\n",
+    };
+    for (expected) |line| {
+        if (std.mem.indexOf(u8, body, line) == null) {
+            std.debug.print("missing: {s}", .{line});
+            return error.TestExpectedEqual;
+        }
+    }
+    // Fields the sample lacks are left out rather than reported as 0
+    try std.testing.expect(std.mem.indexOf(u8, body, "nvprime_gpu_temperature_celsius{") == null);
+    try std.testing.expect(std.mem.endsWith(u8, body, "# EOF\n"));
+}
+
+test "worst case body fits" {
+    var snap = Snapshot{ .gpu_count = nvmon.max_gpus, .scrapes = std.math.maxInt(u64), .sampler_passes = std.math.maxInt(u64) };
+    var labels: [nvmon.max_gpus]GpuLabels = undefined;
+    const long = "\"" ** GpuLabels.max_field;
+    for (0..nvmon.max_gpus) |i| {
+        snap.samples[i] = GpuSample{
+            .valid_mask = nvmon.all_fields,
+            .gpu_clock_mhz = std.math.maxInt(u32),
+            .vram_total_mb = std.math.maxInt(u64),
+        };
+        labels[i] = GpuLabels.init(std.math.maxInt(u32), long, long);
+    }
+    snap.pacer = .{ .fps = 1234.5678 };
+    snap.stream = std.mem.zeroes(nvstream.StreamStats);
+
+    const body = try std.testing.allocator.alloc(u8, body_capacity);
+    defer std.testing.allocator.free(body);
+    var w = std.Io.Writer.fixed(body);
+    try render(&w, &snap, &labels);
+}
+
+test "serves cached metrics" {
+    const exporter = try Exporter.init(std.testing.allocator, .{ .address = .{ 127, 0, 0, 1 }, .port = 0 });
+    defer exporter.deinit();
+
+    // The kernel queues the connection and request until serveOne accepts
+    const address = std.net.Address.initIp4(.{ 127, 0, 0, 1 }, try exporter.port());
+    const client = try posix.socket(posix.AF.INET, posix.SOCK.STREAM | posix.SOCK.CLOEXEC, posix.IPPROTO.TCP);
+    defer posix.close(client);
+    try posix.connect(client, &address.any, address.getOsSockLen());
+    const request = "GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    try std.testing.expectEqual(request.len, try posix.write(client, request));
+
+    try std.testing.expect(try exporter.serveOne(1000));
+    var buf: [8192]u8 = undefined;
+    var len: usize = 0;
+    while (true) {
+        const n = try posix.read(client, buf[len..]);
+        if (n == 0) break;
+        len += n;
+    }
+    const response = buf[0..len];
+    try std.testing.expect(std.mem.startsWith(u8, response, "HTTP/1.1 200 OK\r\n"));
+    try std.testing.expect(std.mem.indexOf(u8, response, content_type) != null);
+    try std.testing.expect(std.mem.endsWith(u8, response, "# EOF\n"));
+    try std.testing.expectEqual(@as(u64, 1), exporter.scrapes);
+}
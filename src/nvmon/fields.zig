@@ -0,0 +1,393 @@
+//! nvmon/fields - Telemetry Field Table
+//!
+//! One declarative entry per scalar telemetry value: which sampler field
+//! (and so which NVML query) produces it, where it lives in `GpuSample`,
+//! its C getter names, its D-Bus property name and its OpenMetrics series.
+//! The C getters, the sampler masks they need, the D-Bus property map and
+//! the exporter's per-GPU families are generated from this table at
+//! comptime. include/nvprime.h is checked against the table and the
+//! sampler's field bits by tests, so a getter or field added here fails the
+//! build until it is declared.
+
+const std = @import("std");
+const nvmon = @import("nvmon.zig");
+const registry = @import("../nvcaps/registry.zig");
+
+const Field = nvmon.Field;
+const FieldMask = nvmon.FieldMask;
+const GpuSample = nvmon.GpuSample;
+
+/// Every scalar value in the table
+pub const Id = enum {
+    temperature,
+    memory_temperature,
+    power_draw,
+    power_limit,
+    gpu_clock,
+    mem_clock,
+    sm_clock,
+    video_clock,
+    utilization,
+    mem_utilization,
+    fan_speed,
+    vram_used,
+    vram_total,
+    pstate,
+    throttle_reasons,
+    encoder_sessions,
+    encoder_fps,
+    encoder_latency,
+    encoder_utilization,
+};
+
+/// C return type of a generated getter
+pub const CType = enum {
+    /// c_int, -1 on error
+    int,
+    /// uint64_t, 0 on error
+    uint64,
+
+    pub fn Type(comptime self: CType) type {
+        return switch (self) {
+            .int => c_int,
+            .uint64 => u64,
+        };
+    }
+
+    pub fn cName(self: CType) []const u8 {
+        return switch (self) {
+            .int => "int",
+            .uint64 => "uint64_t",
+        };
+    }
+};
+
+/// Series of an OpenMetrics family in the exporter
+pub const Metric = struct {
+    /// Family name; its help and unit are listed in exporter.zig
+    family: []const u8,
+    /// Labels after the GPU's own, e.g. `domain="graphics"`
+    labels: []const u8 = "",
+    /// Conversion to the family's base unit: value * mul / div
+    mul: f64 = 1,
+    div: f64 = 1,
+};
+
+pub const Def = struct {
+    /// Sampler field whose NVML query produces the value
+    field: Field,
+    /// `GpuSample` member holding it
+    member: []const u8,
+    /// Exported C getters, each declared in nvprime.h
+    c_names: []const [:0]const u8 = &.{},
+    /// Older exported names the header maps onto a newer getter with a macro
+    legacy_names: []const [:0]const u8 = &.{},
+    c_type: CType = .int,
+    /// Property name on com.nvidia.NVPrime.GPU, if exported there
+    dbus_name: ?[:0]const u8 = null,
+    /// Series in the OpenMetrics exporter, if exported there
+    metric: ?Metric = null,
+    /// Shown in the generated header comment
+    doc: []const u8,
+};
+
+pub fn get(comptime id: Id) Def {
+    return switch (id) {
+        .temperature => .{
+            .field = .temperature,
+            .member = "temperature_c",
+            .c_names = &.{"nvprime_power_get_temperature"},
+            .legacy_names = &.{"nvprime_get_gpu_temperature"},
+            .dbus_name = "Temperature",
+            .metric = .{ .family = "nvprime_gpu_temperature_celsius", .labels = "sensor=\"gpu\"" },
+            .doc = "GPU temperature in Celsius",
+        },
+        .memory_temperature => .{
+            .field = .memory_temperature,
+            .member = "memory_temp_c",
+            .c_names = &.{"nvprime_get_memory_temperature"},
+            .metric = .{ .family = "nvprime_gpu_temperature_celsius", .labels = "sensor=\"memory\"" },
+            .doc = "Memory (HBM/GDDR) temperature in Celsius",
+        },
+        .power_draw => .{
+            .field = .power_draw,
+            .member = "power_draw_mw",
+            .legacy_names = &.{"nvprime_get_gpu_power_usage"},
+            .dbus_name = "PowerDraw",
+            .metric = .{ .family = "nvprime_gpu_power_draw_watts", .div = 1e3 },
+            .doc = "GPU power usage in milliwatts",
+        },
+        .power_limit => .{
+            .field = .power_limit,
+            .member = "power_limit_mw",
+            .metric = .{ .family = "nvprime_gpu_power_limit_watts", .div = 1e3 },
+            .doc = "Enforced power limit in milliwatts",
+        },
+        .gpu_clock => .{
+            .field = .gpu_clock,
+            .member = "gpu_clock_mhz",
+            .c_names = &.{"nvprime_core_get_gpu_clock"},
+            .legacy_names = &.{"nvprime_get_gpu_clock"},
+            .dbus_name = "GpuClock",
+            .metric = .{ .family = "nvprime_gpu_clock_hertz", .labels = "domain=\"graphics\"", .mul = 1e6 },
+            .doc = "Graphics clock in MHz",
+        },
+        .mem_clock => .{
+            .field = .mem_clock,
+            .member = "mem_clock_mhz",
+            .c_names = &.{"nvprime_core_get_mem_clock"},
+            .legacy_names = &.{"nvprime_get_mem_clock"},
+            .dbus_name = "MemClock",
+            .metric = .{ .family = "nvprime_gpu_clock_hertz", .labels = "domain=\"memory\"", .mul = 1e6 },
+            .doc = "Memory clock in MHz",
+        },
+        .sm_clock => .{
+            .field = .sm_clock,
+            .member = "sm_clock_mhz",
+            .c_names = &.{"nvprime_core_get_sm_clock"},
+            .metric = .{ .family = "nvprime_gpu_clock_hertz", .labels = "domain=\"sm\"", .mul = 1e6 },
+            .doc = "SM clock in MHz",
+        },
+        .video_clock => .{
+            .field = .video_clock,
+            .member = "video_clock_mhz",
+            .c_names = &.{"nvprime_core_get_video_clock"},
+            .metric = .{ .family = "nvprime_gpu_clock_hertz", .labels = "domain=\"video\"", .mul = 1e6 },
+            .doc = "Video engine clock in MHz",
+        },
+        .utilization => .{
+            .field = .utilization,
+            .member = "gpu_utilization",
+            .c_names = &.{"nvprime_core_get_gpu_utilization"},
+            .dbus_name = "Utilization",
+            .metric = .{ .family = "nvprime_gpu_utilization_ratio", .labels = "engine=\"gpu\"", .div = 100 },
+            .doc = "GPU utilization percentage (0-100)",
+        },
+        .mem_utilization => .{
+            .field = .utilization,
+            .member = "mem_utilization",
+            .c_names = &.{"nvprime_core_get_mem_utilization"},
+            .dbus_name = "MemUtilization",
+            .metric = .{ .family = "nvprime_gpu_utilization_ratio", .labels = "engine=\"memory\"", .div = 100 },
+            .doc = "Memory controller utilization percentage (0-100)",
+        },
+        .fan_speed => .{
+            .field = .fan_speed,
+            .member = "fan_speed_percent",
+            .c_names = &.{"nvprime_power_get_fan_speed"},
+            .dbus_name = "FanSpeed",
+            .metric = .{ .family = "nvprime_gpu_fan_speed_ratio", .div = 100 },
+            .doc = "Fan speed percentage (0-100)",
+        },
+        .vram_used => .{
+            .field = .vram,
+            .member = "vram_used_mb",
+            .c_names = &.{"nvprime_get_vram_used"},
+            .c_type = .uint64,
+            .dbus_name = "VramUsed",
+            .metric = .{ .family = "nvprime_gpu_memory_used_bytes", .mul = 1024 * 1024 },
+            .doc = "VRAM used in megabytes",
+        },
+        .vram_total => .{
+            .field = .vram,
+            .member = "vram_total_mb",
+            .dbus_name = "VramTotal",
+            .metric = .{ .family = "nvprime_gpu_memory_total_bytes", .mul = 1024 * 1024 },
+            .doc = "VRAM total in megabytes",
+        },
+        .pstate => .{
+            .field = .pstate,
+            .member = "pstate",
+            .c_names = &.{"nvprime_core_get_pstate"},
+            .legacy_names = &.{"nvprime_get_pstate"},
+            .dbus_name = "PState",
+            .metric = .{ .family = "nvprime_gpu_pstate" },
+            .doc = "Performance state (0-15)",
+        },
+        .throttle_reasons => .{
+            .field = .throttle_reasons,
+            .member = "throttle_reasons",
+            .c_type = .uint64,
+            // One series per reason bit, rendered by the exporter itself
+            .doc = "NV_THROTTLE_* bits holding clocks down",
+        },
+        .encoder_sessions => .{
+            .field = .encoder,
+            .member = "encoder_sessions",
+            .metric = .{ .family = "nvprime_gpu_encoder_sessions" },
+            .doc = "Active NVENC sessions",
+        },
+        .encoder_fps => .{
+            .field = .encoder,
+            .member = "encoder_fps",
+            .metric = .{ .family = "nvprime_gpu_encoder_fps" },
+            .doc = "Average NVENC frame rate across sessions",
+        },
+        .encoder_latency => .{
+            .field = .encoder,
+            .member = "encoder_latency_us",
+            .metric = .{ .family = "nvprime_gpu_encoder_latency_seconds", .div = 1e6 },
+            .doc = "Average NVENC encode latency in microseconds",
+        },
+        .encoder_utilization => .{
+            .field = .encoder,
+            .member = "encoder_utilization",
+            .metric = .{ .family = "nvprime_gpu_encoder_utilization_ratio", .div = 100 },
+            .doc = "NVENC engine utilization percentage (0-100)",
+        },
+    };
+}
+
+/// Sampler mask covering a set of ids
+pub fn maskOf(comptime ids: []const Id) FieldMask {
+    comptime var mask: FieldMask = 0;
+    inline for (ids) |id| mask |= comptime get(id).field.bit();
+    return mask;
+}
+
+/// Mask of every field the table reads
+pub const table_mask: FieldMask = blk: {
+    var mask: FieldMask = 0;
+    for (std.enums.values(Id)) |id| mask |= get(id).field.bit();
+    break :blk mask;
+};
+
+/// Read a value out of a sample, if the sample holds it
+pub fn fromSample(comptime id: Id, sample: *const GpuSample) ?u64 {
+    const def = comptime get(id);
+    if (!sample.has(def.field)) return null;
+    return @field(sample, def.member);
+}
+
+/// Current value of one field: the sampler's cache when fresh, otherwise
+/// only the NVML query that field needs.
+pub fn read(comptime id: Id, index: u32) ?u64 {
+    const def = comptime get(id);
+    if (nvmon.sampler.latestWith(index, def.field)) |sample| return fromSample(id, &sample);
+    const device = registry.getDevice(index) catch return null;
+    const sample = nvmon.sampleDevice(index, device, def.field.bit());
+    return fromSample(id, &sample);
+}
+
+/// Look up an id by its D-Bus property name
+pub fn fromDbusName(name: []const u8) ?Id {
+    inline for (comptime std.enums.values(Id)) |id| {
+        if (comptime get(id).dbus_name) |dbus_name| {
+            if (std.mem.eql(u8, dbus_name, name)) return id;
+        }
+    }
+    return null;
+}
+
+/// Header declaration of one generated getter
+pub fn cDeclaration(comptime id: Id, comptime name: []const u8) []const u8 {
+    return std.fmt.comptimePrint("{s} {s}(uint32_t index);", .{ comptime get(id).c_type.cName(), name });
+}
+
+/// Render the header declarations of every generated getter
+pub fn writeCHeader(out: *std.Io.Writer) !void {
+    inline for (comptime std.enums.values(Id)) |id| {
+        const def = comptime get(id);
+        inline for (def.c_names) |name| {
+            try out.print("/** {s} */\n{s}\n", .{ def.doc, comptime cDeclaration(id, name) });
+        }
+    }
+}
+
+/// Header macro of a sampler field bit, e.g. NV_FIELD_POWER_DRAW
+fn fieldMacro(comptime field: Field) []const u8 {
+    comptime {
+        var name: [@tagName(field).len]u8 = undefined;
+        _ = std.ascii.upperString(&name, @tagName(field));
+        const upper = name;
+        return "NV_FIELD_" ++ &upper;
+    }
+}
+
+/// Value of `#define name value` in a header, if defined
+fn macroValue(header: []const u8, name: []const u8) ?[]const u8 {
+    var lines = std.mem.splitScalar(u8, header, '\n');
+    while (lines.next()) |line| {
+        var tokens = std.mem.tokenizeAny(u8, line, " \t");
+        if (!std.mem.eql(u8, tokens.next() orelse continue, "#define")) continue;
+        if (!std.mem.eql(u8, tokens.next() orelse continue, name)) continue;
+        return std.mem.trim(u8, tokens.rest(), " \t\r");
+    }
+    return null;
+}
+
+test "table members match sample types" {
+    inline for (comptime std.enums.values(Id)) |id| {
+        const def = comptime get(id);
+        const T = @FieldType(GpuSample, def.member);
+        try std.testing.expect(T == u32 or T == u64);
+    }
+}
+
+test "from sample honours the valid mask" {
+    var sample = GpuSample{ .temperature_c = 64, .vram_used_mb = 4096, .valid_mask = Field.temperature.bit() };
+    try std.testing.expectEqual(@as(?u64, 64), fromSample(.temperature, &sample));
+    try std.testing.expectEqual(@as(?u64, null), fromSample(.vram_used, &sample));
+    sample.valid_mask |= Field.vram.bit();
+    try std.testing.expectEqual(@as(?u64, 4096), fromSample(.vram_used, &sample));
+}
+
+test "masks and names" {
+    try std.testing.expectEqual(Field.utilization.bit(), maskOf(&.{ .utilization, .mem_utilization }));
+    try std.testing.expectEqual(@as(?Id, .fan_speed), fromDbusName("FanSpeed"));
+    try std.testing.expectEqual(@as(?Id, null), fromDbusName("Name"));
+
+    var buf: [4096]u8 = undefined;
+    var out = std.Io.Writer.fixed(&buf);
+    try writeCHeader(&out);
+    try std.testing.expect(std.mem.indexOf(u8, out.buffered(), "uint64_t nvprime_get_vram_used(uint32_t index);") != null);
+}
+
+test "nvprime.h declares every generated getter" {
+    const header = @embedFile("nvprime.h");
+    inline for (comptime std.enums.values(Id)) |id| {
+        const def = comptime get(id);
+        inline for (def.c_names) |name| {
+            const decl = comptime cDeclaration(id, name);
+            if (std.mem.indexOf(u8, header, decl) == null) {
+                std.debug.print("nvprime.h is missing: {s}\n", .{decl});
+                return error.TestExpectedEqual;
+            }
+        }
+        inline for (def.legacy_names) |name| {
+            if (std.mem.indexOf(u8, header, "#define " ++ name ++ "(") == null) {
+                std.debug.print("nvprime.h is missing the {s} macro\n", .{name});
+                return error.TestExpectedEqual;
+            }
+        }
+    }
+}
+
+test "nvprime.h defines every sampler field bit" {
+    const header = @embedFile("nvprime.h");
+    const all = comptime std.enums.values(Field);
+    inline for (all) |field| {
+        const name = comptime fieldMacro(field);
+        const expected = std.fmt.comptimePrint("(1ull << {d})", .{@intFromEnum(field)});
+        const value = macroValue(header, name) orelse "(missing)";
+        if (!std.mem.eql(u8, value, expected)) {
+            std.debug.print("nvprime.h: {s} is {s}, expected {s}\n", .{ name, value, expected });
+            return error.TestExpectedEqual;
+        }
+    }
+
+    // NV_FIELD_ALL is written as a contiguous run of bits
+    try std.testing.expectEqual(@as(FieldMask, (1 << all.len) - 1), nvmon.all_fields);
+    try std.testing.expectEqualStrings(
+        std.fmt.comptimePrint("((1ull << {d}) - 1)", .{all.len}),
+        macroValue(header, "NV_FIELD_ALL") orelse "(missing)",
+    );
+
+    // No bit left behind for a field that is gone
+    var defined: usize = 0;
+    var lines = std.mem.splitScalar(u8, header, '\n');
+    while (lines.next()) |line| {
+        if (std.mem.startsWith(u8, line, "#define NV_FIELD_")) defined += 1;
+    }
+    try std.testing.expectEqual(all.len + 1, defined);
+}
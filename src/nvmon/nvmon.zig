@@ -0,0 +1,317 @@
+//! nvmon - Batched GPU Telemetry
+//!
+//! Samples every GPU in one pass into fixed-layout records.
+//! This is the fast path for monitoring agents, exporters and the HUD:
+//! callers pick the fields they need with a bitmask, and fields that NVML
+//! exposes as field values are fetched in a single driver round-trip.
+
+const std = @import("std");
+const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+
+pub const sampler = @import("sampler.zig");
+pub const events = @import("events.zig");
+pub const shm = @import("shm.zig");
+pub const recorder = @import("recorder.zig");
+pub const trace = @import("trace.zig");
+pub const fields = @import("fields.zig");
+pub const exporter = @import("exporter.zig");
+
+/// Maximum number of GPUs tracked per process
+pub const max_gpus = registry.max_devices;
+
+/// Telemetry fields that can be requested in a sample
+pub const Field = enum(u6) {
+    temperature = 0,
+    memory_temperature = 1,
+    power_draw = 2,
+    power_limit = 3,
+    gpu_clock = 4,
+    mem_clock = 5,
+    sm_clock = 6,
+    video_clock = 7,
+    utilization = 8,
+    fan_speed = 9,
+    vram = 10,
+    pstate = 11,
+    throttle_reasons = 12,
+    /// NVENC sessions, average FPS and latency, engine utilization
+    encoder = 13,
+
+    pub fn bit(self: Field) FieldMask {
+        return @as(FieldMask, 1) << @intFromEnum(self);
+    }
+};
+
+/// Bitmask of `Field` values
+pub const FieldMask = u64;
+
+/// Every field nvmon knows how to sample
+pub const all_fields: FieldMask = blk: {
+    var mask: FieldMask = 0;
+    for (std.enums.values(Field)) |f| mask |= f.bit();
+    break :blk mask;
+};
+
+/// Fields the sampler reads unless a consumer asks for more. Throttle
+/// reasons and encoder stats cost extra NVML calls per GPU on every pass,
+/// so the exporter and placement request them with `sampler.requestFields`.
+pub const default_fields: FieldMask = all_fields & ~(Field.throttle_reasons.bit() | Field.encoder.bit());
+
+/// One telemetry sample for one GPU.
+/// Layout is C-compatible; the C API hands this struct out as-is.
+pub const GpuSample = extern struct {
+    index: u32 = 0,
+    pstate: u32 = 15,
+    /// Fields that were requested and successfully read
+    valid_mask: FieldMask = 0,
+    /// CLOCK_MONOTONIC time the sample started
+    timestamp_ns: u64 = 0,
+    /// Time spent sampling this device
+    duration_ns: u64 = 0,
+
+    temperature_c: u32 = 0,
+    memory_temp_c: u32 = 0,
+    power_draw_mw: u32 = 0,
+    power_limit_mw: u32 = 0,
+    gpu_clock_mhz: u32 = 0,
+    mem_clock_mhz: u32 = 0,
+    sm_clock_mhz: u32 = 0,
+    video_clock_mhz: u32 = 0,
+    gpu_utilization: u32 = 0,
+    mem_utilization: u32 = 0,
+    fan_speed_percent: u32 = 0,
+    _reserved: u32 = 0,
+    vram_used_mb: u64 = 0,
+    vram_total_mb: u64 = 0,
+    /// THROTTLE_* bits currently holding clocks down
+    throttle_reasons: u64 = 0,
+    encoder_sessions: u32 = 0,
+    encoder_fps: u32 = 0,
+    encoder_latency_us: u32 = 0,
+    /// NVENC engine utilization percent
+    encoder_utilization: u32 = 0,
+
+    pub fn has(self: *const GpuSample, field: Field) bool {
+        return (self.valid_mask & field.bit()) != 0;
+    }
+
+    pub fn powerDrawW(self: *const GpuSample) f32 {
+        return @as(f32, @floatFromInt(self.power_draw_mw)) / 1000.0;
+    }
+
+    pub fn powerLimitW(self: *const GpuSample) f32 {
+        return @as(f32, @floatFromInt(self.power_limit_mw)) / 1000.0;
+    }
+};
+
+comptime {
+    // Handed to C as NvGpuSample: changing the layout breaks the ABI and
+    // needs an NVPRIME_VERSION bump
+    std.debug.assert(@sizeOf(GpuSample) == 120);
+}
+
+/// Whether a device answers batched field value queries
+const BatchSupport = enum(u8) { unknown, supported, unsupported };
+
+var batch_support: [max_gpus]BatchSupport = [_]BatchSupport{.unknown} ** max_gpus;
+var last_pass_ns = std.atomic.Value(u64).init(0);
+
+/// Sample a single device
+pub fn sampleDevice(index: u32, device: nvml.Device, mask: FieldMask) GpuSample {
+    const start = timestampNs();
+    var sample = GpuSample{ .index = index, .timestamp_ns = start };
+
+    // Fields NVML exposes as field values go through one batched call
+    const batched = mask & (Field.power_draw.bit() | Field.memory_temperature.bit());
+    if (batched != 0) {
+        const handled = sampleFieldValues(index, device, batched, &sample);
+        // Anything the batch did not cover falls back to the classic getters
+        if ((batched & ~handled & Field.power_draw.bit()) != 0) {
+            if (nvml.getDevicePowerUsage(device)) |power| {
+                sample.power_draw_mw = power;
+                sample.valid_mask |= Field.power_draw.bit();
+            } else |err| registry.reportError(index, err);
+        }
+    }
+
+    if ((mask & Field.temperature.bit()) != 0) {
+        if (nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU)) |temp| {
+            sample.temperature_c = temp;
+            sample.valid_mask |= Field.temperature.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.power_limit.bit()) != 0) {
+        if (nvml.getDevicePowerLimit(device)) |limit| {
+            sample.power_limit_mw = limit;
+            sample.valid_mask |= Field.power_limit.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    const clock_fields = [_]struct { field: Field, clock: nvml.ClockType, dest: *u32 }{
+        .{ .field = .gpu_clock, .clock = nvml.CLOCK_GRAPHICS, .dest = &sample.gpu_clock_mhz },
+        .{ .field = .mem_clock, .clock = nvml.CLOCK_MEM, .dest = &sample.mem_clock_mhz },
+        .{ .field = .sm_clock, .clock = nvml.CLOCK_SM, .dest = &sample.sm_clock_mhz },
+        .{ .field = .video_clock, .clock = nvml.CLOCK_VIDEO, .dest = &sample.video_clock_mhz },
+    };
+    for (clock_fields) |entry| {
+        if ((mask & entry.field.bit()) == 0) continue;
+        if (nvml.getDeviceClock(device, entry.clock)) |mhz| {
+            entry.dest.* = mhz;
+            sample.valid_mask |= entry.field.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.utilization.bit()) != 0) {
+        if (nvml.getDeviceUtilization(device)) |util| {
+            sample.gpu_utilization = util.gpu;
+            sample.mem_utilization = util.memory;
+            sample.valid_mask |= Field.utilization.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.fan_speed.bit()) != 0) {
+        if (nvml.getDeviceFanSpeed(device)) |speed| {
+            sample.fan_speed_percent = speed;
+            sample.valid_mask |= Field.fan_speed.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.vram.bit()) != 0) {
+        if (nvml.getDeviceMemoryInfo(device)) |memory| {
+            sample.vram_used_mb = memory.used / (1024 * 1024);
+            sample.vram_total_mb = memory.total / (1024 * 1024);
+            sample.valid_mask |= Field.vram.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.pstate.bit()) != 0) {
+        if (nvml.getDevicePerformanceState(device)) |pstate| {
+            sample.pstate = @intCast(pstate);
+            sample.valid_mask |= Field.pstate.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.throttle_reasons.bit()) != 0) {
+        if (nvml.getDeviceCurrentClocksThrottleReasons(device)) |reasons| {
+            sample.throttle_reasons = reasons;
+            sample.valid_mask |= Field.throttle_reasons.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    if ((mask & Field.encoder.bit()) != 0) {
+        if (nvml.getDeviceEncoderStats(device)) |encoder| {
+            sample.encoder_sessions = encoder.session_count;
+            sample.encoder_fps = encoder.average_fps;
+            sample.encoder_latency_us = encoder.average_latency_us;
+            sample.encoder_utilization = nvml.getDeviceEncoderUtilization(device) catch 0;
+            sample.valid_mask |= Field.encoder.bit();
+        } else |err| registry.reportError(index, err);
+    }
+
+    sample.duration_ns = timestampNs() -| start;
+    return sample;
+}
+
+/// Fill the batched fields of `sample`; returns the mask of fields it covered
+fn sampleFieldValues(index: u32, device: nvml.Device, mask: FieldMask, sample: *GpuSample) FieldMask {
+    const slot: ?*BatchSupport = if (index < max_gpus) &batch_support[index] else null;
+    if (slot) |s| {
+        if (s.* == .unsupported) return 0;
+    }
+
+    var values: [2]nvml.FieldValue = undefined;
+    var fields: [2]Field = undefined;
+    var count: usize = 0;
+
+    if ((mask & Field.power_draw.bit()) != 0) {
+        values[count] = std.mem.zeroes(nvml.FieldValue);
+        values[count].fieldId = nvml.FI_DEV_POWER_INSTANT;
+        fields[count] = .power_draw;
+        count += 1;
+    }
+    if ((mask & Field.memory_temperature.bit()) != 0) {
+        values[count] = std.mem.zeroes(nvml.FieldValue);
+        values[count].fieldId = nvml.FI_DEV_MEMORY_TEMP;
+        fields[count] = .memory_temperature;
+        count += 1;
+    }
+    if (count == 0) return 0;
+
+    nvml.getDeviceFieldValues(device, values[0..count]) catch {
+        // Older drivers reject the whole call; remember and stop asking
+        if (slot) |s| s.* = .unsupported;
+        return 0;
+    };
+    if (slot) |s| s.* = .supported;
+
+    var handled: FieldMask = 0;
+    for (values[0..count], fields[0..count]) |*value, field| {
+        nvml.fieldValueResult(value) catch continue;
+        switch (field) {
+            .power_draw => sample.power_draw_mw = value.value.uiVal,
+            .memory_temperature => sample.memory_temp_c = value.value.uiVal,
+            else => unreachable,
+        }
+        sample.valid_mask |= field.bit();
+        handled |= field.bit();
+    }
+    return handled;
+}
+
+/// Sample every GPU in one pass. Returns the number of entries written to `out`.
+/// Devices whose handle cannot be resolved still get an entry with an empty `valid_mask`.
+pub fn sampleAll(out: []GpuSample, mask: FieldMask) !usize {
+    const start = timestampNs();
+    const count = try registry.count();
+    const n = @min(count, out.len);
+
+    for (0..n) |i| {
+        const index: u32 = @intCast(i);
+        if (registry.getDevice(index)) |device| {
+            out[i] = sampleDevice(index, device, mask);
+        } else |_| {
+            out[i] = GpuSample{ .index = index, .timestamp_ns = timestampNs() };
+        }
+    }
+
+    last_pass_ns.store(timestampNs() -| start, .monotonic);
+    return n;
+}
+
+/// Duration of the most recent `sampleAll` pass across all devices
+pub fn lastPassDurationNs() u64 {
+    return last_pass_ns.load(.monotonic);
+}
+
+/// CLOCK_MONOTONIC in nanoseconds, the clock `GpuSample.timestamp_ns` uses.
+/// System-wide, so samples from the daemon's segment compare against it too.
+pub fn timestampNs() u64 {
+    const ts = std.posix.clock_gettime(.MONOTONIC) catch return 0;
+    return @as(u64, @intCast(ts.sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.nsec));
+}
+
+test {
+    _ = sampler;
+    _ = events;
+    _ = shm;
+    _ = recorder;
+    _ = trace;
+    _ = fields;
+    _ = exporter;
+}
+
+test "field mask" {
+    try std.testing.expectEqual(@as(FieldMask, 1), Field.temperature.bit());
+    try std.testing.expect((all_fields & Field.pstate.bit()) != 0);
+    try std.testing.expectEqual(@as(u64, 14), @popCount(all_fields));
+}
+
+test "sample field validity" {
+    var sample = GpuSample{ .power_draw_mw = 250_000 };
+    try std.testing.expect(!sample.has(.power_draw));
+    sample.valid_mask |= Field.power_draw.bit();
+    try std.testing.expect(sample.has(.power_draw));
+    try std.testing.expectEqual(@as(f32, 250.0), sample.powerDrawW());
+}
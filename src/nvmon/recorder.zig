@@ -0,0 +1,648 @@
+//! nvmon/recorder - Telemetry Flight Recorder
+//!
+//! Appends one fixed-width frame per interval to a memory-mapped ring file:
+//! a frame-time summary plus every GPU's sample. GPU values are quantized
+//! into 16 bytes of absolute values, so every frame decodes on its own and
+//! a reader can start anywhere after the ring wraps. (Deltas against the
+//! previous frame would need the same width to hold a clock or power step,
+//! so they saved nothing.) At the default 500 ms interval a frame is
+//! 32 + 16 bytes per GPU: about 350 KB per hour with one GPU, plus about
+//! 115 KB per hour for each additional GPU.
+//!
+//! Frame times come from the pacing thread through `recordFrame`, which only
+//! touches atomics and never blocks. Frames are written into the mapping by
+//! the nvmon sampler thread (the only producer), which publishes each one by
+//! bumping the header's write index, so readers in other processes can
+//! replay a recording while it is still being written.
+
+const std = @import("std");
+const nvmon = @import("nvmon.zig");
+const registry = @import("../nvcaps/registry.zig");
+
+const posix = std.posix;
+const GpuSample = nvmon.GpuSample;
+
+/// "NVPR"
+pub const magic: u32 = 0x5250564e;
+
+/// Bumped on any incompatible layout change
+pub const format_version: u32 = 2;
+
+/// Frames start one page into the file
+const header_size = 4096;
+
+/// Frames longer than this multiple of the previous interval's average count as stutters
+const stutter_factor = 2;
+
+/// Recorder configuration
+pub const Config = struct {
+    /// Time covered by one frame
+    interval_ms: u32 = 500,
+    /// Length of the ring; older frames are overwritten
+    duration_s: u32 = 4 * 3600,
+};
+
+/// File header (first page)
+pub const FileHeader = extern struct {
+    magic: u32,
+    version: u32,
+    header_size: u32,
+    frame_size: u32,
+    gpu_count: u32,
+    interval_ms: u32,
+    /// Frames the ring holds
+    capacity: u32,
+    _reserved: u32 = 0,
+    /// CLOCK_MONOTONIC time the recording started
+    start_ns: u64,
+    /// Frames written so far; frame n lives in slot n % capacity
+    write_index: u64,
+};
+
+/// Per-frame header
+pub const FrameHeader = extern struct {
+    /// Frame number + 1 (0 = never written); tells readers a slot was reused
+    seq: u32,
+    gpu_count: u8,
+    _reserved: [3]u8 = .{ 0, 0, 0 },
+    /// Milliseconds since the recording started
+    time_ms: u32,
+    _reserved2: u32 = 0,
+};
+
+/// Frame-time summary for one interval
+pub const FrameSummary = extern struct {
+    frame_count: u16 = 0,
+    stutter_count: u16 = 0,
+    avg_frame_us: u32 = 0,
+    max_frame_us: u32 = 0,
+    max_latency_us: u32 = 0,
+};
+
+/// Which values a GPU entry carries
+pub const GpuField = enum(u3) {
+    temperature,
+    power,
+    gpu_clock,
+    mem_clock,
+    vram,
+    utilization,
+    fan,
+    pstate,
+
+    pub fn bit(self: GpuField) u8 {
+        return @as(u8, 1) << @intFromEnum(self);
+    }
+};
+
+/// One GPU in a frame. Fields the sample lacked hold their last value.
+pub const GpuEntry = extern struct {
+    /// GpuField bits
+    valid: u8,
+    /// Always absolute
+    pstate: u8,
+    temperature_c: u16,
+    /// 0.1 W units
+    power_dw: u16,
+    gpu_clock_mhz: u16,
+    mem_clock_mhz: u16,
+    /// 8 MB units
+    vram_8mb: u16,
+    utilization: u8,
+    mem_utilization: u8,
+    fan_percent: u8,
+    _reserved: u8 = 0,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(FileHeader) <= header_size);
+    std.debug.assert(@sizeOf(FrameHeader) == 16);
+    std.debug.assert(@sizeOf(FrameSummary) == 16);
+    std.debug.assert(@sizeOf(GpuEntry) == 16);
+}
+
+/// Size of one frame for `gpu_count` GPUs
+pub fn frameSize(gpu_count: u32) u32 {
+    return @sizeOf(FrameHeader) + @sizeOf(FrameSummary) + gpu_count * @sizeOf(GpuEntry);
+}
+
+/// Decoded GPU values (layout is C-compatible; the C API hands it out as-is)
+pub const GpuValues = extern struct {
+    valid: u32 = 0,
+    pstate: u32 = 0,
+    temperature_c: u32 = 0,
+    power_mw: u32 = 0,
+    gpu_clock_mhz: u32 = 0,
+    mem_clock_mhz: u32 = 0,
+    utilization: u32 = 0,
+    mem_utilization: u32 = 0,
+    fan_percent: u32 = 0,
+    _reserved: u32 = 0,
+    vram_used_mb: u64 = 0,
+
+    pub fn has(self: *const GpuValues, field: GpuField) bool {
+        return self.valid & field.bit() != 0;
+    }
+};
+
+/// One decoded frame (C-compatible)
+pub const Frame = extern struct {
+    time_ms: u32 = 0,
+    summary: FrameSummary = .{},
+    gpu_count: u32 = 0,
+    _reserved: u32 = 0,
+    gpus: [nvmon.max_gpus]GpuValues = [_]GpuValues{.{}} ** nvmon.max_gpus,
+};
+
+fn sampleValidity(sample: *const GpuSample) u8 {
+    var valid: u8 = 0;
+    if (sample.has(.temperature)) valid |= GpuField.temperature.bit();
+    if (sample.has(.power_draw)) valid |= GpuField.power.bit();
+    if (sample.has(.gpu_clock)) valid |= GpuField.gpu_clock.bit();
+    if (sample.has(.mem_clock)) valid |= GpuField.mem_clock.bit();
+    if (sample.has(.vram)) valid |= GpuField.vram.bit();
+    if (sample.has(.utilization)) valid |= GpuField.utilization.bit();
+    if (sample.has(.fan_speed)) valid |= GpuField.fan.bit();
+    if (sample.has(.pstate)) valid |= GpuField.pstate.bit();
+    return valid;
+}
+
+fn quantize(comptime T: type, value: anytype) T {
+    return @intCast(@min(value, std.math.maxInt(T)));
+}
+
+/// Encode one GPU. `last` holds the previous entry's values, which fields
+/// missing from `sample` (or a missing sample) keep.
+fn encodeGpu(last: *GpuEntry, sample: ?*const GpuSample) GpuEntry {
+    var entry = last.*;
+    entry.valid = 0;
+    entry.pstate = 0;
+    const s = sample orelse return entry;
+
+    const valid = sampleValidity(s);
+    entry.valid = valid;
+    entry.pstate = @intCast(@min(s.pstate, 15));
+    if (valid & GpuField.temperature.bit() != 0) entry.temperature_c = quantize(u16, s.temperature_c);
+    if (valid & GpuField.power.bit() != 0) entry.power_dw = quantize(u16, s.power_draw_mw / 100);
+    if (valid & GpuField.gpu_clock.bit() != 0) entry.gpu_clock_mhz = quantize(u16, s.gpu_clock_mhz);
+    if (valid & GpuField.mem_clock.bit() != 0) entry.mem_clock_mhz = quantize(u16, s.mem_clock_mhz);
+    if (valid & GpuField.vram.bit() != 0) entry.vram_8mb = quantize(u16, s.vram_used_mb / 8);
+    if (valid & GpuField.utilization.bit() != 0) {
+        entry.utilization = @intCast(@min(s.gpu_utilization, 100));
+        entry.mem_utilization = @intCast(@min(s.mem_utilization, 100));
+    }
+    if (valid & GpuField.fan.bit() != 0) entry.fan_percent = @intCast(@min(s.fan_speed_percent, 100));
+    last.* = entry;
+    return entry;
+}
+
+fn decodeGpu(entry: *const GpuEntry) GpuValues {
+    return .{
+        .valid = entry.valid,
+        .pstate = entry.pstate,
+        .temperature_c = entry.temperature_c,
+        .power_mw = @as(u32, entry.power_dw) * 100,
+        .gpu_clock_mhz = entry.gpu_clock_mhz,
+        .mem_clock_mhz = entry.mem_clock_mhz,
+        .utilization = entry.utilization,
+        .mem_utilization = entry.mem_utilization,
+        .fan_percent = entry.fan_percent,
+        .vram_used_mb = @as(u64, entry.vram_8mb) * 8,
+    };
+}
+
+// ============================================================================
+// Frame-time accumulation (pacing thread, lock-free)
+// ============================================================================
+
+const FrameAccumulator = struct {
+    count: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    stutters: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    sum_us: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    max_us: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    max_latency_us: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    /// Previous interval's average, for stutter detection
+    reference_us: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+
+    fn add(self: *FrameAccumulator, frame_us: u32, latency_us: u32) void {
+        _ = self.count.fetchAdd(1, .monotonic);
+        _ = self.sum_us.fetchAdd(frame_us, .monotonic);
+        _ = self.max_us.fetchMax(frame_us, .monotonic);
+        _ = self.max_latency_us.fetchMax(latency_us, .monotonic);
+        const reference = self.reference_us.load(.monotonic);
+        if (reference > 0 and frame_us > reference * stutter_factor) _ = self.stutters.fetchAdd(1, .monotonic);
+    }
+
+    /// Take the interval's totals. A frame landing mid-drain ends up split
+    /// across two intervals, which only blurs one sample.
+    fn drain(self: *FrameAccumulator) FrameSummary {
+        const count = self.count.swap(0, .monotonic);
+        const sum = self.sum_us.swap(0, .monotonic);
+        const avg: u32 = if (count > 0) @intCast(sum / count) else 0;
+        if (count > 0) self.reference_us.store(avg, .monotonic);
+        return .{
+            .frame_count = @intCast(@min(count, std.math.maxInt(u16))),
+            .stutter_count = @intCast(@min(self.stutters.swap(0, .monotonic), std.math.maxInt(u16))),
+            .avg_frame_us = avg,
+            .max_frame_us = self.max_us.swap(0, .monotonic),
+            .max_latency_us = self.max_latency_us.swap(0, .monotonic),
+        };
+    }
+};
+
+var frame_totals = FrameAccumulator{};
+
+/// Record one presented frame. Safe to call from the pacing thread: a few
+/// atomic adds, no locks, no I/O. Does nothing when not recording.
+pub fn recordFrame(frame_time_ns: u64, latency_ns: u64) void {
+    if (!recording.load(.acquire)) return;
+    const frame_us: u32 = @intCast(@min(frame_time_ns / std.time.ns_per_us, std.math.maxInt(u32)));
+    const latency_us: u32 = @intCast(@min(latency_ns / std.time.ns_per_us, std.math.maxInt(u32)));
+    frame_totals.add(frame_us, latency_us);
+}
+
+// ============================================================================
+// Ring writer (sampler thread)
+// ============================================================================
+
+const Writer = struct {
+    mapping: []align(std.heap.page_size_min) u8,
+    header: *FileHeader,
+    frame_size: u32,
+    gpu_count: u32,
+    capacity: u32,
+    interval_ns: u64,
+    start_ns: u64,
+    last_frame_ns: u64 = 0,
+    last: [nvmon.max_gpus]GpuEntry = std.mem.zeroes([nvmon.max_gpus]GpuEntry),
+
+    fn create(path: []const u8, config: Config, gpu_count: u32) !Writer {
+        if (config.interval_ms == 0) return error.InvalidArgument;
+        const capacity: u32 = @max(@as(u32, @intCast(@as(u64, config.duration_s) * 1000 / config.interval_ms)), 16);
+        const frame_size = frameSize(gpu_count);
+        const file_size = header_size + @as(u64, capacity) * frame_size;
+
+        const file = try std.fs.cwd().createFile(path, .{ .read = true, .truncate = true });
+        defer file.close();
+        try file.setEndPos(file_size);
+
+        const mapping = try posix.mmap(null, @intCast(file_size), posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, file.handle, 0);
+        const header: *FileHeader = @ptrCast(mapping.ptr);
+        const start_ns = nvmon.timestampNs();
+        header.* = .{
+            .magic = 0,
+            .version = format_version,
+            .header_size = header_size,
+            .frame_size = frame_size,
+            .gpu_count = gpu_count,
+            .interval_ms = config.interval_ms,
+            .capacity = capacity,
+            .start_ns = start_ns,
+            .write_index = 0,
+        };
+        @atomicStore(u32, &header.magic, magic, .release);
+
+        return .{
+            .mapping = mapping,
+            .header = header,
+            .frame_size = frame_size,
+            .gpu_count = gpu_count,
+            .capacity = capacity,
+            .interval_ns = @as(u64, config.interval_ms) * std.time.ns_per_ms,
+            .start_ns = start_ns,
+        };
+    }
+
+    fn close(self: *Writer) void {
+        posix.msync(self.mapping, posix.MSF.ASYNC) catch {};
+        posix.munmap(self.mapping);
+    }
+
+    /// Write one frame if the interval has elapsed
+    fn tick(self: *Writer, samples: []const GpuSample, now_ns: u64) void {
+        if (self.last_frame_ns != 0 and now_ns -| self.last_frame_ns < self.interval_ns) return;
+        self.last_frame_ns = now_ns;
+        self.writeFrame(samples, frame_totals.drain(), now_ns);
+    }
+
+    fn writeFrame(self: *Writer, samples: []const GpuSample, summary: FrameSummary, now_ns: u64) void {
+        const index = self.header.write_index;
+        const offset = header_size + (index % self.capacity) * self.frame_size;
+        const slot = self.mapping[@intCast(offset)..][0..self.frame_size];
+
+        // Encode locally, then publish into the shared slot
+        var buf: [frameSize(nvmon.max_gpus)]u8 align(8) = undefined;
+        const frame = buf[0..self.frame_size];
+        const header = FrameHeader{
+            .seq = @truncate(index + 1),
+            .gpu_count = @intCast(self.gpu_count),
+            .time_ms = @intCast(@min((now_ns -| self.start_ns) / std.time.ns_per_ms, std.math.maxInt(u32))),
+        };
+        @memcpy(frame[0..@sizeOf(FrameHeader)], std.mem.asBytes(&header));
+        @memcpy(frame[@sizeOf(FrameHeader)..][0..@sizeOf(FrameSummary)], std.mem.asBytes(&summary));
+
+        for (0..self.gpu_count) |i| {
+            var sample: ?*const GpuSample = null;
+            for (samples) |*s| {
+                if (s.index == i) sample = s;
+            }
+            const entry = encodeGpu(&self.last[i], sample);
+            const at = @sizeOf(FrameHeader) + @sizeOf(FrameSummary) + i * @sizeOf(GpuEntry);
+            @memcpy(frame[at..][0..@sizeOf(GpuEntry)], std.mem.asBytes(&entry));
+        }
+
+        storeFrame(slot, frame);
+        @atomicStore(u64, &self.header.write_index, index + 1, .release);
+    }
+};
+
+/// Frame words as seen through the mapping; frames are 16-byte multiples
+/// and start on 16-byte boundaries
+fn frameWords(bytes: []const u8) []const u64 {
+    return @as([*]const u64, @ptrCast(@alignCast(bytes.ptr)))[0 .. bytes.len / 8];
+}
+
+/// Publish `frame` into `slot`. The first word holds the sequence: it is
+/// cleared first and written last, and release stores keep the payload
+/// between the two.
+fn storeFrame(slot: []u8, frame: []const u8) void {
+    const dst = @as([*]u64, @ptrCast(@alignCast(slot.ptr)))[0 .. slot.len / 8];
+    const src = frameWords(frame);
+    @atomicStore(u32, @as(*u32, @ptrCast(dst.ptr)), 0, .monotonic);
+    for (dst[1..], src[1..]) |*word, value| @atomicStore(u64, word, value, .release);
+    @atomicStore(u64, &dst[0], src[0], .release);
+}
+
+/// Copy a slot out of the mapping. Acquire loads keep a later sequence
+/// re-read after the payload.
+fn loadFrame(out: []u8, slot: []const u8) void {
+    const dst = @as([*]u64, @ptrCast(@alignCast(out.ptr)))[0 .. out.len / 8];
+    for (dst, frameWords(slot)) |*value, *word| value.* = @atomicLoad(u64, word, .acquire);
+}
+
+var writer: ?Writer = null;
+var recording = std.atomic.Value(bool).init(false);
+var writer_mutex: std.Thread.Mutex = .{};
+/// The sampler was started by `start` and is stopped with the recording
+var owns_sampler = false;
+
+/// Start recording to `path` (created or truncated). Frames are written
+/// from the nvmon sampler, which is started if it is not running.
+pub fn start(path: []const u8, config: Config) !void {
+    writer_mutex.lock();
+    defer writer_mutex.unlock();
+    if (writer != null) return error.AlreadyRecording;
+
+    const gpu_count = @min(registry.count() catch 0, nvmon.max_gpus);
+    writer = try Writer.create(path, config, gpu_count);
+    _ = frame_totals.drain();
+    recording.store(true, .release);
+
+    if (!nvmon.sampler.isRunning()) {
+        nvmon.sampler.start(.{}) catch |err| {
+            recording.store(false, .release);
+            writer.?.close();
+            writer = null;
+            return err;
+        };
+        owns_sampler = true;
+    }
+}
+
+/// Stop recording and unmap the file. Stops the sampler if `start` started it.
+pub fn stop() void {
+    const stop_sampler = blk: {
+        writer_mutex.lock();
+        defer writer_mutex.unlock();
+        recording.store(false, .release);
+        if (writer) |*w| w.close();
+        writer = null;
+        const owned = owns_sampler;
+        owns_sampler = false;
+        break :blk owned;
+    };
+    if (stop_sampler) nvmon.sampler.stop();
+}
+
+pub fn isRecording() bool {
+    return recording.load(.acquire);
+}
+
+/// Append a frame when one is due. Called by the nvmon sampler after every pass.
+pub fn observe(samples: []const GpuSample) void {
+    if (!recording.load(.acquire)) return;
+    // Only start/stop contend for this; never wait on them from the sampler
+    if (!writer_mutex.tryLock()) return;
+    defer writer_mutex.unlock();
+    // Sample timestamps are CLOCK_MONOTONIC, like the recording's start
+    const now = if (samples.len > 0) samples[0].timestamp_ns else nvmon.timestampNs();
+    if (writer) |*w| w.tick(samples, now);
+}
+
+// ============================================================================
+// Reader
+// ============================================================================
+
+/// Read-only view of a recording file, live or finished
+pub const Recording = struct {
+    mapping: []align(std.heap.page_size_min) const u8,
+    header: *const FileHeader,
+
+    const Self = @This();
+
+    pub fn open(path: []const u8) !Self {
+        const file = try std.fs.cwd().openFile(path, .{});
+        defer file.close();
+        const size = (try file.stat()).size;
+        if (size < header_size) return error.InvalidRecording;
+
+        const mapping = try posix.mmap(null, @intCast(size), posix.PROT.READ, .{ .TYPE = .SHARED }, file.handle, 0);
+        errdefer posix.munmap(mapping);
+        const header: *const FileHeader = @ptrCast(mapping.ptr);
+        if (@atomicLoad(u32, &header.magic, .acquire) != magic) return error.InvalidRecording;
+        if (header.version != format_version or header.header_size != header_size) return error.VersionMismatch;
+        // Bound gpu_count first: frameSize would overflow on a corrupt header
+        if (header.gpu_count > nvmon.max_gpus or header.frame_size != frameSize(header.gpu_count) or header.capacity == 0) {
+            return error.InvalidRecording;
+        }
+        if (size < header_size + @as(u64, header.capacity) * header.frame_size) return error.InvalidRecording;
+        return .{ .mapping = mapping, .header = header };
+    }
+
+    pub fn close(self: *Self) void {
+        posix.munmap(self.mapping);
+    }
+
+    pub fn writeIndex(self: *const Self) u64 {
+        return @atomicLoad(u64, &self.header.write_index, .acquire);
+    }
+
+    /// Iterate over every frame still in the ring, oldest first. The oldest
+    /// slot is skipped: it is the one the writer overwrites next.
+    pub fn frames(self: *const Self) Iterator {
+        const end = self.writeIndex();
+        return .{ .recording = self, .next_index = (end + 1) -| self.header.capacity, .end = end };
+    }
+};
+
+/// Decodes frames in order. Frames overwritten while reading a live file
+/// are skipped.
+pub const Iterator = struct {
+    recording: *const Recording,
+    next_index: u64,
+    end: u64,
+
+    pub fn next(self: *Iterator, out: *Frame) bool {
+        const header = self.recording.header;
+        while (self.next_index < self.end) {
+            const index = self.next_index;
+            self.next_index += 1;
+
+            const offset = header_size + (index % header.capacity) * header.frame_size;
+            const slot = self.recording.mapping[@intCast(offset)..][0..header.frame_size];
+            const seq_ptr: *const u32 = @ptrCast(@alignCast(slot.ptr));
+            var buf: [frameSize(nvmon.max_gpus)]u8 align(8) = undefined;
+            const raw = buf[0..header.frame_size];
+            loadFrame(raw, slot);
+
+            // Torn or lapped by the writer while copying: drop it.
+            // Once the writer reaches index + capacity it is rewriting this slot.
+            const fh = std.mem.bytesToValue(FrameHeader, raw[0..@sizeOf(FrameHeader)]);
+            const expected: u32 = @truncate(index + 1);
+            if (fh.seq != expected or @atomicLoad(u32, seq_ptr, .monotonic) != expected or
+                self.recording.writeIndex() -| index >= header.capacity)
+            {
+                continue;
+            }
+
+            out.* = .{
+                .time_ms = fh.time_ms,
+                .summary = std.mem.bytesToValue(FrameSummary, raw[@sizeOf(FrameHeader)..][0..@sizeOf(FrameSummary)]),
+                .gpu_count = header.gpu_count,
+            };
+            for (0..header.gpu_count) |i| {
+                const at = @sizeOf(FrameHeader) + @sizeOf(FrameSummary) + i * @sizeOf(GpuEntry);
+                const entry = std.mem.bytesToValue(GpuEntry, raw[at..][0..@sizeOf(GpuEntry)]);
+                out.gpus[i] = decodeGpu(&entry);
+            }
+            return true;
+        }
+        return false;
+    }
+};
+
+/// Write a recording as CSV, one row per frame
+pub fn exportCsv(rec: *const Recording, out: *std.Io.Writer) !void {
+    const gpu_count = rec.header.gpu_count;
+    try out.writeAll("time_s,frames,avg_frame_ms,max_frame_ms,stutters,max_latency_ms");
+    for (0..gpu_count) |i| {
+        try out.print(",gpu{d}_temp_c,gpu{d}_power_w,gpu{d}_clock_mhz,gpu{d}_mem_clock_mhz,gpu{d}_util,gpu{d}_mem_util,gpu{d}_fan,gpu{d}_vram_mb,gpu{d}_pstate", .{ i, i, i, i, i, i, i, i, i });
+    }
+    try out.writeAll("\n");
+
+    var it = rec.frames();
+    var frame: Frame = undefined;
+    while (it.next(&frame)) {
+        const s = frame.summary;
+        try out.print("{d:.3},{d},{d:.3},{d:.3},{d},{d:.3}", .{
+            @as(f64, @floatFromInt(frame.time_ms)) / 1000.0,
+            s.frame_count,
+            @as(f64, @floatFromInt(s.avg_frame_us)) / 1000.0,
+            @as(f64, @floatFromInt(s.max_frame_us)) / 1000.0,
+            s.stutter_count,
+            @as(f64, @floatFromInt(s.max_latency_us)) / 1000.0,
+        });
+        for (frame.gpus[0..gpu_count]) |g| {
+            try out.print(",{d},{d:.1},{d},{d},{d},{d},{d},{d},{d}", .{
+                g.temperature_c,
+                @as(f64, @floatFromInt(g.power_mw)) / 1000.0,
+                g.gpu_clock_mhz,
+                g.mem_clock_mhz,
+                g.utilization,
+                g.mem_utilization,
+                g.fan_percent,
+                g.vram_used_mb,
+                g.pstate,
+            });
+        }
+        try out.writeAll("\n");
+    }
+}
+
+test "frame layout" {
+    try std.testing.expectEqual(@as(u32, 48), frameSize(1));
+    // One GPU at 500 ms stays well under 1 MB per hour
+    try std.testing.expect(@as(u64, frameSize(1)) * 7200 < 1024 * 1024);
+}
+
+test "gpu entry round trip" {
+    var last = std.mem.zeroes(GpuEntry);
+    const mask = nvmon.Field.temperature.bit() | nvmon.Field.power_draw.bit() | nvmon.Field.gpu_clock.bit() | nvmon.Field.vram.bit();
+
+    const first = GpuSample{ .valid_mask = mask, .temperature_c = 55, .power_draw_mw = 180_000, .gpu_clock_mhz = 2520, .vram_used_mb = 6000, .pstate = 0 };
+    const a = decodeGpu(&encodeGpu(&last, &first));
+    try std.testing.expectEqual(@as(u32, 55), a.temperature_c);
+    try std.testing.expectEqual(@as(u32, 180_000), a.power_mw);
+    try std.testing.expectEqual(@as(u64, 6000), a.vram_used_mb);
+    try std.testing.expect(!a.has(.utilization));
+
+    // Large steps land in one frame; fields missing from the sample hold
+    const second = GpuSample{ .valid_mask = nvmon.Field.power_draw.bit() | nvmon.Field.utilization.bit(), .power_draw_mw = 350_000, .gpu_utilization = 100 };
+    const b = decodeGpu(&encodeGpu(&last, &second));
+    try std.testing.expectEqual(@as(u32, 55), b.temperature_c);
+    try std.testing.expectEqual(@as(u32, 350_000), b.power_mw);
+    try std.testing.expectEqual(@as(u32, 2520), b.gpu_clock_mhz);
+    try std.testing.expectEqual(@as(u32, 100), b.utilization);
+    try std.testing.expect(b.has(.utilization) and !b.has(.temperature));
+
+    // No sample at all: nothing valid, values held
+    const c = decodeGpu(&encodeGpu(&last, null));
+    try std.testing.expectEqual(@as(u32, 0), c.valid);
+    try std.testing.expectEqual(@as(u32, 350_000), c.power_mw);
+}
+
+test "ring file write and replay" {
+    var tmp = std.testing.tmpDir(.{});
+    defer tmp.cleanup();
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const dir_path = try tmp.dir.realpath(".", &path_buf);
+    var file_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const path = try std.fmt.bufPrint(&file_buf, "{s}/rec.nvpr", .{dir_path});
+
+    // 16-frame ring
+    var w = try Writer.create(path, .{ .interval_ms = 1000, .duration_s = 16 }, 1);
+    defer w.close();
+    for (0..20) |i| {
+        const sample = GpuSample{ .index = 0, .valid_mask = nvmon.Field.temperature.bit(), .temperature_c = @intCast(40 + i) };
+        w.writeFrame(&[_]GpuSample{sample}, .{ .frame_count = @intCast(i) }, w.start_ns + i * std.time.ns_per_s);
+    }
+
+    var rec = try Recording.open(path);
+    defer rec.close();
+    var it = rec.frames();
+    var frame: Frame = undefined;
+    var count: usize = 0;
+    var first_temp: u32 = 0;
+    while (it.next(&frame)) {
+        if (count == 0) first_temp = frame.gpus[0].temperature_c;
+        try std.testing.expectEqual(frame.summary.frame_count + 40, @as(u16, @intCast(frame.gpus[0].temperature_c)));
+        count += 1;
+    }
+    // Frames 5..19 are readable (slot 4 is next to be overwritten)
+    try std.testing.expectEqual(@as(usize, 15), count);
+    try std.testing.expectEqual(@as(u32, 45), first_temp);
+}
+
+test "frame accumulator" {
+    var acc = FrameAccumulator{};
+    acc.add(16_000, 30_000);
+    acc.add(17_000, 31_000);
+    const first = acc.drain();
+    try std.testing.expectEqual(@as(u16, 2), first.frame_count);
+    try std.testing.expectEqual(@as(u32, 16_500), first.avg_frame_us);
+
+    acc.add(50_000, 60_000); // > 2x the previous average
+    const second = acc.drain();
+    try std.testing.expectEqual(@as(u16, 1), second.stutter_count);
+    try std.testing.expectEqual(@as(u32, 60_000), second.max_latency_us);
+}
@@ -0,0 +1,257 @@
+//! nvmon/sampler - Background Telemetry Sampler
+//!
+//! One thread per process samples every GPU at a fixed rate and publishes the
+//! result into a per-device seqlock slot. Readers never touch NVML: `latest`
+//! is a handful of atomic loads, so HUD, exporter and scheduler threads stop
+//! contending on the NVML global lock.
+//!
+//! A process can instead attach to the nvprime daemon's shared segment
+//! (`attach`); `latest` then reads the daemon's samples and this process
+//! never needs NVML for telemetry.
+
+const std = @import("std");
+const nvmon = @import("nvmon.zig");
+const placement = @import("../nvcaps/placement.zig");
+const fans = @import("../nvpower/fans.zig");
+const autotune = @import("../nvpower/autotune.zig");
+const shm = @import("shm.zig");
+const recorder = @import("recorder.zig");
+
+const GpuSample = nvmon.GpuSample;
+const FieldMask = nvmon.FieldMask;
+
+/// Sampler configuration
+pub const Config = struct {
+    /// Sampling period
+    interval_ms: u32 = 100,
+    /// Fields sampled on every pass
+    field_mask: FieldMask = nvmon.default_fields,
+    /// Samples older than this many intervals are treated as missing
+    max_age_intervals: u32 = 4,
+};
+
+const sample_words = @sizeOf(GpuSample) / @sizeOf(u64);
+
+comptime {
+    // The seqlock copies samples as whole words
+    std.debug.assert(@sizeOf(GpuSample) % @sizeOf(u64) == 0);
+}
+
+/// Seqlock-protected copy of the newest sample for one GPU.
+/// The sequence is odd while the sampler thread is writing.
+const Slot = struct {
+    seq: std.atomic.Value(u64) align(std.atomic.cache_line) = std.atomic.Value(u64).init(0),
+    words: [sample_words]std.atomic.Value(u64) = [_]std.atomic.Value(u64){std.atomic.Value(u64).init(0)} ** sample_words,
+
+    fn publish(self: *Slot, sample: GpuSample) void {
+        const raw: [sample_words]u64 = @bitCast(sample);
+        const seq = self.seq.load(.monotonic);
+        self.seq.store(seq + 1, .monotonic);
+        // Release stores keep the odd sequence ordered before the payload
+        for (&self.words, raw) |*word, value| word.store(value, .release);
+        self.seq.store(seq + 2, .release);
+    }
+
+    fn read(self: *const Slot) ?GpuSample {
+        var attempts: usize = 0;
+        while (attempts < 64) : (attempts += 1) {
+            const before = self.seq.load(.acquire);
+            if (before == 0) return null; // never written
+            if (before & 1 != 0) {
+                std.atomic.spinLoopHint();
+                continue;
+            }
+
+            var raw: [sample_words]u64 = undefined;
+            // Acquire loads keep the second sequence read after the payload
+            for (&raw, &self.words) |*value, *word| value.* = word.load(.acquire);
+
+            if (self.seq.load(.monotonic) == before) return @bitCast(raw);
+            std.atomic.spinLoopHint();
+        }
+        return null;
+    }
+};
+
+var slots: [nvmon.max_gpus]Slot = [_]Slot{.{}} ** nvmon.max_gpus;
+var thread: ?std.Thread = null;
+var running = std.atomic.Value(bool).init(false);
+var interval_ns = std.atomic.Value(u64).init(100 * std.time.ns_per_ms);
+var field_mask = std.atomic.Value(FieldMask).init(nvmon.default_fields);
+var max_age_intervals = std.atomic.Value(u32).init(4);
+var pass_counter = std.atomic.Value(u64).init(0);
+var control_mutex: std.Thread.Mutex = .{};
+var publisher: ?*shm.Publisher = null;
+var attached = std.atomic.Value(?*const shm.Segment).init(null);
+// Stored before `attached`, so a reader that sees the segment sees its fd
+var attached_fd = std.atomic.Value(std.posix.fd_t).init(-1);
+
+/// Start the sampler thread. Does nothing if it is already running.
+pub fn start(config: Config) !void {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+
+    if (thread != null) return;
+    if (config.interval_ms == 0) return error.InvalidArgument;
+
+    interval_ns.store(@as(u64, config.interval_ms) * std.time.ns_per_ms, .monotonic);
+    field_mask.store(config.field_mask, .monotonic);
+    max_age_intervals.store(@max(config.max_age_intervals, 1), .monotonic);
+
+    // Publish one pass synchronously so readers have data as soon as we return
+    samplePass();
+
+    running.store(true, .release);
+    thread = std.Thread.spawn(.{}, run, .{}) catch |err| {
+        running.store(false, .release);
+        return err;
+    };
+}
+
+/// Stop the sampler thread and wait for it to exit
+pub fn stop() void {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+
+    const t = thread orelse return;
+    running.store(false, .release);
+    t.join();
+    thread = null;
+    // Curves have no driver without the sampler
+    fans.releaseCurves();
+}
+
+/// Also publish every pass into a shared segment (daemon mode).
+/// Must be set while the sampler is stopped.
+pub fn publishTo(target: ?*shm.Publisher) !void {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    if (thread != null) return error.AlreadyRunning;
+    publisher = target;
+}
+
+/// Read telemetry from a running daemon's segment instead of sampling here.
+/// Returns false if no live, compatible daemon segment exists.
+pub fn attach(path: []const u8) bool {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    if (attached.load(.acquire) != null) return true;
+    const reader = shm.Reader.attach(path) catch return false;
+    attached_fd.store(reader.fd, .release);
+    attached.store(reader.segment, .release);
+    return true;
+}
+
+/// Unmap the daemon segment. Call only once no thread is reading samples.
+pub fn detach() void {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    const segment = attached.swap(null, .acq_rel) orelse return;
+    (shm.Reader{ .segment = segment, .fd = attached_fd.load(.acquire) }).detach();
+}
+
+/// The attached daemon segment, if any
+pub fn attachedReader() ?shm.Reader {
+    const segment = attached.load(.acquire) orelse return null;
+    return .{ .segment = segment, .fd = attached_fd.load(.acquire) };
+}
+
+/// Whether the sampler thread is active
+pub fn isRunning() bool {
+    return running.load(.acquire);
+}
+
+/// Change the sampling period of a running sampler
+pub fn setInterval(ms: u32) void {
+    if (ms == 0) return;
+    interval_ns.store(@as(u64, ms) * std.time.ns_per_ms, .monotonic);
+}
+
+/// Change the sampled fields of a running sampler
+pub fn setFieldMask(mask: FieldMask) void {
+    field_mask.store(mask, .monotonic);
+}
+
+/// Add fields to the sampled set, running or not
+pub fn requestFields(mask: FieldMask) void {
+    _ = field_mask.fetchOr(mask, .monotonic);
+}
+
+/// Number of completed sampling passes
+pub fn passCount() u64 {
+    return pass_counter.load(.monotonic);
+}
+
+/// Newest sample for a GPU without touching NVML.
+/// Returns null when the sampler is not running or the sample is stale,
+/// in which case callers should query NVML directly.
+pub fn latest(index: u32) ?GpuSample {
+    if (index >= nvmon.max_gpus) return null;
+    if (!isRunning()) return latestAttached(index);
+    const sample = slots[index].read() orelse return null;
+
+    const max_age = interval_ns.load(.monotonic) * max_age_intervals.load(.monotonic);
+    const now = nvmon.timestampNs();
+    if (now -| sample.timestamp_ns > max_age) return null;
+    return sample;
+}
+
+/// Newest sample for a GPU, only if it carries `field`
+pub fn latestWith(index: u32, field: nvmon.Field) ?GpuSample {
+    const sample = latest(index) orelse return null;
+    return if (sample.has(field)) sample else null;
+}
+
+fn latestAttached(index: u32) ?GpuSample {
+    const reader = attachedReader() orelse return null;
+    // A stopped daemon stops refreshing timestamps, so age alone detects it
+    const sample = reader.read(index) orelse return null;
+
+    const now = nvmon.timestampNs();
+    if (now -| sample.timestamp_ns > reader.heartbeatTimeoutNs()) return null;
+    return sample;
+}
+
+fn run() void {
+    while (running.load(.acquire)) {
+        const start_ns = nvmon.timestampNs();
+        samplePass();
+
+        const elapsed = nvmon.timestampNs() -| start_ns;
+        const period = interval_ns.load(.monotonic);
+        if (elapsed < period) {
+            const remaining = period - elapsed;
+            std.posix.nanosleep(remaining / std.time.ns_per_s, remaining % std.time.ns_per_s);
+        }
+    }
+}
+
+fn samplePass() void {
+    var samples: [nvmon.max_gpus]GpuSample = undefined;
+    const n = nvmon.sampleAll(&samples, field_mask.load(.monotonic)) catch return;
+    for (samples[0..n], 0..) |sample, i| slots[i].publish(sample);
+    if (publisher) |target| target.publish(samples[0..n]);
+    placement.observe(samples[0..n]);
+    fans.observe(samples[0..n]);
+    autotune.observe(samples[0..n]);
+    recorder.observe(samples[0..n]);
+    _ = pass_counter.fetchAdd(1, .monotonic);
+}
+
+test "seqlock slot round trip" {
+    var slot = Slot{};
+    try std.testing.expect(slot.read() == null);
+
+    slot.publish(GpuSample{ .index = 3, .temperature_c = 61, .vram_total_mb = 24576 });
+    const sample = slot.read().?;
+    try std.testing.expectEqual(@as(u32, 3), sample.index);
+    try std.testing.expectEqual(@as(u32, 61), sample.temperature_c);
+    try std.testing.expectEqual(@as(u64, 24576), sample.vram_total_mb);
+    try std.testing.expectEqual(@as(u64, 2), slot.seq.load(.monotonic));
+}
+
+test "latest without sampler" {
+    try std.testing.expect(!isRunning());
+    try std.testing.expect(attachedReader() == null);
+    try std.testing.expect(latest(0) == null);
+}
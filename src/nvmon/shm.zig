@@ -0,0 +1,374 @@
+//! nvmon/shm - Shared-Memory Telemetry Segment
+//!
+//! The nvprime daemon owns NVML and publishes every sampler pass into a
+//! memory-mapped file under /dev/shm. Client processes map it read-only and
+//! read samples through the same per-GPU seqlock protocol the in-process
+//! sampler uses, so a short-lived tool or an injected HUD gets telemetry
+//! without paying for NVML initialization.
+//!
+//! The layout is versioned: readers check the magic, layout version and
+//! record sizes before trusting anything else, and fall back to NVML when the
+//! segment is missing, mismatched or its heartbeat has gone stale.
+//!
+//! The daemon holds an exclusive flock on the segment for its lifetime.
+//! Readers probe the lock rather than the recorded PID, which means nothing
+//! in another PID namespace. They also refuse segments that are not owned by
+//! themselves or root, or that anyone else can write.
+
+const std = @import("std");
+const nvmon = @import("nvmon.zig");
+const registry = @import("../nvcaps/registry.zig");
+
+const posix = std.posix;
+const GpuSample = nvmon.GpuSample;
+
+/// Default segment path
+pub const default_path = "/dev/shm/nvprime-telemetry";
+
+/// "NVPT"
+pub const magic: u32 = 0x5450564e;
+
+/// Bumped on any incompatible layout change
+pub const layout_version: u32 = 2;
+
+const sample_words = @sizeOf(GpuSample) / @sizeOf(u64);
+const slot_size = 128;
+
+/// Heartbeats older than this many sampling intervals mark the daemon as gone
+const heartbeat_intervals = 4;
+const min_heartbeat_timeout_ns = std.time.ns_per_s;
+
+/// Segment header. `magic` is written last, so a reader that sees it sees
+/// the rest of the header.
+pub const Header = extern struct {
+    magic: u32,
+    version: u32,
+    header_size: u32,
+    slot_size: u32,
+    sample_size: u32,
+    max_gpus: u32,
+    gpu_count: u32,
+    daemon_pid: i32,
+    interval_ns: u64,
+    started_ns: u64,
+    /// Time of the last published pass (same clock as sample timestamps)
+    heartbeat_ns: u64,
+    pass_count: u64,
+};
+
+/// Static identity of one GPU, written once at daemon startup
+pub const Identity = extern struct {
+    uuid: [96]u8 = [_]u8{0} ** 96,
+    pcie_bus_id: [32]u8 = [_]u8{0} ** 32,
+    name: [96]u8 = [_]u8{0} ** 96,
+    vram_total_mb: u64 = 0,
+
+    pub fn getUuid(self: *const Identity) []const u8 {
+        return std.mem.sliceTo(&self.uuid, 0);
+    }
+
+    pub fn getBusId(self: *const Identity) []const u8 {
+        return std.mem.sliceTo(&self.pcie_bus_id, 0);
+    }
+
+    pub fn getName(self: *const Identity) []const u8 {
+        return std.mem.sliceTo(&self.name, 0);
+    }
+};
+
+/// Seqlock slot, one cache line per GPU. The sequence is odd while the
+/// daemon is writing.
+pub const Slot = extern struct {
+    seq: u64,
+    words: [sample_words]u64,
+    _pad: [slot_size / 8 - 1 - sample_words]u64,
+};
+
+/// Whole mapped segment
+pub const Segment = extern struct {
+    header: Header,
+    identities: [nvmon.max_gpus]Identity,
+    slots: [nvmon.max_gpus]Slot,
+};
+
+comptime {
+    std.debug.assert(@sizeOf(GpuSample) % @sizeOf(u64) == 0);
+    std.debug.assert(@sizeOf(Slot) == slot_size);
+    std.debug.assert(@offsetOf(Segment, "slots") % std.atomic.cache_line == 0);
+}
+
+/// Writer side, owned by the daemon
+pub const Publisher = struct {
+    segment: *Segment,
+    path: []const u8,
+    /// Open for the publisher's lifetime; holds the liveness lock
+    file: std.fs.File,
+
+    const Self = @This();
+
+    /// Create (or replace) the segment at `path`. `path` must outlive the publisher.
+    /// Fails with error.DaemonRunning while another publisher holds it.
+    pub fn create(path: []const u8, interval_ns: u64) !Self {
+        if (try isLocked(path)) return error.DaemonRunning;
+
+        // Replace rather than truncate: clients still mapping an old segment
+        // keep a valid mapping and notice its heartbeat stop
+        std.fs.deleteFileAbsolute(path) catch |err| switch (err) {
+            error.FileNotFound => {},
+            else => return err,
+        };
+        const file = try std.fs.createFileAbsolute(path, .{ .read = true, .exclusive = true, .mode = 0o644 });
+        errdefer file.close();
+        errdefer std.fs.deleteFileAbsolute(path) catch {};
+        // Taken before the magic is written, so a reader that validates sees it held
+        try posix.flock(file.handle, posix.LOCK.EX | posix.LOCK.NB);
+        try file.setEndPos(@sizeOf(Segment));
+
+        const mapping = try posix.mmap(null, @sizeOf(Segment), posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, file.handle, 0);
+        const segment: *Segment = @ptrCast(@alignCast(mapping.ptr));
+        @memset(std.mem.asBytes(segment), 0);
+
+        segment.header = .{
+            .magic = 0,
+            .version = layout_version,
+            .header_size = @sizeOf(Header),
+            .slot_size = @sizeOf(Slot),
+            .sample_size = @sizeOf(GpuSample),
+            .max_gpus = nvmon.max_gpus,
+            .gpu_count = 0,
+            .daemon_pid = @intCast(std.os.linux.getpid()),
+            .interval_ns = interval_ns,
+            .started_ns = timestampNs(),
+            .heartbeat_ns = 0,
+            .pass_count = 0,
+        };
+        @atomicStore(u32, &segment.header.magic, magic, .release);
+        return .{ .segment = segment, .path = path, .file = file };
+    }
+
+    /// Unmap and remove the segment
+    pub fn close(self: *Self) void {
+        @atomicStore(u64, &self.segment.header.heartbeat_ns, 0, .release);
+        unmap(self.segment);
+        std.fs.deleteFileAbsolute(self.path) catch {};
+        self.file.close();
+    }
+
+    /// Record a GPU's identity. Call before the first `publish`.
+    pub fn setIdentity(self: *Self, index: u32, identity: Identity) void {
+        if (index >= nvmon.max_gpus) return;
+        self.segment.identities[index] = identity;
+        const count = @max(self.segment.header.gpu_count, index + 1);
+        @atomicStore(u32, &self.segment.header.gpu_count, count, .release);
+    }
+
+    /// Publish one sampler pass and bump the heartbeat
+    pub fn publish(self: *Self, samples: []const GpuSample) void {
+        for (samples) |sample| {
+            if (sample.index >= nvmon.max_gpus) continue;
+            writeSlot(&self.segment.slots[sample.index], sample);
+        }
+        const passes = self.segment.header.pass_count + 1;
+        @atomicStore(u64, &self.segment.header.pass_count, passes, .release);
+        @atomicStore(u64, &self.segment.header.heartbeat_ns, timestampNs(), .release);
+    }
+};
+
+/// Read-only client view of a daemon's segment
+pub const Reader = struct {
+    segment: *const Segment,
+    /// Segment file, kept open to probe the daemon's lock
+    fd: posix.fd_t,
+
+    const Self = @This();
+
+    /// Map the segment at `path`. Fails if it does not exist, is not owned
+    /// by this user or root, was written by an incompatible version, or its
+    /// daemon has exited.
+    pub fn attach(path: []const u8) !Self {
+        const file = try std.fs.openFileAbsolute(path, .{});
+        errdefer file.close();
+        const stat = try posix.fstat(file.handle);
+        if (!isTrusted(stat)) return error.UntrustedSegment;
+        if (stat.size < @sizeOf(Segment)) return error.InvalidSegment;
+
+        const mapping = try posix.mmap(null, @sizeOf(Segment), posix.PROT.READ, .{ .TYPE = .SHARED }, file.handle, 0);
+        const self = Self{ .segment = @ptrCast(@alignCast(mapping.ptr)), .fd = file.handle };
+        errdefer unmap(self.segment);
+
+        try self.validate();
+        if (!self.isAlive()) return error.DaemonNotRunning;
+        return self;
+    }
+
+    pub fn detach(self: Self) void {
+        unmap(self.segment);
+        posix.close(self.fd);
+    }
+
+    fn validate(self: Self) !void {
+        const header = &self.segment.header;
+        if (@atomicLoad(u32, &header.magic, .acquire) != magic) return error.InvalidSegment;
+        if (header.version != layout_version) return error.VersionMismatch;
+        if (header.header_size != @sizeOf(Header) or header.slot_size != @sizeOf(Slot) or
+            header.sample_size != @sizeOf(GpuSample) or header.max_gpus != nvmon.max_gpus)
+        {
+            return error.VersionMismatch;
+        }
+    }
+
+    /// Whether the daemon is still publishing
+    pub fn isAlive(self: Self) bool {
+        const header = &self.segment.header;
+        const heartbeat = @atomicLoad(u64, &header.heartbeat_ns, .acquire);
+        if (heartbeat == 0) return false;
+        if (timestampNs() -| heartbeat > self.heartbeatTimeoutNs()) return false;
+        return holdsLock(self.fd);
+    }
+
+    pub fn heartbeatTimeoutNs(self: Self) u64 {
+        return @max(self.segment.header.interval_ns * heartbeat_intervals, min_heartbeat_timeout_ns);
+    }
+
+    pub fn intervalNs(self: Self) u64 {
+        return self.segment.header.interval_ns;
+    }
+
+    /// PID in the daemon's namespace; for display only
+    pub fn daemonPid(self: Self) i32 {
+        return self.segment.header.daemon_pid;
+    }
+
+    pub fn gpuCount(self: Self) u32 {
+        return @min(@atomicLoad(u32, &self.segment.header.gpu_count, .acquire), nvmon.max_gpus);
+    }
+
+    pub fn identity(self: Self, index: u32) ?*const Identity {
+        if (index >= self.gpuCount()) return null;
+        return &self.segment.identities[index];
+    }
+
+    pub fn findByUuid(self: Self, uuid: []const u8) ?u32 {
+        for (0..self.gpuCount()) |i| {
+            if (std.mem.eql(u8, self.segment.identities[i].getUuid(), uuid)) return @intCast(i);
+        }
+        return null;
+    }
+
+    /// Accepts both NVML and sysfs bus ID forms
+    pub fn findByBusId(self: Self, bus_id: []const u8) ?u32 {
+        var buf: [32]u8 = undefined;
+        var other: [32]u8 = undefined;
+        const canonical = registry.canonicalBusId(bus_id, &buf) orelse return null;
+        for (0..self.gpuCount()) |i| {
+            const id = registry.canonicalBusId(self.segment.identities[i].getBusId(), &other) orelse continue;
+            if (std.mem.eql(u8, id, canonical)) return @intCast(i);
+        }
+        return null;
+    }
+
+    /// Newest sample for a GPU, or null if none was published
+    pub fn read(self: Self, index: u32) ?GpuSample {
+        if (index >= nvmon.max_gpus) return null;
+        return readSlot(&self.segment.slots[index]);
+    }
+};
+
+fn writeSlot(slot: *Slot, sample: GpuSample) void {
+    const raw: [sample_words]u64 = @bitCast(sample);
+    const seq = slot.seq;
+    @atomicStore(u64, &slot.seq, seq + 1, .monotonic);
+    // Release stores keep the odd sequence ordered before the payload
+    for (&slot.words, raw) |*word, value| @atomicStore(u64, word, value, .release);
+    @atomicStore(u64, &slot.seq, seq + 2, .release);
+}
+
+fn readSlot(slot: *const Slot) ?GpuSample {
+    var attempts: usize = 0;
+    while (attempts < 64) : (attempts += 1) {
+        const before = @atomicLoad(u64, &slot.seq, .acquire);
+        if (before == 0) return null; // never written
+        if (before & 1 != 0) {
+            std.atomic.spinLoopHint();
+            continue;
+        }
+
+        var raw: [sample_words]u64 = undefined;
+        // Acquire loads keep the second sequence read after the payload
+        for (&raw, &slot.words) |*value, *word| value.* = @atomicLoad(u64, word, .acquire);
+
+        if (@atomicLoad(u64, &slot.seq, .monotonic) == before) return @bitCast(raw);
+        std.atomic.spinLoopHint();
+    }
+    return null;
+}
+
+/// Whether a live publisher holds the lock on `fd`'s segment
+pub fn holdsLock(fd: posix.fd_t) bool {
+    posix.flock(fd, posix.LOCK.SH | posix.LOCK.NB) catch |err| return err == error.WouldBlock;
+    posix.flock(fd, posix.LOCK.UN) catch {};
+    return false;
+}
+
+/// Whether another publisher holds the segment at `path`
+pub fn isLocked(path: []const u8) !bool {
+    const file = std.fs.openFileAbsolute(path, .{}) catch |err| switch (err) {
+        error.FileNotFound => return false,
+        else => return err,
+    };
+    defer file.close();
+    // A reader's probe holds a shared lock for an instant; look twice
+    for (0..2) |_| {
+        if (!holdsLock(file.handle)) return false;
+        std.Thread.sleep(std.time.ns_per_ms);
+    }
+    return holdsLock(file.handle);
+}
+
+/// Owned by this user or root, and writable by no one else
+pub fn isTrusted(stat: posix.Stat) bool {
+    const uid = std.os.linux.geteuid();
+    if (stat.uid != uid and stat.uid != 0) return false;
+    return stat.mode & 0o022 == 0;
+}
+
+fn unmap(segment: *const Segment) void {
+    const bytes: [*]align(std.heap.page_size_min) const u8 = @ptrCast(@alignCast(segment));
+    posix.munmap(bytes[0..@sizeOf(Segment)]);
+}
+
+const timestampNs = nvmon.timestampNs;
+
+test "segment layout" {
+    try std.testing.expectEqual(@as(usize, 64), @sizeOf(Header));
+    try std.testing.expectEqual(@as(usize, 128), @sizeOf(Slot));
+}
+
+test "publish and attach" {
+    var path_buf: [64]u8 = undefined;
+    const path = try std.fmt.bufPrint(&path_buf, "/dev/shm/nvprime-test-{d}", .{std.os.linux.getpid()});
+
+    var publisher = Publisher.create(path, 100 * std.time.ns_per_ms) catch return error.SkipZigTest;
+    defer publisher.close();
+
+    // Nothing published yet: no heartbeat
+    try std.testing.expectError(error.DaemonNotRunning, Reader.attach(path));
+
+    var id = Identity{ .vram_total_mb = 24576 };
+    @memcpy(id.uuid[0..8], "GPU-test");
+    @memcpy(id.pcie_bus_id[0..16], "00000000:01:00.0");
+    publisher.setIdentity(0, id);
+    publisher.publish(&[_]GpuSample{.{ .index = 0, .timestamp_ns = timestampNs(), .temperature_c = 57 }});
+
+    const reader = try Reader.attach(path);
+    defer reader.detach();
+    try std.testing.expect(reader.isAlive());
+    try std.testing.expectEqual(@as(u32, 1), reader.gpuCount());
+    try std.testing.expectEqual(@as(?u32, 0), reader.findByUuid("GPU-test"));
+    try std.testing.expectEqual(@as(?u32, 0), reader.findByBusId("0000:01:00.0"));
+    try std.testing.expectEqual(@as(u32, 57), reader.read(0).?.temperature_c);
+    try std.testing.expect(reader.read(1) == null);
+
+    // A second daemon may not replace a live segment
+    try std.testing.expectError(error.DaemonRunning, Publisher.create(path, 100 * std.time.ns_per_ms));
+}
@@ -0,0 +1,354 @@
+//! nvmon/trace - Hot-Path Tracing
+//!
+//! Spans, instants and counters recorded into per-thread ring buffers and
+//! exported as Chrome trace JSON, which Perfetto and chrome://tracing load
+//! directly. Recording is compiled in with -Dtrace=true; otherwise every
+//! call folds away, clock reads included. A TimedSpan keeps its clock reads
+//! either way, for call sites that use it as their timer.
+//!
+//! Events carrying a frame ID are linked into one flow in the viewer. IDs
+//! come from a single counter: the stage that starts a frame (Reflex
+//! simulation start, or primetime when it presents) takes one with
+//! `beginFrame`, and later stages pick it up through `currentFrame`
+//! (nvstream capture, encode and send), so a frame can be followed from
+//! simulation to present to the network on one timeline.
+//!
+//! Each thread writes only its own buffer: one relaxed load to check that
+//! recording is on, a slot store and a release store of the head. Buffers
+//! wrap, keeping the most recent `events_per_thread` events. `reset` only
+//! posts a request; each owner thread empties its buffer on its next event.
+
+const std = @import("std");
+const build_options = @import("build_options");
+
+/// Whether tracing was compiled in (-Dtrace)
+pub const enabled = build_options.trace;
+
+/// Events kept per thread before the oldest are overwritten
+pub const events_per_thread = 8192;
+
+/// Threads that can record; later threads are ignored
+pub const max_threads = 64;
+
+pub const Category = enum(u8) {
+    primetime,
+    nvstream,
+    nvdlss,
+    nvlatency,
+    nvmon,
+};
+
+const Kind = enum(u8) {
+    span,
+    instant,
+    counter,
+};
+
+const Event = struct {
+    name: [*:0]const u8,
+    ts_ns: u64,
+    dur_ns: u64,
+    frame: u64,
+    value: f64,
+    category: Category,
+    kind: Kind,
+};
+
+const ThreadBuffer = struct {
+    tid: std.Thread.Id,
+    name: ?[*:0]const u8 = null,
+    /// Events written so far; event n lives in slot n % events_per_thread
+    head: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    /// Last reset the owner applied; the buffer counts as empty until it
+    /// catches up with `reset_epoch`
+    epoch: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    events: [events_per_thread]Event = undefined,
+
+    fn push(self: *ThreadBuffer, event: Event) void {
+        var head = self.head.load(.monotonic);
+        const requested = reset_epoch.load(.monotonic);
+        if (self.epoch.load(.monotonic) != requested) {
+            head = 0;
+            self.head.store(0, .monotonic);
+            self.epoch.store(requested, .release);
+        }
+        self.events[head % events_per_thread] = event;
+        self.head.store(head + 1, .release);
+    }
+
+    /// Events visible to an exporter (0 while a reset is pending)
+    fn visibleHead(self: *const ThreadBuffer) u64 {
+        if (self.epoch.load(.acquire) != reset_epoch.load(.acquire)) return 0;
+        return self.head.load(.acquire);
+    }
+};
+
+var buffers: [max_threads]std.atomic.Value(?*ThreadBuffer) = [_]std.atomic.Value(?*ThreadBuffer){std.atomic.Value(?*ThreadBuffer).init(null)} ** max_threads;
+var buffer_count = std.atomic.Value(u32).init(0);
+var active = std.atomic.Value(bool).init(false);
+var current_frame = std.atomic.Value(u64).init(0);
+var reset_epoch = std.atomic.Value(u64).init(0);
+
+threadlocal var local_buffer: ?*ThreadBuffer = null;
+threadlocal var local_failed: bool = false;
+
+/// This thread's buffer, created on first use
+fn threadBuffer() ?*ThreadBuffer {
+    if (local_buffer) |buf| return buf;
+    if (local_failed) return null;
+
+    const slot = buffer_count.fetchAdd(1, .monotonic);
+    if (slot >= max_threads) {
+        local_failed = true;
+        return null;
+    }
+    // Buffers outlive their threads so a dump still shows them
+    const buf = std.heap.page_allocator.create(ThreadBuffer) catch {
+        local_failed = true;
+        return null;
+    };
+    buf.* = .{ .tid = std.Thread.getCurrentId() };
+    buffers[slot].store(buf, .release);
+    local_buffer = buf;
+    return buf;
+}
+
+inline fn record(event: Event) void {
+    if (!enabled) return;
+    if (!active.load(.monotonic)) return;
+    const buf = threadBuffer() orelse return;
+    buf.push(event);
+}
+
+/// Trace clock (CLOCK_MONOTONIC_RAW, same as the frame pacer)
+pub fn now() u64 {
+    const ts = std.posix.clock_gettime(.MONOTONIC_RAW) catch return 0;
+    return @as(u64, @intCast(ts.sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.nsec));
+}
+
+/// Start recording events
+pub fn start() void {
+    active.store(true, .release);
+}
+
+/// Stop recording; buffers keep their events until `reset`
+pub fn stop() void {
+    active.store(false, .release);
+}
+
+pub fn isActive() bool {
+    return enabled and active.load(.monotonic);
+}
+
+/// Drop all recorded events. Exports see every buffer empty at once; each
+/// thread rewinds its own buffer on its next event.
+pub fn reset() void {
+    _ = reset_epoch.fetchAdd(1, .acq_rel);
+}
+
+/// Name the calling thread in exported traces
+pub fn setThreadName(comptime name: [:0]const u8) void {
+    if (!enabled) return;
+    const buf = threadBuffer() orelse return;
+    buf.name = name.ptr;
+}
+
+/// Start a new frame: take the next frame ID and publish it as the one in
+/// flight. Returns the ID (0 when tracing is compiled out).
+pub fn beginFrame() u64 {
+    if (!enabled) return 0;
+    return current_frame.fetchAdd(1, .monotonic) + 1;
+}
+
+/// Frame most recently started with `beginFrame` (0 when tracing is compiled out)
+pub fn currentFrame() u64 {
+    if (!enabled) return 0;
+    return current_frame.load(.monotonic);
+}
+
+/// A traced region; `end` records it. Free when tracing is compiled out.
+pub const Span = struct {
+    start_ns: u64,
+    frame: u64,
+    name: [*:0]const u8,
+    category: Category,
+
+    pub fn end(self: Span) void {
+        if (!enabled) return;
+        complete(self.category, self.name, self.frame, self.start_ns, now());
+    }
+};
+
+/// A traced region that also times itself; `end` returns its duration
+/// whether or not tracing is compiled in
+pub const TimedSpan = struct {
+    start_ns: u64,
+    frame: u64,
+    name: [*:0]const u8,
+    category: Category,
+
+    pub fn end(self: TimedSpan) u64 {
+        const end_ns = now();
+        complete(self.category, self.name, self.frame, self.start_ns, end_ns);
+        return end_ns -| self.start_ns;
+    }
+};
+
+/// Open a span. `frame` links it to other events of the same frame (0 = none).
+pub fn begin(comptime category: Category, comptime name: [:0]const u8, frame: u64) Span {
+    return .{ .start_ns = if (enabled) now() else 0, .frame = frame, .name = name.ptr, .category = category };
+}
+
+/// Open a span whose duration the caller needs
+pub fn beginTimed(comptime category: Category, comptime name: [:0]const u8, frame: u64) TimedSpan {
+    return .{ .start_ns = now(), .frame = frame, .name = name.ptr, .category = category };
+}
+
+/// Record a span whose timestamps were already taken (trace clock)
+pub fn complete(category: Category, name: [*:0]const u8, frame: u64, start_ns: u64, end_ns: u64) void {
+    if (!enabled or start_ns == 0 or end_ns < start_ns) return;
+    record(.{ .name = name, .ts_ns = start_ns, .dur_ns = end_ns - start_ns, .frame = frame, .value = 0, .category = category, .kind = .span });
+}
+
+/// Record a point in time
+pub fn instant(comptime category: Category, comptime name: [:0]const u8, frame: u64) void {
+    instantAt(category, name, frame, if (enabled) now() else 0);
+}
+
+/// Record a point in time that was already measured (trace clock)
+pub fn instantAt(comptime category: Category, comptime name: [:0]const u8, frame: u64, ts_ns: u64) void {
+    record(.{ .name = name.ptr, .ts_ns = ts_ns, .dur_ns = 0, .frame = frame, .value = 0, .category = category, .kind = .instant });
+}
+
+/// Record a counter sample
+pub fn counter(comptime category: Category, comptime name: [:0]const u8, value: f64) void {
+    record(.{ .name = name.ptr, .ts_ns = if (enabled) now() else 0, .dur_ns = 0, .frame = 0, .value = value, .category = category, .kind = .counter });
+}
+
+// ============================================================================
+// Export
+// ============================================================================
+
+fn writeTimestamp(out: *std.Io.Writer, ns: u64) !void {
+    // Chrome trace timestamps are microseconds
+    try out.print("{d}.{d:0>3}", .{ ns / std.time.ns_per_us, ns % std.time.ns_per_us });
+}
+
+fn writeEvent(out: *std.Io.Writer, pid: std.posix.pid_t, tid: std.Thread.Id, event: *const Event) !void {
+    try out.print("{{\"name\":\"{s}\",\"cat\":\"{s}\",\"pid\":{d},\"tid\":{d},\"ts\":", .{
+        event.name,
+        @tagName(event.category),
+        pid,
+        tid,
+    });
+    try writeTimestamp(out, event.ts_ns);
+    switch (event.kind) {
+        .span => {
+            try out.writeAll(",\"ph\":\"X\",\"dur\":");
+            try writeTimestamp(out, event.dur_ns);
+        },
+        .instant => try out.writeAll(",\"ph\":\"i\",\"s\":\"t\""),
+        .counter => {
+            try out.print(",\"ph\":\"C\",\"args\":{{\"value\":{d}}}}}", .{event.value});
+            return;
+        },
+    }
+    if (event.frame != 0) {
+        // Slices sharing a bind_id are drawn as one flow
+        try out.print(",\"args\":{{\"frame\":{d}}},\"bind_id\":\"frame-{d}\",\"flow_in\":true,\"flow_out\":true", .{ event.frame, event.frame });
+    }
+    try out.writeAll("}");
+}
+
+/// Write every buffered event as Chrome trace JSON. Call after `stop` for
+/// a consistent snapshot; events written during the export may be torn.
+pub fn writeChromeJson(out: *std.Io.Writer) !void {
+    const pid = std.os.linux.getpid();
+    try out.writeAll("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    var first = true;
+    const count = @min(buffer_count.load(.acquire), max_threads);
+    for (buffers[0..count]) |*slot| {
+        const buf = slot.load(.acquire) orelse continue;
+        if (buf.name) |name| {
+            try out.writeAll(if (first) "\n" else ",\n");
+            first = false;
+            try out.print("{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{d},\"tid\":{d},\"args\":{{\"name\":\"{s}\"}}}}", .{ pid, buf.tid, name });
+        }
+
+        const head = buf.visibleHead();
+        var i = head -| events_per_thread;
+        while (i < head) : (i += 1) {
+            try out.writeAll(if (first) "\n" else ",\n");
+            first = false;
+            try writeEvent(out, pid, buf.tid, &buf.events[i % events_per_thread]);
+        }
+    }
+    try out.writeAll("\n]}\n");
+}
+
+/// Stop recording and write the trace to `path`
+pub fn dumpToFile(path: []const u8) !void {
+    stop();
+    const file = try std.fs.cwd().createFile(path, .{});
+    defer file.close();
+    var buf: [16 * 1024]u8 = undefined;
+    var writer = file.writer(&buf);
+    try writeChromeJson(&writer.interface);
+    try writer.interface.flush();
+}
+
+test "timed span reports duration with tracing compiled out" {
+    const span = beginTimed(.nvmon, "test", 0);
+    std.Thread.sleep(std.time.ns_per_ms);
+    try std.testing.expect(span.end() >= std.time.ns_per_ms);
+    // Plain spans skip the clock entirely
+    if (!enabled) try std.testing.expectEqual(@as(u64, 0), begin(.nvmon, "test", 0).start_ns);
+}
+
+test "reset empties buffers without touching them" {
+    if (!enabled) return error.SkipZigTest;
+    start();
+    defer stop();
+    instantAt(.nvmon, "before", 0, 1_000);
+    const buf = threadBuffer().?;
+    try std.testing.expect(buf.visibleHead() > 0);
+
+    reset();
+    try std.testing.expectEqual(@as(u64, 0), buf.visibleHead());
+    instantAt(.nvmon, "after", 0, 2_000);
+    try std.testing.expectEqual(@as(u64, 1), buf.visibleHead());
+    reset();
+}
+
+test "frame ids come from one counter" {
+    if (!enabled) return error.SkipZigTest;
+    const a = beginFrame();
+    const b = beginFrame();
+    try std.testing.expectEqual(a + 1, b);
+    try std.testing.expectEqual(b, currentFrame());
+}
+
+test "chrome json export" {
+    if (!enabled) return error.SkipZigTest;
+    reset();
+    start();
+    setThreadName("test-main");
+    complete(.primetime, "cpu", 7, 1_000, 3_500);
+    instantAt(.primetime, "present", 7, 4_000);
+    counter(.nvstream, "bitrate_kbps", 20000);
+    stop();
+
+    var buf: [4096]u8 = undefined;
+    var out = std.Io.Writer.fixed(&buf);
+    try writeChromeJson(&out);
+    const json = out.buffered();
+    try std.testing.expect(std.mem.indexOf(u8, json, "\"name\":\"cpu\"") != null);
+    try std.testing.expect(std.mem.indexOf(u8, json, "\"ts\":1.000,\"ph\":\"X\",\"dur\":2.500") != null);
+    try std.testing.expect(std.mem.indexOf(u8, json, "\"bind_id\":\"frame-7\"") != null);
+    try std.testing.expect(std.mem.indexOf(u8, json, "\"thread_name\"") != null);
+
+    const parsed = try std.json.parseFromSlice(std.json.Value, std.testing.allocator, json, .{});
+    defer parsed.deinit();
+    reset();
+}
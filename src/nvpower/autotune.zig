@@ -0,0 +1,608 @@
+//! nvpower/autotune - Perf-per-Watt Auto-Tuner
+//!
+//! Learns how a game's frame rate scales with power while it runs. The
+//! tuner steps a level (percent of the default power limit and of the
+//! maximum graphics clock) down from 100%, measures FPS and board power at
+//! each step, and stops once the FPS floor is crossed. It then holds the
+//! knee of the resulting curve: the best FPS per watt that still clears
+//! the floor with some headroom. If a heavier scene drops FPS below the
+//! floor while holding, it backs off a step at a time, and steps back
+//! toward the knee once the scene is no heavier than during the sweep.
+//! Measurements taken while holding never replace swept points.
+//!
+//! Curves are cached per executable, so the next launch goes straight to
+//! the operating point. The loop runs on the nvmon sampler (power draw) and
+//! counts frames reported through `recordFrame`; settings are applied
+//! through tuning transactions, so neither thread waits on NVML writes.
+
+const std = @import("std");
+const nvml = @import("../bindings/nvml.zig");
+const nvcaps = @import("../nvcaps/nvcaps.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvmon = @import("../nvmon/nvmon.zig");
+const tuning = @import("../nvcore/tuning.zig");
+const clocks = @import("../nvcore/clocks.zig");
+
+pub const Config = struct {
+    /// Lowest acceptable average FPS
+    fps_floor: f32 = 60,
+    /// Margin kept above the floor when picking the operating point
+    headroom_percent: u32 = 5,
+    /// Sweep range and step (percent of default power limit and max clock)
+    max_level: u32 = 100,
+    min_level: u32 = 50,
+    level_step: u32 = 5,
+    /// Time for clocks and power to settle after a change
+    settle_ms: u32 = 2000,
+    /// Length of one measurement
+    measure_ms: u32 = 3000,
+
+    /// Floor plus headroom
+    pub fn minFps(self: Config) f32 {
+        return self.fps_floor * @as(f32, @floatFromInt(100 + self.headroom_percent)) / 100.0;
+    }
+
+    pub fn validate(self: Config) !void {
+        if (self.fps_floor <= 0 or self.level_step == 0 or self.measure_ms == 0) return error.InvalidArgument;
+        if (self.min_level == 0 or self.min_level > self.max_level or self.max_level > 100) return error.InvalidArgument;
+    }
+};
+
+/// One measured point of the curve
+pub const Point = struct {
+    level: u32,
+    fps: f32,
+    watts: f32,
+
+    pub fn fpsPerWatt(self: Point) f32 {
+        return if (self.watts > 0) self.fps / self.watts else 0;
+    }
+};
+
+pub const max_points = 32;
+
+/// Measurements by level, highest level first
+pub const Curve = struct {
+    points: [max_points]Point = undefined,
+    len: usize = 0,
+
+    pub fn slice(self: *const Curve) []const Point {
+        return self.points[0..self.len];
+    }
+
+    pub fn at(self: *const Curve, level: u32) ?Point {
+        for (self.slice()) |p| {
+            if (p.level == level) return p;
+        }
+        return null;
+    }
+
+    /// Add a measurement, replacing an earlier one at the same level
+    pub fn record(self: *Curve, point: Point) void {
+        var i: usize = 0;
+        while (i < self.len and self.points[i].level > point.level) i += 1;
+        if (i < self.len and self.points[i].level == point.level) {
+            self.points[i] = point;
+            return;
+        }
+        if (self.len == max_points) return;
+        std.mem.copyBackwards(Point, self.points[i + 1 .. self.len + 1], self.points[i..self.len]);
+        self.points[i] = point;
+        self.len += 1;
+    }
+
+    /// Operating point: the best FPS per watt among points that clear the
+    /// floor with headroom (the higher level wins a tie)
+    pub fn knee(self: *const Curve, config: Config) ?Point {
+        const min_fps = config.minFps();
+        var best: ?Point = null;
+        for (self.slice()) |p| {
+            if (p.fps < min_fps) continue;
+            if (best == null or p.fpsPerWatt() > best.?.fpsPerWatt()) best = p;
+        }
+        return best;
+    }
+};
+
+pub const Phase = enum {
+    /// Stepping down and measuring
+    sweeping,
+    /// Holding the knee
+    holding,
+};
+
+/// The tuning loop, fed with frame counts and power samples
+pub const Tuner = struct {
+    config: Config,
+    curve: Curve = .{},
+    phase: Phase = .sweeping,
+    level: u32,
+    /// Level held once the sweep is done; `level` is above it while backed off
+    knee_level: u32,
+    /// When `level` was last changed (0 = not started)
+    changed_ns: u64 = 0,
+    window: ?Window = null,
+
+    const Window = struct {
+        start_ns: u64,
+        start_frames: u64,
+        power_sum: f64 = 0,
+        power_count: u32 = 0,
+    };
+
+    pub fn init(config: Config) Tuner {
+        return .{ .config = config, .level = config.max_level, .knee_level = config.max_level };
+    }
+
+    /// Continue from a cached curve: hold its knee without sweeping again
+    pub fn resumeFrom(config: Config, curve: Curve) Tuner {
+        var tuner = init(config);
+        tuner.curve = curve;
+        if (curve.knee(config)) |k| {
+            tuner.phase = .holding;
+            tuner.knee_level = std.math.clamp(k.level, config.min_level, config.max_level);
+            tuner.level = tuner.knee_level;
+        }
+        return tuner;
+    }
+
+    /// Advance with the total frames presented so far and the current power
+    /// draw. Returns the level to apply when it changes.
+    pub fn step(self: *Tuner, now_ns: u64, frames: u64, power_w: ?f32) ?u32 {
+        if (self.changed_ns == 0) self.changed_ns = now_ns;
+        if (now_ns -| self.changed_ns < @as(u64, self.config.settle_ms) * std.time.ns_per_ms) return null;
+
+        const window = if (self.window) |*w| w else {
+            self.window = .{ .start_ns = now_ns, .start_frames = frames };
+            return null;
+        };
+        if (power_w) |p| {
+            window.power_sum += p;
+            window.power_count += 1;
+        }
+        const elapsed_ns = now_ns -| window.start_ns;
+        if (elapsed_ns < @as(u64, self.config.measure_ms) * std.time.ns_per_ms) return null;
+
+        const frame_delta = frames -| window.start_frames;
+        const power_count = window.power_count;
+        const power_sum = window.power_sum;
+        self.window = null;
+        // Paused game or no power telemetry: measure again
+        if (frame_delta == 0 or power_count == 0) return null;
+
+        const elapsed_s = @as(f32, @floatFromInt(elapsed_ns)) / std.time.ns_per_s;
+        return self.decide(now_ns, .{
+            .level = self.level,
+            .fps = @as(f32, @floatFromInt(frame_delta)) / elapsed_s,
+            .watts = @floatCast(power_sum / @as(f64, @floatFromInt(power_count))),
+        });
+    }
+
+    fn decide(self: *Tuner, now_ns: u64, point: Point) ?u32 {
+        const cfg = self.config;
+        switch (self.phase) {
+            .sweeping => {
+                self.curve.record(point);
+                if (point.fps >= cfg.fps_floor and self.level > cfg.min_level) {
+                    return self.changeTo(now_ns, @max(self.level -| cfg.level_step, cfg.min_level));
+                }
+                self.phase = .holding;
+                self.knee_level = if (self.curve.knee(cfg)) |k| k.level else cfg.max_level;
+                return self.changeTo(now_ns, self.knee_level);
+            },
+            .holding => {
+                // The scene got heavier: back off one step
+                if (point.fps < cfg.fps_floor) {
+                    if (self.level >= cfg.max_level) return null;
+                    return self.changeTo(now_ns, @min(self.level + cfg.level_step, cfg.max_level));
+                }
+                if (self.level > self.knee_level and self.sceneRecovered(point)) {
+                    return self.changeTo(now_ns, @max(self.level -| cfg.level_step, self.knee_level));
+                }
+                return null;
+            },
+        }
+    }
+
+    /// Whether a backed-off level renders at least as fast as it did during
+    /// the sweep (less the headroom), so the step below should clear the
+    /// floor again
+    fn sceneRecovered(self: *const Tuner, point: Point) bool {
+        const headroom = @as(f32, @floatFromInt(100 - @min(self.config.headroom_percent, 100))) / 100.0;
+        const swept = self.curve.at(point.level) orelse {
+            // Not swept (a cached curve from a lower max_level): demand twice the headroom
+            return point.fps >= self.config.minFps() * (2.0 - headroom);
+        };
+        return point.fps >= swept.fps * headroom;
+    }
+
+    fn changeTo(self: *Tuner, now_ns: u64, level: u32) ?u32 {
+        if (level == self.level) return null;
+        self.level = level;
+        self.changed_ns = now_ns;
+        return level;
+    }
+};
+
+/// Power limit and clock cap for a level
+pub fn levelTransaction(device_index: u32, level: u32) tuning.Transaction {
+    var tx = tuning.Transaction.init(device_index);
+    tx.power_limit = .{ .percent = level };
+    tx.gpu_lock = if (level >= 100) .reset else .{ .max_percent = level };
+    return tx;
+}
+
+// ============================================================================
+// Curve cache
+// ============================================================================
+
+const cache_magic = "nvprime-autotune 1";
+
+/// Cache file of an executable: $XDG_CACHE_HOME/nvprime/autotune/<exe>.curve
+pub fn cachePath(buf: []u8, exe_name: []const u8) ![]const u8 {
+    var name_buf: [64]u8 = undefined;
+    const name = sanitizeName(&name_buf, exe_name);
+    if (name.len == 0) return error.InvalidArgument;
+    if (std.posix.getenv("XDG_CACHE_HOME")) |dir| {
+        return std.fmt.bufPrint(buf, "{s}/nvprime/autotune/{s}.curve", .{ dir, name });
+    }
+    const home = std.posix.getenv("HOME") orelse return error.NotFound;
+    return std.fmt.bufPrint(buf, "{s}/.cache/nvprime/autotune/{s}.curve", .{ home, name });
+}
+
+/// Basename of an executable path, restricted to [A-Za-z0-9._-]
+fn sanitizeName(buf: []u8, exe_name: []const u8) []const u8 {
+    const base = std.fs.path.basename(exe_name);
+    const len = @min(base.len, buf.len);
+    for (base[0..len], buf[0..len]) |ch, *out| {
+        out.* = if (std.ascii.isAlphanumeric(ch) or ch == '.' or ch == '-' or ch == '_') ch else '_';
+    }
+    return buf[0..len];
+}
+
+pub fn writeCurve(out: *std.Io.Writer, curve: *const Curve, gpu_name: []const u8) !void {
+    try out.print("{s}\ngpu {s}\n", .{ cache_magic, gpu_name });
+    for (curve.slice()) |p| try out.print("point {d} {d:.2} {d:.2}\n", .{ p.level, p.fps, p.watts });
+}
+
+/// Parse a cached curve; null if it is malformed or from another GPU model
+pub fn parseCurve(text: []const u8, gpu_name: []const u8) ?Curve {
+    var lines = std.mem.tokenizeScalar(u8, text, '\n');
+    if (!std.mem.eql(u8, lines.next() orelse return null, cache_magic)) return null;
+    const gpu_line = lines.next() orelse return null;
+    if (!std.mem.startsWith(u8, gpu_line, "gpu ") or !std.mem.eql(u8, gpu_line[4..], gpu_name)) return null;
+
+    var curve = Curve{};
+    while (lines.next()) |line| {
+        var fields = std.mem.tokenizeScalar(u8, line, ' ');
+        if (!std.mem.eql(u8, fields.next() orelse continue, "point")) continue;
+        const level = std.fmt.parseInt(u32, fields.next() orelse return null, 10) catch return null;
+        const fps = std.fmt.parseFloat(f32, fields.next() orelse return null) catch return null;
+        const watts = std.fmt.parseFloat(f32, fields.next() orelse return null) catch return null;
+        curve.record(.{ .level = level, .fps = fps, .watts = watts });
+    }
+    return curve;
+}
+
+pub fn loadCurve(exe_name: []const u8, gpu_name: []const u8) ?Curve {
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const path = cachePath(&path_buf, exe_name) catch return null;
+    var buf: [4096]u8 = undefined;
+    const text = std.fs.cwd().readFile(path, &buf) catch return null;
+    return parseCurve(text, gpu_name);
+}
+
+pub fn saveCurve(exe_name: []const u8, gpu_name: []const u8, curve: *const Curve) !void {
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const path = try cachePath(&path_buf, exe_name);
+    if (std.fs.path.dirname(path)) |dir| try std.fs.cwd().makePath(dir);
+
+    // Write a temporary file and rename it so a crash never leaves half a curve
+    var tmp_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const tmp_path = try std.fmt.bufPrint(&tmp_buf, "{s}.tmp", .{path});
+    {
+        const file = try std.fs.cwd().createFile(tmp_path, .{});
+        defer file.close();
+        var buf: [4096]u8 = undefined;
+        var writer = file.writer(&buf);
+        try writeCurve(&writer.interface, curve, gpu_name);
+        try writer.interface.flush();
+    }
+    try std.fs.cwd().rename(tmp_path, path);
+}
+
+// ============================================================================
+// Session
+// ============================================================================
+
+const Session = struct {
+    device_index: u32,
+    tuner: Tuner,
+    exe: [64]u8 = undefined,
+    exe_len: usize = 0,
+    gpu_name: [96]u8 = undefined,
+    gpu_name_len: usize = 0,
+    /// Level last handed to the tuning worker
+    applied: ?u32 = null,
+    /// Power limit and graphics clock lock from before the session
+    saved_power_mw: u32 = 0,
+    saved_gpu_lock: ?clocks.LockedRange = null,
+
+    fn exeName(self: *const Session) []const u8 {
+        return self.exe[0..self.exe_len];
+    }
+
+    fn gpuName(self: *const Session) []const u8 {
+        return self.gpu_name[0..self.gpu_name_len];
+    }
+
+    /// Puts back what the session replaced
+    fn restoreTransaction(self: *const Session) tuning.Transaction {
+        var tx = tuning.Transaction.init(self.device_index);
+        tx.power_limit = .{ .milliwatts = self.saved_power_mw };
+        tx.gpu_lock = if (self.saved_gpu_lock) |range| .{ .range = range } else .reset;
+        return tx;
+    }
+};
+
+var session: ?Session = null;
+var session_mutex: std.Thread.Mutex = .{};
+var running = std.atomic.Value(bool).init(false);
+var frame_count = std.atomic.Value(u64).init(0);
+var apply_future: tuning.Future = .{};
+
+/// Start tuning a GPU for a game (requires root).
+/// Starts the sampler if it is not already running.
+pub fn start(device_index: u32, exe_name: []const u8, config: Config) !void {
+    try config.validate();
+    const caps = try nvcaps.getStaticCapabilities(device_index);
+
+    session_mutex.lock();
+    defer session_mutex.unlock();
+    if (session != null) return error.InUse;
+
+    var s = Session{ .device_index = device_index, .tuner = undefined };
+    // Let a previous session's restore land before saving what to restore.
+    // The worker runs transactions in order, so an empty one is a barrier.
+    var barrier: tuning.Future = .{};
+    if (tuning.commit(tuning.Transaction.init(device_index), &barrier, null, null)) |_| {
+        _ = barrier.wait();
+    } else |_| {}
+    s.saved_power_mw = try nvml.getDevicePowerLimit(try registry.getDevice(device_index));
+    s.saved_gpu_lock = clocks.getLock(device_index, .gpu);
+    s.exe_len = sanitizeName(&s.exe, exe_name).len;
+    if (s.exe_len == 0) return error.InvalidArgument;
+    const gpu_name = std.mem.sliceTo(&caps.name, 0);
+    s.gpu_name_len = @min(gpu_name.len, s.gpu_name.len);
+    @memcpy(s.gpu_name[0..s.gpu_name_len], gpu_name[0..s.gpu_name_len]);
+
+    if (loadCurve(s.exeName(), s.gpuName())) |curve| {
+        s.tuner = Tuner.resumeFrom(config, curve);
+    } else {
+        s.tuner = Tuner.init(config);
+    }
+    session = s;
+    _ = applyLevel(&session.?);
+    running.store(true, .release);
+    errdefer {
+        running.store(false, .release);
+        const ended = session.?;
+        finish(&ended);
+    }
+
+    if (!nvmon.sampler.isRunning()) try nvmon.sampler.start(.{});
+}
+
+/// Stop tuning, save the curve and restore the power limit and clock
+/// lock the GPU had before `start`
+pub fn stop() void {
+    running.store(false, .release);
+    session_mutex.lock();
+    defer session_mutex.unlock();
+    const s = session orelse return;
+    finish(&s);
+}
+
+/// End the session. Called with session_mutex held. The restore is
+/// queued behind any level still in flight and the curve is saved on the
+/// tuning worker, so this never blocks.
+fn finish(s: *const Session) void {
+    session = null;
+    commitAndSave(s, s.restoreTransaction(), true) catch |err| {
+        std.log.warn("autotune: cannot queue restore for GPU {d} ({s}), restoring inline", .{ s.device_index, @errorName(err) });
+        const res = tuning.apply(s.restoreTransaction());
+        if (res.status != .committed) logRestoreFailure(s.device_index, res.err);
+        saveSessionCurve(s);
+    };
+}
+
+/// A transaction followed by a curve save, both run on the tuning worker
+const Handoff = struct {
+    future: tuning.Future = .{},
+    session: Session,
+    restore: bool,
+};
+
+fn commitAndSave(s: *const Session, tx: tuning.Transaction, restore: bool) !void {
+    const handoff = try std.heap.page_allocator.create(Handoff);
+    errdefer std.heap.page_allocator.destroy(handoff);
+    handoff.* = .{ .session = s.*, .restore = restore };
+    try tuning.commit(tx, &handoff.future, finishHandoff, handoff);
+}
+
+fn finishHandoff(future: *tuning.Future, context: ?*anyopaque) void {
+    const handoff: *Handoff = @ptrCast(@alignCast(context.?));
+    defer std.heap.page_allocator.destroy(handoff);
+    if (handoff.restore and future.poll() != .committed) logRestoreFailure(handoff.session.device_index, future.err);
+    saveSessionCurve(&handoff.session);
+}
+
+fn logRestoreFailure(device_index: u32, err: ?anyerror) void {
+    std.log.warn("autotune: restoring GPU {d} failed: {s}", .{ device_index, if (err) |e| @errorName(e) else "unknown" });
+}
+
+/// Count a presented frame (lock-free, never blocks)
+pub fn recordFrame() void {
+    if (!running.load(.monotonic)) return;
+    _ = frame_count.fetchAdd(1, .monotonic);
+}
+
+/// Advance the tuner from a telemetry pass. Called by the nvmon sampler.
+pub fn observe(samples: []const nvmon.GpuSample) void {
+    if (!running.load(.acquire)) return;
+    // Never stall the sampler behind start/stop
+    if (!session_mutex.tryLock()) return;
+    defer session_mutex.unlock();
+    const s = if (session) |*s| s else return;
+
+    for (samples) |sample| {
+        if (sample.index != s.device_index) continue;
+        const power: ?f32 = if (sample.has(.power_draw)) sample.powerDrawW() else null;
+        const was_sweeping = s.tuner.phase == .sweeping;
+        _ = s.tuner.step(sample.timestamp_ns, frame_count.load(.monotonic), power);
+        if (was_sweeping and s.tuner.phase == .holding) {
+            commitAndSave(s, tuning.Transaction.init(s.device_index), false) catch |err| {
+                std.log.warn("autotune: could not cache curve for {s}: {s}", .{ s.exeName(), @errorName(err) });
+            };
+        }
+        break;
+    }
+    if (!applyLevel(s)) {
+        // Give up on the GPU, so `start` can be called again
+        running.store(false, .release);
+        const ended = s.*;
+        finish(&ended);
+    }
+}
+
+/// Hand the tuner's level to the tuning worker unless a change is in flight.
+/// Returns false if the GPU rejected the last level.
+fn applyLevel(s: *Session) bool {
+    switch (apply_future.poll()) {
+        .pending => return true,
+        .rolled_back, .rollback_failed => {
+            // A failure left over from an earlier session is not ours
+            const level = s.applied orelse {
+                commitLevel(s);
+                return true;
+            };
+            std.log.warn("autotune: GPU {d} rejected level {d}%: {s}", .{
+                s.device_index,
+                level,
+                if (apply_future.err) |err| @errorName(err) else "unknown",
+            });
+            return false;
+        },
+        .idle, .committed => {},
+    }
+    if (s.applied != s.tuner.level) commitLevel(s);
+    return true;
+}
+
+fn commitLevel(s: *Session) void {
+    tuning.commit(levelTransaction(s.device_index, s.tuner.level), &apply_future, null, null) catch return;
+    s.applied = s.tuner.level;
+}
+
+fn saveSessionCurve(s: *const Session) void {
+    if (s.tuner.curve.len == 0) return;
+    saveCurve(s.exeName(), s.gpuName(), &s.tuner.curve) catch |err| {
+        std.log.warn("autotune: could not cache curve for {s}: {s}", .{ s.exeName(), @errorName(err) });
+    };
+}
+
+pub const Status = struct {
+    device_index: u32,
+    phase: Phase,
+    level: u32,
+    points: usize,
+    knee: ?Point,
+};
+
+/// State of the running tuner, if any
+pub fn status() ?Status {
+    session_mutex.lock();
+    defer session_mutex.unlock();
+    const s = session orelse return null;
+    return .{
+        .device_index = s.device_index,
+        .phase = s.tuner.phase,
+        .level = s.tuner.level,
+        .points = s.tuner.curve.len,
+        .knee = s.tuner.curve.knee(s.tuner.config),
+    };
+}
+
+test "knee picks best fps per watt above the floor" {
+    var curve = Curve{};
+    curve.record(.{ .level = 100, .fps = 144, .watts = 320 });
+    curve.record(.{ .level = 80, .fps = 138, .watts = 240 });
+    curve.record(.{ .level = 90, .fps = 142, .watts = 280 });
+    curve.record(.{ .level = 70, .fps = 110, .watts = 180 });
+    try std.testing.expectEqual(@as(u32, 100), curve.points[0].level);
+    try std.testing.expectEqual(@as(u32, 70), curve.points[3].level);
+
+    // 70% has the best ratio but misses 120 FPS + 5%
+    try std.testing.expectEqual(@as(u32, 80), curve.knee(.{ .fps_floor = 120 }).?.level);
+    try std.testing.expectEqual(@as(u32, 70), curve.knee(.{ .fps_floor = 100 }).?.level);
+    try std.testing.expect(curve.knee(.{ .fps_floor = 200 }) == null);
+}
+
+test "tuner sweeps down then holds the knee" {
+    const cfg = Config{ .fps_floor = 100, .min_level = 70, .level_step = 10, .settle_ms = 0, .measure_ms = 1000 };
+    var tuner = Tuner.init(cfg);
+    const fps_at = [_]u64{ 144, 140, 120, 90 }; // at 100, 90, 80, 70
+    const watts_at = [_]f32{ 300, 250, 210, 180 };
+
+    var now: u64 = 1;
+    var frames: u64 = 0;
+    var applied: ?u32 = null;
+    for (fps_at, watts_at) |fps, watts| {
+        try std.testing.expectEqual(@as(?u32, null), tuner.step(now, frames, watts));
+        now += std.time.ns_per_s;
+        frames += fps;
+        applied = tuner.step(now, frames, watts);
+    }
+    // 70% missed the floor; 80% has the best FPS per watt above 105 FPS
+    try std.testing.expectEqual(Phase.holding, tuner.phase);
+    try std.testing.expectEqual(@as(?u32, 80), applied);
+
+    // A heavier scene at 80% backs off one step
+    _ = tuner.step(now, frames, 210);
+    now += std.time.ns_per_s;
+    frames += 95;
+    try std.testing.expectEqual(@as(?u32, 90), tuner.step(now, frames, 210));
+
+    // Still heavy, but above the floor at 90%: stay
+    _ = tuner.step(now, frames, 250);
+    now += std.time.ns_per_s;
+    frames += 110;
+    try std.testing.expectEqual(@as(?u32, null), tuner.step(now, frames, 250));
+
+    // Back to the swept rate: return to the knee, which stays as swept
+    _ = tuner.step(now, frames, 250);
+    now += std.time.ns_per_s;
+    frames += 140;
+    try std.testing.expectEqual(@as(?u32, 80), tuner.step(now, frames, 250));
+    try std.testing.expectApproxEqAbs(@as(f32, 120), tuner.curve.at(80).?.fps, 0.5);
+    try std.testing.expectEqual(@as(u32, 80), tuner.curve.knee(cfg).?.level);
+}
+
+test "curve cache round trip" {
+    var curve = Curve{};
+    curve.record(.{ .level = 100, .fps = 144.5, .watts = 320.25 });
+    curve.record(.{ .level = 85, .fps = 139, .watts = 251 });
+
+    var buf: [512]u8 = undefined;
+    var out = std.Io.Writer.fixed(&buf);
+    try writeCurve(&out, &curve, "NVIDIA GeForce RTX 4090");
+
+    const parsed = parseCurve(out.buffered(), "NVIDIA GeForce RTX 4090").?;
+    try std.testing.expectEqual(@as(usize, 2), parsed.len);
+    try std.testing.expectEqual(@as(u32, 85), parsed.points[1].level);
+    try std.testing.expectApproxEqAbs(@as(f32, 144.5), parsed.points[0].fps, 0.01);
+    try std.testing.expect(parseCurve(out.buffered(), "NVIDIA GeForce RTX 4080") == null);
+
+    var name_buf: [64]u8 = undefined;
+    try std.testing.expectEqualStrings("Game_x64.exe", sanitizeName(&name_buf, "/games/bin/Game x64.exe"));
+}
@@ -4,6 +4,7 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
 
 /// Efficiency mode
 pub const EfficiencyMode = enum {
@@ -72,7 +73,7 @@ pub const EfficiencyState = struct {
 
 /// Get current efficiency state
 pub fn getState(device_index: u32) !EfficiencyState {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
 
     const util = nvml.getDeviceUtilization(device) catch nvml.Utilization{ .gpu = 0, .memory = 0 };
     const power = nvml.getDevicePowerUsage(device) catch 0;
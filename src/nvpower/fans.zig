@@ -1,9 +1,21 @@
 //! nvpower/fans - Fan Control
 //!
 //! Fan speed management and custom fan curves.
+//!
+//! Curve mode is a closed loop driven by the nvmon sampler: once per control
+//! tick each curve-controlled GPU records its temperature, looks the target
+//! speed up in a table precomputed from the curve, and moves toward it with
+//! hysteresis, slew-rate limits and a lead from the temperature trend.
+//! NVML is only called when the commanded speed actually changes.
+//!
+//! Curves only live as long as the sampler: stopping it, or the process
+//! exiting, hands the fans back to the driver so they are never left pinned.
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvmon = @import("../nvmon/nvmon.zig");
+const thermals = @import("thermals.zig");
 
 /// Fan state
 pub const FanState = struct {
@@ -33,40 +45,44 @@ pub const FanMode = enum {
 
 /// Get current fan state
 pub fn getState(device_index: u32) !FanState {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     const speed = nvml.getDeviceFanSpeed(device) catch 0;
 
+    const control = controlState(device_index);
+
     return FanState{
         .speed_percent = speed,
         .speed_rpm = 0, // TODO: query if available
-        .target_percent = speed,
-        .mode = .auto,
-        .fan_count = 1, // TODO: query actual fan count
+        .target_percent = control.target orelse speed,
+        .mode = control.mode,
+        .fan_count = nvml.getDeviceNumFans(device) catch 1,
     };
 }
 
 /// Get fan speed percentage
 pub fn getSpeed(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     return nvml.getDeviceFanSpeed(device);
 }
 
-/// Set manual fan speed (requires elevated permissions + Coolbits)
+/// Set a fixed fan speed on every fan (requires root; stops a running curve)
 pub fn setSpeed(device_index: u32, speed_percent: u32) !void {
-    _ = device_index;
-    _ = speed_percent;
-    // NVML doesn't support fan speed setting on consumer cards
-    // Would need nvidia-settings with Coolbits enabled
-    // nvidia-settings -a "[gpu:0]/GPUFanControlState=1"
-    // nvidia-settings -a "[fan:0]/GPUTargetFanSpeed=XX"
-    return error.NotSupported;
+    if (speed_percent > 100) return error.InvalidArgument;
+    const device = try registry.getDevice(device_index);
+    write_mutex.lock();
+    defer write_mutex.unlock();
+    stopCurve(device_index, .manual);
+    try applySpeed(device, try nvml.getDeviceNumFans(device), speed_percent);
 }
 
-/// Enable automatic fan control
+/// Return every fan to driver control (stops a running curve)
 pub fn setAuto(device_index: u32) !void {
-    _ = device_index;
-    // nvidia-settings -a "[gpu:0]/GPUFanControlState=0"
-    return error.NotSupported;
+    const device = try registry.getDevice(device_index);
+    write_mutex.lock();
+    defer write_mutex.unlock();
+    stopCurve(device_index, .auto);
+    const fan_count = try nvml.getDeviceNumFans(device);
+    for (0..fan_count) |fan| try nvml.setDeviceDefaultFanSpeed(device, @intCast(fan));
 }
 
 /// Fan curve point
@@ -150,13 +166,327 @@ pub const FanCurve = struct {
     }
 };
 
-/// Set custom fan curve (requires elevated permissions)
+/// Highest temperature the lookup table resolves; hotter reads use the last entry
+pub const table_max_temp_c = 127;
+
+/// Curve sampled at every whole degree, so a control tick is one array index
+pub const SpeedTable = struct {
+    speeds: [table_max_temp_c + 1]u8,
+
+    pub fn fromCurve(curve: *const FanCurve) SpeedTable {
+        var table: SpeedTable = undefined;
+        for (&table.speeds, 0..) |*speed, temp| {
+            speed.* = @intCast(@min(curve.getSpeedAt(@intCast(temp)), 100));
+        }
+        return table;
+    }
+
+    pub fn at(self: *const SpeedTable, temp_c: u32) u32 {
+        return self.speeds[@min(temp_c, table_max_temp_c)];
+    }
+};
+
+/// Control loop tuning
+pub const Tuning = struct {
+    /// Control period; TempHistory trends assume roughly one tick per second
+    tick_ms: u32 = 1000,
+    /// Largest speed increase per tick, in percent
+    max_step_up: u32 = 10,
+    /// Largest speed decrease per tick; kept small so bursty loads don't make fans hunt
+    max_step_down: u32 = 2,
+    /// Cap on how far ahead a rising trend can push the lookup temperature
+    max_lead_c: u32 = 6,
+};
+
+/// Per-GPU curve controller: table lookup, hysteresis, trend lead and slew limiting
+pub const Regulator = struct {
+    table: SpeedTable,
+    tuning: Tuning,
+    hysteresis_c: u32,
+    min_percent: u32 = 0,
+    max_percent: u32 = 100,
+    /// Temperature the speed is currently looked up at
+    anchor_c: ?u32 = null,
+    /// Last speed produced by `step`
+    commanded: ?u32 = null,
+
+    pub fn init(curve: *const FanCurve, tuning: Tuning) Regulator {
+        return .{
+            .table = SpeedTable.fromCurve(curve),
+            .tuning = tuning,
+            .hysteresis_c = curve.hysteresis_c,
+        };
+    }
+
+    /// One control tick. `trend_c` is TempHistory.trend(): the rise over the
+    /// last ten samples. Returns the speed to command.
+    pub fn step(self: *Regulator, temp_c: u32, trend_c: i32) u32 {
+        // Heating: look ahead so the fan starts ramping before the temperature arrives
+        const lead: u32 = @min(@as(u32, @intCast(@max(trend_c, 0))), self.tuning.max_lead_c);
+        const predicted = temp_c + lead;
+
+        // Follow rises at once; only follow falls once they exceed the hysteresis band
+        if (self.anchor_c) |anchor| {
+            if (predicted > anchor) {
+                self.anchor_c = predicted;
+            } else if (predicted + self.hysteresis_c < anchor) {
+                self.anchor_c = predicted + self.hysteresis_c;
+            }
+        } else {
+            self.anchor_c = predicted;
+        }
+
+        const target = std.math.clamp(self.table.at(self.anchor_c.?), self.min_percent, self.max_percent);
+        const current = self.commanded orelse target;
+        const next = if (target > current)
+            current + @min(target - current, self.tuning.max_step_up)
+        else
+            current - @min(current - target, self.tuning.max_step_down);
+
+        self.commanded = next;
+        return next;
+    }
+};
+
+/// Curve-controlled GPU
+const Channel = struct {
+    regulator: Regulator,
+    history: thermals.TempHistory,
+    fan_count: u32,
+    /// Last speed written through NVML
+    applied: ?u32,
+    last_tick_ns: u64 = 0,
+};
+
+var channels: [registry.max_devices]?Channel = [_]?Channel{null} ** registry.max_devices;
+var modes: [registry.max_devices]FanMode = [_]FanMode{.auto} ** registry.max_devices;
+/// Bumped whenever a GPU's control changes hands; a curve write computed
+/// under an older generation is dropped
+var generations: [registry.max_devices]u32 = [_]u32{0} ** registry.max_devices;
+var active_curves = std.atomic.Value(u32).init(0);
+var control_mutex: std.Thread.Mutex = .{};
+/// Serializes fan writes, so a curve tick can't land after setSpeed/setAuto
+var write_mutex: std.Thread.Mutex = .{};
+var exit_hook = std.once(registerExitHook);
+
+/// Run a fan curve on a GPU from the background sampler (requires root).
+/// Starts the sampler if it is not already running.
 pub fn setCurve(device_index: u32, curve: FanCurve) !void {
-    _ = device_index;
-    _ = curve;
-    // Would need to implement as a daemon that polls temperature
-    // and sets fan speed accordingly
-    return error.NotSupported;
+    return setCurveTuned(device_index, curve, .{});
+}
+
+pub fn setCurveTuned(device_index: u32, curve: FanCurve, tuning: Tuning) !void {
+    if (device_index >= registry.max_devices) return error.NotFound;
+    if (curve.point_count == 0 or tuning.tick_ms == 0) return error.InvalidArgument;
+
+    const device = try registry.getDevice(device_index);
+    const fan_count = try nvml.getDeviceNumFans(device);
+    if (fan_count == 0) return error.NotSupported;
+
+    var regulator = Regulator.init(&curve, tuning);
+    if (nvml.getDeviceMinMaxFanSpeed(device)) |range| {
+        regulator.min_percent = range.min_percent;
+        regulator.max_percent = @max(range.max_percent, range.min_percent);
+    } else |_| {}
+    // Start from where the fan is so the first tick is slew limited too
+    const current = nvml.getDeviceFanSpeedN(device, 0) catch null;
+    regulator.commanded = current;
+
+    try installChannel(device_index, .{
+        .regulator = regulator,
+        .history = thermals.TempHistory.init(),
+        .fan_count = fan_count,
+        .applied = null,
+    });
+}
+
+fn installChannel(device_index: u32, channel: Channel) !void {
+    exit_hook.call();
+    {
+        control_mutex.lock();
+        defer control_mutex.unlock();
+        if (channels[device_index] == null) _ = active_curves.fetchAdd(1, .release);
+        channels[device_index] = channel;
+        modes[device_index] = .curve;
+        generations[device_index] +%= 1;
+    }
+
+    // The loop only ticks on passes that read the temperature
+    nvmon.sampler.requestFields(nvmon.Field.temperature.bit());
+    if (!nvmon.sampler.isRunning()) nvmon.sampler.start(.{}) catch |err| {
+        stopCurve(device_index, .auto);
+        return err;
+    };
+}
+
+/// Fan control of one GPU, as saved and restored around tuning changes
+pub const Control = struct {
+    mode: FanMode,
+    /// Running curve, in curve mode
+    channel: ?Channel = null,
+    /// Fixed speed, in manual mode
+    speed_percent: ?u32 = null,
+};
+
+/// Capture how a GPU's fans are driven right now
+pub fn saveControl(device_index: u32) !Control {
+    if (device_index >= registry.max_devices) return error.NotFound;
+    var control = blk: {
+        control_mutex.lock();
+        defer control_mutex.unlock();
+        break :blk Control{ .mode = modes[device_index], .channel = channels[device_index] };
+    };
+    if (control.mode == .manual) {
+        const device = try registry.getDevice(device_index);
+        control.speed_percent = try nvml.getDeviceFanSpeedN(device, 0);
+    }
+    return control;
+}
+
+/// Return a GPU's fans to a state captured by `saveControl`
+pub fn restoreControl(device_index: u32, control: Control) !void {
+    switch (control.mode) {
+        .curve => {
+            var channel = control.channel orelse return setAuto(device_index);
+            // Rewrite the speed on the next tick
+            channel.applied = null;
+            channel.last_tick_ns = 0;
+            try installChannel(device_index, channel);
+        },
+        .manual => try setSpeed(device_index, control.speed_percent orelse return setAuto(device_index)),
+        .auto, .zero_rpm => try setAuto(device_index),
+    }
+}
+
+/// Whether a curve is running on a GPU
+pub fn isCurveActive(device_index: u32) bool {
+    if (device_index >= registry.max_devices) return false;
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    return channels[device_index] != null;
+}
+
+/// Current control mode of a GPU's fans
+pub fn getMode(device_index: u32) FanMode {
+    return controlState(device_index).mode;
+}
+
+const ControlState = struct {
+    mode: FanMode,
+    target: ?u32,
+};
+
+fn controlState(device_index: u32) ControlState {
+    if (device_index >= registry.max_devices) return .{ .mode = .auto, .target = null };
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    const target = if (channels[device_index]) |ch| ch.regulator.commanded else null;
+    return .{ .mode = modes[device_index], .target = target };
+}
+
+fn stopCurve(device_index: u32, mode: FanMode) void {
+    if (device_index >= registry.max_devices) return;
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    if (channels[device_index] != null) _ = active_curves.fetchSub(1, .release);
+    channels[device_index] = null;
+    modes[device_index] = mode;
+    generations[device_index] +%= 1;
+}
+
+/// Stop every curve and return those fans to driver control. Called when
+/// the sampler stops, since nothing would drive the curves afterwards.
+pub fn releaseCurves() void {
+    if (active_curves.load(.acquire) == 0) return;
+    write_mutex.lock();
+    defer write_mutex.unlock();
+
+    for (0..registry.max_devices) |i| {
+        const fan_count = blk: {
+            control_mutex.lock();
+            defer control_mutex.unlock();
+            const ch = channels[i] orelse continue;
+            break :blk ch.fan_count;
+        };
+        stopCurve(@intCast(i), .auto);
+        const device = registry.getDevice(@intCast(i)) catch continue;
+        restoreDefault(device, fan_count);
+    }
+}
+
+fn registerExitHook() void {
+    _ = std.c.atexit(releaseAtExit);
+}
+
+fn releaseAtExit() callconv(.c) void {
+    releaseCurves();
+}
+
+/// Advance curve controllers from a telemetry pass. Called by the nvmon
+/// sampler after every pass; a GPU's loop only steps once per tick.
+pub fn observe(samples: []const nvmon.GpuSample) void {
+    if (active_curves.load(.acquire) == 0) return;
+
+    const Pending = struct { index: u32, speed: u32, fan_count: u32, generation: u32 };
+    var pending: [registry.max_devices]Pending = undefined;
+    var pending_count: usize = 0;
+
+    control_mutex.lock();
+    for (samples) |sample| {
+        if (sample.index >= registry.max_devices or !sample.has(.temperature)) continue;
+        const slot = &channels[sample.index];
+        if (slot.* == null) continue;
+        const ch = &slot.*.?;
+        const tick_ns = @as(u64, ch.regulator.tuning.tick_ms) * std.time.ns_per_ms;
+        if (ch.last_tick_ns != 0 and sample.timestamp_ns -| ch.last_tick_ns < tick_ns) continue;
+        ch.last_tick_ns = sample.timestamp_ns;
+
+        ch.history.record(sample.temperature_c);
+        const speed = ch.regulator.step(sample.temperature_c, ch.history.trend());
+        if (ch.applied == speed) continue;
+        ch.applied = speed;
+        pending[pending_count] = .{
+            .index = sample.index,
+            .speed = speed,
+            .fan_count = ch.fan_count,
+            .generation = generations[sample.index],
+        };
+        pending_count += 1;
+    }
+    control_mutex.unlock();
+
+    // NVML writes happen outside the control lock, so getState never waits on them
+    write_mutex.lock();
+    defer write_mutex.unlock();
+    for (pending[0..pending_count]) |p| {
+        if (!isCurrent(p.index, p.generation)) continue;
+        const device = registry.getDevice(p.index) catch continue;
+        applySpeed(device, p.fan_count, p.speed) catch |err| {
+            std.log.warn("fan curve on GPU {d} stopped: {s}", .{ p.index, @errorName(err) });
+            stopCurve(p.index, .auto);
+            restoreDefault(device, p.fan_count);
+        };
+    }
+}
+
+/// Whether a GPU's control is unchanged since `generation` was read
+fn isCurrent(device_index: u32, generation: u32) bool {
+    control_mutex.lock();
+    defer control_mutex.unlock();
+    return generations[device_index] == generation;
+}
+
+fn applySpeed(device: nvml.Device, fan_count: u32, speed_percent: u32) !void {
+    for (0..fan_count) |fan| try nvml.setDeviceFanSpeed(device, @intCast(fan), speed_percent);
+}
+
+/// Best effort: hand every fan back to the driver
+fn restoreDefault(device: nvml.Device, fan_count: u32) void {
+    for (0..fan_count) |fan| {
+        nvml.setDeviceDefaultFanSpeed(device, @intCast(fan)) catch |err| {
+            std.log.warn("fan {d}: restoring driver control failed: {s}", .{ fan, @errorName(err) });
+        };
+    }
 }
 
 /// Preset fan curves
@@ -221,3 +551,46 @@ test "fan curve" {
     try std.testing.expectEqual(@as(u32, 40), curve.getSpeedAt(50)); // Interpolated
     try std.testing.expectEqual(@as(u32, 100), curve.getSpeedAt(90)); // Above last
 }
+
+test "speed table matches curve" {
+    const curve = FanPreset.balanced.getCurve();
+    const table = SpeedTable.fromCurve(&curve);
+    for ([_]u32{ 0, 40, 45, 63, 85, 100 }) |temp| {
+        try std.testing.expectEqual(curve.getSpeedAt(temp), table.at(temp));
+    }
+    try std.testing.expectEqual(@as(u32, 100), table.at(500));
+}
+
+test "regulator hysteresis and slew" {
+    var curve = FanCurve.init();
+    try curve.addPoint(40, 20);
+    try curve.addPoint(80, 100);
+    var reg = Regulator.init(&curve, .{ .max_step_up = 10, .max_step_down = 2 });
+    reg.commanded = 20;
+
+    // A jump to 80C ramps at most 10% per tick
+    try std.testing.expectEqual(@as(u32, 30), reg.step(80, 0));
+    try std.testing.expectEqual(@as(u32, 40), reg.step(80, 0));
+
+    // Settle at 60C (60%), then dip within the 3C hysteresis band: no change
+    reg.commanded = 60;
+    reg.anchor_c = 60;
+    try std.testing.expectEqual(@as(u32, 60), reg.step(58, 0));
+    try std.testing.expectEqual(@as(u32, 60), reg.step(57, 0));
+
+    // A real drop steps down slowly
+    try std.testing.expectEqual(@as(u32, 58), reg.step(50, 0));
+}
+
+test "regulator ramps ahead of a rising trend" {
+    var curve = FanCurve.init();
+    try curve.addPoint(40, 20);
+    try curve.addPoint(80, 100);
+    var steady = Regulator.init(&curve, .{ .max_step_up = 100 });
+    var rising = Regulator.init(&curve, .{ .max_step_up = 100 });
+
+    try std.testing.expect(rising.step(60, 4) > steady.step(60, 0));
+    // The lead is capped
+    var wild = Regulator.init(&curve, .{ .max_step_up = 100, .max_lead_c = 6 });
+    try std.testing.expectEqual(@as(u32, 72), wild.step(60, 50));
+}
@@ -4,6 +4,7 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
 
 /// Power limit configuration
 pub const PowerLimitConfig = struct {
@@ -34,39 +35,45 @@ pub const PowerLimitInfo = struct {
 
 /// Get power limit info
 pub fn getInfo(device_index: u32) !PowerLimitInfo {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
 
     const limit = nvml.getDevicePowerLimit(device) catch 0;
     // NVML returns milliwatts
     const limit_w = limit / 1000;
+    const default_w = (nvml.getDevicePowerDefaultLimit(device) catch limit) / 1000;
+
+    // Without constraints, estimate the range (typically 70-110% of default)
+    const range = nvml.getDevicePowerLimitConstraints(device) catch nvml.PowerLimitRange{
+        .min_mw = default_w * 700,
+        .max_mw = default_w * 1100,
+    };
 
-    // Estimate min/max (typically 70-110% of default)
     return PowerLimitInfo{
         .current_w = limit_w,
-        .default_w = limit_w, // TODO: query actual default
-        .min_w = limit_w * 70 / 100,
-        .max_w = limit_w * 110 / 100,
+        .default_w = default_w,
+        .min_w = range.min_mw / 1000,
+        .max_w = range.max_mw / 1000,
         .enforced_w = limit_w,
     };
 }
 
 /// Get current power limit in watts
 pub fn get(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     const limit = try nvml.getDevicePowerLimit(device);
     return limit / 1000;
 }
 
 /// Get current power draw in watts
 pub fn getPowerDraw(device_index: u32) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     const power = try nvml.getDevicePowerUsage(device);
     return power / 1000;
 }
 
 /// Set power limit (requires root)
 pub fn set(device_index: u32, config: PowerLimitConfig) !void {
-    const device = try nvml.getDeviceByIndex(device_index);
+    const device = try registry.getDevice(device_index);
     const info = try getInfo(device_index);
 
     var target_watts: u32 = undefined;
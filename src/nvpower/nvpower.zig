@@ -5,11 +5,16 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const nvmon = @import("../nvmon/nvmon.zig");
+const sampler = @import("../nvmon/sampler.zig");
+const events = @import("../nvmon/events.zig");
 
 pub const limits = @import("limits.zig");
 pub const thermals = @import("thermals.zig");
 pub const fans = @import("fans.zig");
 pub const efficiency = @import("efficiency.zig");
+pub const autotune = @import("autotune.zig");
 
 /// Complete power/thermal state
 pub const PowerState = struct {
@@ -34,6 +39,9 @@ pub const PowerState = struct {
     fan_target_percent: u32,
     fan_mode: FanMode,
 
+    // Clock throttle reasons (nvml THROTTLE_* bits), null if unavailable
+    throttle_reasons: ?u64 = null,
+
     pub fn print(self: PowerState, writer: anytype) !void {
         try writer.print("Power: {d:.1}W / {d:.1}W ({d:.0}%)\n", .{
             self.power_draw_w,
@@ -54,10 +62,13 @@ pub const PowerState = struct {
     }
 
     pub fn isThermalThrottling(self: PowerState) bool {
+        if (self.throttle_reasons) |reasons| return events.isThermalThrottle(reasons);
         return self.gpu_temp_c >= self.thermal_slowdown_c;
     }
 
     pub fn isPowerThrottling(self: PowerState) bool {
+        if (self.throttle_reasons) |reasons| return events.isPowerThrottle(reasons);
+        // Driver did not report reasons; estimate from draw vs. limit
         return self.power_draw_w >= self.power_limit_w * 0.98;
     }
 };
@@ -72,12 +83,22 @@ pub const FanMode = enum {
 
 /// Get current power state
 pub fn getState(device_index: u32) !PowerState {
-    const device = try nvml.getDeviceByIndex(device_index);
-
-    const power = nvml.getDevicePowerUsage(device) catch 0;
-    const power_limit = nvml.getDevicePowerLimit(device) catch 0;
-    const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
-    const fan_speed = nvml.getDeviceFanSpeed(device) catch 0;
+    // Fields the sampler carries come from its snapshot; the rest from NVML
+    const sample = sampler.latest(device_index) orelse nvmon.GpuSample{};
+    var power: u32 = if (sample.has(.power_draw)) sample.power_draw_mw else 0;
+    var power_limit: u32 = if (sample.has(.power_limit)) sample.power_limit_mw else 0;
+    var temp: u32 = if (sample.has(.temperature)) sample.temperature_c else 0;
+    const memory_temp: u32 = if (sample.has(.memory_temperature)) sample.memory_temp_c else 0;
+    var fan_speed: u32 = if (sample.has(.fan_speed)) sample.fan_speed_percent else 0;
+
+    if (!sample.has(.power_draw) or !sample.has(.power_limit) or !sample.has(.temperature) or !sample.has(.fan_speed)) {
+        const device = try registry.getDevice(device_index);
+        if (!sample.has(.power_draw)) power = nvml.getDevicePowerUsage(device) catch 0;
+        if (!sample.has(.power_limit)) power_limit = nvml.getDevicePowerLimit(device) catch 0;
+        if (!sample.has(.temperature)) temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
+        if (!sample.has(.fan_speed)) fan_speed = nvml.getDeviceFanSpeed(device) catch 0;
+    }
+    const throttle_reasons = getThrottleReasons(device_index) catch null;
 
     return PowerState{
         .power_draw_w = @as(f32, @floatFromInt(power)) / 1000.0,
@@ -86,7 +107,7 @@ pub fn getState(device_index: u32) !PowerState {
         .power_limit_min_w = @as(f32, @floatFromInt(power_limit)) * 0.7 / 1000.0, // Estimate
         .power_limit_max_w = @as(f32, @floatFromInt(power_limit)) * 1.1 / 1000.0, // Estimate
         .gpu_temp_c = temp,
-        .memory_temp_c = 0, // Would need memory temp sensor query
+        .memory_temp_c = memory_temp,
         .hotspot_temp_c = 0, // Would need hotspot query
         .thermal_target_c = 83, // Typical NVIDIA target
         .thermal_slowdown_c = 83, // Typical slowdown point
@@ -94,10 +115,24 @@ pub fn getState(device_index: u32) !PowerState {
         .fan_speed_percent = fan_speed,
         .fan_speed_rpm = 0, // Would need RPM query
         .fan_target_percent = fan_speed,
-        .fan_mode = .auto,
+        .fan_mode = switch (fans.getMode(device_index)) {
+            .auto => .auto,
+            .manual => .manual,
+            .curve => .curve,
+            .zero_rpm => .zero_rpm,
+        },
+        .throttle_reasons = throttle_reasons,
     };
 }
 
+/// Current clock throttle reasons (nvml THROTTLE_* bits).
+/// Served from the event monitor when it is running.
+pub fn getThrottleReasons(device_index: u32) !u64 {
+    if (events.throttleReasons(device_index)) |reasons| return reasons;
+    const device = try registry.getDevice(device_index);
+    return nvml.getDeviceCurrentClocksThrottleReasons(device);
+}
+
 /// Quick power check
 pub const PowerHealth = enum {
     optimal, // Well under limits
@@ -149,6 +184,11 @@ pub const EfficiencyMode = enum {
     }
 };
 
+test {
+    _ = fans;
+    _ = autotune;
+}
+
 test "power state" {
     const state = PowerState{
         .power_draw_w = 250,
@@ -169,4 +209,9 @@ test "power state" {
     };
     try std.testing.expect(!state.isThermalThrottling());
     try std.testing.expect(!state.isPowerThrottling());
+
+    var capped = state;
+    capped.throttle_reasons = nvml.THROTTLE_SW_POWER_CAP;
+    try std.testing.expect(capped.isPowerThrottling());
+    try std.testing.expect(!capped.isThermalThrottling());
 }
@@ -4,6 +4,8 @@
 
 const std = @import("std");
 const nvml = @import("../bindings/nvml.zig");
+const registry = @import("../nvcaps/registry.zig");
+const sampler = @import("../nvmon/sampler.zig");
 
 /// Temperature sensor types
 pub const Sensor = enum {
@@ -62,12 +64,19 @@ pub const ThermalStatus = enum {
 
 /// Get current thermal state
 pub fn getState(device_index: u32) !ThermalState {
-    const device = try nvml.getDeviceByIndex(device_index);
-    const temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
+    var temp: u32 = 0;
+    var memory_temp: u32 = 0;
+    if (sampler.latestWith(device_index, .temperature)) |sample| {
+        temp = sample.temperature_c;
+        if (sample.has(.memory_temperature)) memory_temp = sample.memory_temp_c;
+    } else {
+        const device = try registry.getDevice(device_index);
+        temp = nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU) catch 0;
+    }
 
     return ThermalState{
         .gpu_temp_c = temp,
-        .memory_temp_c = 0, // TODO: query if available
+        .memory_temp_c = memory_temp,
         .hotspot_temp_c = 0, // TODO: query if available
         .target_temp_c = 83, // Default NVIDIA target
         .slowdown_temp_c = 83,
@@ -77,7 +86,11 @@ pub fn getState(device_index: u32) !ThermalState {
 
 /// Get single temperature reading
 pub fn getTemperature(device_index: u32, sensor: Sensor) !u32 {
-    const device = try nvml.getDeviceByIndex(device_index);
+    if (sensor == .gpu) {
+        if (sampler.latestWith(device_index, .temperature)) |sample| return sample.temperature_c;
+    }
+
+    const device = try registry.getDevice(device_index);
 
     return switch (sensor) {
         .gpu => nvml.getDeviceTemperature(device, nvml.TEMPERATURE_GPU),
@@ -7,12 +7,16 @@
 //!
 //! - **Cache Detection** - Auto-detect DXVK, vkd3d, Mesa, NVIDIA caches
 //! - **Game Integration** - Steam, Lutris, Heroic game library support
-//! - **Pre-warming** - Compile shaders before game launch
+//! - **Pre-warming** - Compile shaders before game launch (see `scheduler`)
 //! - **Cache Sharing** - Export/import shader caches between systems
 //! - **Real-time Monitoring** - Watch shader compilation in real-time
 
+const std = @import("std");
 const nvshader_lib = @import("nvshader");
 
+/// Background pre-warm of stale Fossilize caches for the current driver and GPU
+pub const scheduler = @import("scheduler.zig");
+
 // Re-export version
 pub const version = nvshader_lib.version;
 
@@ -57,10 +61,36 @@ pub const CachePreset = enum {
 
 /// Quick check: are there any shader caches on the system?
 pub fn hasCaches() bool {
-    // TODO: Check common cache locations like:
-    // ~/.cache/dxvk/
-    // ~/.cache/vkd3d-proton/
-    // ~/.nv/ComputeCache/
-    // ~/.cache/mesa_shader_cache/
-    return true; // Optimistic default
+    const home = std.posix.getenv("HOME") orelse return false;
+    var buf: [std.fs.max_path_bytes]u8 = undefined;
+
+    const cache_dirs = [_][]const u8{ "dxvk", "vkd3d-proton", "mesa_shader_cache", "nvidia/GLCache" };
+    for (cache_dirs) |dir| {
+        const path = if (std.posix.getenv("XDG_CACHE_HOME")) |xdg|
+            std.fmt.bufPrint(&buf, "{s}/{s}", .{ xdg, dir }) catch continue
+        else
+            std.fmt.bufPrint(&buf, "{s}/.cache/{s}", .{ home, dir }) catch continue;
+        if (exists(path)) return true;
+    }
+
+    const home_dirs = [_][]const u8{
+        ".nv/ComputeCache",
+        ".nv/GLCache",
+        ".local/share/Steam/steamapps/shadercache",
+        ".steam/steam/steamapps/shadercache",
+    };
+    for (home_dirs) |dir| {
+        const path = std.fmt.bufPrint(&buf, "{s}/{s}", .{ home, dir }) catch continue;
+        if (exists(path)) return true;
+    }
+    return false;
+}
+
+fn exists(path: []const u8) bool {
+    std.fs.cwd().access(path, .{}) catch return false;
+    return true;
+}
+
+test {
+    _ = scheduler;
 }
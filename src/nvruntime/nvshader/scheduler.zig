@@ -0,0 +1,740 @@
+//! nvshader/scheduler - Shader Cache Pre-Warm Scheduler
+//!
+//! Finds Fossilize pipeline caches (Steam's shadercache/<appid> databases,
+//! which carry the DXVK and vkd3d-proton pipelines of Proton titles) that
+//! have not been replayed for the current driver and GPU, and replays them
+//! with `fossilize_replay` so the NVIDIA driver cache is warm before the
+//! game's first launch.
+//!
+//! Replays run on a small work-stealing pool. Each worker is pinned to one
+//! of the least busy cores and runs with SCHED_IDLE and idle I/O priority;
+//! the replay processes inherit all three. While primetime has a game in
+//! the foreground, workers stop their replay (SIGSTOP) and pick up no new
+//! work until it is gone.
+//!
+//! A cache counts as stale when its stamp file is missing, was written for
+//! another driver version or GPU UUID, or is older than one of its
+//! databases (the game added pipelines since the last replay).
+//!
+//! Replays run on the GPU the cache is stamped for, with the driver's disk
+//! cache pointed where Steam points it for the game
+//! (shadercache/<appid>/nvidiav1), so the game finds the compiled shaders.
+
+const std = @import("std");
+const linux = std.os.linux;
+const nvml = @import("../../bindings/nvml.zig");
+const nvcaps = @import("../../nvcaps/nvcaps.zig");
+const primetime = @import("../primetime/primetime.zig");
+
+const Allocator = std.mem.Allocator;
+
+/// Written into a cache directory after a successful replay
+pub const stamp_name = ".nvprime-prewarm";
+
+/// Most databases replayed per cache directory
+pub const max_databases = 16;
+
+/// Most CPUs considered when picking idle cores
+const max_cpus = 256;
+
+/// NVIDIA's Vulkan ICD manifests, in loader search order. With only this
+/// ICD loaded, Vulkan lists the NVIDIA GPUs in NVML's (PCI bus) order.
+const nvidia_icds = [_][]const u8{
+    "/etc/vulkan/icd.d/nvidia_icd.json",
+    "/usr/local/share/vulkan/icd.d/nvidia_icd.json",
+    "/usr/share/vulkan/icd.d/nvidia_icd.json",
+};
+
+/// Steam installs under $HOME (native, legacy symlink, Flatpak)
+const steam_roots = [_][]const u8{
+    ".local/share/Steam",
+    ".steam/steam",
+    ".var/app/com.valvesoftware.Steam/.local/share/Steam",
+};
+
+/// Driver and GPU a cache was compiled for
+pub const Identity = struct {
+    driver: [80]u8 = [_]u8{0} ** 80,
+    gpu_uuid: [96]u8 = [_]u8{0} ** 96,
+
+    /// Identity of a GPU under the loaded driver
+    pub fn current(device_index: u32) !Identity {
+        const caps = try nvcaps.getStaticCapabilities(device_index);
+        return .{ .driver = try nvml.getDriverVersion(), .gpu_uuid = caps.uuid };
+    }
+
+    pub fn getDriver(self: *const Identity) []const u8 {
+        return std.mem.sliceTo(&self.driver, 0);
+    }
+
+    pub fn getGpuUuid(self: *const Identity) []const u8 {
+        return std.mem.sliceTo(&self.gpu_uuid, 0);
+    }
+
+    pub fn writeStamp(self: *const Identity, out: *std.Io.Writer) !void {
+        try out.print("driver {s}\ngpu {s}\n", .{ self.getDriver(), self.getGpuUuid() });
+    }
+
+    /// Whether a stamp was written for this driver and GPU
+    pub fn matches(self: *const Identity, stamp: []const u8) bool {
+        var driver_ok = false;
+        var gpu_ok = false;
+        var lines = std.mem.tokenizeScalar(u8, stamp, '\n');
+        while (lines.next()) |line| {
+            if (std.mem.startsWith(u8, line, "driver ")) {
+                driver_ok = std.mem.eql(u8, line["driver ".len..], self.getDriver());
+            } else if (std.mem.startsWith(u8, line, "gpu ")) {
+                gpu_ok = std.mem.eql(u8, line["gpu ".len..], self.getGpuUuid());
+            }
+        }
+        return driver_ok and gpu_ok;
+    }
+};
+
+/// One directory of Fossilize databases
+pub const Cache = struct {
+    /// Directory holding the databases
+    dir: []const u8,
+    /// Steam app id
+    name: []const u8,
+    /// Absolute database paths
+    databases: []const []const u8,
+    bytes: u64,
+};
+
+fn isDatabase(name: []const u8) bool {
+    return std.mem.endsWith(u8, name, ".foz");
+}
+
+/// Whether the databases in `dir` (opened with `.iterate`) need a replay
+pub fn isStale(dir: std.fs.Dir, identity: *const Identity) bool {
+    var buf: [512]u8 = undefined;
+    const stamp = dir.readFile(stamp_name, &buf) catch return true;
+    if (!identity.matches(stamp)) return true;
+    const stamp_mtime = (dir.statFile(stamp_name) catch return true).mtime;
+
+    var it = dir.iterate();
+    while (it.next() catch return true) |entry| {
+        if (entry.kind != .file or !isDatabase(entry.name)) continue;
+        const stat = dir.statFile(entry.name) catch continue;
+        if (stat.mtime > stamp_mtime) return true;
+    }
+    return false;
+}
+
+/// Steam library paths listed in a libraryfolders.vdf
+pub const LibraryPaths = struct {
+    lines: std.mem.TokenIterator(u8, .scalar),
+
+    pub fn init(vdf: []const u8) LibraryPaths {
+        return .{ .lines = std.mem.tokenizeScalar(u8, vdf, '\n') };
+    }
+
+    pub fn next(self: *LibraryPaths) ?[]const u8 {
+        while (self.lines.next()) |raw| {
+            // "path"		"/mnt/games/SteamLibrary"
+            const line = std.mem.trim(u8, raw, " \t\r");
+            if (!std.mem.startsWith(u8, line, "\"path\"")) continue;
+            const rest = std.mem.trim(u8, line["\"path\"".len..], " \t");
+            if (rest.len < 2 or rest[0] != '"' or rest[rest.len - 1] != '"') continue;
+            return rest[1 .. rest.len - 1];
+        }
+        return null;
+    }
+};
+
+/// Steam installs under $HOME and the libraries they list, with symlinked
+/// duplicates removed
+pub fn defaultRoots(arena: Allocator) ![]const []const u8 {
+    const home = std.posix.getenv("HOME") orelse return error.NotFound;
+    var roots: std.ArrayList([]const u8) = .empty;
+
+    for (steam_roots) |suffix| {
+        const joined = try std.fs.path.join(arena, &.{ home, suffix });
+        try addRoot(arena, &roots, joined);
+
+        const vdf_path = try std.fs.path.join(arena, &.{ joined, "steamapps", "libraryfolders.vdf" });
+        const vdf = std.fs.cwd().readFileAlloc(arena, vdf_path, 1 << 20) catch continue;
+        var libraries = LibraryPaths.init(vdf);
+        while (libraries.next()) |library| try addRoot(arena, &roots, library);
+    }
+    return roots.toOwnedSlice(arena);
+}
+
+fn addRoot(arena: Allocator, roots: *std.ArrayList([]const u8), path: []const u8) !void {
+    const real = std.fs.cwd().realpathAlloc(arena, path) catch return;
+    for (roots.items) |root| {
+        if (std.mem.eql(u8, root, real)) return;
+    }
+    try roots.append(arena, real);
+}
+
+/// Stale caches under the given Steam roots, largest first
+pub fn findStale(arena: Allocator, identity: *const Identity, roots: []const []const u8) ![]Cache {
+    var caches: std.ArrayList(Cache) = .empty;
+    for (roots) |root| {
+        const shader_path = try std.fs.path.join(arena, &.{ root, "steamapps", "shadercache" });
+        var shader_dir = std.fs.cwd().openDir(shader_path, .{ .iterate = true }) catch continue;
+        defer shader_dir.close();
+
+        var apps = shader_dir.iterate();
+        while (try apps.next()) |app| {
+            if (app.kind != .directory) continue;
+            var app_dir = shader_dir.openDir(app.name, .{ .iterate = true }) catch continue;
+            defer app_dir.close();
+
+            // fozpipelinesv6 today; older clients left other versions behind
+            var subdirs = app_dir.iterate();
+            while (try subdirs.next()) |sub| {
+                if (sub.kind != .directory or !std.mem.startsWith(u8, sub.name, "fozpipelines")) continue;
+                var foz_dir = app_dir.openDir(sub.name, .{ .iterate = true }) catch continue;
+                defer foz_dir.close();
+                if (!isStale(foz_dir, identity)) continue;
+
+                const dir_path = try std.fs.path.join(arena, &.{ shader_path, app.name, sub.name });
+                const cache = try collect(arena, foz_dir, dir_path, try arena.dupe(u8, app.name)) orelse continue;
+                try caches.append(arena, cache);
+            }
+        }
+    }
+
+    std.mem.sort(Cache, caches.items, {}, largerFirst);
+    return caches.toOwnedSlice(arena);
+}
+
+fn largerFirst(_: void, a: Cache, b: Cache) bool {
+    return a.bytes > b.bytes;
+}
+
+fn collect(arena: Allocator, dir: std.fs.Dir, dir_path: []const u8, name: []const u8) !?Cache {
+    var databases: std.ArrayList([]const u8) = .empty;
+    var bytes: u64 = 0;
+    var it = dir.iterate();
+    while (try it.next()) |entry| {
+        if (entry.kind != .file or !isDatabase(entry.name)) continue;
+        if (databases.items.len == max_databases) break;
+        const stat = dir.statFile(entry.name) catch continue;
+        if (stat.size == 0) continue;
+        try databases.append(arena, try std.fs.path.join(arena, &.{ dir_path, entry.name }));
+        bytes += stat.size;
+    }
+    if (databases.items.len == 0) return null;
+    return .{ .dir = dir_path, .name = name, .databases = try databases.toOwnedSlice(arena), .bytes = bytes };
+}
+
+/// Driver shader cache Steam sets up for the cache's app:
+/// shadercache/<appid>/nvidiav1, next to the Fossilize databases
+pub fn driverCachePath(buf: []u8, cache: *const Cache) ![]const u8 {
+    const app_dir = std.fs.path.dirname(cache.dir) orelse return error.InvalidArgument;
+    return std.fmt.bufPrint(buf, "{s}/nvidiav1", .{app_dir});
+}
+
+fn findNvidiaIcd() ?[]const u8 {
+    for (nvidia_icds) |path| {
+        std.fs.accessAbsolute(path, .{}) catch continue;
+        return path;
+    }
+    return null;
+}
+
+fn writeStampFile(cache: *const Cache, identity: *const Identity) !void {
+    var buf: [256]u8 = undefined;
+    var out = std.Io.Writer.fixed(&buf);
+    try identity.writeStamp(&out);
+    var dir = try std.fs.cwd().openDir(cache.dir, .{});
+    defer dir.close();
+    try dir.writeFile(.{ .sub_path = stamp_name, .data = out.buffered() });
+}
+
+// ============================================================================
+// Idle core selection
+// ============================================================================
+
+const CpuTimes = struct {
+    cpu: usize,
+    busy: u64,
+    total: u64,
+};
+
+/// Per-CPU lines of /proc/stat. Returns the number of entries written.
+fn parseProcStat(text: []const u8, out: []CpuTimes) usize {
+    var n: usize = 0;
+    var lines = std.mem.tokenizeScalar(u8, text, '\n');
+    while (lines.next()) |line| {
+        if (n == out.len) break;
+        // The aggregate "cpu " line comes first; per-CPU lines follow
+        if (!std.mem.startsWith(u8, line, "cpu") or line.len < 4 or !std.ascii.isDigit(line[3])) continue;
+        var fields = std.mem.tokenizeScalar(u8, line, ' ');
+        const cpu = std.fmt.parseInt(usize, fields.next().?[3..], 10) catch continue;
+
+        // user nice system idle iowait irq softirq steal
+        var values: [8]u64 = [_]u64{0} ** 8;
+        for (&values) |*value| {
+            value.* = std.fmt.parseInt(u64, fields.next() orelse break, 10) catch 0;
+        }
+        var total: u64 = 0;
+        for (values) |value| total += value;
+        out[n] = .{ .cpu = cpu, .busy = total - values[3] - values[4], .total = total };
+        n += 1;
+    }
+    return n;
+}
+
+/// Fill `out` with the CPUs that were least busy between two snapshots
+fn rankIdle(before: []const CpuTimes, after: []const CpuTimes, out: []usize) usize {
+    const Load = struct { cpu: usize, permille: u64 };
+    var loads: [max_cpus]Load = undefined;
+    var n: usize = 0;
+    for (after) |now| {
+        for (before) |then| {
+            if (then.cpu != now.cpu) continue;
+            const total = now.total -| then.total;
+            const busy = now.busy -| then.busy;
+            loads[n] = .{ .cpu = now.cpu, .permille = if (total == 0) 0 else busy * 1000 / total };
+            n += 1;
+            break;
+        }
+        if (n == loads.len) break;
+    }
+
+    std.mem.sort(Load, loads[0..n], {}, struct {
+        fn lessThan(_: void, a: Load, b: Load) bool {
+            return a.permille < b.permille or (a.permille == b.permille and a.cpu < b.cpu);
+        }
+    }.lessThan);
+
+    const count = @min(n, out.len);
+    for (loads[0..count], out[0..count]) |load, *cpu| cpu.* = load.cpu;
+    return count;
+}
+
+/// The least busy CPUs over a short /proc/stat window
+fn idleCpus(out: []usize) usize {
+    var buf: [32 * 1024]u8 = undefined;
+    var before: [max_cpus]CpuTimes = undefined;
+    var after: [max_cpus]CpuTimes = undefined;
+
+    const first = std.fs.cwd().readFile("/proc/stat", &buf) catch return 0;
+    const n_before = parseProcStat(first, &before);
+    std.posix.nanosleep(0, 200 * std.time.ns_per_ms);
+    const second = std.fs.cwd().readFile("/proc/stat", &buf) catch return 0;
+    const n_after = parseProcStat(second, &after);
+    return rankIdle(before[0..n_before], after[0..n_after], out);
+}
+
+const SCHED_IDLE = 5;
+const IOPRIO_WHO_PROCESS = 1;
+const IOPRIO_CLASS_IDLE = 3;
+const IOPRIO_CLASS_SHIFT = 13;
+
+/// Move the calling thread out of the game's way. Failures are harmless:
+/// the work still runs, just without the hints.
+fn lowerPriority(cpu: ?usize) void {
+    if (cpu) |c| {
+        var set = std.mem.zeroes(linux.cpu_set_t);
+        const bits = @bitSizeOf(usize);
+        if (c < set.len * bits) {
+            set[c / bits] |= @as(usize, 1) << @intCast(c % bits);
+            const rc = linux.syscall3(.sched_setaffinity, 0, @sizeOf(linux.cpu_set_t), @intFromPtr(&set));
+            if (linux.E.init(rc) != .SUCCESS) std.log.debug("shader pre-warm: pinning to CPU {d} failed", .{c});
+        }
+    }
+
+    const param: extern struct { priority: c_int } = .{ .priority = 0 };
+    if (linux.E.init(linux.syscall3(.sched_setscheduler, 0, SCHED_IDLE, @intFromPtr(&param))) != .SUCCESS) {
+        std.log.debug("shader pre-warm: SCHED_IDLE unavailable", .{});
+    }
+    // Thread id 0 is the calling thread
+    const ioprio = IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT;
+    if (linux.E.init(linux.syscall3(.ioprio_set, IOPRIO_WHO_PROCESS, 0, ioprio)) != .SUCCESS) {
+        std.log.debug("shader pre-warm: idle I/O priority unavailable", .{});
+    }
+}
+
+// ============================================================================
+// Work-stealing pool
+// ============================================================================
+
+/// Jobs of one worker. The owner pops from the tail, thieves take the head.
+const Deque = struct {
+    mutex: std.Thread.Mutex = .{},
+    items: []u32 = &.{},
+    head: usize = 0,
+    tail: usize = 0,
+
+    fn pop(self: *Deque) ?u32 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.head == self.tail) return null;
+        self.tail -= 1;
+        return self.items[self.tail];
+    }
+
+    fn steal(self: *Deque) ?u32 {
+        self.mutex.lock();
+        defer self.mutex.unlock();
+        if (self.head == self.tail) return null;
+        const job = self.items[self.head];
+        self.head += 1;
+        return job;
+    }
+};
+
+/// Deal jobs (sorted largest first) round-robin, each deque holding its
+/// share smallest-first: owners start on their largest job and thieves
+/// take what the owner would have run last.
+fn deal(queues: []Deque, slots: []u32, job_count: usize) void {
+    var offset: usize = 0;
+    for (queues, 0..) |*queue, w| {
+        const share = if (w < job_count) (job_count - w + queues.len - 1) / queues.len else 0;
+        queue.* = .{ .items = slots[offset .. offset + share], .tail = share };
+        for (queue.items, 0..) |*slot, i| {
+            // Position i from the tail is the worker's i-th largest job
+            slot.* = @intCast(w + (share - 1 - i) * queues.len);
+        }
+        offset += share;
+    }
+}
+
+pub const Config = struct {
+    /// Worker threads; 0 uses a quarter of the cores (at least one)
+    workers: u32 = 0,
+    /// Fossilize replayer, looked up in PATH
+    replay_command: []const u8 = "fossilize_replay",
+    /// How often a paused or running replay checks the foreground signal
+    poll_ms: u32 = 250,
+    /// Workers pause while this returns true
+    inForeground: *const fn () bool = primetime.gameInForeground,
+};
+
+pub const Progress = struct {
+    total: u32,
+    done: u32,
+    failed: u32,
+    /// Workers currently paused for a game
+    paused: u32,
+    finished: bool,
+};
+
+pub const Scheduler = struct {
+    allocator: Allocator,
+    arena: std.heap.ArenaAllocator,
+    config: Config,
+    /// NVML index of the GPU replays run on
+    device_index: u32 = 0,
+    identity: Identity,
+    caches: []const Cache = &.{},
+    queues: []Deque = &.{},
+    threads: []std.Thread = &.{},
+
+    done: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    failed: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    paused: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    running: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    cancelled: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+    /// Find the caches stale for a GPU under the Steam installs in $HOME
+    /// and start replaying them
+    pub fn start(allocator: Allocator, device_index: u32, config: Config) !*Scheduler {
+        const identity = try Identity.current(device_index);
+        const self = try create(allocator, device_index, identity, config);
+        errdefer self.deinit();
+        const roots = try defaultRoots(self.arena.allocator());
+        try self.launch(try findStale(self.arena.allocator(), &self.identity, roots));
+        return self;
+    }
+
+    /// Start replaying an explicit set of caches on a GPU
+    pub fn startWith(allocator: Allocator, device_index: u32, identity: Identity, caches: []const Cache, config: Config) !*Scheduler {
+        const self = try create(allocator, device_index, identity, config);
+        errdefer self.deinit();
+        try self.launch(caches);
+        return self;
+    }
+
+    fn create(allocator: Allocator, device_index: u32, identity: Identity, config: Config) !*Scheduler {
+        const self = try allocator.create(Scheduler);
+        self.* = .{
+            .allocator = allocator,
+            .arena = std.heap.ArenaAllocator.init(allocator),
+            .config = config,
+            .device_index = device_index,
+            .identity = identity,
+        };
+        return self;
+    }
+
+    fn launch(self: *Scheduler, caches: []const Cache) !void {
+        self.caches = caches;
+        if (caches.len == 0) return;
+        const arena = self.arena.allocator();
+
+        const cores = std.Thread.getCpuCount() catch 1;
+        const wanted = if (self.config.workers > 0) self.config.workers else @max(cores / 4, 1);
+        const count = @min(wanted, caches.len, max_cpus);
+
+        self.queues = try arena.alloc(Deque, count);
+        deal(self.queues, try arena.alloc(u32, caches.len), caches.len);
+
+        var cpus: [max_cpus]usize = undefined;
+        const idle = idleCpus(cpus[0..count]);
+
+        self.threads = try arena.alloc(std.Thread, count);
+        var spawned: usize = 0;
+        errdefer {
+            // Drop the remaining work so the spawned workers exit
+            self.cancel();
+            for (self.threads[0..spawned]) |thread| thread.join();
+            self.threads = &.{};
+        }
+        for (self.threads, 0..) |*thread, w| {
+            const cpu: ?usize = if (w < idle) cpus[w] else null;
+            _ = self.running.fetchAdd(1, .monotonic);
+            thread.* = std.Thread.spawn(.{}, workerMain, .{ self, w, cpu }) catch |err| {
+                _ = self.running.fetchSub(1, .monotonic);
+                return err;
+            };
+            spawned += 1;
+        }
+    }
+
+    pub fn progress(self: *const Scheduler) Progress {
+        return .{
+            .total = @intCast(self.caches.len),
+            .done = self.done.load(.monotonic),
+            .failed = self.failed.load(.monotonic),
+            .paused = self.paused.load(.monotonic),
+            .finished = self.running.load(.acquire) == 0,
+        };
+    }
+
+    /// Stop early: running replays are killed and queued ones dropped
+    pub fn cancel(self: *Scheduler) void {
+        self.cancelled.store(true, .release);
+    }
+
+    /// Wait for the workers (call `cancel` first to stop early) and free
+    /// the scheduler
+    pub fn deinit(self: *Scheduler) void {
+        for (self.threads) |thread| thread.join();
+        self.arena.deinit();
+        self.allocator.destroy(self);
+    }
+
+    fn nextJob(self: *Scheduler, worker: usize) ?u32 {
+        if (self.queues[worker].pop()) |job| return job;
+        for (1..self.queues.len) |i| {
+            const victim = (worker + i) % self.queues.len;
+            if (self.queues[victim].steal()) |job| return job;
+        }
+        return null;
+    }
+
+    fn workerMain(self: *Scheduler, worker: usize, cpu: ?usize) void {
+        defer _ = self.running.fetchSub(1, .release);
+        lowerPriority(cpu);
+
+        var paused = false;
+        defer self.setPaused(&paused, false);
+        while (!self.cancelled.load(.acquire)) {
+            // Hold off on new work while a game is up
+            if (self.config.inForeground()) {
+                self.setPaused(&paused, true);
+                std.posix.nanosleep(0, @as(u64, self.config.poll_ms) * std.time.ns_per_ms);
+                continue;
+            }
+            self.setPaused(&paused, false);
+
+            const job = self.nextJob(worker) orelse return;
+            const cache = &self.caches[job];
+            if (self.replay(cache, &paused)) {
+                writeStampFile(cache, &self.identity) catch |err| {
+                    std.log.warn("shader pre-warm: could not stamp {s}: {s}", .{ cache.dir, @errorName(err) });
+                };
+                _ = self.done.fetchAdd(1, .monotonic);
+            } else |err| {
+                if (err == error.Cancelled) return;
+                std.log.warn("shader pre-warm of app {s} failed: {s}", .{ cache.name, @errorName(err) });
+                _ = self.failed.fetchAdd(1, .monotonic);
+            }
+        }
+    }
+
+    fn setPaused(self: *Scheduler, paused: *bool, value: bool) void {
+        if (paused.* == value) return;
+        paused.* = value;
+        if (value) _ = self.paused.fetchAdd(1, .monotonic) else _ = self.paused.fetchSub(1, .monotonic);
+    }
+
+    /// Replay one cache in a child process, which inherits this thread's
+    /// affinity and priorities. Stops the child while a game is up.
+    fn replay(self: *Scheduler, cache: *const Cache, paused: *bool) !void {
+        var index_buf: [16]u8 = undefined;
+        var argv_buf: [max_databases + 5][]const u8 = undefined;
+        argv_buf[0] = self.config.replay_command;
+        // One thread per replay; the pool provides the parallelism
+        argv_buf[1] = "--num-threads";
+        argv_buf[2] = "1";
+        argv_buf[3] = "--device-index";
+        argv_buf[4] = try std.fmt.bufPrint(&index_buf, "{d}", .{self.device_index});
+        @memcpy(argv_buf[5..][0..cache.databases.len], cache.databases);
+
+        var env = try std.process.getEnvMap(std.heap.page_allocator);
+        defer env.deinit();
+        // Compile into the cache the game reads, as Steam configures it
+        var cache_buf: [std.fs.max_path_bytes]u8 = undefined;
+        const driver_cache = try driverCachePath(&cache_buf, cache);
+        std.fs.cwd().makePath(driver_cache) catch {};
+        try env.put("__GL_SHADER_DISK_CACHE", "1");
+        try env.put("__GL_SHADER_DISK_CACHE_PATH", driver_cache);
+        try env.put("__GL_SHADER_DISK_CACHE_SKIP_CLEANUP", "1");
+        // Only NVIDIA's GPUs, so --device-index counts like NVML
+        if (findNvidiaIcd()) |icd| {
+            try env.put("VK_DRIVER_FILES", icd);
+            try env.put("VK_ICD_FILENAMES", icd);
+        } else {
+            std.log.debug("shader pre-warm: NVIDIA Vulkan ICD not found, device {d} may not match", .{self.device_index});
+        }
+
+        var child = std.process.Child.init(argv_buf[0 .. 5 + cache.databases.len], std.heap.page_allocator);
+        child.env_map = &env;
+        child.stdin_behavior = .Ignore;
+        child.stdout_behavior = .Ignore;
+        child.stderr_behavior = .Ignore;
+        try child.spawn();
+        const pid = child.id;
+
+        while (true) {
+            const res = std.posix.waitpid(pid, std.posix.W.NOHANG);
+            if (res.pid != 0) {
+                const ok = std.posix.W.IFEXITED(res.status) and std.posix.W.EXITSTATUS(res.status) == 0;
+                return if (ok) {} else error.ReplayFailed;
+            }
+            if (self.cancelled.load(.acquire)) {
+                // SIGKILL also ends a stopped process
+                std.posix.kill(pid, std.posix.SIG.KILL) catch {};
+                _ = std.posix.waitpid(pid, 0);
+                return error.Cancelled;
+            }
+
+            const foreground = self.config.inForeground();
+            if (foreground != paused.*) {
+                std.posix.kill(pid, if (foreground) std.posix.SIG.STOP else std.posix.SIG.CONT) catch {};
+                self.setPaused(paused, foreground);
+            }
+            std.posix.nanosleep(0, @as(u64, self.config.poll_ms) * std.time.ns_per_ms);
+        }
+    }
+};
+
+test "stamp identity" {
+    var id = Identity{};
+    @memcpy(id.driver[0..6], "570.86");
+    @memcpy(id.gpu_uuid[0..8], "GPU-1234");
+
+    var buf: [128]u8 = undefined;
+    var out = std.Io.Writer.fixed(&buf);
+    try id.writeStamp(&out);
+    try std.testing.expect(id.matches(out.buffered()));
+    try std.testing.expect(!id.matches("driver 565.77\ngpu GPU-1234\n"));
+    try std.testing.expect(!id.matches("driver 570.86\n"));
+}
+
+test "stale caches" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+    try tmp.dir.makePath("steamapps/shadercache/1091500/fozpipelinesv6");
+    try tmp.dir.writeFile(.{ .sub_path = "steamapps/shadercache/1091500/fozpipelinesv6/steamapp_pipeline_cache.foz", .data = "pipelines" });
+    try tmp.dir.makePath("steamapps/shadercache/570/fozpipelinesv6");
+
+    var id = Identity{};
+    @memcpy(id.driver[0..6], "570.86");
+    @memcpy(id.gpu_uuid[0..8], "GPU-1234");
+
+    var arena = std.heap.ArenaAllocator.init(std.testing.allocator);
+    defer arena.deinit();
+    var root_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const root = try tmp.dir.realpath(".", &root_buf);
+
+    // The empty app has nothing to replay
+    const caches = try findStale(arena.allocator(), &id, &.{root});
+    try std.testing.expectEqual(@as(usize, 1), caches.len);
+    try std.testing.expectEqualStrings("1091500", caches[0].name);
+    try std.testing.expectEqual(@as(u64, 9), caches[0].bytes);
+
+    var cache_buf: [std.fs.max_path_bytes]u8 = undefined;
+    const driver_cache = try driverCachePath(&cache_buf, &caches[0]);
+    try std.testing.expect(std.mem.endsWith(u8, driver_cache, "steamapps/shadercache/1091500/nvidiav1"));
+
+    // Stamped for this identity: fresh; for another driver: stale again
+    try writeStampFile(&caches[0], &id);
+    try std.testing.expectEqual(@as(usize, 0), (try findStale(arena.allocator(), &id, &.{root})).len);
+    @memcpy(id.driver[0..6], "575.51");
+    try std.testing.expectEqual(@as(usize, 1), (try findStale(arena.allocator(), &id, &.{root})).len);
+}
+
+test "library folders" {
+    const vdf =
+        \\"libraryfolders"
+        \\{
+        \\	"0"
+        \\	{
+        \\		"path"		"/home/user/.local/share/Steam"
+        \\		"label"		""
+        \\	}
+        \\	"1"
+        \\	{
+        \\		"path"		"/mnt/games/SteamLibrary"
+        \\	}
+        \\}
+    ;
+    var it = LibraryPaths.init(vdf);
+    try std.testing.expectEqualStrings("/home/user/.local/share/Steam", it.next().?);
+    try std.testing.expectEqualStrings("/mnt/games/SteamLibrary", it.next().?);
+    try std.testing.expect(it.next() == null);
+}
+
+test "idle core ranking" {
+    var before: [4]CpuTimes = undefined;
+    var after: [4]CpuTimes = undefined;
+    const n0 = parseProcStat(
+        \\cpu  400 0 0 400 0 0 0 0 0 0
+        \\cpu0 100 0 0 100 0 0 0 0 0 0
+        \\cpu1 100 0 0 100 0 0 0 0 0 0
+        \\cpu2 100 0 0 100 0 0 0 0 0 0
+        \\intr 12345 0 0
+    , &before);
+    // cpu0 fully busy, cpu1 idle, cpu2 half busy
+    const n1 = parseProcStat(
+        \\cpu  500 0 0 500 0 0 0 0 0 0
+        \\cpu0 200 0 0 100 0 0 0 0 0 0
+        \\cpu1 100 0 0 200 0 0 0 0 0 0
+        \\cpu2 150 0 0 150 0 0 0 0 0 0
+    , &after);
+    try std.testing.expectEqual(@as(usize, 3), n0);
+
+    var out: [2]usize = undefined;
+    try std.testing.expectEqual(@as(usize, 2), rankIdle(before[0..n0], after[0..n1], &out));
+    try std.testing.expectEqual(@as(usize, 1), out[0]);
+    try std.testing.expectEqual(@as(usize, 2), out[1]);
+}
+
+test "work stealing drains every job once" {
+    var queues: [3]Deque = undefined;
+    var slots: [7]u32 = undefined;
+    deal(&queues, &slots, slots.len);
+
+    // Each owner starts on its largest job (lowest index)
+    try std.testing.expectEqual(@as(?u32, 0), queues[0].pop());
+    try std.testing.expectEqual(@as(?u32, 2), queues[2].pop());
+
+    var seen = [_]bool{false} ** 7;
+    seen[0] = true;
+    seen[2] = true;
+    var s = Scheduler{ .allocator = std.testing.allocator, .arena = undefined, .config = .{}, .identity = .{}, .queues = &queues };
+    while (s.nextJob(1)) |job| {
+        try std.testing.expect(!seen[job]);
+        seen[job] = true;
+    }
+    for (seen) |hit| try std.testing.expect(hit);
+}
@@ -0,0 +1,302 @@
+//! nvstream/bitrate - Adaptive Bitrate Controller
+//!
+//! Closed-loop congestion control in the spirit of Google Congestion Control:
+//! a loss-based controller (back off above 10% loss, hold between 2% and 10%),
+//! a delay-based overuse detector on RTT against its running minimum, and a
+//! sender-side signal from the encode and socket queues. The target rate
+//! grows multiplicatively far from the last congestion point and additively
+//! near it. When the rate leaves too few bits per pixel the output resolution
+//! steps down a rung, and it steps back up once there is sustained headroom.
+//!
+//! Decisions only retarget the encoder. A keyframe is requested only when
+//! loss exceeds what forward error correction can repair.
+
+const std = @import("std");
+
+/// Output scale rungs relative to the configured resolution, in eighths
+pub const scale_ladder = [_]u8{ 8, 6, 5, 4 };
+
+/// Controller state
+pub const State = enum(u8) {
+    increase,
+    hold,
+    decrease,
+};
+
+/// Controller configuration
+pub const Config = struct {
+    /// Bitrate ceiling (the preset or configured bitrate)
+    max_kbps: u32,
+    /// Bitrate floor
+    min_kbps: u32 = 1500,
+    /// Starting rate; 0 starts at the ceiling
+    start_kbps: u32 = 0,
+    /// Pixels per second at full scale (width * height * framerate)
+    pixel_rate: u64,
+    /// Target frame rate, for per-frame byte budgets
+    framerate: u32 = 60,
+    /// Allow stepping the output resolution down the ladder
+    allow_scaling: bool = true,
+    /// Loss FEC can repair, in percent; beyond it a keyframe is requested
+    fec_percentage: u8 = 20,
+};
+
+/// Signals sampled for one controller update
+pub const Feedback = struct {
+    /// Loss over the last report interval, in percent.
+    /// Null for updates between receiver reports (queue and delay signals only).
+    loss_percent: ?f32 = null,
+    /// Round-trip time; 0 if unknown
+    rtt_ms: u32 = 0,
+    /// Frames waiting for the encoder and the configured queue depth
+    encode_queue_depth: u32 = 0,
+    queue_capacity: u32 = 1,
+    /// Bytes still queued in the socket send buffer
+    socket_queue_bytes: u32 = 0,
+};
+
+/// Controller output
+pub const Decision = struct {
+    bitrate_kbps: u32,
+    /// Index into `scale_ladder`
+    scale_index: u8,
+    /// Request a keyframe (loss beyond FEC)
+    keyframe: bool = false,
+    /// Bitrate or scale moved enough to be worth reconfiguring the encoder
+    changed: bool = false,
+
+    /// Output dimension for a full-scale dimension, kept even for 4:2:0
+    pub fn scaled(self: Decision, full: u32) u32 {
+        return (full * scale_ladder[self.scale_index] / 8) & ~@as(u32, 1);
+    }
+};
+
+/// Bits per pixel below which the controller trades resolution for quality
+const downscale_bpp = 0.04;
+/// Bits per pixel the next larger rung must have before stepping back up
+const upscale_bpp = 0.07;
+const downscale_hold_ns = 1 * std.time.ns_per_s;
+const upscale_hold_ns = 4 * std.time.ns_per_s;
+const keyframe_min_interval_ns = 1 * std.time.ns_per_s;
+
+pub const Controller = struct {
+    config: Config,
+    state: State = .increase,
+    /// Verdict of the loss-based controller at the last receiver report
+    loss_state: State = .increase,
+    target_kbps: f64,
+    /// Rate at the last congestion event; growth turns additive near it
+    congestion_kbps: f64 = 0,
+    scale_index: u8 = 0,
+
+    min_rtt_ms: f64 = 0,
+    srtt_ms: f64 = 0,
+
+    last_update_ns: u64 = 0,
+    last_decrease_ns: u64 = 0,
+    last_keyframe_ns: u64 = 0,
+    /// When the current scaling condition started holding (0 = not holding)
+    scale_pending_since_ns: u64 = 0,
+
+    /// Last decision the encoder was told about
+    applied_kbps: u32,
+    applied_scale: u8 = 0,
+
+    const Self = @This();
+
+    pub fn init(config: Config) Self {
+        const max = @max(config.max_kbps, config.min_kbps);
+        const start = if (config.start_kbps == 0) max else std.math.clamp(config.start_kbps, config.min_kbps, max);
+        return .{
+            .config = config,
+            .target_kbps = @floatFromInt(start),
+            .applied_kbps = start,
+        };
+    }
+
+    /// Change the ceiling (e.g. after a quality preset change)
+    pub fn setMaxBitrate(self: *Self, kbps: u32) void {
+        self.config.max_kbps = kbps;
+        self.target_kbps = @min(self.target_kbps, @as(f64, @floatFromInt(@max(kbps, self.config.min_kbps))));
+    }
+
+    pub fn update(self: *Self, feedback: Feedback, now_ns: u64) Decision {
+        const dt_s: f64 = if (self.last_update_ns == 0) 0 else @as(f64, @floatFromInt(now_ns -| self.last_update_ns)) / std.time.ns_per_s;
+        self.last_update_ns = now_ns;
+
+        const overuse = self.updateDelay(feedback) or self.queueCongested(feedback);
+
+        // Each report's loss is acted on once; later ticks only keep holding
+        var loss: f64 = 0;
+        if (feedback.loss_percent) |percent| {
+            loss = @as(f64, percent) / 100.0;
+            self.loss_state = if (loss > 0.10) .decrease else if (loss > 0.02) .hold else .increase;
+        }
+
+        if (loss > 0.10 or overuse) {
+            self.state = .decrease;
+            // At most one back-off per RTT so one episode is not counted twice
+            const rtt_ns: u64 = @intFromFloat(@max(self.srtt_ms, 100) * std.time.ns_per_ms);
+            if (now_ns -| self.last_decrease_ns >= rtt_ns) {
+                self.congestion_kbps = self.target_kbps;
+                const factor = if (loss > 0.10) 1.0 - 0.5 * loss else 0.85;
+                self.target_kbps *= factor;
+                self.last_decrease_ns = now_ns;
+            }
+        } else if (self.loss_state != .increase) {
+            self.state = .hold;
+        } else {
+            self.state = .increase;
+            if (self.congestion_kbps == 0 or self.target_kbps < self.congestion_kbps * 0.9) {
+                // Far from the last congestion point: probe quickly (8%/s)
+                self.target_kbps *= std.math.pow(f64, 1.08, dt_s);
+            } else {
+                // Near it: creep up by 2% of the congestion rate per second
+                self.target_kbps += self.congestion_kbps * 0.02 * dt_s;
+            }
+        }
+
+        const min: f64 = @floatFromInt(self.config.min_kbps);
+        const max: f64 = @floatFromInt(@max(self.config.max_kbps, self.config.min_kbps));
+        self.target_kbps = std.math.clamp(self.target_kbps, min, max);
+
+        if (self.config.allow_scaling) self.updateScale(now_ns);
+
+        var decision = Decision{
+            .bitrate_kbps = @intFromFloat(self.target_kbps),
+            .scale_index = self.scale_index,
+        };
+
+        // Loss FEC cannot repair leaves the decoder without references
+        const reported_loss = feedback.loss_percent orelse 0;
+        if (reported_loss > @as(f32, @floatFromInt(self.config.fec_percentage)) and
+            now_ns -| self.last_keyframe_ns >= keyframe_min_interval_ns)
+        {
+            decision.keyframe = true;
+            self.last_keyframe_ns = now_ns;
+        }
+
+        // Skip reconfigures for changes under 5%
+        const delta = @abs(@as(f64, @floatFromInt(decision.bitrate_kbps)) - @as(f64, @floatFromInt(self.applied_kbps)));
+        if (delta > @as(f64, @floatFromInt(self.applied_kbps)) * 0.05 or decision.scale_index != self.applied_scale) {
+            decision.changed = true;
+            self.applied_kbps = decision.bitrate_kbps;
+            self.applied_scale = decision.scale_index;
+        }
+        return decision;
+    }
+
+    /// Delay-based overuse: smoothed RTT well above the path's minimum
+    fn updateDelay(self: *Self, feedback: Feedback) bool {
+        if (feedback.rtt_ms == 0) return false;
+        const rtt: f64 = @floatFromInt(feedback.rtt_ms);
+        if (self.srtt_ms == 0) {
+            self.srtt_ms = rtt;
+            self.min_rtt_ms = rtt;
+            return false;
+        }
+        self.srtt_ms += (rtt - self.srtt_ms) / 8.0;
+        if (rtt < self.min_rtt_ms) {
+            self.min_rtt_ms = rtt;
+        } else {
+            // Let the baseline follow slow route changes
+            self.min_rtt_ms += (rtt - self.min_rtt_ms) * 0.002;
+        }
+        return self.srtt_ms > self.min_rtt_ms + @max(10.0, self.min_rtt_ms * 0.25);
+    }
+
+    /// Sender-side congestion: the encoder backlog is full or the socket
+    /// buffer is holding more than two frames of data
+    fn queueCongested(self: *const Self, feedback: Feedback) bool {
+        if (feedback.queue_capacity > 0 and feedback.encode_queue_depth >= feedback.queue_capacity) return true;
+        const frame_bytes = self.target_kbps * 1000.0 / 8.0 / @as(f64, @floatFromInt(@max(self.config.framerate, 1)));
+        return @as(f64, @floatFromInt(feedback.socket_queue_bytes)) > frame_bytes * 2;
+    }
+
+    fn bitsPerPixel(self: *const Self, scale_index: usize) f64 {
+        const s: f64 = @as(f64, @floatFromInt(scale_ladder[scale_index])) / 8.0;
+        const pixels = @as(f64, @floatFromInt(@max(self.config.pixel_rate, 1))) * s * s;
+        return self.target_kbps * 1000.0 / pixels;
+    }
+
+    fn updateScale(self: *Self, now_ns: u64) void {
+        const down = self.scale_index + 1 < scale_ladder.len and self.bitsPerPixel(self.scale_index) < downscale_bpp;
+        const up = self.scale_index > 0 and self.state == .increase and self.bitsPerPixel(self.scale_index - 1) > upscale_bpp;
+
+        if (!down and !up) {
+            self.scale_pending_since_ns = 0;
+            return;
+        }
+        if (self.scale_pending_since_ns == 0) {
+            self.scale_pending_since_ns = now_ns;
+            return;
+        }
+        const held = now_ns -| self.scale_pending_since_ns;
+        if (down and held >= downscale_hold_ns) {
+            self.scale_index += 1;
+            self.scale_pending_since_ns = 0;
+        } else if (up and held >= upscale_hold_ns) {
+            self.scale_index -= 1;
+            self.scale_pending_since_ns = 0;
+        }
+    }
+};
+
+// 1080p60
+const test_pixel_rate = 1920 * 1080 * 60;
+
+test "backs off on loss and recovers" {
+    var ctl = Controller.init(.{ .max_kbps = 20000, .pixel_rate = test_pixel_rate });
+    var now: u64 = std.time.ns_per_s;
+    _ = ctl.update(.{}, now);
+
+    now += 100 * std.time.ns_per_ms;
+    const lossy = ctl.update(.{ .loss_percent = 15 }, now);
+    try std.testing.expectEqual(State.decrease, ctl.state);
+    try std.testing.expect(lossy.changed);
+    try std.testing.expect(!lossy.keyframe); // FEC covers 15%
+    try std.testing.expect(lossy.bitrate_kbps < 20000 * 0.95);
+
+    // Moderate loss holds the rate
+    now += 100 * std.time.ns_per_ms;
+    const held = ctl.update(.{ .loss_percent = 5 }, now);
+    try std.testing.expectEqual(lossy.bitrate_kbps, held.bitrate_kbps);
+
+    // Ticks between reports keep holding
+    now += 100 * std.time.ns_per_ms;
+    try std.testing.expectEqual(lossy.bitrate_kbps, ctl.update(.{}, now).bitrate_kbps);
+
+    // Clean link: climbs back to the ceiling
+    _ = ctl.update(.{ .loss_percent = 0 }, now);
+    for (0..600) |_| {
+        now += 100 * std.time.ns_per_ms;
+        _ = ctl.update(.{}, now);
+    }
+    try std.testing.expectEqual(@as(f64, 20000), ctl.target_kbps);
+}
+
+test "keyframe only on unrecoverable loss" {
+    var ctl = Controller.init(.{ .max_kbps = 20000, .pixel_rate = test_pixel_rate, .fec_percentage = 20 });
+    const now: u64 = std.time.ns_per_s;
+    try std.testing.expect(!ctl.update(.{ .loss_percent = 19 }, now).keyframe);
+    try std.testing.expect(ctl.update(.{ .loss_percent = 30 }, now + 1).keyframe);
+    // Rate limited while the loss persists
+    try std.testing.expect(!ctl.update(.{ .loss_percent = 30 }, now + 2).keyframe);
+}
+
+test "delay overuse and resolution step down" {
+    var ctl = Controller.init(.{ .max_kbps = 20000, .min_kbps = 1000, .pixel_rate = test_pixel_rate });
+    var now: u64 = std.time.ns_per_s;
+    _ = ctl.update(.{ .rtt_ms = 20 }, now);
+
+    // Bufferbloat: RTT climbs far above its minimum with no loss
+    var decision: Decision = undefined;
+    for (0..100) |_| {
+        now += 100 * std.time.ns_per_ms;
+        decision = ctl.update(.{ .rtt_ms = 200 }, now);
+    }
+    try std.testing.expectEqual(@as(u32, 1000), decision.bitrate_kbps);
+    // 1 Mbit/s at 1080p60 is far below the bits-per-pixel floor
+    try std.testing.expect(decision.scale_index > 0);
+    try std.testing.expect(decision.scaled(1920) < 1920);
+}
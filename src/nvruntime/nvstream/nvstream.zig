@@ -5,6 +5,15 @@
 
 const std = @import("std");
 
+pub const zerocopy = @import("zerocopy.zig");
+pub const pipeline = @import("pipeline.zig");
+pub const pool = @import("pool.zig");
+pub const rtp = @import("rtp.zig");
+pub const udp = @import("udp.zig");
+pub const bitrate = @import("bitrate.zig");
+const trace = @import("../../nvmon/trace.zig");
+const nvmon = @import("../../nvmon/nvmon.zig");
+
 pub const version = "0.1.0";
 
 // ============================================================================
@@ -75,6 +84,14 @@ pub const VideoCodec = enum(u8) {
             .av1 => "main",
         };
     }
+
+    pub fn payloadFormat(self: VideoCodec) rtp.PayloadFormat {
+        return switch (self) {
+            .h264 => .h264,
+            .hevc => .hevc,
+            .av1 => .av1,
+        };
+    }
 };
 
 /// Audio codec for streaming
@@ -124,11 +141,65 @@ pub const StreamConfig = struct {
     // Network settings
     max_packet_size: u16 = 1400, // MTU-friendly
     fec_percentage: u8 = 20, // Forward error correction
+    use_gso: bool = true, // Coalesce RTP fragments with UDP GSO
+    pacing_kbps: u32 = 0, // 0 = send each frame as one burst
+
+    // Adaptive bitrate: quality_preset / video_bitrate_kbps become the ceiling
+    adaptive_bitrate: bool = true,
+    min_bitrate_kbps: u32 = 1500,
+    adaptive_resolution: bool = true, // Step resolution down when bits per pixel run low
 
     // HDR
     hdr_enabled: bool = false,
     hdr_format: HdrFormat = .hdr10,
 
+    // Capture
+    capture_mode: CaptureMode = .system_memory,
+    cuda_device: u32 = 0,
+
+    // Pipeline: capture, encode and transport run on their own threads
+    pipelined: bool = true,
+    queue_depth: u8 = 2, // Frames queued between stages (1..pipeline.max_depth)
+    capture_drop_policy: pipeline.DropPolicy = .drop_oldest,
+    encode_drop_policy: pipeline.DropPolicy = .block,
+
+    /// Bytes needed for one uncompressed captured frame
+    pub fn frameBufferSize(self: StreamConfig) usize {
+        const pixels = @as(usize, self.resolution.width) * self.resolution.height;
+        // NV12 is 12 bpp; P010 doubles it for HDR
+        return if (self.hdr_enabled) pixels * 3 else pixels * 3 / 2;
+    }
+
+    /// Bytes reserved for one encoded frame: a few times the average frame
+    /// size so keyframes fit without reallocating
+    pub fn packetBufferSize(self: StreamConfig) usize {
+        const avg_bytes = @as(usize, self.getEffectiveBitrate()) * 1000 / 8 / @max(self.framerate, 1);
+        return @max(avg_bytes * 4, 256 * 1024);
+    }
+
+    /// Buffer pool sized for this stream: packets and frames in flight
+    pub fn bufferPoolConfig(self: StreamConfig) pool.PoolConfig {
+        const depth: u16 = std.math.clamp(self.queue_depth, 1, pipeline.max_depth);
+        // Every queue slot, plus one held by each stage on either side of it.
+        // A drop_oldest eviction releases its buffer before the capture
+        // stage asks for the next one, so this covers the encoder's hold too.
+        const in_flight: u16 = if (self.pipelined) depth + 2 else 1;
+        const packet_size = self.packetBufferSize();
+        const frame_size = self.frameBufferSize();
+
+        var config = pool.PoolConfig{};
+        if (self.capture_mode == .system_memory and frame_size > packet_size) {
+            config.classes[0] = .{ .size = packet_size, .count = in_flight };
+            config.classes[1] = .{ .size = frame_size, .count = in_flight };
+        } else if (self.capture_mode == .system_memory) {
+            config.classes[0] = .{ .size = @max(frame_size, packet_size), .count = in_flight * 2 };
+        } else {
+            // Zero-copy frames stay on the GPU; only packets need CPU buffers
+            config.classes[0] = .{ .size = packet_size, .count = in_flight };
+        }
+        return config;
+    }
+
     pub fn getEffectiveBitrate(self: StreamConfig) u32 {
         if (self.quality_preset) |preset| {
             return preset.getTargetBitrate(self.resolution);
@@ -169,22 +240,41 @@ pub const CaptureSource = enum(u8) {
     pipewire, // PipeWire screen capture
 };
 
+/// Where captured pixels live on their way to the encoder
+pub const CaptureMode = enum(u8) {
+    system_memory, // Read back into a reusable CPU buffer
+    zero_copy, // DMA-BUF/NvFBC surface imported into CUDA, read by NVENC in place
+};
+
 /// Captured frame
 pub const CapturedFrame = struct {
+    /// CPU pixels (system_memory mode)
     data: ?[]u8,
     width: u32,
     height: u32,
     stride: u32,
     format: PixelFormat,
+    /// Capture start, CLOCK_MONOTONIC
     timestamp_ns: i64,
     dma_buf_fd: ?i32, // For zero-copy
+    /// GPU-resident pixels (zero_copy mode)
+    surface: ?zerocopy.GpuSurface = null,
     is_hdr: bool,
+    /// Pool buffer backing `data`, released with the frame
+    lease: ?pool.Lease = null,
+    /// Whether `data` was allocated for this frame alone (no pool)
+    owns_data: bool = false,
+    /// Trace frame ID of the presented frame this capture holds
+    frame_id: u64 = 0,
 
     pub fn deinit(self: *CapturedFrame, allocator: std.mem.Allocator) void {
-        if (self.data) |d| {
-            allocator.free(d);
-            self.data = null;
+        if (self.surface) |*surface| surface.release();
+        if (self.lease) |lease| lease.release();
+        self.lease = null;
+        if (self.owns_data) {
+            if (self.data) |d| allocator.free(d);
         }
+        self.data = null;
     }
 };
 
@@ -200,6 +290,7 @@ pub const PixelFormat = enum(u8) {
 /// Capture context
 pub const CaptureContext = struct {
     source: CaptureSource,
+    mode: CaptureMode,
     target_fps: u32,
     frame_count: u64,
     last_capture_ns: i64,
@@ -208,9 +299,20 @@ pub const CaptureContext = struct {
     // NVFBC handle (opaque for C interop)
     nvfbc_handle: ?*anyopaque,
 
+    /// Capture size (system_memory mode)
+    resolution: Resolution = Resolution.r1080p,
+    /// Frame buffers (system_memory mode); without a pool each frame is allocated
+    buffer_pool: ?*pool.BufferPool = null,
+
+    /// CUDA import cache (zero_copy mode)
+    importer: ?zerocopy.Importer = null,
+    /// Latest DMA-BUF handed over by the capture backend
+    pending_dmabuf: ?zerocopy.DmaBufDesc = null,
+
     pub fn init(source: CaptureSource, target_fps: u32) CaptureContext {
         return .{
             .source = source,
+            .mode = .system_memory,
             .target_fps = target_fps,
             .frame_count = 0,
             .last_capture_ns = 0,
@@ -219,37 +321,109 @@ pub const CaptureContext = struct {
         };
     }
 
+    /// Create a capture context that hands frames to NVENC without leaving the GPU
+    pub fn initZeroCopy(source: CaptureSource, target_fps: u32, cuda_device: u32) !CaptureContext {
+        var ctx = init(source, target_fps);
+        ctx.mode = .zero_copy;
+        ctx.importer = try zerocopy.Importer.init(cuda_device);
+        return ctx;
+    }
+
+    /// Hand the next DMA-BUF to the context (PipeWire/compositor capture callback).
+    /// The fd stays owned by the caller; it is imported once and cached.
+    pub fn submitDmaBuf(self: *CaptureContext, desc: zerocopy.DmaBufDesc) void {
+        self.pending_dmabuf = desc;
+    }
+
     pub fn captureFrame(self: *CaptureContext, allocator: std.mem.Allocator) !CapturedFrame {
-        const start = std.time.nanoTimestamp();
+        const start = nvmon.timestampNs();
+        const span = trace.beginTimed(.nvstream, "capture", trace.currentFrame());
 
-        // TODO: Actual NVFBC/PipeWire capture
-        // For now, allocate placeholder frame
-        const frame_size = 1920 * 1080 * 3 / 2; // NV12
-        const data = try allocator.alloc(u8, frame_size);
+        var frame = switch (self.mode) {
+            .system_memory => try self.captureToMemory(allocator),
+            .zero_copy => try self.captureToSurface(),
+        };
+        frame.timestamp_ns = @intCast(start);
+        frame.frame_id = span.frame;
 
-        const end = std.time.nanoTimestamp();
-        self.capture_latency_us = @intCast(@divFloor(end - start, 1000));
+        const elapsed = span.end();
+        self.capture_latency_us = @intCast(@min(elapsed / std.time.ns_per_us, std.math.maxInt(u32)));
         self.frame_count += 1;
-        self.last_capture_ns = end;
+        self.last_capture_ns = @intCast(start + elapsed);
 
-        return CapturedFrame{
-            .data = data,
-            .width = 1920,
-            .height = 1080,
-            .stride = 1920,
+        return frame;
+    }
+
+    fn captureToMemory(self: *CaptureContext, allocator: std.mem.Allocator) !CapturedFrame {
+        // TODO: Actual NVFBC/PipeWire capture
+        const width = self.resolution.width;
+        const height = self.resolution.height;
+        const frame_size = @as(usize, width) * height * 3 / 2; // NV12
+
+        var frame = CapturedFrame{
+            .data = null,
+            .width = width,
+            .height = height,
+            .stride = width,
             .format = .nv12,
-            .timestamp_ns = start,
+            .timestamp_ns = 0,
             .dma_buf_fd = null,
             .is_hdr = false,
         };
+
+        if (self.buffer_pool) |buffers| {
+            const lease = buffers.acquire(frame_size) orelse return error.PoolExhausted;
+            frame.lease = lease;
+            frame.data = lease.data[0..frame_size];
+        } else {
+            frame.data = try allocator.alloc(u8, frame_size);
+            frame.owns_data = true;
+        }
+        return frame;
+    }
+
+    fn captureToSurface(self: *CaptureContext) !CapturedFrame {
+        const importer = &(self.importer orelse return error.ZeroCopyUnavailable);
+        // TODO: NvFBC NVFBC_TOCUDA grabs hand out device pointers directly
+        const desc = self.pending_dmabuf orelse return error.NoFrameAvailable;
+        self.pending_dmabuf = null;
+
+        const format = try formatFromFourcc(desc.fourcc);
+        const surface = try importer.import(desc);
+        return CapturedFrame{
+            .data = null,
+            .width = desc.width,
+            .height = desc.height,
+            .stride = desc.pitch,
+            .format = format,
+            .timestamp_ns = 0,
+            .dma_buf_fd = desc.fd,
+            .surface = surface,
+            .is_hdr = format == .p010,
+        };
     }
 
     pub fn deinit(self: *CaptureContext) void {
         // TODO: Release NVFBC handle
-        _ = self;
+        if (self.importer) |*importer| importer.deinit();
+        self.importer = null;
     }
 };
 
+/// Map a DRM fourcc to the encoder pixel format
+fn formatFromFourcc(fourcc: u32) !PixelFormat {
+    return switch (fourcc) {
+        fourccCode("NV12") => .nv12,
+        fourccCode("P010") => .p010,
+        fourccCode("AB24") => .rgba,
+        fourccCode("AR24") => .bgra,
+        fourccCode("AR30") => .argb10,
+        else => error.UnsupportedFormat,
+    };
+}
+
+const fourccCode = zerocopy.fourccCode;
+
 // ============================================================================
 // Encoder System
 // ============================================================================
@@ -262,6 +436,21 @@ pub const EncodedPacket = struct {
     is_keyframe: bool,
     is_sps_pps: bool, // Contains codec config
     encode_latency_us: u32,
+    /// Pool buffer backing `data`
+    lease: ?pool.Lease = null,
+    /// Set when `data` was allocated for this packet alone (no pool)
+    allocator: ?std.mem.Allocator = null,
+    /// Trace frame ID carried over from the captured frame
+    frame_id: u64 = 0,
+
+    /// Return the packet's buffer (TransportContext.sendEncoded does this after sending)
+    pub fn deinit(self: *EncodedPacket) void {
+        if (self.lease) |lease| lease.release();
+        self.lease = null;
+        if (self.allocator) |alloc| alloc.free(@constCast(self.data));
+        self.allocator = null;
+        self.data = &[_]u8{};
+    }
 };
 
 /// Encoder context
@@ -275,6 +464,20 @@ pub const EncoderContext = struct {
     nvenc_handle: ?*anyopaque,
     cuda_context: ?*anyopaque,
 
+    /// Bitstream buffers; without a pool each packet is allocated
+    buffer_pool: ?*pool.BufferPool = null,
+
+    /// Current rate control target and output size
+    bitrate_kbps: u32,
+    resolution: Resolution,
+    /// Next frame is coded as an IDR
+    force_keyframe: bool = false,
+    /// Next frame carries fresh parameter sets (after a resolution change)
+    send_parameter_sets: bool = false,
+
+    /// NVENC input registrations, one per zero-copy import slot
+    registered_inputs: [zerocopy.Importer.max_slots]?u64 = [_]?u64{null} ** zerocopy.Importer.max_slots,
+
     pub fn init(config: StreamConfig) !EncoderContext {
         return .{
             .config = config,
@@ -283,38 +486,84 @@ pub const EncoderContext = struct {
             .avg_encode_time_us = 0,
             .nvenc_handle = null,
             .cuda_context = null,
+            .bitrate_kbps = config.getEffectiveBitrate(),
+            .resolution = config.resolution,
         };
     }
 
+    /// Retarget bitrate without restarting the GOP; a new output size
+    /// starts one with an IDR
+    pub fn reconfigure(self: *EncoderContext, bitrate_kbps: u32, resolution: Resolution) void {
+        if (bitrate_kbps == self.bitrate_kbps and std.meta.eql(resolution, self.resolution)) return;
+        // TODO: nvEncReconfigureEncoder with NV_ENC_RECONFIGURE_PARAMS
+        // { .resetEncoder = 0, .forceIDR = <size changed> } and the new
+        // averageBitRate / vbvBufferSize (one frame at the new rate) and encodeWidth/Height
+        if (!std.meta.eql(resolution, self.resolution)) {
+            // New sequence parameters only take effect at an IDR
+            self.send_parameter_sets = true;
+            self.force_keyframe = true;
+        }
+        self.bitrate_kbps = bitrate_kbps;
+        self.resolution = resolution;
+    }
+
+    /// Code the next frame as an IDR (decoder lost its references)
+    pub fn requestKeyframe(self: *EncoderContext) void {
+        self.force_keyframe = true;
+    }
+
+    /// Make sure a GPU surface is registered as an NVENC input resource.
+    /// Surfaces map to import slots, so registration happens once per buffer.
+    fn registerInput(self: *EncoderContext, surface: zerocopy.GpuSurface) void {
+        if (self.registered_inputs[surface.slot] == surface.device_ptr) return;
+        // TODO: nvEncUnregisterResource on the old pointer, then
+        // nvEncRegisterResource(NV_ENC_INPUT_RESOURCE_TYPE_CUDADEVICEPTR)
+        self.registered_inputs[surface.slot] = surface.device_ptr;
+    }
+
+    /// The returned packet owns its buffer until `EncodedPacket.deinit`.
     pub fn encodeFrame(self: *EncoderContext, frame: *const CapturedFrame, allocator: std.mem.Allocator) !?EncodedPacket {
-        const start = std.time.nanoTimestamp();
+        const span = trace.beginTimed(.nvstream, "encode", frame.frame_id);
 
         // TODO: Actual NVENC encoding
-        // 1. Upload frame to GPU (or use DMA-BUF)
+        // 1. Map the registered input (zero-copy) or upload `frame.data`
         // 2. Submit to NVENC
-        // 3. Wait for encoded data
+        // 3. Lock the bitstream and copy it into a pooled buffer
+        if (frame.surface) |surface| self.registerInput(surface);
 
-        const is_keyframe = (self.frame_count % self.keyframe_interval) == 0;
+        const is_keyframe = self.force_keyframe or (self.frame_count % self.keyframe_interval) == 0;
+        const has_parameter_sets = is_keyframe or self.send_parameter_sets;
+        self.force_keyframe = false;
+        self.send_parameter_sets = false;
         self.frame_count += 1;
 
         // Placeholder encoded data
         const encoded_size: usize = if (is_keyframe) 50000 else 10000;
-        const encoded_data = try allocator.alloc(u8, encoded_size);
+        var packet = EncodedPacket{
+            .data = &[_]u8{},
+            .pts = frame.timestamp_ns,
+            .dts = frame.timestamp_ns,
+            .is_keyframe = is_keyframe,
+            .is_sps_pps = has_parameter_sets,
+            .encode_latency_us = 0,
+            .frame_id = frame.frame_id,
+        };
+        if (self.buffer_pool) |buffers| {
+            const lease = buffers.acquire(encoded_size) orelse return error.PoolExhausted;
+            packet.lease = lease;
+            packet.data = lease.data[0..encoded_size];
+        } else {
+            packet.data = try allocator.alloc(u8, encoded_size);
+            packet.allocator = allocator;
+        }
 
-        const end = std.time.nanoTimestamp();
-        const encode_time: u32 = @intCast(@divFloor(end - start, 1000));
+        const encode_time: u32 = @intCast(@min(span.end() / std.time.ns_per_us, std.math.maxInt(u32)));
 
         // Update rolling average
         self.avg_encode_time_us = (self.avg_encode_time_us * 7 + encode_time) / 8;
 
-        return EncodedPacket{
-            .data = encoded_data,
-            .pts = frame.timestamp_ns,
-            .dts = frame.timestamp_ns,
-            .is_keyframe = is_keyframe,
-            .is_sps_pps = is_keyframe,
-            .encode_latency_us = encode_time,
-        };
+        packet.encode_latency_us = encode_time;
+        return packet;
     }
 
     pub fn deinit(self: *EncoderContext) void {
@@ -344,6 +593,19 @@ pub const NetworkStats = struct {
     jitter_ms: u32,
     bandwidth_kbps: u32,
 
+    // Batched send path
+    batches_sent: u64 = 0,
+    send_syscalls: u64 = 0,
+    /// Datagrams the peer refused (nothing listening)
+    packets_refused: u64 = 0,
+    /// Packets in the most recent batch
+    last_batch_packets: u32 = 0,
+    last_batch_send_us: u32 = 0,
+    avg_batch_send_us: u32 = 0,
+    max_batch_send_us: u32 = 0,
+    /// Bytes still queued in the socket send buffer after the last batch
+    socket_queue_bytes: u32 = 0,
+
     pub fn packetLossPercent(self: NetworkStats) f32 {
         if (self.packets_sent == 0) return 0;
         return @as(f32, @floatFromInt(self.packets_lost)) / @as(f32, @floatFromInt(self.packets_sent)) * 100.0;
@@ -356,9 +618,17 @@ pub const TransportContext = struct {
     host: [256]u8,
     host_len: usize,
     port: u16,
+    /// Written by the send stage and receiver reports; read through `getStats`
     stats: NetworkStats,
+    stats_mutex: std.Thread.Mutex = .{},
     connected: bool,
 
+    // RTP over UDP
+    packetizer: rtp.Packetizer,
+    send_config: udp.Config = .{},
+    sender: ?udp.Sender = null,
+    batch: ?*rtp.Batch = null,
+
     pub fn init(protocol: TransportProtocol, host: []const u8, port: u16) TransportContext {
         var ctx = TransportContext{
             .protocol = protocol,
@@ -367,24 +637,103 @@ pub const TransportContext = struct {
             .port = port,
             .stats = std.mem.zeroes(NetworkStats),
             .connected = false,
+            .packetizer = rtp.Packetizer.init(.hevc, std.crypto.random.int(u32), 1400),
         };
         @memcpy(ctx.host[0..ctx.host_len], host[0..ctx.host_len]);
         return ctx;
     }
 
+    /// Apply codec, MTU and pacing settings; call before `connect`
+    pub fn configure(self: *TransportContext, config: StreamConfig) void {
+        self.packetizer = rtp.Packetizer.init(config.video_codec.payloadFormat(), self.packetizer.ssrc, config.max_packet_size);
+        self.send_config = .{ .use_gso = config.use_gso, .pacing_kbps = config.pacing_kbps };
+    }
+
     pub fn connect(self: *TransportContext) !void {
-        // TODO: Establish connection based on protocol
+        switch (self.protocol) {
+            .rtp_udp => {
+                // The batch is large, so keep it off the engine and the stack
+                const batch = try std.heap.page_allocator.create(rtp.Batch);
+                errdefer std.heap.page_allocator.destroy(batch);
+                batch.* = .{};
+                self.sender = try udp.Sender.open(self.host[0..self.host_len], self.port, self.send_config);
+                self.batch = batch;
+            },
+            // TODO: Establish connection for the other protocols
+            else => {},
+        }
         self.connected = true;
     }
 
     pub fn sendPacket(self: *TransportContext, data: []const u8) !void {
         if (!self.connected) return error.NotConnected;
         // TODO: Actually send data
+        self.stats_mutex.lock();
+        defer self.stats_mutex.unlock();
         self.stats.packets_sent += 1;
         self.stats.bytes_sent += data.len;
     }
 
+    /// Consistent copy of the network statistics
+    pub fn getStats(self: *TransportContext) NetworkStats {
+        self.stats_mutex.lock();
+        defer self.stats_mutex.unlock();
+        return self.stats;
+    }
+
+    /// Record what the receiver reported about the stream
+    pub fn recordReport(self: *TransportContext, report: ReceiverReport) void {
+        self.stats_mutex.lock();
+        defer self.stats_mutex.unlock();
+        self.stats.packets_lost = report.cumulative_lost;
+        self.stats.rtt_ms = report.rtt_ms;
+        self.stats.jitter_ms = report.jitter_ms;
+    }
+
+    /// Send an encoded frame and hand its buffer back to the pool.
+    /// Over RTP/UDP the frame is packetized and sent in as few sendmmsg calls as the batch allows.
+    pub fn sendEncoded(self: *TransportContext, packet: *EncodedPacket) !void {
+        defer packet.deinit();
+        if (!self.connected) return error.NotConnected;
+
+        const sender = if (self.sender) |*s| s else return self.sendPacket(packet.data);
+        const batch = self.batch.?;
+        const span = trace.begin(.nvstream, "send", packet.frame_id);
+        defer span.end();
+
+        try self.packetizer.begin(packet.data, packet.pts, packet.is_keyframe);
+        var done = false;
+        while (!done) {
+            batch.reset();
+            done = self.packetizer.fill(batch);
+
+            const start = nvmon.timestampNs();
+            const result = try sender.send(batch);
+            const elapsed_us: u32 = @intCast(@min((nvmon.timestampNs() -| start) / std.time.ns_per_us, std.math.maxInt(u32)));
+
+            self.stats_mutex.lock();
+            defer self.stats_mutex.unlock();
+            self.stats.packets_sent += result.packets;
+            self.stats.bytes_sent += result.bytes;
+            self.stats.packets_refused += result.refused;
+            self.stats.send_syscalls += result.syscalls;
+            self.stats.batches_sent += 1;
+            self.stats.last_batch_packets = @intCast(result.packets);
+            self.stats.last_batch_send_us = elapsed_us;
+            self.stats.avg_batch_send_us = (self.stats.avg_batch_send_us * 7 + elapsed_us) / 8;
+            self.stats.max_batch_send_us = @max(self.stats.max_batch_send_us, elapsed_us);
+        }
+        const queued = sender.queuedBytes();
+        self.stats_mutex.lock();
+        defer self.stats_mutex.unlock();
+        self.stats.socket_queue_bytes = queued;
+    }
+
     pub fn disconnect(self: *TransportContext) void {
+        if (self.sender) |*sender| sender.close();
+        self.sender = null;
+        if (self.batch) |batch| std.heap.page_allocator.destroy(batch);
+        self.batch = null;
         self.connected = false;
     }
 };
@@ -393,6 +742,18 @@ pub const TransportContext = struct {
 // Main Streaming Engine
 // ============================================================================
 
+/// Receiver feedback, as carried in an RTCP receiver report
+pub const ReceiverReport = struct {
+    /// Loss since the previous report, in 1/256 units
+    fraction_lost: u8 = 0,
+    cumulative_lost: u64 = 0,
+    rtt_ms: u32 = 0,
+    jitter_ms: u32 = 0,
+};
+
+/// How often the send side re-runs the rate controller between reports
+const rate_tick_ns = 100 * std.time.ns_per_ms;
+
 /// Stream statistics
 pub const StreamStats = struct {
     state: StreamState,
@@ -411,11 +772,38 @@ pub const StreamStats = struct {
 
     network: NetworkStats,
 
+    // Per-stage latency distributions
+    capture_latency: pipeline.LatencySnapshot = .{},
+    encode_latency: pipeline.LatencySnapshot = .{},
+    send_latency: pipeline.LatencySnapshot = .{},
+    /// Capture start to send complete
+    end_to_end_latency: pipeline.LatencySnapshot = .{},
+
+    // Current queue occupancy between stages
+    capture_queue_depth: u32 = 0,
+    send_queue_depth: u32 = 0,
+
     pub fn getEffectiveFps(self: StreamStats, duration_seconds: f64) f64 {
         return @as(f64, @floatFromInt(self.frames_sent)) / duration_seconds;
     }
 };
 
+/// Counters shared by the pipeline stage threads
+const StageCounters = struct {
+    frames_captured: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    frames_encoded: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    frames_sent: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    frames_dropped: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+
+    capture: pipeline.LatencyHistogram = .{},
+    encode: pipeline.LatencyHistogram = .{},
+    send: pipeline.LatencyHistogram = .{},
+    end_to_end: pipeline.LatencyHistogram = .{},
+};
+
+const FrameQueue = pipeline.SpscRing(CapturedFrame, pipeline.max_depth);
+const PacketQueue = pipeline.SpscRing(EncodedPacket, pipeline.max_depth);
+
 /// Streaming engine
 pub const StreamEngine = struct {
     allocator: std.mem.Allocator,
@@ -429,19 +817,62 @@ pub const StreamEngine = struct {
     stats: StreamStats,
     start_time_ns: i64,
 
+    /// Frame and packet buffers shared by all stages
+    buffers: pool.BufferPool,
+
+    // Pipelined mode
+    frame_queue: FrameQueue,
+    packet_queue: PacketQueue,
+    counters: StageCounters = .{},
+    threads: [3]?std.Thread = .{ null, null, null },
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
+    // Adaptive bitrate: decided on the feedback/send side, applied by the encode side
+    rate_controller: bitrate.Controller,
+    rate_mutex: std.Thread.Mutex = .{},
+    last_rate_tick_ns: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    target_bitrate_kbps: std.atomic.Value(u32),
+    target_scale: std.atomic.Value(u8) = std.atomic.Value(u8).init(0),
+    keyframe_requested: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+
     pub fn init(allocator: std.mem.Allocator, config: StreamConfig) !*StreamEngine {
         const engine = try allocator.create(StreamEngine);
 
+        errdefer allocator.destroy(engine);
+
+        var buffers = try pool.BufferPool.init(config.bufferPoolConfig());
+        errdefer buffers.deinit();
+
+        var capture = switch (config.capture_mode) {
+            .system_memory => CaptureContext.init(.nvfbc, config.framerate),
+            .zero_copy => try CaptureContext.initZeroCopy(.nvfbc, config.framerate, config.cuda_device),
+        };
+        errdefer capture.deinit();
+        capture.resolution = config.resolution;
+
+        var encoder = try EncoderContext.init(config);
+        errdefer encoder.deinit();
+
+        const depth: usize = std.math.clamp(config.queue_depth, 1, pipeline.max_depth);
+
         engine.* = StreamEngine{
             .allocator = allocator,
             .config = config,
             .state = .idle,
-            .capture = CaptureContext.init(.nvfbc, config.framerate),
-            .encoder = try EncoderContext.init(config),
+            .capture = capture,
+            .encoder = encoder,
             .transport = TransportContext.init(.rtp_udp, "0.0.0.0", 47998),
             .stats = std.mem.zeroes(StreamStats),
             .start_time_ns = 0,
+            .buffers = buffers,
+            .frame_queue = FrameQueue.init(depth),
+            .packet_queue = PacketQueue.init(depth),
+            .rate_controller = bitrate.Controller.init(rateConfig(config)),
+            .target_bitrate_kbps = std.atomic.Value(u32).init(config.getEffectiveBitrate()),
         };
+        // The pool lives inside the engine, so point the stages at it only now
+        engine.capture.buffer_pool = &engine.buffers;
+        engine.encoder.buffer_pool = &engine.buffers;
 
         return engine;
     }
@@ -452,6 +883,7 @@ pub const StreamEngine = struct {
         }
         self.capture.deinit();
         self.encoder.deinit();
+        self.buffers.deinit();
         self.allocator.destroy(self);
     }
 
@@ -460,38 +892,60 @@ pub const StreamEngine = struct {
 
         self.state = .initializing;
         self.transport = TransportContext.init(.rtp_udp, host, port);
+        self.transport.configure(self.config);
 
         try self.transport.connect();
 
-        self.start_time_ns = std.time.nanoTimestamp();
+        self.start_time_ns = @intCast(nvmon.timestampNs());
         self.state = .streaming;
         self.stats.state = .streaming;
+
+        if (self.config.pipelined) {
+            self.startPipeline() catch |err| {
+                self.stop();
+                return err;
+            };
+        }
     }
 
     pub fn stop(self: *StreamEngine) void {
         self.state = .stopping;
+        self.stopPipeline();
         self.transport.disconnect();
         self.state = .idle;
         self.stats.state = .idle;
     }
 
+    /// Capture, encode and send one frame on the calling thread (non-pipelined mode)
     pub fn processFrame(self: *StreamEngine) !void {
-        if (self.state != .streaming) return;
+        if (self.state != .streaming or self.running.load(.acquire)) return;
+
+        self.maybeAdaptRate();
+        self.applyRateTarget();
+        self.capture.resolution = self.targetResolution();
 
         // Capture
         self.state = .capturing;
-        var frame = try self.capture.captureFrame(self.allocator);
+        var frame = self.capture.captureFrame(self.allocator) catch |err| switch (err) {
+            error.NoFrameAvailable => {
+                // Zero-copy capture had no new buffer this tick
+                self.state = .streaming;
+                return;
+            },
+            else => return err,
+        };
         defer frame.deinit(self.allocator);
         self.stats.frames_captured += 1;
 
         // Encode
         self.state = .encoding;
-        if (try self.encoder.encodeFrame(&frame, self.allocator)) |packet| {
+        if (try self.encoder.encodeFrame(&frame, self.allocator)) |encoded| {
+            var packet = encoded;
             self.stats.frames_encoded += 1;
 
             // Send
             self.state = .streaming;
-            try self.transport.sendPacket(packet.data);
+            try self.transport.sendEncoded(&packet);
             self.stats.frames_sent += 1;
 
             // Update latency stats
@@ -500,18 +954,258 @@ pub const StreamEngine = struct {
             self.stats.total_latency_ms = @as(f32, @floatFromInt(
                 self.stats.avg_capture_latency_us + self.stats.avg_encode_latency_us
             )) / 1000.0;
+        }
+    }
+
+    fn startPipeline(self: *StreamEngine) !void {
+        self.counters = .{};
+        self.running.store(true, .release);
+        errdefer self.stopPipeline();
 
-            self.allocator.free(@constCast(packet.data));
+        self.threads[0] = try std.Thread.spawn(.{}, captureLoop, .{self});
+        self.threads[1] = try std.Thread.spawn(.{}, encodeLoop, .{self});
+        self.threads[2] = try std.Thread.spawn(.{}, sendLoop, .{self});
+    }
+
+    fn stopPipeline(self: *StreamEngine) void {
+        self.running.store(false, .release);
+        for (&self.threads) |*t| {
+            if (t.*) |thread| thread.join();
+            t.* = null;
         }
+        // Return queued buffers to the pool
+        while (self.frame_queue.pop()) |frame| self.discard(frame);
+        while (self.packet_queue.pop()) |packet| self.discard(packet);
     }
 
-    pub fn getStats(self: *const StreamEngine) StreamStats {
-        return self.stats;
+    fn captureLoop(self: *StreamEngine) void {
+        trace.setThreadName("nvstream-capture");
+        const period_ns: u64 = std.time.ns_per_s / @max(self.config.framerate, 1);
+        var next_deadline = nvmon.timestampNs();
+
+        while (self.running.load(.acquire)) {
+            self.capture.resolution = self.targetResolution();
+            const frame = self.capture.captureFrame(self.allocator) catch |err| {
+                switch (err) {
+                    error.NoFrameAvailable => {},
+                    // Downstream still holds every frame buffer
+                    error.PoolExhausted => _ = self.counters.frames_dropped.fetchAdd(1, .monotonic),
+                    else => std.log.warn("capture failed: {s}", .{@errorName(err)}),
+                }
+                std.posix.nanosleep(0, 500 * std.time.ns_per_us);
+                continue;
+            };
+            self.counters.capture.record(self.capture.capture_latency_us);
+            _ = self.counters.frames_captured.fetchAdd(1, .monotonic);
+
+            if (!self.enqueue(FrameQueue, &self.frame_queue, frame, self.config.capture_drop_policy)) {
+                _ = self.counters.frames_dropped.fetchAdd(1, .monotonic);
+            }
+
+            // Capture on a fixed cadence; skip missed deadlines instead of bursting
+            next_deadline += period_ns;
+            const now = nvmon.timestampNs();
+            if (next_deadline > now) {
+                const wait = next_deadline - now;
+                std.posix.nanosleep(wait / std.time.ns_per_s, wait % std.time.ns_per_s);
+            } else {
+                next_deadline = now;
+            }
+        }
+    }
+
+    fn encodeLoop(self: *StreamEngine) void {
+        trace.setThreadName("nvstream-encode");
+        var backoff = pipeline.Backoff{};
+        while (self.running.load(.acquire)) {
+            var frame = self.frame_queue.pop() orelse {
+                backoff.wait();
+                continue;
+            };
+            backoff.reset();
+            defer frame.deinit(self.allocator);
+
+            self.applyRateTarget();
+            const packet = self.encoder.encodeFrame(&frame, self.allocator) catch |err| {
+                std.log.warn("encode failed: {s}", .{@errorName(err)});
+                continue;
+            } orelse continue;
+            self.counters.encode.record(packet.encode_latency_us);
+            _ = self.counters.frames_encoded.fetchAdd(1, .monotonic);
+
+            if (!self.enqueue(PacketQueue, &self.packet_queue, packet, self.config.encode_drop_policy)) {
+                _ = self.counters.frames_dropped.fetchAdd(1, .monotonic);
+            }
+        }
+    }
+
+    fn sendLoop(self: *StreamEngine) void {
+        trace.setThreadName("nvstream-send");
+        var backoff = pipeline.Backoff{};
+        while (self.running.load(.acquire)) {
+            var packet = self.packet_queue.pop() orelse {
+                backoff.wait();
+                continue;
+            };
+            backoff.reset();
+
+            const pts = packet.pts;
+            const send_start = nvmon.timestampNs();
+            self.transport.sendEncoded(&packet) catch |err| {
+                std.log.warn("send failed: {s}", .{@errorName(err)});
+                _ = self.counters.frames_dropped.fetchAdd(1, .monotonic);
+                continue;
+            };
+            const done = nvmon.timestampNs();
+            self.counters.send.record((done -| send_start) / std.time.ns_per_us);
+            self.counters.end_to_end.record((done -| @as(u64, @intCast(pts))) / std.time.ns_per_us);
+            _ = self.counters.frames_sent.fetchAdd(1, .monotonic);
+            self.maybeAdaptRate();
+        }
+    }
+
+    fn rateConfig(config: StreamConfig) bitrate.Config {
+        return .{
+            .max_kbps = config.getEffectiveBitrate(),
+            .min_kbps = config.min_bitrate_kbps,
+            .pixel_rate = @as(u64, config.resolution.width) * config.resolution.height * config.framerate,
+            .allow_scaling = config.adaptive_resolution,
+            .fec_percentage = config.fec_percentage,
+            .framerate = config.framerate,
+        };
+    }
+
+    /// Feed a receiver report (RTCP RR or client feedback) to the rate controller
+    pub fn submitReceiverReport(self: *StreamEngine, report: ReceiverReport) void {
+        self.transport.recordReport(report);
+        const loss_percent = @as(f32, @floatFromInt(report.fraction_lost)) * 100.0 / 256.0;
+        self.adaptRate(loss_percent);
+    }
+
+    /// Force the next frame to be an IDR (e.g. on a client picture loss indication)
+    pub fn requestKeyframe(self: *StreamEngine) void {
+        self.keyframe_requested.store(true, .release);
+    }
+
+    /// Run the controller on sender-side signals between receiver reports
+    fn maybeAdaptRate(self: *StreamEngine) void {
+        const now = nvmon.timestampNs();
+        const last = self.last_rate_tick_ns.load(.monotonic);
+        if (now -| last < rate_tick_ns) return;
+        // Only the caller that claims the tick runs the controller
+        if (self.last_rate_tick_ns.cmpxchgStrong(last, now, .monotonic, .monotonic) != null) return;
+        self.adaptRate(null);
+    }
+
+    fn adaptRate(self: *StreamEngine, loss_percent: ?f32) void {
+        if (!self.config.adaptive_bitrate) return;
+
+        self.rate_mutex.lock();
+        defer self.rate_mutex.unlock();
+
+        const network = self.transport.getStats();
+        const decision = self.rate_controller.update(.{
+            .loss_percent = loss_percent,
+            .rtt_ms = network.rtt_ms,
+            .encode_queue_depth = @intCast(self.frame_queue.len()),
+            .queue_capacity = if (self.config.pipelined) @intCast(self.frame_queue.depth) else 0,
+            .socket_queue_bytes = network.socket_queue_bytes,
+        }, nvmon.timestampNs());
+
+        if (decision.changed) {
+            trace.counter(.nvstream, "bitrate_kbps", @floatFromInt(decision.bitrate_kbps));
+            self.target_bitrate_kbps.store(decision.bitrate_kbps, .release);
+            self.target_scale.store(decision.scale_index, .release);
+        }
+        if (decision.keyframe) self.keyframe_requested.store(true, .release);
+    }
+
+    fn targetResolution(self: *const StreamEngine) Resolution {
+        const decision = bitrate.Decision{ .bitrate_kbps = 0, .scale_index = self.target_scale.load(.acquire) };
+        return .{
+            .width = decision.scaled(self.config.resolution.width),
+            .height = decision.scaled(self.config.resolution.height),
+        };
+    }
+
+    /// Called on the encoding thread before each frame
+    fn applyRateTarget(self: *StreamEngine) void {
+        self.encoder.reconfigure(self.target_bitrate_kbps.load(.acquire), self.targetResolution());
+        if (self.keyframe_requested.swap(false, .acq_rel)) self.encoder.requestKeyframe();
+    }
+
+    /// Hand an item to the next stage. Returns false if it (or an older one) was dropped;
+    /// dropped items are released back to the pool.
+    fn enqueue(self: *StreamEngine, comptime Queue: type, queue: *Queue, item: anytype, policy: pipeline.DropPolicy) bool {
+        switch (policy) {
+            .drop_newest => {
+                if (queue.tryPush(item)) return true;
+                self.discard(item);
+                return false;
+            },
+            .drop_oldest => {
+                const evicted = queue.pushEvict(item) orelse return true;
+                self.discard(evicted);
+                return false;
+            },
+            .block => {
+                var backoff = pipeline.Backoff{};
+                while (!queue.tryPush(item)) {
+                    if (!self.running.load(.acquire)) {
+                        self.discard(item);
+                        return false;
+                    }
+                    backoff.wait();
+                }
+                return true;
+            },
+        }
+    }
+
+    fn discard(self: *StreamEngine, item: anytype) void {
+        var owned = item;
+        switch (@TypeOf(item)) {
+            CapturedFrame => owned.deinit(self.allocator),
+            EncodedPacket => owned.deinit(),
+            else => @compileError("no release for " ++ @typeName(@TypeOf(item))),
+        }
+    }
+
+    pub fn getStats(self: *StreamEngine) StreamStats {
+        var stats = self.stats;
+        stats.network = self.transport.getStats();
+        stats.current_bitrate_kbps = self.encoder.bitrate_kbps;
+        stats.target_bitrate_kbps = self.target_bitrate_kbps.load(.acquire);
+        if (!self.config.pipelined) return stats;
+
+        const c = &self.counters;
+        stats.frames_captured = c.frames_captured.load(.monotonic);
+        stats.frames_encoded = c.frames_encoded.load(.monotonic);
+        stats.frames_sent = c.frames_sent.load(.monotonic);
+        stats.frames_dropped = c.frames_dropped.load(.monotonic);
+        stats.capture_latency = c.capture.snapshot();
+        stats.encode_latency = c.encode.snapshot();
+        stats.send_latency = c.send.snapshot();
+        stats.end_to_end_latency = c.end_to_end.snapshot();
+        stats.avg_capture_latency_us = @intCast(stats.capture_latency.meanUs());
+        stats.avg_encode_latency_us = @intCast(stats.encode_latency.meanUs());
+        stats.avg_network_latency_us = @intCast(stats.send_latency.meanUs());
+        stats.total_latency_ms = @as(f32, @floatFromInt(stats.end_to_end_latency.meanUs())) / 1000.0;
+        stats.capture_queue_depth = @intCast(self.frame_queue.len());
+        stats.send_queue_depth = @intCast(self.packet_queue.len());
+        return stats;
     }
 
     pub fn setQualityPreset(self: *StreamEngine, preset: QualityPreset) void {
+        self.rate_mutex.lock();
+        defer self.rate_mutex.unlock();
+
         self.config.quality_preset = preset;
-        // TODO: Reconfigure encoder on the fly
+        const ceiling = self.config.getEffectiveBitrate();
+        // The preset sets the ceiling; the controller works below it
+        self.rate_controller.setMaxBitrate(ceiling);
+        const target = if (self.config.adaptive_bitrate) @min(ceiling, self.target_bitrate_kbps.load(.acquire)) else ceiling;
+        self.target_bitrate_kbps.store(target, .release);
     }
 };
 
@@ -573,6 +1267,11 @@ pub fn isNvfbcAvailable() bool {
     return true;
 }
 
+/// Check if zero-copy DMA-BUF capture is available (CUDA driver API present)
+pub fn isZeroCopyAvailable() bool {
+    return zerocopy.isAvailable();
+}
+
 /// Check if streaming is supported on this system
 pub fn isSupported() bool {
     return isNvfbcAvailable();
@@ -582,6 +1281,15 @@ pub fn isSupported() bool {
 // Tests
 // ============================================================================
 
+test {
+    _ = zerocopy;
+    _ = pipeline;
+    _ = pool;
+    _ = rtp;
+    _ = udp;
+    _ = bitrate;
+}
+
 test "quality preset bitrate" {
     const preset = QualityPreset.balanced;
     const bitrate = preset.getTargetBitrate(Resolution.r1080p);
@@ -608,6 +1316,83 @@ test "capture context init" {
     try std.testing.expectEqual(@as(u32, 60), ctx.target_fps);
 }
 
+test "capture buffer reuse" {
+    const config = StreamConfig{ .resolution = Resolution.r720p, .pipelined = false };
+    var buffers = try pool.BufferPool.init(config.bufferPoolConfig());
+    defer buffers.deinit();
+
+    var ctx = CaptureContext.init(.nvfbc, 60);
+    defer ctx.deinit();
+    ctx.resolution = config.resolution;
+    ctx.buffer_pool = &buffers;
+
+    var first = try ctx.captureFrame(std.testing.allocator);
+    const first_ptr = first.data.?.ptr;
+    try std.testing.expectError(error.PoolExhausted, ctx.captureFrame(std.testing.allocator));
+    first.deinit(std.testing.allocator);
+
+    var second = try ctx.captureFrame(std.testing.allocator);
+    defer second.deinit(std.testing.allocator);
+    try std.testing.expectEqual(first_ptr, second.data.?.ptr);
+    try std.testing.expectEqual(@as(usize, 1280 * 720 * 3 / 2), second.data.?.len);
+}
+
+test "encoder bitstream reuse" {
+    const config = StreamConfig{ .pipelined = false };
+    var buffers = try pool.BufferPool.init(config.bufferPoolConfig());
+    defer buffers.deinit();
+
+    var encoder = try EncoderContext.init(config);
+    defer encoder.deinit();
+    encoder.buffer_pool = &buffers;
+    const frame = CapturedFrame{
+        .data = null,
+        .width = 1920,
+        .height = 1080,
+        .stride = 1920,
+        .format = .nv12,
+        .timestamp_ns = 0,
+        .dma_buf_fd = null,
+        .is_hdr = false,
+    };
+
+    var key = (try encoder.encodeFrame(&frame, std.testing.allocator)).?;
+    const key_ptr = key.data.ptr;
+    try std.testing.expect(key.is_keyframe);
+
+    var transport = TransportContext.init(.rtp_udp, "127.0.0.1", 47998);
+    try transport.connect();
+    defer transport.disconnect();
+    try transport.sendEncoded(&key);
+    try std.testing.expectEqual(@as(u32, 0), buffers.inUse());
+
+    var delta = (try encoder.encodeFrame(&frame, std.testing.allocator)).?;
+    defer delta.deinit();
+    try std.testing.expectEqual(key_ptr, delta.data.ptr);
+}
+
+test "pipelined engine overlaps stages" {
+    const engine = try StreamEngine.init(std.testing.allocator, .{ .framerate = 240 });
+    defer engine.deinit();
+
+    try engine.start("127.0.0.1", 47998);
+    std.posix.nanosleep(0, 100 * std.time.ns_per_ms);
+    engine.stop();
+
+    const stats = engine.getStats();
+    try std.testing.expect(stats.frames_sent > 0);
+    try std.testing.expect(stats.frames_sent <= stats.frames_captured);
+    try std.testing.expectEqual(stats.frames_sent, stats.end_to_end_latency.count);
+    // Every dropped, queued and sent buffer went back to the pool
+    try std.testing.expectEqual(@as(u32, 0), engine.buffers.inUse());
+}
+
+test "fourcc mapping" {
+    try std.testing.expectEqual(PixelFormat.nv12, try formatFromFourcc(fourccCode("NV12")));
+    try std.testing.expectEqual(PixelFormat.p010, try formatFromFourcc(fourccCode("P010")));
+    try std.testing.expectError(error.UnsupportedFormat, formatFromFourcc(fourccCode("YUYV")));
+}
+
 test "network stats packet loss" {
     var stats = NetworkStats{
         .packets_sent = 100,
@@ -619,3 +1404,45 @@ test "network stats packet loss" {
     };
     try std.testing.expect(stats.packetLossPercent() == 5.0);
 }
+
+test "rtp transport batches a frame" {
+    var transport = TransportContext.init(.rtp_udp, "127.0.0.1", 47998);
+    transport.configure(.{ .video_codec = .h264 });
+    try transport.connect();
+    defer transport.disconnect();
+
+    const data = try std.testing.allocator.alloc(u8, 50000);
+    @memset(data, 0);
+    data[0] = 0x65;
+    var packet = EncodedPacket{
+        .data = data,
+        .pts = 0,
+        .dts = 0,
+        .is_keyframe = true,
+        .is_sps_pps = false,
+        .encode_latency_us = 0,
+        .allocator = std.testing.allocator,
+    };
+    try transport.sendEncoded(&packet);
+
+    // ~36 RTP packets, one batch
+    try std.testing.expect(transport.stats.packets_sent > 30);
+    try std.testing.expectEqual(@as(u64, 1), transport.stats.batches_sent);
+    try std.testing.expect(transport.stats.send_syscalls < transport.stats.packets_sent);
+}
+
+test "receiver loss retargets encoder without idr" {
+    const engine = try StreamEngine.init(std.testing.allocator, .{ .pipelined = false, .video_bitrate_kbps = 20000, .quality_preset = null });
+    defer engine.deinit();
+
+    // 15% loss is within FEC: lower the rate, no keyframe
+    engine.submitReceiverReport(.{ .fraction_lost = 38, .rtt_ms = 20 });
+    engine.applyRateTarget();
+    try std.testing.expect(engine.encoder.bitrate_kbps < 20000);
+    try std.testing.expect(!engine.encoder.force_keyframe);
+
+    // 40% loss outruns FEC: request a keyframe
+    engine.submitReceiverReport(.{ .fraction_lost = 102, .rtt_ms = 20 });
+    engine.applyRateTarget();
+    try std.testing.expect(engine.encoder.force_keyframe);
+}
@@ -0,0 +1,193 @@
+//! nvstream/pipeline - Stage Queues and Latency Histograms
+//!
+//! Building blocks for the threaded capture -> encode -> transport pipeline:
+//! bounded single-producer/single-consumer rings with a drop policy, and
+//! lock-free log2 latency histograms each stage records into.
+
+const std = @import("std");
+
+/// Deepest queue a pipeline stage may be configured with
+pub const max_depth = 8;
+
+/// What a producer does when the next stage's queue is full
+pub const DropPolicy = enum(u8) {
+    drop_oldest, // Replace the stalest queued item (capture: always send the freshest frame)
+    drop_newest, // Discard the item being pushed
+    block, // Wait for the consumer (transport: never lose encoded data)
+};
+
+/// Bounded lock-free SPSC ring.
+/// `depth` is chosen at runtime up to `capacity`. The head index is advanced
+/// with CAS so the producer can evict the oldest item under `drop_oldest`.
+pub fn SpscRing(comptime T: type, comptime capacity: usize) type {
+    return struct {
+        const Self = @This();
+
+        items: [capacity]T = undefined,
+        head: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        tail: std.atomic.Value(usize) align(std.atomic.cache_line) = std.atomic.Value(usize).init(0),
+        depth: usize,
+
+        pub fn init(depth: usize) Self {
+            return .{ .depth = std.math.clamp(depth, 1, capacity) };
+        }
+
+        /// Push an item. Returns false if the ring is full.
+        pub fn tryPush(self: *Self, item: T) bool {
+            const tail = self.tail.load(.monotonic);
+            if (tail - self.head.load(.acquire) >= self.depth) return false;
+            self.items[tail % capacity] = item;
+            self.tail.store(tail + 1, .release);
+            return true;
+        }
+
+        /// Push an item, evicting the oldest one if the ring is full.
+        /// Returns the evicted item so the caller can release it.
+        pub fn pushEvict(self: *Self, item: T) ?T {
+            var evicted: ?T = null;
+            const tail = self.tail.load(.monotonic);
+            var head = self.head.load(.acquire);
+            while (tail - head >= self.depth) {
+                const oldest = self.items[head % capacity];
+                if (self.head.cmpxchgWeak(head, head + 1, .acq_rel, .acquire)) |actual| {
+                    head = actual; // consumer took it first
+                } else {
+                    evicted = oldest;
+                    head += 1;
+                }
+            }
+            self.items[tail % capacity] = item;
+            self.tail.store(tail + 1, .release);
+            return evicted;
+        }
+
+        /// Pop the oldest item, or null if the ring is empty
+        pub fn pop(self: *Self) ?T {
+            var head = self.head.load(.acquire);
+            while (true) {
+                if (head == self.tail.load(.acquire)) return null;
+                const item = self.items[head % capacity];
+                // Fails only if the producer evicted this slot under drop_oldest
+                head = self.head.cmpxchgWeak(head, head + 1, .acq_rel, .acquire) orelse return item;
+            }
+        }
+
+        pub fn len(self: *const Self) usize {
+            return self.tail.load(.acquire) -| self.head.load(.acquire);
+        }
+    };
+}
+
+/// Spin briefly, then sleep; used by stages waiting on an empty or full queue
+pub const Backoff = struct {
+    spins: u32 = 0,
+
+    pub fn wait(self: *Backoff) void {
+        if (self.spins < 64) {
+            self.spins += 1;
+            std.atomic.spinLoopHint();
+        } else {
+            std.posix.nanosleep(0, 50 * std.time.ns_per_us);
+        }
+    }
+
+    pub fn reset(self: *Backoff) void {
+        self.spins = 0;
+    }
+};
+
+/// Lock-free latency histogram with power-of-two microsecond buckets.
+/// Bucket i counts samples in [2^(i-1), 2^i) us; the last bucket is open-ended.
+pub const LatencyHistogram = struct {
+    pub const bucket_count = 24;
+
+    buckets: [bucket_count]std.atomic.Value(u64) = [_]std.atomic.Value(u64){std.atomic.Value(u64).init(0)} ** bucket_count,
+    count: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    sum_us: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    max_us: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+
+    pub fn record(self: *LatencyHistogram, us: u64) void {
+        _ = self.buckets[bucketFor(us)].fetchAdd(1, .monotonic);
+        _ = self.count.fetchAdd(1, .monotonic);
+        _ = self.sum_us.fetchAdd(us, .monotonic);
+        _ = self.max_us.fetchMax(us, .monotonic);
+    }
+
+    pub fn snapshot(self: *const LatencyHistogram) LatencySnapshot {
+        var snap = LatencySnapshot{};
+        for (&snap.buckets, &self.buckets) |*dst, *src| dst.* = src.load(.monotonic);
+        snap.count = self.count.load(.monotonic);
+        snap.sum_us = self.sum_us.load(.monotonic);
+        snap.max_us = self.max_us.load(.monotonic);
+        return snap;
+    }
+
+    pub fn reset(self: *LatencyHistogram) void {
+        self.* = .{};
+    }
+
+    fn bucketFor(us: u64) usize {
+        if (us == 0) return 0;
+        const bits: usize = 64 - @clz(us);
+        return @min(bits, bucket_count - 1);
+    }
+};
+
+/// Point-in-time copy of a `LatencyHistogram`
+pub const LatencySnapshot = struct {
+    buckets: [LatencyHistogram.bucket_count]u64 = [_]u64{0} ** LatencyHistogram.bucket_count,
+    count: u64 = 0,
+    sum_us: u64 = 0,
+    max_us: u64 = 0,
+
+    pub fn meanUs(self: LatencySnapshot) u64 {
+        if (self.count == 0) return 0;
+        return self.sum_us / self.count;
+    }
+
+    /// Upper bound of the bucket containing the p-th percentile (0-100)
+    pub fn percentileUs(self: LatencySnapshot, p: f64) u64 {
+        if (self.count == 0) return 0;
+        const rank: u64 = @intFromFloat(@ceil(@as(f64, @floatFromInt(self.count)) * std.math.clamp(p, 0, 100) / 100.0));
+        var seen: u64 = 0;
+        for (self.buckets, 0..) |n, i| {
+            seen += n;
+            if (seen >= @max(rank, 1)) {
+                if (i == self.buckets.len - 1) return self.max_us;
+                return @min(@as(u64, 1) << @intCast(i), self.max_us);
+            }
+        }
+        return self.max_us;
+    }
+};
+
+test "spsc ring order and capacity" {
+    var ring = SpscRing(u32, 4).init(3);
+    try std.testing.expect(ring.tryPush(1));
+    try std.testing.expect(ring.tryPush(2));
+    try std.testing.expect(ring.tryPush(3));
+    try std.testing.expect(!ring.tryPush(4));
+    try std.testing.expectEqual(@as(?u32, 1), ring.pop());
+    try std.testing.expectEqual(@as(usize, 2), ring.len());
+}
+
+test "spsc ring drop oldest" {
+    var ring = SpscRing(u32, 4).init(2);
+    try std.testing.expectEqual(@as(?u32, null), ring.pushEvict(1));
+    try std.testing.expectEqual(@as(?u32, null), ring.pushEvict(2));
+    try std.testing.expectEqual(@as(?u32, 1), ring.pushEvict(3));
+    try std.testing.expectEqual(@as(?u32, 2), ring.pop());
+    try std.testing.expectEqual(@as(?u32, 3), ring.pop());
+    try std.testing.expectEqual(@as(?u32, null), ring.pop());
+}
+
+test "latency histogram percentiles" {
+    var hist = LatencyHistogram{};
+    for (0..99) |_| hist.record(900); // bucket [512, 1024)
+    hist.record(20_000);
+    const snap = hist.snapshot();
+    try std.testing.expectEqual(@as(u64, 100), snap.count);
+    try std.testing.expectEqual(@as(u64, 1024), snap.percentileUs(50));
+    try std.testing.expectEqual(@as(u64, 20_000), snap.percentileUs(100));
+    try std.testing.expectEqual(@as(u64, 20_000), snap.max_us);
+}
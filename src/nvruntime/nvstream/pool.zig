@@ -0,0 +1,238 @@
+//! nvstream/pool - Frame and Packet Buffer Pool
+//!
+//! Fixed-capacity, size-classed buffers carved out of one page-aligned
+//! mapping (hugepage-backed when available). Buffers are handed out as
+//! refcounted leases and return to a lock-free free list when the last
+//! holder releases them, so steady-state streaming never touches the
+//! general-purpose allocator and RSS stays flat over long sessions.
+
+const std = @import("std");
+
+/// Maximum number of size classes per pool
+pub const max_classes = 4;
+
+/// Maximum buffers per size class
+pub const max_buffers_per_class = 64;
+
+/// One size class: `count` buffers of `size` bytes
+pub const SizeClass = struct {
+    size: usize,
+    count: u16,
+};
+
+/// Pool configuration
+pub const PoolConfig = struct {
+    classes: [max_classes]?SizeClass = [_]?SizeClass{null} ** max_classes,
+    /// Try MAP_HUGETLB first, then fall back to transparent hugepages
+    use_hugepages: bool = true,
+};
+
+pub const PoolError = error{
+    InvalidConfig,
+    OutOfMemory,
+};
+
+const empty: u32 = 0;
+
+/// Per-class lock-free free list (Treiber stack with an ABA tag)
+const FreeList = struct {
+    /// Low 32 bits: index + 1 of the top buffer (0 = empty); high 32 bits: tag
+    head: std.atomic.Value(u64) align(std.atomic.cache_line) = std.atomic.Value(u64).init(0),
+    next: [max_buffers_per_class]std.atomic.Value(u32) = [_]std.atomic.Value(u32){std.atomic.Value(u32).init(empty)} ** max_buffers_per_class,
+
+    fn push(self: *FreeList, index: u16) void {
+        var head = self.head.load(.monotonic);
+        while (true) {
+            self.next[index].store(@truncate(head), .monotonic);
+            const tag = (head >> 32) +% 1;
+            const new = (tag << 32) | (@as(u64, index) + 1);
+            head = self.head.cmpxchgWeak(head, new, .release, .monotonic) orelse return;
+        }
+    }
+
+    fn pop(self: *FreeList) ?u16 {
+        var head = self.head.load(.acquire);
+        while (true) {
+            const top: u32 = @truncate(head);
+            if (top == empty) return null;
+            const next = self.next[top - 1].load(.monotonic);
+            const tag = (head >> 32) +% 1;
+            const new = (tag << 32) | next;
+            head = self.head.cmpxchgWeak(head, new, .acquire, .acquire) orelse return @intCast(top - 1);
+        }
+    }
+};
+
+const Class = struct {
+    size: usize = 0,
+    count: u16 = 0,
+    /// Offset of the first buffer in the mapping
+    offset: usize = 0,
+    free: FreeList = .{},
+    refs: [max_buffers_per_class]std.atomic.Value(u32) = [_]std.atomic.Value(u32){std.atomic.Value(u32).init(0)} ** max_buffers_per_class,
+    /// Buffers currently leased
+    in_use: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+    /// Acquire attempts that found the class empty
+    misses: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+};
+
+/// A refcounted handle to a pooled buffer. Copying a lease does not add a
+/// reference; call `retain` for every additional owner.
+pub const Lease = struct {
+    pool: *BufferPool,
+    class: u8,
+    index: u16,
+    /// Full buffer capacity
+    data: []u8,
+
+    /// Add a reference (e.g. a second consumer of the same frame)
+    pub fn retain(self: Lease) void {
+        _ = self.pool.classes[self.class].refs[self.index].fetchAdd(1, .monotonic);
+    }
+
+    /// Drop a reference; the buffer returns to the pool on the last release
+    pub fn release(self: Lease) void {
+        const class = &self.pool.classes[self.class];
+        if (class.refs[self.index].fetchSub(1, .acq_rel) == 1) {
+            _ = class.in_use.fetchSub(1, .monotonic);
+            class.free.push(self.index);
+        }
+    }
+};
+
+/// Fixed-capacity pool of page-aligned buffers
+pub const BufferPool = struct {
+    mapping: []align(std.heap.page_size_min) u8,
+    classes: [max_classes]Class = [_]Class{.{}} ** max_classes,
+    class_count: u8 = 0,
+    hugepages: bool = false,
+
+    const Self = @This();
+
+    /// Map all buffers up front. Size classes must be listed smallest first.
+    pub fn init(config: PoolConfig) PoolError!Self {
+        var self = Self{ .mapping = &[_]u8{} };
+
+        var total: usize = 0;
+        var previous_size: usize = 0;
+        for (config.classes) |maybe_class| {
+            const class = maybe_class orelse break;
+            if (class.count == 0 or class.count > max_buffers_per_class) return PoolError.InvalidConfig;
+            if (class.size <= previous_size) return PoolError.InvalidConfig;
+            previous_size = class.size;
+
+            const slot = &self.classes[self.class_count];
+            slot.size = std.mem.alignForward(usize, class.size, std.heap.pageSize());
+            slot.count = class.count;
+            slot.offset = total;
+            total += slot.size * class.count;
+            self.class_count += 1;
+        }
+        if (self.class_count == 0) return PoolError.InvalidConfig;
+
+        self.mapping = mapBuffers(total, config.use_hugepages, &self.hugepages) orelse return PoolError.OutOfMemory;
+
+        for (self.classes[0..self.class_count]) |*class| {
+            var i: u16 = class.count;
+            while (i > 0) {
+                i -= 1;
+                class.free.push(i);
+            }
+        }
+        return self;
+    }
+
+    pub fn deinit(self: *Self) void {
+        if (self.mapping.len > 0) std.posix.munmap(self.mapping);
+        self.mapping = &[_]u8{};
+    }
+
+    /// Lease the smallest free buffer of at least `size` bytes.
+    /// Returns null if every suitable buffer is in use.
+    pub fn acquire(self: *Self, size: usize) ?Lease {
+        for (self.classes[0..self.class_count], 0..) |*class, ci| {
+            if (class.size < size) continue;
+            if (class.free.pop()) |index| {
+                class.refs[index].store(1, .monotonic);
+                _ = class.in_use.fetchAdd(1, .monotonic);
+                const start = class.offset + @as(usize, index) * class.size;
+                return Lease{
+                    .pool = self,
+                    .class = @intCast(ci),
+                    .index = index,
+                    .data = self.mapping[start .. start + class.size],
+                };
+            }
+            _ = class.misses.fetchAdd(1, .monotonic);
+        }
+        return null;
+    }
+
+    /// Buffers currently leased across all classes
+    pub fn inUse(self: *const Self) u32 {
+        var n: u32 = 0;
+        for (self.classes[0..self.class_count]) |*class| n += class.in_use.load(.monotonic);
+        return n;
+    }
+
+    /// Bytes reserved by the pool
+    pub fn reservedBytes(self: *const Self) usize {
+        return self.mapping.len;
+    }
+};
+
+fn mapBuffers(len: usize, use_hugepages: bool, hugepages: *bool) ?[]align(std.heap.page_size_min) u8 {
+    const prot = std.posix.PROT.READ | std.posix.PROT.WRITE;
+    if (use_hugepages) {
+        const huge_len = std.mem.alignForward(usize, len, 2 * 1024 * 1024);
+        if (std.posix.mmap(null, huge_len, prot, .{ .TYPE = .PRIVATE, .ANONYMOUS = true, .HUGETLB = true }, -1, 0)) |mem| {
+            hugepages.* = true;
+            return mem;
+        } else |_| {}
+    }
+
+    const mem = std.posix.mmap(null, len, prot, .{ .TYPE = .PRIVATE, .ANONYMOUS = true }, -1, 0) catch return null;
+    if (use_hugepages) {
+        // No reserved hugepages; ask for transparent ones instead
+        std.posix.madvise(mem.ptr, mem.len, std.posix.MADV.HUGEPAGE) catch {};
+    }
+    return mem;
+}
+
+test "lease and release" {
+    var pool = try BufferPool.init(.{
+        .classes = .{ .{ .size = 1000, .count = 2 }, .{ .size = 10000, .count = 1 }, null, null },
+        .use_hugepages = false,
+    });
+    defer pool.deinit();
+
+    const a = pool.acquire(100).?;
+    const b = pool.acquire(100).?;
+    try std.testing.expectEqual(@as(u8, 0), a.class);
+    try std.testing.expect(std.mem.isAligned(@intFromPtr(a.data.ptr), std.heap.pageSize()));
+
+    // Small class exhausted: falls through to the larger class
+    const c = pool.acquire(100).?;
+    try std.testing.expectEqual(@as(u8, 1), c.class);
+    try std.testing.expect(pool.acquire(100) == null);
+    try std.testing.expectEqual(@as(u32, 3), pool.inUse());
+
+    b.retain();
+    b.release();
+    try std.testing.expectEqual(@as(u32, 3), pool.inUse());
+    b.release();
+    a.release();
+    c.release();
+    try std.testing.expectEqual(@as(u32, 0), pool.inUse());
+
+    const again = pool.acquire(100).?;
+    defer again.release();
+    try std.testing.expectEqual(@as(u8, 0), again.class);
+}
+
+test "invalid config" {
+    try std.testing.expectError(PoolError.InvalidConfig, BufferPool.init(.{}));
+    try std.testing.expectError(PoolError.InvalidConfig, BufferPool.init(.{
+        .classes = .{ .{ .size = 4096, .count = 1 }, .{ .size = 1024, .count = 1 }, null, null },
+    }));
+}
@@ -0,0 +1,427 @@
+//! nvstream/rtp - RTP Packetization
+//!
+//! Splits encoded access units into RTP packets following the H.264
+//! (RFC 6184), HEVC (RFC 7798) and AV1 (AOM RTP specification) payload
+//! formats. Packets are written back to back into a fixed `Batch` so the
+//! transport can hand a whole frame to the kernel in one `sendmmsg` call.
+//! Fragments of one NAL unit or OBU are all the same size except the last,
+//! which is what UDP GSO needs to send them as a single segmented datagram.
+
+const std = @import("std");
+
+/// RTP fixed header size (no CSRCs, no extensions)
+pub const header_size = 12;
+
+/// RTP clock for video payloads
+pub const clock_rate = 90_000;
+
+/// Largest RTP packet the batch can hold (header included)
+pub const max_packet_size = 1500;
+
+/// Most NAL units / OBUs accepted in one access unit
+pub const max_units = 128;
+
+/// RTP payload format
+pub const PayloadFormat = enum(u8) {
+    h264,
+    hevc,
+    av1,
+};
+
+/// RTP fixed header
+pub const Header = struct {
+    marker: bool = false,
+    payload_type: u7 = 96,
+    sequence: u16 = 0,
+    timestamp: u32 = 0,
+    ssrc: u32 = 0,
+
+    pub fn write(self: Header, out: *[header_size]u8) void {
+        out[0] = 0x80; // V=2, no padding, no extension, no CSRCs
+        out[1] = (@as(u8, @intFromBool(self.marker)) << 7) | self.payload_type;
+        std.mem.writeInt(u16, out[2..4], self.sequence, .big);
+        std.mem.writeInt(u32, out[4..8], self.timestamp, .big);
+        std.mem.writeInt(u32, out[8..12], self.ssrc, .big);
+    }
+
+    pub fn parse(in: *const [header_size]u8) Header {
+        return .{
+            .marker = in[1] & 0x80 != 0,
+            .payload_type = @truncate(in[1]),
+            .sequence = std.mem.readInt(u16, in[2..4], .big),
+            .timestamp = std.mem.readInt(u32, in[4..8], .big),
+            .ssrc = std.mem.readInt(u32, in[8..12], .big),
+        };
+    }
+};
+
+/// Convert a presentation timestamp to the 90 kHz RTP clock
+pub fn rtpTimestamp(pts_ns: i64) u32 {
+    const ns: u64 = @bitCast(pts_ns);
+    return @truncate(ns / 1000 * (clock_rate / 1000) / 1000);
+}
+
+/// Fixed-capacity run of packets laid out back to back
+pub const Batch = struct {
+    pub const max_packets = 64;
+
+    data: [max_packets * max_packet_size]u8 = undefined,
+    offsets: [max_packets]u32 = undefined,
+    lens: [max_packets]u16 = undefined,
+    count: usize = 0,
+    used: usize = 0,
+
+    pub fn reset(self: *Batch) void {
+        self.count = 0;
+        self.used = 0;
+    }
+
+    pub fn isFull(self: *const Batch) bool {
+        return self.count == max_packets;
+    }
+
+    pub fn packet(self: *const Batch, i: usize) []const u8 {
+        return self.data[self.offsets[i]..][0..self.lens[i]];
+    }
+
+    /// Total bytes queued
+    pub fn bytes(self: *const Batch) usize {
+        return self.used;
+    }
+
+    fn append(self: *Batch, len: usize) []u8 {
+        std.debug.assert(!self.isFull() and len <= max_packet_size);
+        self.offsets[self.count] = @intCast(self.used);
+        self.lens[self.count] = @intCast(len);
+        self.count += 1;
+        const out = self.data[self.used..][0..len];
+        self.used += len;
+        return out;
+    }
+};
+
+/// One NAL unit or OBU: a (possibly rewritten) header plus a payload range
+const Unit = struct {
+    header: [2]u8 = .{ 0, 0 },
+    header_len: u8 = 0,
+    payload_start: u32 = 0,
+    payload_len: u32 = 0,
+
+    fn bodyLen(self: Unit) usize {
+        return self.header_len + self.payload_len;
+    }
+};
+
+pub const PacketizeError = error{
+    TooManyUnits,
+    MalformedBitstream,
+};
+
+/// Stateful packetizer for one RTP stream.
+/// `begin` splits an access unit, then `fill` is called until it returns
+/// true, flushing the batch between calls.
+pub const Packetizer = struct {
+    format: PayloadFormat,
+    payload_type: u7 = 96,
+    ssrc: u32,
+    sequence: u16 = 0,
+    /// Largest packet produced, RTP header included
+    mtu: u16 = 1400,
+
+    frame: []const u8 = &[_]u8{},
+    timestamp: u32 = 0,
+    /// Set for the first packet of an AV1 coded video sequence
+    new_sequence: bool = false,
+    units: [max_units]Unit = undefined,
+    unit_count: usize = 0,
+    unit_index: usize = 0,
+    /// Bytes of the current unit already packetized
+    unit_offset: usize = 0,
+
+    const Self = @This();
+
+    pub fn init(format: PayloadFormat, ssrc: u32, mtu: u16) Self {
+        return .{
+            .format = format,
+            .ssrc = ssrc,
+            .mtu = std.math.clamp(mtu, header_size + 64, max_packet_size),
+        };
+    }
+
+    /// Start packetizing an access unit (Annex-B for H.264/HEVC, low-overhead OBUs for AV1).
+    /// `frame` must stay valid until `fill` returns true.
+    pub fn begin(self: *Self, frame: []const u8, pts_ns: i64, is_keyframe: bool) PacketizeError!void {
+        self.frame = frame;
+        self.timestamp = rtpTimestamp(pts_ns);
+        self.new_sequence = is_keyframe;
+        self.unit_index = 0;
+        self.unit_offset = 0;
+        self.unit_count = 0;
+        switch (self.format) {
+            .h264, .hevc => try self.splitAnnexB(),
+            .av1 => try self.splitObus(),
+        }
+    }
+
+    /// Write packets into `batch` until the frame is done or the batch is full.
+    /// Returns true once the whole access unit has been packetized.
+    pub fn fill(self: *Self, batch: *Batch) bool {
+        while (self.unit_index < self.unit_count) {
+            if (batch.isFull()) return false;
+            self.emit(batch);
+        }
+        return true;
+    }
+
+    fn emit(self: *Self, batch: *Batch) void {
+        const unit = self.units[self.unit_index];
+        const room = @as(usize, self.mtu) - header_size;
+        const body_len = unit.bodyLen();
+
+        var out: []u8 = undefined;
+        var done: bool = undefined;
+
+        if (self.unit_offset == 0 and body_len + aggregationOverhead(self.format) <= room) {
+            // Single unit packet
+            const len = aggregationOverhead(self.format) + body_len;
+            out = batch.append(header_size + len);
+            var payload = out[header_size..];
+            if (self.format == .av1) {
+                payload[0] = self.av1Aggregation(false, false);
+                payload = payload[1..];
+            }
+            self.copyBody(unit, 0, payload);
+            done = true;
+        } else {
+            const overhead = fragmentOverhead(self.format);
+            // H.264/HEVC fragments carry the NAL header in the FU header instead
+            const skip: usize = if (self.format == .av1) 0 else unit.header_len;
+            const start = skip + self.unit_offset;
+            const chunk = @min(room - overhead, body_len - start);
+            const first = self.unit_offset == 0;
+            done = start + chunk == body_len;
+
+            out = batch.append(header_size + overhead + chunk);
+            const payload = out[header_size..];
+            self.writeFragmentHeader(unit, payload[0..overhead], first, done);
+            self.copyBody(unit, start, payload[overhead..]);
+            self.unit_offset += chunk;
+        }
+
+        if (done) {
+            self.unit_index += 1;
+            self.unit_offset = 0;
+        }
+        const header = Header{
+            .marker = self.unit_index == self.unit_count,
+            .payload_type = self.payload_type,
+            .sequence = self.sequence,
+            .timestamp = self.timestamp,
+            .ssrc = self.ssrc,
+        };
+        header.write(out[0..header_size]);
+        self.sequence +%= 1;
+        self.new_sequence = false;
+    }
+
+    fn writeFragmentHeader(self: *Self, unit: Unit, out: []u8, first: bool, last: bool) void {
+        const se = (@as(u8, @intFromBool(first)) << 7) | (@as(u8, @intFromBool(last)) << 6);
+        switch (self.format) {
+            .h264 => {
+                // FU-A indicator: F and NRI from the NAL, type 28
+                out[0] = (unit.header[0] & 0xe0) | 28;
+                out[1] = se | (unit.header[0] & 0x1f);
+            },
+            .hevc => {
+                // PayloadHdr with type 49, then FU header with the NAL type
+                out[0] = (unit.header[0] & 0x81) | (49 << 1);
+                out[1] = unit.header[1];
+                out[2] = se | ((unit.header[0] >> 1) & 0x3f);
+            },
+            .av1 => out[0] = self.av1Aggregation(!first, !last),
+        }
+    }
+
+    /// AV1 aggregation header: Z (continues previous), Y (continues in next), W=1, N
+    fn av1Aggregation(self: *const Self, z: bool, y: bool) u8 {
+        return (@as(u8, @intFromBool(z)) << 7) | (@as(u8, @intFromBool(y)) << 6) |
+            (1 << 4) | (@as(u8, @intFromBool(self.new_sequence)) << 3);
+    }
+
+    /// Copy the unit's body (header ++ payload) starting at `from`
+    fn copyBody(self: *const Self, unit: Unit, from: usize, out: []u8) void {
+        var written: usize = 0;
+        if (from < unit.header_len) {
+            const n = @min(unit.header_len - from, out.len);
+            @memcpy(out[0..n], unit.header[from..][0..n]);
+            written = n;
+        }
+        const payload_from = (from + written) - unit.header_len;
+        const payload = self.frame[unit.payload_start..][0..unit.payload_len];
+        @memcpy(out[written..], payload[payload_from..][0 .. out.len - written]);
+    }
+
+    fn addUnit(self: *Self, unit: Unit) PacketizeError!void {
+        if (self.unit_count == max_units) return PacketizeError.TooManyUnits;
+        self.units[self.unit_count] = unit;
+        self.unit_count += 1;
+    }
+
+    fn splitAnnexB(self: *Self) PacketizeError!void {
+        const header_len: u8 = if (self.format == .hevc) 2 else 1;
+        const data = self.frame;
+
+        var start = findStartCode(data, 0) orelse {
+            // No start codes: treat the buffer as a single NAL
+            return self.addNal(0, data.len, header_len);
+        };
+        while (true) {
+            const next = findStartCode(data, start);
+            var end = if (next) |n| n - 3 else data.len;
+            if (next != null) {
+                // trailing_zero_8bits / 4-byte start code prefix
+                while (end > start and data[end - 1] == 0) end -= 1;
+            }
+            if (end > start) try self.addNal(start, end, header_len);
+            start = next orelse break;
+        }
+    }
+
+    fn addNal(self: *Self, start: usize, end: usize, header_len: u8) PacketizeError!void {
+        if (end - start <= header_len) return PacketizeError.MalformedBitstream;
+        const data = self.frame;
+        const nal_type = if (self.format == .hevc) (data[start] >> 1) & 0x3f else data[start] & 0x1f;
+        // Access unit delimiters are implied by the RTP timestamp
+        if ((self.format == .h264 and nal_type == 9) or (self.format == .hevc and nal_type == 35)) return;
+
+        var unit = Unit{
+            .header_len = header_len,
+            .payload_start = @intCast(start + header_len),
+            .payload_len = @intCast(end - start - header_len),
+        };
+        @memcpy(unit.header[0..header_len], data[start..][0..header_len]);
+        try self.addUnit(unit);
+    }
+
+    fn splitObus(self: *Self) PacketizeError!void {
+        const data = self.frame;
+        var pos: usize = 0;
+        while (pos < data.len) {
+            const obu_pos = pos;
+            const obu_header = data[pos];
+            const obu_type = (obu_header >> 3) & 0x0f;
+            const has_extension = obu_header & 0x04 != 0;
+            const has_size = obu_header & 0x02 != 0;
+            const header_len: u8 = if (has_extension) 2 else 1;
+            if (pos + header_len > data.len) return PacketizeError.MalformedBitstream;
+
+            var payload_start = pos + header_len;
+            var payload_len = data.len - payload_start;
+            if (has_size) {
+                const size = readLeb128(data[payload_start..]) orelse return PacketizeError.MalformedBitstream;
+                payload_start += size.len;
+                if (size.value > data.len - payload_start) return PacketizeError.MalformedBitstream;
+                payload_len = @intCast(size.value);
+            }
+            pos = payload_start + payload_len;
+
+            // Temporal delimiters and tile lists are not transmitted
+            if (obu_type == 2 or obu_type == 8) continue;
+
+            var unit = Unit{
+                .header_len = header_len,
+                .payload_start = @intCast(payload_start),
+                .payload_len = @intCast(payload_len),
+            };
+            // The last OBU element's length is implied (W=1), so drop the size field
+            unit.header[0] = obu_header & ~@as(u8, 0x02);
+            if (has_extension) unit.header[1] = data[obu_pos + 1];
+            try self.addUnit(unit);
+        }
+    }
+};
+
+fn aggregationOverhead(format: PayloadFormat) usize {
+    return if (format == .av1) 1 else 0;
+}
+
+fn fragmentOverhead(format: PayloadFormat) usize {
+    return switch (format) {
+        .h264 => 2, // FU indicator + FU header
+        .hevc => 3, // PayloadHdr + FU header
+        .av1 => 1, // aggregation header
+    };
+}
+
+/// Index just past the next 00 00 01 start code at or after `from`
+fn findStartCode(data: []const u8, from: usize) ?usize {
+    if (data.len < 3) return null;
+    var i = from;
+    while (i + 3 <= data.len) : (i += 1) {
+        if (data[i] == 0 and data[i + 1] == 0 and data[i + 2] == 1) return i + 3;
+    }
+    return null;
+}
+
+const Leb128 = struct { value: u64, len: usize };
+
+fn readLeb128(data: []const u8) ?Leb128 {
+    var value: u64 = 0;
+    for (data[0..@min(data.len, 8)], 0..) |byte, i| {
+        value |= @as(u64, byte & 0x7f) << @intCast(i * 7);
+        if (byte & 0x80 == 0) return .{ .value = value, .len = i + 1 };
+    }
+    return null;
+}
+
+test "rtp header round trip" {
+    var buf: [header_size]u8 = undefined;
+    const header = Header{ .marker = true, .payload_type = 97, .sequence = 65535, .timestamp = 0xdeadbeef, .ssrc = 42 };
+    header.write(&buf);
+    try std.testing.expectEqual(@as(u8, 0x80), buf[0]);
+    try std.testing.expectEqual(header, Header.parse(&buf));
+}
+
+test "h264 single nal and fu-a fragmentation" {
+    // SPS (small) followed by an IDR slice that needs fragmenting
+    var frame: [4 + 8 + 4 + 3000]u8 = undefined;
+    @memcpy(frame[0..4], &[_]u8{ 0, 0, 0, 1 });
+    @memcpy(frame[4..12], &[_]u8{ 0x67, 1, 2, 3, 4, 5, 6, 7 });
+    @memcpy(frame[12..16], &[_]u8{ 0, 0, 0, 1 });
+    frame[16] = 0x65;
+    @memset(frame[17..], 0xab);
+
+    var packetizer = Packetizer.init(.h264, 1234, 1200);
+    try packetizer.begin(&frame, 0, true);
+    var batch = Batch{};
+    try std.testing.expect(packetizer.fill(&batch));
+
+    // SPS whole, then ceil(2999 / (1188 - 2)) = 3 fragments
+    try std.testing.expectEqual(@as(usize, 4), batch.count);
+    try std.testing.expectEqualSlices(u8, frame[4..12], batch.packet(0)[header_size..]);
+
+    const first = batch.packet(1);
+    try std.testing.expectEqual(@as(u8, 0x60 | 28), first[header_size]);
+    try std.testing.expectEqual(@as(u8, 0x80 | 5), first[header_size + 1]);
+    // Fragments share one size so they can go out as a single GSO send
+    try std.testing.expectEqual(@as(usize, 1200), first.len);
+    try std.testing.expectEqual(@as(usize, 1200), batch.packet(2).len);
+
+    const last = batch.packet(3);
+    try std.testing.expectEqual(@as(u8, 0x40 | 5), last[header_size + 1]);
+    try std.testing.expect(Header.parse(last[0..header_size]).marker);
+    try std.testing.expect(!Header.parse(first[0..header_size]).marker);
+    try std.testing.expectEqual(@as(u16, 3), Header.parse(last[0..header_size]).sequence);
+}
+
+test "av1 obu size field stripped" {
+    // Temporal delimiter, then a frame OBU with a size field
+    const frame = [_]u8{ 0x12, 0x00, 0x32, 0x03, 0xaa, 0xbb, 0xcc };
+    var packetizer = Packetizer.init(.av1, 1, 1400);
+    try packetizer.begin(&frame, 0, false);
+    var batch = Batch{};
+    try std.testing.expect(packetizer.fill(&batch));
+
+    try std.testing.expectEqual(@as(usize, 1), batch.count);
+    try std.testing.expectEqualSlices(u8, &[_]u8{ 0x10, 0x30, 0xaa, 0xbb, 0xcc }, batch.packet(0)[header_size..]);
+}
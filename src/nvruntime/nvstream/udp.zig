@@ -0,0 +1,264 @@
+//! nvstream/udp - Batched UDP Send Path
+//!
+//! Sends an RTP `Batch` with one `sendmmsg` call. Runs of equal-sized
+//! packets are coalesced into a single UDP GSO message (`UDP_SEGMENT`),
+//! so a fragmented keyframe leaves userspace as a handful of super-datagrams
+//! instead of one syscall per packet. Optional pacing caps the socket rate
+//! (SO_MAX_PACING_RATE, honoured by the fq qdisc) and spreads bursts.
+
+const std = @import("std");
+const rtp = @import("rtp.zig");
+const nvmon = @import("../../nvmon/nvmon.zig");
+
+const linux = std.os.linux;
+const posix = std.posix;
+
+const SOL_UDP = 17;
+const UDP_SEGMENT = 103;
+const SO_MAX_PACING_RATE = 47;
+const SIOCOUTQ = 0x5411;
+
+/// Kernel limit on segments per GSO send (UDP_MAX_SEGMENTS)
+const max_gso_segments = 64;
+/// Largest UDP payload over IPv4; a GSO super-datagram must fit it too
+const max_udp_payload = 65507;
+
+/// Send path configuration
+pub const Config = struct {
+    /// Coalesce equal-sized packets with UDP_SEGMENT when the kernel supports it
+    use_gso: bool = true,
+    /// Pacing rate in kbit/s; 0 sends every batch as fast as possible
+    pacing_kbps: u32 = 0,
+    /// With pacing, packets sent back to back before waiting
+    burst_packets: u16 = 16,
+};
+
+/// Result of one batch send
+pub const SendResult = struct {
+    packets: usize = 0,
+    bytes: usize = 0,
+    syscalls: u32 = 0,
+    /// Earlier datagrams refused by the peer (ICMP port unreachable on a connected socket)
+    refused: usize = 0,
+};
+
+/// cmsghdr carrying a u16 UDP_SEGMENT value, padded to CMSG_SPACE(2)
+const SegmentCmsg = extern struct {
+    len: usize,
+    level: i32,
+    type: i32,
+    segment: u16,
+    pad: [6]u8 = .{ 0, 0, 0, 0, 0, 0 },
+};
+
+/// Connected UDP socket with a batched send path
+pub const Sender = struct {
+    fd: posix.socket_t,
+    gso: bool,
+    config: Config,
+
+    // Scratch for one sendmmsg call, kept here to stay off the stack
+    msgs: [rtp.Batch.max_packets]linux.mmsghdr_const = undefined,
+    iovs: [rtp.Batch.max_packets]posix.iovec_const = undefined,
+    cmsgs: [rtp.Batch.max_packets]SegmentCmsg = undefined,
+    /// First packet of each message
+    message_first: [rtp.Batch.max_packets]u32 = undefined,
+
+    const Self = @This();
+
+    pub fn open(host: []const u8, port: u16, config: Config) !Self {
+        const address = try std.net.Address.parseIp(host, port);
+        const fd = try posix.socket(address.any.family, posix.SOCK.DGRAM | posix.SOCK.CLOEXEC, posix.IPPROTO.UDP);
+        errdefer posix.close(fd);
+        try posix.connect(fd, &address.any, address.getOsSockLen());
+
+        var self = Self{ .fd = fd, .gso = false, .config = config };
+        if (config.use_gso) {
+            // Probe: kernels without UDP GSO reject the option
+            const probe: u16 = 0;
+            self.gso = if (posix.setsockopt(fd, SOL_UDP, UDP_SEGMENT, std.mem.asBytes(&probe))) true else |_| false;
+        }
+        if (config.pacing_kbps > 0) {
+            const bytes_per_sec: u32 = @intCast(@min(@as(u64, config.pacing_kbps) * 1000 / 8, std.math.maxInt(u32)));
+            posix.setsockopt(fd, posix.SOL.SOCKET, SO_MAX_PACING_RATE, std.mem.asBytes(&bytes_per_sec)) catch {};
+        }
+        return self;
+    }
+
+    pub fn close(self: *Self) void {
+        posix.close(self.fd);
+    }
+
+    /// Send every packet in `batch`. Returns once the kernel has accepted all of them.
+    pub fn send(self: *Self, batch: *const rtp.Batch) !SendResult {
+        var result = SendResult{};
+        const burst: usize = if (self.config.pacing_kbps > 0) @max(self.config.burst_packets, 1) else batch.count;
+
+        var first: usize = 0;
+        while (first < batch.count) {
+            const last = @min(first + burst, batch.count);
+            const burst_start = nvmon.timestampNs();
+            const sent = try self.sendRange(batch, first, last, &result);
+            first = last;
+
+            if (self.config.pacing_kbps > 0 and first < batch.count) {
+                const due_ns = sent * 8 * std.time.ns_per_ms / self.config.pacing_kbps;
+                const elapsed = nvmon.timestampNs() -| burst_start;
+                if (due_ns > elapsed) {
+                    const wait = due_ns - elapsed;
+                    posix.nanosleep(wait / std.time.ns_per_s, wait % std.time.ns_per_s);
+                }
+            }
+        }
+        return result;
+    }
+
+    /// Bytes still waiting in the socket send queue
+    pub fn queuedBytes(self: *const Self) u32 {
+        var outq: c_int = 0;
+        const rc = linux.ioctl(self.fd, SIOCOUTQ, @intFromPtr(&outq));
+        if (posix.errno(rc) != .SUCCESS) return 0;
+        return @intCast(@max(outq, 0));
+    }
+
+    /// Send packets [first, last) and return the bytes sent
+    fn sendRange(self: *Self, batch: *const rtp.Batch, first: usize, last: usize, result: *SendResult) !usize {
+        const count = self.buildMessages(batch, first, last);
+        var bytes: usize = 0;
+        for (self.iovs[0..count]) |iov| bytes += iov.len;
+
+        var done: usize = 0;
+        while (done < count) {
+            const rc = linux.sendmmsg(self.fd, self.msgs[done..count].ptr, @intCast(count - done), 0);
+            result.syscalls += 1;
+            switch (posix.errno(rc)) {
+                .SUCCESS => done += rc,
+                .INTR, .AGAIN => continue,
+                .CONNREFUSED => {
+                    // Pending error from an earlier datagram (nobody listening yet);
+                    // reporting it clears it, so retry this message
+                    result.refused += 1;
+                },
+                .IO, .MSGSIZE => {
+                    if (!self.gso) return error.SendFailed;
+                    // The device cannot segment (or refused the super-datagram):
+                    // fall back to one datagram per packet, resuming after the
+                    // messages that already went out
+                    self.gso = false;
+                    const resume_at: usize = self.message_first[done];
+                    var sent: usize = 0;
+                    for (self.iovs[0..done]) |iov| sent += iov.len;
+                    result.packets += resume_at - first;
+                    result.bytes += sent;
+                    return sent + try self.sendRange(batch, resume_at, last, result);
+                },
+                else => return error.SendFailed,
+            }
+        }
+        result.packets += last - first;
+        result.bytes += bytes;
+        return bytes;
+    }
+
+    /// Fill the sendmmsg vector for packets [first, last). Returns the message count.
+    fn buildMessages(self: *Self, batch: *const rtp.Batch, first: usize, last: usize) usize {
+        var count: usize = 0;
+        var i = first;
+        while (i < last) {
+            const segment = batch.packet(i);
+            var run: usize = 1;
+            if (self.gso) {
+                // Equal-sized packets are contiguous in the batch; the run may
+                // end with one shorter packet. The whole run is one datagram,
+                // so it must stay under the UDP payload limit.
+                const max_run = @min(max_gso_segments, max_udp_payload / @max(segment.len, 1));
+                while (i + run < last and run < max_run) {
+                    const next_len = batch.packet(i + run).len;
+                    if (next_len > segment.len) break;
+                    run += 1;
+                    if (next_len < segment.len) break;
+                }
+            }
+
+            var len: usize = 0;
+            for (i..i + run) |p| len += batch.packet(p).len;
+            self.iovs[count] = .{ .base = segment.ptr, .len = len };
+            self.message_first[count] = @intCast(i);
+
+            var control: ?*const anyopaque = null;
+            if (run > 1) {
+                self.cmsgs[count] = .{
+                    .len = @sizeOf(usize) + 2 * @sizeOf(i32) + @sizeOf(u16),
+                    .level = SOL_UDP,
+                    .type = UDP_SEGMENT,
+                    .segment = @intCast(segment.len),
+                };
+                control = &self.cmsgs[count];
+            }
+            self.msgs[count] = .{
+                .hdr = .{
+                    .name = null,
+                    .namelen = 0,
+                    .iov = @ptrCast(&self.iovs[count]),
+                    .iovlen = 1,
+                    .control = control,
+                    .controllen = if (control != null) @sizeOf(SegmentCmsg) else 0,
+                    .flags = 0,
+                },
+                .len = 0,
+            };
+            count += 1;
+            i += run;
+        }
+        return count;
+    }
+};
+
+test "segment cmsg layout" {
+    // Must match CMSG_SPACE(sizeof(uint16_t)) on 64-bit Linux
+    try std.testing.expectEqual(@as(usize, 24), @sizeOf(SegmentCmsg));
+}
+
+test "gso runs group equal-sized packets" {
+    var batch = rtp.Batch{};
+    var packetizer = rtp.Packetizer.init(.h264, 7, 1200);
+    var frame: [4 + 5000]u8 = undefined;
+    @memcpy(frame[0..4], &[_]u8{ 0, 0, 0, 1 });
+    frame[4] = 0x65;
+    @memset(frame[5..], 0x11);
+    try packetizer.begin(&frame, 0, true);
+    try std.testing.expect(packetizer.fill(&batch));
+
+    var sender = Sender{ .fd = -1, .gso = true, .config = .{} };
+    // Four full fragments and a short tail collapse into one message
+    try std.testing.expectEqual(@as(usize, 5), batch.count);
+    try std.testing.expectEqual(@as(usize, 1), sender.buildMessages(&batch, 0, batch.count));
+    try std.testing.expectEqual(batch.bytes(), sender.iovs[0].len);
+
+    sender.gso = false;
+    try std.testing.expectEqual(@as(usize, 5), sender.buildMessages(&batch, 0, batch.count));
+}
+
+test "gso runs fit one udp payload" {
+    var batch = rtp.Batch{};
+    var packetizer = rtp.Packetizer.init(.h264, 7, 1400);
+    var frame: [4 + 120_000]u8 = undefined;
+    @memcpy(frame[0..4], &[_]u8{ 0, 0, 0, 1 });
+    frame[4] = 0x65;
+    @memset(frame[5..], 0x11);
+    try packetizer.begin(&frame, 0, true);
+    _ = packetizer.fill(&batch);
+
+    var sender = Sender{ .fd = -1, .gso = true, .config = .{} };
+    const count = sender.buildMessages(&batch, 0, batch.count);
+    try std.testing.expect(count > 1);
+    for (sender.iovs[0..count]) |iov| try std.testing.expect(iov.len <= max_udp_payload);
+
+    // Each message records where its run starts, so a fallback can resume there
+    try std.testing.expectEqual(@as(u32, 0), sender.message_first[0]);
+    for (1..count) |m| {
+        var len: usize = 0;
+        for (sender.message_first[m - 1]..sender.message_first[m]) |p| len += batch.packet(p).len;
+        try std.testing.expectEqual(sender.iovs[m - 1].len, len);
+    }
+}
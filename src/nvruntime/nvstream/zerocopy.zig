@@ -0,0 +1,558 @@
+//! nvstream/zerocopy - DMA-BUF to NVENC Import Path
+//!
+//! Imports captured DMA-BUF surfaces as EGL images and registers them with
+//! CUDA so NVENC can read them in place: no CPU readback and no per-frame
+//! allocation. CUDA's own external memory import only accepts opaque fds
+//! exported by CUDA or Vulkan, so compositor and PipeWire buffers go
+//! through EGL_EXT_image_dma_buf_import on the EGL device of the CUDA GPU.
+//! Compositors and PipeWire recycle a small swapchain, so each buffer is
+//! imported once and then served from a fixed-size cache.
+
+const std = @import("std");
+const pipeline = @import("pipeline.zig");
+
+const dl = @cImport({
+    @cInclude("dlfcn.h");
+});
+
+/// The only layout the import path understands: CUDA maps the buffer as
+/// plain linear memory, so tiled or compressed buffers would read as garbage
+pub const DRM_FORMAT_MOD_LINEAR: u64 = 0;
+
+/// CUDA driver API entry points used by the import path (loaded dynamically)
+const Cuda = struct {
+    const CUresult = c_int;
+    const CUdevice = c_int;
+    const CUcontext = ?*anyopaque;
+    const CUgraphicsResource = ?*anyopaque;
+
+    const CUDA_SUCCESS: CUresult = 0;
+    const CU_GRAPHICS_REGISTER_FLAGS_READ_ONLY: c_uint = 1;
+    const CU_EGL_FRAME_TYPE_PITCH: c_int = 1;
+
+    /// CUeglFrame from cudaEGL.h
+    const EglFrame = extern struct {
+        /// Plane pointers (pitch frames) or CUarrays (array frames)
+        planes: [3]?*anyopaque,
+        width: c_uint,
+        height: c_uint,
+        depth: c_uint,
+        pitch: c_uint,
+        plane_count: c_uint,
+        num_channels: c_uint,
+        frame_type: c_int,
+        egl_color_format: c_int,
+        cu_format: c_int,
+    };
+
+    init: ?*const fn (c_uint) callconv(.c) CUresult = null,
+    device_get: ?*const fn (*CUdevice, c_int) callconv(.c) CUresult = null,
+    primary_ctx_retain: ?*const fn (*CUcontext, CUdevice) callconv(.c) CUresult = null,
+    primary_ctx_release: ?*const fn (CUdevice) callconv(.c) CUresult = null,
+    ctx_push_current: ?*const fn (CUcontext) callconv(.c) CUresult = null,
+    ctx_pop_current: ?*const fn (*CUcontext) callconv(.c) CUresult = null,
+    egl_register_image: ?*const fn (*CUgraphicsResource, Egl.EGLImage, c_uint) callconv(.c) CUresult = null,
+    get_mapped_egl_frame: ?*const fn (*EglFrame, CUgraphicsResource, c_uint, c_uint) callconv(.c) CUresult = null,
+    unregister_resource: ?*const fn (CUgraphicsResource) callconv(.c) CUresult = null,
+
+    handle: ?*anyopaque = null,
+
+    fn load() ?Cuda {
+        var self = Cuda{};
+
+        self.handle = dl.dlopen("libcuda.so.1", dl.RTLD_LAZY);
+        if (self.handle == null) {
+            self.handle = dl.dlopen("libcuda.so", dl.RTLD_LAZY);
+        }
+
+        if (self.handle == null) {
+            return null;
+        }
+
+        self.init = @ptrCast(dl.dlsym(self.handle, "cuInit"));
+        self.device_get = @ptrCast(dl.dlsym(self.handle, "cuDeviceGet"));
+        self.primary_ctx_retain = @ptrCast(dl.dlsym(self.handle, "cuDevicePrimaryCtxRetain"));
+        self.primary_ctx_release = @ptrCast(dl.dlsym(self.handle, "cuDevicePrimaryCtxRelease_v2"));
+        self.ctx_push_current = @ptrCast(dl.dlsym(self.handle, "cuCtxPushCurrent_v2"));
+        self.ctx_pop_current = @ptrCast(dl.dlsym(self.handle, "cuCtxPopCurrent_v2"));
+        self.egl_register_image = @ptrCast(dl.dlsym(self.handle, "cuGraphicsEGLRegisterImage"));
+        self.get_mapped_egl_frame = @ptrCast(dl.dlsym(self.handle, "cuGraphicsResourceGetMappedEglFrame"));
+        self.unregister_resource = @ptrCast(dl.dlsym(self.handle, "cuGraphicsUnregisterResource"));
+
+        return self;
+    }
+
+    fn unload(self: *Cuda) void {
+        if (self.handle) |handle| _ = dl.dlclose(handle);
+        self.handle = null;
+    }
+
+    fn isComplete(self: *const Cuda) bool {
+        return self.init != null and self.device_get != null and
+            self.primary_ctx_retain != null and self.primary_ctx_release != null and
+            self.ctx_push_current != null and self.ctx_pop_current != null and
+            self.egl_register_image != null and self.get_mapped_egl_frame != null and
+            self.unregister_resource != null;
+    }
+};
+
+/// EGL entry points used to wrap DMA-BUFs as images (loaded dynamically)
+const Egl = struct {
+    const EGLDisplay = ?*anyopaque;
+    const EGLDeviceEXT = ?*anyopaque;
+    const EGLImage = ?*anyopaque;
+    const EGLint = i32;
+    const EGLAttrib = isize;
+    const EGLBoolean = c_uint;
+
+    const EGL_NONE: EGLint = 0x3038;
+    const EGL_WIDTH: EGLint = 0x3057;
+    const EGL_HEIGHT: EGLint = 0x3056;
+    const EGL_PLATFORM_DEVICE_EXT: c_uint = 0x313F;
+    const EGL_CUDA_DEVICE_NV: EGLint = 0x323A;
+    const EGL_LINUX_DMA_BUF_EXT: c_uint = 0x3270;
+    const EGL_LINUX_DRM_FOURCC_EXT: EGLint = 0x3271;
+    /// FD, OFFSET and PITCH of plane 0; plane 1 follows at +3
+    const EGL_DMA_BUF_PLANE0_FD_EXT: EGLint = 0x3272;
+    /// MODIFIER_LO and _HI of plane 0; plane 1 follows at +2
+    const EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT: EGLint = 0x3443;
+
+    get_proc_address: ?*const fn ([*:0]const u8) callconv(.c) ?*anyopaque = null,
+    initialize: ?*const fn (EGLDisplay, ?*EGLint, ?*EGLint) callconv(.c) EGLBoolean = null,
+    terminate: ?*const fn (EGLDisplay) callconv(.c) EGLBoolean = null,
+    // Extensions, resolved through eglGetProcAddress
+    query_devices: ?*const fn (EGLint, [*]EGLDeviceEXT, *EGLint) callconv(.c) EGLBoolean = null,
+    query_device_attrib: ?*const fn (EGLDeviceEXT, EGLint, *EGLAttrib) callconv(.c) EGLBoolean = null,
+    get_platform_display: ?*const fn (c_uint, ?*anyopaque, ?[*]const EGLint) callconv(.c) EGLDisplay = null,
+    create_image: ?*const fn (EGLDisplay, ?*anyopaque, c_uint, ?*anyopaque, [*]const EGLint) callconv(.c) EGLImage = null,
+    destroy_image: ?*const fn (EGLDisplay, EGLImage) callconv(.c) EGLBoolean = null,
+
+    handle: ?*anyopaque = null,
+
+    fn load() ?Egl {
+        var self = Egl{};
+
+        self.handle = dl.dlopen("libEGL.so.1", dl.RTLD_LAZY);
+        if (self.handle == null) {
+            return null;
+        }
+
+        self.get_proc_address = @ptrCast(dl.dlsym(self.handle, "eglGetProcAddress"));
+        self.initialize = @ptrCast(dl.dlsym(self.handle, "eglInitialize"));
+        self.terminate = @ptrCast(dl.dlsym(self.handle, "eglTerminate"));
+        const proc = self.get_proc_address orelse return self;
+        self.query_devices = @ptrCast(proc("eglQueryDevicesEXT"));
+        self.query_device_attrib = @ptrCast(proc("eglQueryDeviceAttribEXT"));
+        self.get_platform_display = @ptrCast(proc("eglGetPlatformDisplayEXT"));
+        self.create_image = @ptrCast(proc("eglCreateImageKHR"));
+        self.destroy_image = @ptrCast(proc("eglDestroyImageKHR"));
+
+        return self;
+    }
+
+    fn unload(self: *Egl) void {
+        if (self.handle) |handle| _ = dl.dlclose(handle);
+        self.handle = null;
+    }
+
+    fn isComplete(self: *const Egl) bool {
+        return self.get_proc_address != null and self.initialize != null and self.terminate != null and
+            self.query_devices != null and self.query_device_attrib != null and
+            self.get_platform_display != null and self.create_image != null and self.destroy_image != null;
+    }
+
+    /// Initialize the EGL display of the device CUDA knows as `cuda_device`
+    fn openDisplay(self: *const Egl, cuda_device: Cuda.CUdevice) ?EGLDisplay {
+        var devices: [16]EGLDeviceEXT = undefined;
+        var count: EGLint = 0;
+        if (self.query_devices.?(devices.len, &devices, &count) == 0) return null;
+        for (devices[0..@intCast(count)]) |device| {
+            var value: EGLAttrib = -1;
+            if (self.query_device_attrib.?(device, EGL_CUDA_DEVICE_NV, &value) == 0) continue;
+            if (value != cuda_device) continue;
+            const display = self.get_platform_display.?(EGL_PLATFORM_DEVICE_EXT, device, null);
+            if (display == null) continue;
+            if (self.initialize.?(display, null, null) == 0) continue;
+            return display;
+        }
+        return null;
+    }
+};
+
+/// Description of a captured DMA-BUF (single-plane or contiguous NV12/P010)
+pub const DmaBufDesc = struct {
+    fd: std.posix.fd_t,
+    size: u64,
+    offset: u64 = 0,
+    width: u32,
+    height: u32,
+    pitch: u32,
+    /// DRM fourcc of the buffer
+    fourcc: u32,
+    modifier: u64 = DRM_FORMAT_MOD_LINEAR,
+};
+
+/// Memory layout of a supported fourcc: bytes per pixel of the first plane
+/// and total rows of all planes, in units of half the frame height
+const FormatLayout = struct {
+    bytes_per_pixel: u32,
+    half_rows: u32,
+};
+
+fn formatLayout(fourcc: u32) ?FormatLayout {
+    return switch (fourcc) {
+        fourccCode("NV12") => .{ .bytes_per_pixel = 1, .half_rows = 3 },
+        fourccCode("P010") => .{ .bytes_per_pixel = 2, .half_rows = 3 },
+        fourccCode("AB24"), fourccCode("AR24"), fourccCode("AR30") => .{ .bytes_per_pixel = 4, .half_rows = 2 },
+        else => null,
+    };
+}
+
+pub fn fourccCode(comptime code: *const [4]u8) u32 {
+    return std.mem.readInt(u32, code, .little);
+}
+
+/// Check that `desc` is a linear buffer of a known format whose planes fit
+pub fn validate(desc: DmaBufDesc) ImportError!void {
+    if (desc.modifier != DRM_FORMAT_MOD_LINEAR) return ImportError.UnsupportedModifier;
+    const layout = formatLayout(desc.fourcc) orelse return ImportError.UnsupportedFormat;
+    if (desc.size == 0 or desc.offset >= desc.size) return ImportError.InvalidBuffer;
+    if (desc.pitch < @as(u64, desc.width) * layout.bytes_per_pixel) return ImportError.InvalidBuffer;
+    const bytes = @as(u64, desc.pitch) * ((@as(u64, desc.height) * layout.half_rows + 1) / 2);
+    if (bytes > desc.size - desc.offset) return ImportError.InvalidBuffer;
+}
+
+const max_attribs = 32;
+
+/// EGL_LINUX_DMA_BUF_EXT attributes of a validated `desc`. The chroma plane
+/// of NV12/P010 follows the luma rows, as NVENC expects.
+fn dmabufAttribs(desc: DmaBufDesc, buf: *[max_attribs]Egl.EGLint) []const Egl.EGLint {
+    const layout = formatLayout(desc.fourcc).?;
+    const planes: u32 = if (layout.half_rows == 3) 2 else 1;
+    var n: usize = 0;
+    const pairs = [_][2]Egl.EGLint{
+        .{ Egl.EGL_WIDTH, @intCast(desc.width) },
+        .{ Egl.EGL_HEIGHT, @intCast(desc.height) },
+        .{ Egl.EGL_LINUX_DRM_FOURCC_EXT, @bitCast(desc.fourcc) },
+    };
+    for (pairs) |pair| {
+        buf[n] = pair[0];
+        buf[n + 1] = pair[1];
+        n += 2;
+    }
+    for (0..planes) |plane| {
+        const offset = desc.offset + plane * @as(u64, desc.pitch) * desc.height;
+        const attr = Egl.EGL_DMA_BUF_PLANE0_FD_EXT + @as(Egl.EGLint, @intCast(plane)) * 3;
+        const modifier_attr = Egl.EGL_DMA_BUF_PLANE0_MODIFIER_LO_EXT + @as(Egl.EGLint, @intCast(plane)) * 2;
+        const values = [_]Egl.EGLint{
+            attr,              desc.fd,
+            attr + 1,          @intCast(offset),
+            attr + 2,          @intCast(desc.pitch),
+            modifier_attr,     @bitCast(@as(u32, @truncate(desc.modifier))),
+            modifier_attr + 1, @bitCast(@as(u32, @truncate(desc.modifier >> 32))),
+        };
+        @memcpy(buf[n..][0..values.len], &values);
+        n += values.len;
+    }
+    buf[n] = Egl.EGL_NONE;
+    return buf[0 .. n + 1];
+}
+
+/// A captured frame resident in GPU memory, ready for NVENC input registration.
+/// Holds its import slot until `release`, so the slot is not evicted while
+/// the frame is queued or being encoded.
+pub const GpuSurface = struct {
+    /// CUDA device pointer to the first pixel
+    device_ptr: u64,
+    width: u32,
+    height: u32,
+    pitch: u32,
+    fourcc: u32,
+    /// Import cache slot backing this surface (stable for the buffer's lifetime)
+    slot: u8,
+    importer: ?*Importer = null,
+
+    /// Drop this surface's hold on its import slot
+    pub fn release(self: *GpuSurface) void {
+        const importer = self.importer orelse return;
+        _ = importer.slots[self.slot].holds.fetchSub(1, .release);
+        self.importer = null;
+    }
+};
+
+/// Imported buffer kept alive across frames
+const ImportSlot = struct {
+    /// Identity of the underlying buffer (the fd number alone is reused)
+    dev: u64 = 0,
+    ino: u64 = 0,
+    /// Layout the image was created with; a new one needs a new image
+    desc: DmaBufDesc = undefined,
+    image: Egl.EGLImage = null,
+    resource: Cuda.CUgraphicsResource = null,
+    device_ptr: u64 = 0,
+    last_use: u64 = 0,
+    in_use: bool = false,
+    /// Surfaces handed out and not yet released (queued or encoding)
+    holds: std.atomic.Value(u32) = std.atomic.Value(u32).init(0),
+};
+
+pub const ImportError = error{
+    CudaNotAvailable,
+    CudaInitFailed,
+    ImportFailed,
+    /// libEGL, its device platform or DMA-BUF import is missing
+    EglNotAvailable,
+    InvalidBuffer,
+    /// Tiled/compressed layout; the capture backend must offer LINEAR
+    UnsupportedModifier,
+    /// Every slot backs a frame still queued or being encoded
+    PoolExhausted,
+    UnsupportedFormat,
+};
+
+/// Imports DMA-BUFs into CUDA once and hands out cached device pointers
+pub const Importer = struct {
+    /// The deepest frame queue plus the frames capture and encode hold
+    pub const max_slots = pipeline.max_depth + 2;
+
+    cuda: Cuda,
+    egl: Egl,
+    display: Egl.EGLDisplay = null,
+    device: Cuda.CUdevice = 0,
+    context: Cuda.CUcontext = null,
+    slots: [max_slots]ImportSlot = [_]ImportSlot{.{}} ** max_slots,
+    use_counter: u64 = 0,
+
+    /// Cache statistics
+    imports: u64 = 0,
+    hits: u64 = 0,
+
+    const Self = @This();
+
+    /// Load libcuda and libEGL, retain the primary context of `cuda_device`
+    /// and open the EGL display of the same GPU
+    pub fn init(cuda_device: u32) ImportError!Self {
+        var cuda = Cuda.load() orelse return ImportError.CudaNotAvailable;
+        errdefer cuda.unload();
+        if (!cuda.isComplete()) return ImportError.CudaNotAvailable;
+        var egl = Egl.load() orelse return ImportError.EglNotAvailable;
+        errdefer egl.unload();
+        if (!egl.isComplete()) return ImportError.EglNotAvailable;
+
+        var self = Self{ .cuda = cuda, .egl = egl };
+        if (cuda.init.?(0) != Cuda.CUDA_SUCCESS) return ImportError.CudaInitFailed;
+        if (cuda.device_get.?(&self.device, @intCast(cuda_device)) != Cuda.CUDA_SUCCESS) return ImportError.CudaInitFailed;
+        self.display = egl.openDisplay(self.device) orelse return ImportError.EglNotAvailable;
+        errdefer _ = egl.terminate.?(self.display);
+        if (cuda.primary_ctx_retain.?(&self.context, self.device) != Cuda.CUDA_SUCCESS) return ImportError.CudaInitFailed;
+        return self;
+    }
+
+    pub fn deinit(self: *Self) void {
+        self.pushContext();
+        for (&self.slots) |*slot| self.release(slot);
+        self.popContext();
+        _ = self.cuda.primary_ctx_release.?(self.device);
+        _ = self.egl.terminate.?(self.display);
+        self.egl.unload();
+        self.cuda.unload();
+    }
+
+    /// CUDA context NVENC should be opened on (NV_ENC_DEVICE_TYPE_CUDA)
+    pub fn cudaContext(self: *const Self) ?*anyopaque {
+        return self.context;
+    }
+
+    /// Map a DMA-BUF to a CUDA device pointer, importing it on first sight.
+    /// Only LINEAR buffers are accepted (see `validate`). The surface holds
+    /// its slot until `GpuSurface.release`; held slots are never evicted.
+    pub fn import(self: *Self, desc: DmaBufDesc) !GpuSurface {
+        try validate(desc);
+
+        const st = try std.posix.fstat(desc.fd);
+        const dev: u64 = @intCast(st.dev);
+        const ino: u64 = @intCast(st.ino);
+        self.use_counter += 1;
+
+        for (&self.slots, 0..) |*slot, i| {
+            if (slot.in_use and slot.dev == dev and slot.ino == ino and sameLayout(slot.desc, desc)) {
+                slot.last_use = self.use_counter;
+                self.hits += 1;
+                return self.surfaceFrom(desc, @intCast(i));
+            }
+        }
+
+        // Evict the least recently used slot no frame in flight still reads
+        var victim: ?usize = null;
+        for (&self.slots, 0..) |*slot, i| {
+            if (slot.holds.load(.acquire) != 0) continue;
+            if (!slot.in_use) {
+                victim = i;
+                break;
+            }
+            if (victim == null or slot.last_use < self.slots[victim.?].last_use) victim = i;
+        }
+        const index = victim orelse return ImportError.PoolExhausted;
+
+        self.pushContext();
+        defer self.popContext();
+
+        const slot = &self.slots[index];
+        self.release(slot);
+
+        // The image holds its own reference to the buffer; the fd stays the caller's
+        var attribs: [max_attribs]Egl.EGLint = undefined;
+        const image = self.egl.create_image.?(self.display, null, Egl.EGL_LINUX_DMA_BUF_EXT, null, dmabufAttribs(desc, &attribs).ptr);
+        if (image == null) return ImportError.ImportFailed;
+        errdefer _ = self.egl.destroy_image.?(self.display, image);
+
+        var resource: Cuda.CUgraphicsResource = null;
+        if (self.cuda.egl_register_image.?(&resource, image, Cuda.CU_GRAPHICS_REGISTER_FLAGS_READ_ONLY) != Cuda.CUDA_SUCCESS) {
+            return ImportError.ImportFailed;
+        }
+        errdefer _ = self.cuda.unregister_resource.?(resource);
+
+        var frame: Cuda.EglFrame = undefined;
+        if (self.cuda.get_mapped_egl_frame.?(&frame, resource, 0, 0) != Cuda.CUDA_SUCCESS) return ImportError.ImportFailed;
+        const device_ptr = try framePointer(&frame, desc);
+
+        slot.* = ImportSlot{
+            .dev = dev,
+            .ino = ino,
+            .desc = desc,
+            .image = image,
+            .resource = resource,
+            .device_ptr = device_ptr,
+            .last_use = self.use_counter,
+            .in_use = true,
+        };
+        self.imports += 1;
+        return self.surfaceFrom(desc, @intCast(index));
+    }
+
+    /// Drop every cached import (e.g. after the capture swapchain was recreated).
+    /// Slots still held by frames in flight are left for LRU eviction.
+    pub fn flush(self: *Self) void {
+        self.pushContext();
+        defer self.popContext();
+        for (&self.slots) |*slot| {
+            if (slot.holds.load(.acquire) == 0) self.release(slot);
+        }
+    }
+
+    fn release(self: *Self, slot: *ImportSlot) void {
+        if (!slot.in_use) return;
+        _ = self.cuda.unregister_resource.?(slot.resource);
+        _ = self.egl.destroy_image.?(self.display, slot.image);
+        slot.* = .{};
+    }
+
+    fn pushContext(self: *Self) void {
+        _ = self.cuda.ctx_push_current.?(self.context);
+    }
+
+    fn popContext(self: *Self) void {
+        var previous: Cuda.CUcontext = null;
+        _ = self.cuda.ctx_pop_current.?(&previous);
+    }
+
+    fn surfaceFrom(self: *Self, desc: DmaBufDesc, index: u8) GpuSurface {
+        const slot = &self.slots[index];
+        _ = slot.holds.fetchAdd(1, .acquire);
+        return GpuSurface{
+            .device_ptr = slot.device_ptr,
+            .width = desc.width,
+            .height = desc.height,
+            .pitch = desc.pitch,
+            .fourcc = desc.fourcc,
+            .slot = index,
+            .importer = self,
+        };
+    }
+};
+
+/// Whether a cached image was created for the same buffer layout
+fn sameLayout(a: DmaBufDesc, b: DmaBufDesc) bool {
+    return a.size == b.size and a.offset == b.offset and a.width == b.width and a.height == b.height and
+        a.pitch == b.pitch and a.fourcc == b.fourcc and a.modifier == b.modifier;
+}
+
+/// Device pointer of a registered image, if CUDA mapped it as the pitch-linear
+/// surface `desc` describes (chroma right after the luma rows)
+fn framePointer(frame: *const Cuda.EglFrame, desc: DmaBufDesc) ImportError!u64 {
+    if (frame.frame_type != Cuda.CU_EGL_FRAME_TYPE_PITCH or frame.pitch != desc.pitch) return ImportError.ImportFailed;
+    const luma = @intFromPtr(frame.planes[0] orelse return ImportError.ImportFailed);
+    if (frame.plane_count > 1) {
+        const chroma = @intFromPtr(frame.planes[1] orelse return ImportError.ImportFailed);
+        if (chroma != luma + @as(u64, desc.pitch) * desc.height) return ImportError.ImportFailed;
+    }
+    return luma;
+}
+
+/// Check whether the CUDA driver API and the EGL entry points needed for
+/// zero-copy capture are present
+pub fn isAvailable() bool {
+    var cuda = Cuda.load() orelse return false;
+    defer cuda.unload();
+    var egl = Egl.load() orelse return false;
+    defer egl.unload();
+    return cuda.isComplete() and egl.isComplete();
+}
+
+test "cuda egl frame layout" {
+    // Must match CUeglFrame on 64-bit Linux
+    try std.testing.expectEqual(@as(usize, 64), @sizeOf(Cuda.EglFrame));
+}
+
+test "dma-buf egl attributes" {
+    const nv12 = DmaBufDesc{
+        .fd = 7,
+        .size = 2048 * 1080 * 3 / 2,
+        .offset = 256,
+        .width = 1920,
+        .height = 1080,
+        .pitch = 2048,
+        .fourcc = fourccCode("NV12"),
+    };
+    var buf: [max_attribs]Egl.EGLint = undefined;
+    const attribs = dmabufAttribs(nv12, &buf);
+    // Three pairs, five pairs per plane, EGL_NONE
+    try std.testing.expectEqual(@as(usize, 6 + 2 * 10 + 1), attribs.len);
+    try std.testing.expectEqual(Egl.EGL_NONE, attribs[attribs.len - 1]);
+    // Plane 1 starts after the luma rows
+    try std.testing.expectEqual(Egl.EGL_DMA_BUF_PLANE0_FD_EXT + 3, attribs[16]);
+    try std.testing.expectEqual(@as(Egl.EGLint, 7), attribs[17]);
+    try std.testing.expectEqual(@as(Egl.EGLint, 256 + 2048 * 1080), attribs[19]);
+
+    var rgb = nv12;
+    rgb.fourcc = fourccCode("AR24");
+    try std.testing.expectEqual(@as(usize, 6 + 10 + 1), dmabufAttribs(rgb, &buf).len);
+}
+
+test "dma-buf validation" {
+    const nv12 = DmaBufDesc{
+        .fd = -1,
+        .size = 1920 * 1080 * 3 / 2,
+        .width = 1920,
+        .height = 1080,
+        .pitch = 1920,
+        .fourcc = fourccCode("NV12"),
+    };
+    try validate(nv12);
+
+    var tiled = nv12;
+    tiled.modifier = 0x0300000000606014; // NVIDIA block-linear
+    try std.testing.expectError(ImportError.UnsupportedModifier, validate(tiled));
+
+    var unknown = nv12;
+    unknown.fourcc = fourccCode("YUYV");
+    try std.testing.expectError(ImportError.UnsupportedFormat, validate(unknown));
+
+    var short = nv12;
+    short.pitch = 1024;
+    try std.testing.expectError(ImportError.InvalidBuffer, validate(short));
+
+    var truncated = nv12;
+    truncated.size = 1920 * 1080;
+    try std.testing.expectError(ImportError.InvalidBuffer, validate(truncated));
+}
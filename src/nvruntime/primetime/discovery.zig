@@ -0,0 +1,238 @@
+//! DRM device discovery for PrimeTime
+//!
+//! Enumerates DRM card nodes from sysfs (the same data udev exposes) and
+//! ties each one to its PCI bus ID, so the compositor can open the card the
+//! chosen NVIDIA GPU actually drives instead of whichever node opens first.
+//! GPUs are matched to NVML devices through the nvcaps registry.
+
+const std = @import("std");
+const registry = @import("../../nvcaps/registry.zig");
+
+pub const sysfs_drm = "/sys/class/drm";
+
+/// Most card nodes tracked
+pub const max_nodes = 16;
+
+pub const pci_vendor_nvidia: u16 = 0x10de;
+
+/// One DRM card node and the PCI device behind it
+pub const Node = struct {
+    /// Node name, e.g. "card1"
+    name: [16]u8 = [_]u8{0} ** 16,
+    /// Device path, e.g. "/dev/dri/card1" (NUL-terminated)
+    path: [32]u8 = [_]u8{0} ** 32,
+    /// Matching render node path, if any (NUL-terminated)
+    render_path: [32]u8 = [_]u8{0} ** 32,
+    /// Canonical sysfs PCI bus ID ("0000:01:00.0"); empty for non-PCI devices
+    pcie_bus_id: [32]u8 = [_]u8{0} ** 32,
+    vendor: u16 = 0,
+    /// Firmware picked this GPU for the boot console
+    boot_vga: bool = false,
+
+    pub fn getName(self: *const Node) []const u8 {
+        return std.mem.sliceTo(&self.name, 0);
+    }
+
+    pub fn getPath(self: *const Node) []const u8 {
+        return std.mem.sliceTo(&self.path, 0);
+    }
+
+    pub fn getRenderPath(self: *const Node) ?[]const u8 {
+        const path = std.mem.sliceTo(&self.render_path, 0);
+        return if (path.len > 0) path else null;
+    }
+
+    pub fn getBusId(self: *const Node) []const u8 {
+        return std.mem.sliceTo(&self.pcie_bus_id, 0);
+    }
+
+    pub fn isNvidia(self: *const Node) bool {
+        return self.vendor == pci_vendor_nvidia;
+    }
+
+    /// NVML device index for this node, if the registry knows its bus ID
+    pub fn gpuIndex(self: *const Node) ?u32 {
+        if (self.getBusId().len == 0) return null;
+        return registry.findByBusId(self.getBusId());
+    }
+};
+
+/// Card nodes found in one enumeration pass, sorted by name
+pub const NodeList = struct {
+    nodes: [max_nodes]Node = undefined,
+    count: usize = 0,
+
+    pub fn slice(self: *const NodeList) []const Node {
+        return self.nodes[0..self.count];
+    }
+
+    pub fn findByBusId(self: *const NodeList, bus_id: []const u8) ?*const Node {
+        var buf: [32]u8 = undefined;
+        const canonical = registry.canonicalBusId(bus_id, &buf) orelse return null;
+        for (self.slice()) |*node| {
+            if (std.mem.eql(u8, node.getBusId(), canonical)) return node;
+        }
+        return null;
+    }
+
+    pub fn findByName(self: *const NodeList, name: []const u8) ?*const Node {
+        for (self.slice()) |*node| {
+            if (std.mem.eql(u8, node.getName(), name)) return node;
+        }
+        return null;
+    }
+
+    /// Card driven by the GPU with this NVML UUID (e.g. "GPU-8c5b...").
+    /// The nvcaps registry must be initialized.
+    pub fn findByUuid(self: *const NodeList, uuid: []const u8) !*const Node {
+        const index = registry.findByUuid(uuid) orelse return error.UnknownGpu;
+        const entry = registry.getEntry(index) orelse return error.UnknownGpu;
+        // NVIDIA without nvidia-drm.modeset=1 has no card node
+        return self.findByBusId(entry.getBusId()) orelse error.NoDisplayNode;
+    }
+
+    /// Default card: the NVIDIA boot VGA device, then any NVIDIA card, then the first card
+    pub fn preferred(self: *const NodeList) ?*const Node {
+        var order: [max_nodes]*const Node = undefined;
+        return if (self.byPreference(&order) > 0) order[0] else null;
+    }
+
+    /// Every card, best default first: the NVIDIA boot VGA device, the other
+    /// NVIDIA cards, then the rest, each group in name order. Returns the count.
+    pub fn byPreference(self: *const NodeList, out: *[max_nodes]*const Node) usize {
+        var n: usize = 0;
+        for (0..3) |rank| {
+            for (self.slice()) |*node| {
+                const node_rank: usize = if (!node.isNvidia()) 2 else if (node.boot_vga) 0 else 1;
+                if (node_rank != rank) continue;
+                out[n] = node;
+                n += 1;
+            }
+        }
+        return n;
+    }
+};
+
+/// Enumerate DRM card nodes from sysfs
+pub fn enumerate() NodeList {
+    var dir = std.fs.openDirAbsolute(sysfs_drm, .{ .iterate = true }) catch return .{};
+    defer dir.close();
+    return enumerateDir(dir);
+}
+
+/// Enumerate card nodes under an open /sys/class/drm directory
+pub fn enumerateDir(dir: std.fs.Dir) NodeList {
+    var list = NodeList{};
+    var it = dir.iterate();
+    while (it.next() catch null) |entry| {
+        if (list.count == max_nodes) break;
+        // "card1" is the device; "card1-DP-1" are its connectors
+        if (!isCardName(entry.name) or entry.name.len >= 16) continue;
+
+        var node = Node{};
+        @memcpy(node.name[0..entry.name.len], entry.name);
+        _ = std.fmt.bufPrint(&node.path, "/dev/dri/{s}", .{entry.name}) catch continue;
+        readPciInfo(dir, entry.name, &node);
+        list.nodes[list.count] = node;
+        list.count += 1;
+    }
+
+    std.mem.sort(Node, list.nodes[0..list.count], {}, struct {
+        fn lessThan(_: void, a: Node, b: Node) bool {
+            const an = a.getName();
+            const bn = b.getName();
+            if (an.len != bn.len) return an.len < bn.len;
+            return std.mem.lessThan(u8, an, bn);
+        }
+    }.lessThan);
+    return list;
+}
+
+fn isCardName(name: []const u8) bool {
+    if (!std.mem.startsWith(u8, name, "card") or name.len == 4) return false;
+    for (name[4..]) |ch| {
+        if (!std.ascii.isDigit(ch)) return false;
+    }
+    return true;
+}
+
+/// Fill bus ID, vendor, boot_vga and render node from cardN/device
+fn readPciInfo(dir: std.fs.Dir, card: []const u8, node: *Node) void {
+    var path_buf: [std.fs.max_path_bytes]u8 = undefined;
+    var link_buf: [std.fs.max_path_bytes]u8 = undefined;
+
+    const device_path = std.fmt.bufPrint(&path_buf, "{s}/device", .{card}) catch return;
+    // cardN/device links to the PCI device directory, named after its bus ID
+    const target = dir.readLink(device_path, &link_buf) catch return;
+    var bus_buf: [32]u8 = undefined;
+    if (registry.canonicalBusId(std.fs.path.basename(target), &bus_buf)) |bus_id| {
+        @memcpy(node.pcie_bus_id[0..bus_id.len], bus_id);
+    }
+
+    var device = dir.openDir(device_path, .{}) catch return;
+    defer device.close();
+
+    var value_buf: [16]u8 = undefined;
+    if (device.readFile("vendor", &value_buf)) |vendor| {
+        const text = std.mem.trim(u8, vendor, " \n");
+        const digits = if (std.mem.startsWith(u8, text, "0x")) text[2..] else text;
+        node.vendor = std.fmt.parseInt(u16, digits, 16) catch 0;
+    } else |_| {}
+    if (device.readFile("boot_vga", &value_buf)) |boot_vga| {
+        node.boot_vga = std.mem.startsWith(u8, boot_vga, "1");
+    } else |_| {}
+
+    var drm_dir = device.openDir("drm", .{ .iterate = true }) catch return;
+    defer drm_dir.close();
+    var it = drm_dir.iterate();
+    while (it.next() catch null) |entry| {
+        if (std.mem.startsWith(u8, entry.name, "renderD")) {
+            _ = std.fmt.bufPrint(&node.render_path, "/dev/dri/{s}", .{entry.name}) catch {};
+            break;
+        }
+    }
+}
+
+test "enumerate fake sysfs" {
+    var tmp = std.testing.tmpDir(.{ .iterate = true });
+    defer tmp.cleanup();
+
+    // devices/<bus>/{vendor,boot_vga,drm/renderD128} with class/drm/card1/device -> device
+    try tmp.dir.makePath("devices/0000:01:00.0/drm/renderD128");
+    try tmp.dir.writeFile(.{ .sub_path = "devices/0000:01:00.0/vendor", .data = "0x10de\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "devices/0000:01:00.0/boot_vga", .data = "0\n" });
+    try tmp.dir.makePath("devices/0000:0a:00.0");
+    try tmp.dir.writeFile(.{ .sub_path = "devices/0000:0a:00.0/vendor", .data = "0x1002\n" });
+    try tmp.dir.writeFile(.{ .sub_path = "devices/0000:0a:00.0/boot_vga", .data = "1\n" });
+
+    try tmp.dir.makePath("class/drm/card1");
+    try tmp.dir.makePath("class/drm/card0");
+    try tmp.dir.makePath("class/drm/card1-DP-1");
+    try tmp.dir.symLink("../../../devices/0000:01:00.0", "class/drm/card1/device", .{ .is_directory = true });
+    try tmp.dir.symLink("../../../devices/0000:0a:00.0", "class/drm/card0/device", .{ .is_directory = true });
+
+    var drm_dir = try tmp.dir.openDir("class/drm", .{ .iterate = true });
+    defer drm_dir.close();
+    const list = enumerateDir(drm_dir);
+
+    try std.testing.expectEqual(@as(usize, 2), list.count);
+    try std.testing.expectEqualStrings("card0", list.nodes[0].getName());
+    try std.testing.expectEqualStrings("/dev/dri/card1", list.nodes[1].getPath());
+    try std.testing.expectEqualStrings("/dev/dri/renderD128", list.nodes[1].getRenderPath().?);
+    try std.testing.expect(list.nodes[1].isNvidia());
+
+    // The AMD card is boot VGA, but an NVIDIA card still wins
+    try std.testing.expectEqualStrings("card1", list.preferred().?.getName());
+    var order: [max_nodes]*const Node = undefined;
+    try std.testing.expectEqual(@as(usize, 2), list.byPreference(&order));
+    try std.testing.expectEqualStrings("card0", order[1].getName());
+    try std.testing.expectEqualStrings("card1", list.findByBusId("00000000:01:00.0").?.getName());
+    try std.testing.expect(list.findByBusId("0000:02:00.0") == null);
+}
+
+test "card node names" {
+    try std.testing.expect(isCardName("card12"));
+    try std.testing.expect(!isCardName("card1-HDMI-A-1"));
+    try std.testing.expect(!isCardName("renderD128"));
+    try std.testing.expect(!isCardName("card"));
+}
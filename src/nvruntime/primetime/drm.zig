@@ -1,15 +1,21 @@
 //! DRM/KMS backend for PrimeTime
 //!
 //! Direct Rendering Manager interface for display control.
-//! Handles monitor enumeration, mode setting, and VRR.
+//! Handles monitor enumeration, mode setting, VRR and atomic page flips:
+//! nonblocking commits with IN_FENCE_FD / OUT_FENCE_PTR, flip-completion
+//! events read from the DRM fd, and commits scheduled just before vblank.
+//! Client DMA-BUFs can be imported as framebuffers for direct scanout.
 //!
 //! Note: This module requires libdrm. Build with -Ddrm=true to enable.
 
 const std = @import("std");
 const builtin = @import("builtin");
+const build_options = @import("build_options");
+const frame_pacing = @import("frame_pacing.zig");
+const discovery = @import("discovery.zig");
 
 // Only include DRM headers when building with DRM support
-const has_drm = @hasDecl(@import("root"), "drm_enabled") and @import("root").drm_enabled;
+const has_drm = build_options.drm_enabled;
 
 const c = if (has_drm) @cImport({
     @cInclude("xf86drm.h");
@@ -24,14 +30,74 @@ const c = if (has_drm) @cImport({
     pub const DRM_VBLANK_RELATIVE: u32 = 1;
     pub const DRM_VBLANK_HIGH_CRTC_SHIFT: u32 = 1;
     pub const DRM_VBLANK_HIGH_CRTC_MASK: u32 = 0;
+    pub const DRM_MODE_OBJECT_CRTC: u32 = 0xcccccccc;
+    pub const DRM_MODE_OBJECT_PLANE: u32 = 0xeeeeeeee;
+    pub const DRM_CLIENT_CAP_UNIVERSAL_PLANES: u64 = 2;
+    pub const DRM_CLIENT_CAP_ATOMIC: u64 = 3;
+    pub const DRM_MODE_PAGE_FLIP_EVENT: u32 = 0x01;
+    pub const DRM_MODE_ATOMIC_TEST_ONLY: u32 = 0x0100;
+    pub const DRM_MODE_ATOMIC_NONBLOCK: u32 = 0x0200;
+    pub const DRM_MODE_ATOMIC_ALLOW_MODESET: u32 = 0x0400;
+    pub const DRM_MODE_FB_MODIFIERS: u32 = 1 << 1;
+    pub const DRM_MODE_CONNECTOR_VGA: u32 = 1;
+    pub const DRM_MODE_CONNECTOR_DVII: u32 = 2;
+    pub const DRM_MODE_CONNECTOR_DVID: u32 = 3;
+    pub const DRM_MODE_CONNECTOR_DVIA: u32 = 4;
+    pub const DRM_MODE_CONNECTOR_DisplayPort: u32 = 10;
+    pub const DRM_MODE_CONNECTOR_HDMIA: u32 = 11;
+    pub const DRM_MODE_CONNECTOR_HDMIB: u32 = 12;
+    pub const DRM_MODE_CONNECTOR_eDP: u32 = 14;
 
-    pub const drmModeRes = opaque {};
+    pub const drmModeRes = extern struct {
+        count_fbs: c_int = 0,
+        fbs: [*]u32 = undefined,
+        count_crtcs: c_int = 0,
+        crtcs: [*]u32 = undefined,
+        count_connectors: c_int = 0,
+        connectors: [*]u32 = undefined,
+    };
     pub const drmModeConnector = extern struct {
+        encoder_id: u32 = 0,
         connection: c_int = 0,
         connector_type: u32 = 0,
+        connector_type_id: u32 = 0,
         count_modes: c_int = 0,
         modes: [*]drmModeModeInfo = undefined,
     };
+    pub const drmModeEncoder = extern struct {
+        crtc_id: u32 = 0,
+        possible_crtcs: u32 = 0,
+    };
+    pub const drmModeCrtc = extern struct {
+        crtc_id: u32 = 0,
+        mode_valid: c_int = 0,
+        mode: drmModeModeInfo = .{},
+    };
+    pub const drmModePlaneRes = extern struct {
+        count_planes: u32 = 0,
+        planes: [*]u32 = undefined,
+    };
+    pub const drmModePlane = extern struct {
+        count_formats: u32 = 0,
+        formats: [*]u32 = undefined,
+        plane_id: u32 = 0,
+        possible_crtcs: u32 = 0,
+    };
+    pub const drmModePropertyBlobRes = extern struct {
+        id: u32 = 0,
+        length: u32 = 0,
+        data: ?*anyopaque = null,
+    };
+    pub const drmModeObjectProperties = extern struct {
+        count_props: u32 = 0,
+        props: [*]u32 = undefined,
+        prop_values: [*]u64 = undefined,
+    };
+    pub const drmModePropertyRes = extern struct {
+        prop_id: u32 = 0,
+        name: [32]u8 = [_]u8{0} ** 32,
+    };
+    pub const drmModeAtomicReq = opaque {};
     pub const drmModeModeInfo = extern struct {
         hdisplay: u16 = 0,
         vdisplay: u16 = 0,
@@ -59,14 +125,59 @@ const c = if (has_drm) @cImport({
         return null;
     }
     pub fn drmModeFreeConnector(_: *drmModeConnector) void {}
-    pub fn drmModeObjectGetProperties(_: c_int, _: u32, _: u32) ?*anyopaque {
+    pub fn drmModeGetEncoder(_: c_int, _: u32) ?*drmModeEncoder {
+        return null;
+    }
+    pub fn drmModeFreeEncoder(_: ?*drmModeEncoder) void {}
+    pub fn drmModeGetCrtc(_: c_int, _: u32) ?*drmModeCrtc {
+        return null;
+    }
+    pub fn drmModeFreeCrtc(_: ?*drmModeCrtc) void {}
+    pub fn drmModeGetPlaneResources(_: c_int) ?*drmModePlaneRes {
         return null;
     }
-    pub fn drmModeFreeObjectProperties(_: ?*anyopaque) void {}
-    pub fn drmModeGetProperty(_: c_int, _: u32) ?*anyopaque {
+    pub fn drmModeFreePlaneResources(_: ?*drmModePlaneRes) void {}
+    pub fn drmModeGetPlane(_: c_int, _: u32) ?*drmModePlane {
+        return null;
+    }
+    pub fn drmModeFreePlane(_: ?*drmModePlane) void {}
+    pub fn drmModeObjectGetProperties(_: c_int, _: u32, _: u32) ?*drmModeObjectProperties {
+        return null;
+    }
+    pub fn drmModeFreeObjectProperties(_: ?*drmModeObjectProperties) void {}
+    pub fn drmModeGetProperty(_: c_int, _: u32) ?*drmModePropertyRes {
+        return null;
+    }
+    pub fn drmModeFreeProperty(_: ?*drmModePropertyRes) void {}
+    pub fn drmModeGetPropertyBlob(_: c_int, _: u32) ?*drmModePropertyBlobRes {
+        return null;
+    }
+    pub fn drmModeFreePropertyBlob(_: ?*drmModePropertyBlobRes) void {}
+    pub fn drmPrimeFDToHandle(_: c_int, _: c_int, _: *u32) c_int {
+        return -1;
+    }
+    pub fn drmCloseBufferHandle(_: c_int, _: u32) c_int {
+        return -1;
+    }
+    pub fn drmModeAddFB2WithModifiers(_: c_int, _: u32, _: u32, _: u32, _: [*c]const u32, _: [*c]const u32, _: [*c]const u32, _: [*c]const u64, _: *u32, _: u32) c_int {
+        return -1;
+    }
+    pub fn drmModeRmFB(_: c_int, _: u32) c_int {
+        return -1;
+    }
+    pub fn drmSetClientCap(_: c_int, _: u64, _: u64) c_int {
+        return -1;
+    }
+    pub fn drmModeAtomicAlloc() ?*drmModeAtomicReq {
         return null;
     }
-    pub fn drmModeFreeProperty(_: ?*anyopaque) void {}
+    pub fn drmModeAtomicFree(_: ?*drmModeAtomicReq) void {}
+    pub fn drmModeAtomicAddProperty(_: ?*drmModeAtomicReq, _: u32, _: u32, _: u64) c_int {
+        return -1;
+    }
+    pub fn drmModeAtomicCommit(_: c_int, _: ?*drmModeAtomicReq, _: u32, _: ?*anyopaque) c_int {
+        return -1;
+    }
     pub fn drmModeObjectSetProperty(_: c_int, _: u32, _: u32, _: u32, _: u64) c_int {
         return -1;
     }
@@ -75,10 +186,149 @@ const c = if (has_drm) @cImport({
     }
 };
 
+/// KMS properties the backend reads or sets
+pub const Prop = enum(u8) {
+    // Connector
+    vrr_capable,
+    max_bpc,
+    colorspace,
+    hdr_output_metadata,
+    // CRTC
+    active,
+    mode_id,
+    vrr_enabled,
+    out_fence_ptr,
+    gamma_lut,
+    ctm,
+    // Plane (CRTC_ID is also on connectors)
+    plane_type,
+    crtc_id,
+    fb_id,
+    src_x,
+    src_y,
+    src_w,
+    src_h,
+    crtc_x,
+    crtc_y,
+    crtc_w,
+    crtc_h,
+    in_fence_fd,
+    in_formats,
+
+    /// Property name as the kernel reports it
+    pub fn name(self: Prop) []const u8 {
+        return switch (self) {
+            .vrr_capable => "vrr_capable",
+            .max_bpc => "max bpc",
+            .colorspace => "Colorspace",
+            .hdr_output_metadata => "HDR_OUTPUT_METADATA",
+            .active => "ACTIVE",
+            .mode_id => "MODE_ID",
+            .vrr_enabled => "VRR_ENABLED",
+            .out_fence_ptr => "OUT_FENCE_PTR",
+            .gamma_lut => "GAMMA_LUT",
+            .ctm => "CTM",
+            .plane_type => "type",
+            .crtc_id => "CRTC_ID",
+            .fb_id => "FB_ID",
+            .src_x => "SRC_X",
+            .src_y => "SRC_Y",
+            .src_w => "SRC_W",
+            .src_h => "SRC_H",
+            .crtc_x => "CRTC_X",
+            .crtc_y => "CRTC_Y",
+            .crtc_w => "CRTC_W",
+            .crtc_h => "CRTC_H",
+            .in_fence_fd => "IN_FENCE_FD",
+            .in_formats => "IN_FORMATS",
+        };
+    }
+};
+
+/// Property IDs per KMS object, filled once when the device opens and
+/// rebuilt on hotplug, so property changes cost no lookups
+pub const PropertyCache = struct {
+    pub const max_objects = 48;
+    const prop_count = @typeInfo(Prop).@"enum".fields.len;
+
+    pub const Object = struct {
+        id: u32 = 0,
+        type: u32 = 0,
+        /// Connectors: CRTC currently driving it (0 = none)
+        crtc_id: u32 = 0,
+        /// Planes: bitmask of CRTC indices the plane can attach to
+        possible_crtcs: u32 = 0,
+        prop_ids: [prop_count]u32 = [_]u32{0} ** prop_count,
+        /// Values at the last refresh; only current for immutable or
+        /// hotplug-driven properties (type, IN_FORMATS, vrr_capable)
+        values: [prop_count]u64 = [_]u64{0} ** prop_count,
+
+        pub fn propId(self: *const Object, prop: Prop) ?u32 {
+            const id = self.prop_ids[@intFromEnum(prop)];
+            return if (id != 0) id else null;
+        }
+
+        pub fn value(self: *const Object, prop: Prop) ?u64 {
+            if (self.propId(prop) == null) return null;
+            return self.values[@intFromEnum(prop)];
+        }
+
+        /// Record a property reported by the kernel; ones the backend doesn't use are ignored
+        pub fn record(self: *Object, prop_name: []const u8, id: u32, val: u64) void {
+            inline for (@typeInfo(Prop).@"enum".fields) |field| {
+                const prop: Prop = @enumFromInt(field.value);
+                if (std.mem.eql(u8, prop_name, prop.name())) {
+                    self.prop_ids[field.value] = id;
+                    self.values[field.value] = val;
+                    return;
+                }
+            }
+        }
+    };
+
+    objects: [max_objects]Object = undefined,
+    count: usize = 0,
+    /// Objects left out since the last reset because the cache was full
+    overflow: usize = 0,
+
+    /// Forget every object
+    pub fn reset(self: *PropertyCache) void {
+        self.count = 0;
+        self.overflow = 0;
+    }
+
+    /// Start a new object entry; null (and counted) once the cache is full
+    pub fn addObject(self: *PropertyCache, id: u32, object_type: u32) ?*Object {
+        if (self.count == max_objects) {
+            self.overflow += 1;
+            return null;
+        }
+        const obj = &self.objects[self.count];
+        obj.* = .{ .id = id, .type = object_type };
+        self.count += 1;
+        return obj;
+    }
+
+    pub fn get(self: *const PropertyCache, object_id: u32) ?*const Object {
+        for (self.objects[0..self.count]) |*obj| {
+            if (obj.id == object_id) return obj;
+        }
+        return null;
+    }
+
+    pub fn propId(self: *const PropertyCache, object_id: u32, prop: Prop) ?u32 {
+        const obj = self.get(object_id) orelse return null;
+        return obj.propId(prop);
+    }
+};
+
 /// DRM device handle
 pub const Device = struct {
     fd: std.posix.fd_t,
     resources: ?*c.drmModeRes,
+    props: PropertyCache = .{},
+    /// Node name ("card1"), matched against hotplug uevents
+    node: [16]u8 = [_]u8{0} ** 16,
 
     pub fn open(path: []const u8) !Device {
         const fd = try std.posix.open(
@@ -89,13 +339,52 @@ pub const Device = struct {
 
         const resources = c.drmModeGetResources(fd);
 
-        return Device{
+        var device = Device{
             .fd = fd,
             .resources = resources,
         };
+        const name = std.fs.path.basename(std.mem.sliceTo(path, 0));
+        @memcpy(device.node[0..@min(name.len, device.node.len)], name[0..@min(name.len, device.node.len)]);
+        device.refreshProperties();
+        return device;
+    }
+
+    /// Open the card driven by the GPU with this NVML UUID
+    pub fn openForGpu(uuid: []const u8) !Device {
+        const nodes = discovery.enumerate();
+        const node = try nodes.findByUuid(uuid);
+        return open(&node.path);
+    }
+
+    /// Open an explicit path, else the card of the GPU `gpu_uuid`, else the default
+    pub fn openSelected(path: ?[]const u8, gpu_uuid: ?[]const u8) !Device {
+        if (path) |p| return open(p);
+        if (gpu_uuid) |uuid| return openForGpu(uuid);
+        return openDefault();
+    }
+
+    pub fn getNodeName(self: *const Device) []const u8 {
+        return std.mem.sliceTo(&self.node, 0);
     }
 
+    /// Open the preferred card from sysfs discovery (NVIDIA boot VGA first)
+    /// that has a monitor connected. Without one anywhere, the preferred card
+    /// that opens; failing that, the first of the usual paths that opens.
     pub fn openDefault() !Device {
+        const nodes = discovery.enumerate();
+        var order: [discovery.max_nodes]*const discovery.Node = undefined;
+        const count = nodes.byPreference(&order);
+        for (order[0..count]) |node| {
+            var device = open(&node.path) catch continue;
+            if (device.hasConnectedOutput()) return device;
+            // e.g. an NVIDIA card in a PRIME laptop whose panel hangs off the iGPU
+            std.log.info("{s}: no connected output, trying the next card", .{node.getName()});
+            device.close();
+        }
+        for (order[0..count]) |node| {
+            if (open(&node.path)) |device| return device else |_| {}
+        }
+
         // Try common DRM device paths
         const paths = [_][]const u8{
             "/dev/dri/card0",
@@ -112,6 +401,19 @@ pub const Device = struct {
         return error.NoDrmDevice;
     }
 
+    /// Second handle on the same open card. It shares DRM master and client
+    /// caps with this one and stays usable after this one is closed.
+    pub fn dupe(self: *const Device) !Device {
+        const fd = try std.posix.dup(self.fd);
+        var device = Device{
+            .fd = fd,
+            .resources = c.drmModeGetResources(fd),
+            .node = self.node,
+        };
+        device.refreshProperties();
+        return device;
+    }
+
     pub fn close(self: *Device) void {
         if (self.resources) |res| {
             c.drmModeFreeResources(res);
@@ -119,7 +421,18 @@ pub const Device = struct {
         std.posix.close(self.fd);
     }
 
-    /// Get number of connected connectors (monitors)
+    /// Whether any connector has a monitor attached
+    pub fn hasConnectedOutput(self: *const Device) bool {
+        var i: u32 = 0;
+        while (i < self.getConnectorCount()) : (i += 1) {
+            var conn = self.getConnector(i) orelse continue;
+            defer conn.deinit();
+            if (conn.isConnected()) return true;
+        }
+        return false;
+    }
+
+    /// Get number of connectors (connected or not)
     pub fn getConnectorCount(self: *const Device) u32 {
         if (self.resources) |res| {
             return @intCast(res.count_connectors);
@@ -144,46 +457,427 @@ pub const Device = struct {
         return null;
     }
 
-    /// Check if VRR is supported
+    /// Check if VRR is supported: the display reports vrr_capable and the
+    /// CRTC driving it exposes VRR_ENABLED
     pub fn supportsVrr(self: *const Device, connector_id: u32) bool {
-        var prop_id: u32 = 0;
-        if (self.findProperty(connector_id, c.DRM_MODE_OBJECT_CONNECTOR, "VRR_ENABLED")) |id| {
-            prop_id = id;
-        } else {
-            return false;
-        }
-        _ = prop_id;
-        return true;
+        const conn = self.props.get(connector_id) orelse return false;
+        if ((conn.value(.vrr_capable) orelse 0) != 1) return false;
+        return self.props.propId(conn.crtc_id, .vrr_enabled) != null;
     }
 
-    /// Set VRR enabled/disabled
+    /// Set VRR enabled/disabled on the CRTC driving the connector
     pub fn setVrr(self: *Device, connector_id: u32, enabled: bool) !void {
-        const prop_id = self.findProperty(connector_id, c.DRM_MODE_OBJECT_CONNECTOR, "VRR_ENABLED") orelse
+        const conn = self.props.get(connector_id) orelse return error.VrrNotSupported;
+        const prop_id = self.props.propId(conn.crtc_id, .vrr_enabled) orelse
             return error.VrrNotSupported;
 
         const value: u64 = if (enabled) 1 else 0;
-        const ret = c.drmModeObjectSetProperty(self.fd, connector_id, c.DRM_MODE_OBJECT_CONNECTOR, prop_id, value);
+        const ret = c.drmModeObjectSetProperty(self.fd, conn.crtc_id, c.DRM_MODE_OBJECT_CRTC, prop_id, value);
         if (ret != 0) return error.SetPropertyFailed;
     }
 
-    fn findProperty(self: *const Device, object_id: u32, object_type: u32, name: []const u8) ?u32 {
-        const props = c.drmModeObjectGetProperties(self.fd, object_id, object_type);
-        if (props == null) return null;
-        defer c.drmModeFreeObjectProperties(props);
+    /// Enable atomic modesetting. Implies universal planes, so primary
+    /// planes show up in the plane list (and in the property cache).
+    pub fn enableAtomic(self: *Device) !void {
+        if (c.drmSetClientCap(self.fd, c.DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) != 0) return error.AtomicNotSupported;
+        if (c.drmSetClientCap(self.fd, c.DRM_CLIENT_CAP_ATOMIC, 1) != 0) return error.AtomicNotSupported;
+        self.refreshProperties();
+    }
+
+    /// Re-read resources and the property cache after a hotplug uevent
+    pub fn handleHotplug(self: *Device) void {
+        if (self.resources) |res| c.drmModeFreeResources(res);
+        self.resources = c.drmModeGetResources(self.fd);
+        self.refreshProperties();
+    }
+
+    /// Rebuild the property cache, scanning every connector, CRTC and plane once
+    pub fn refreshProperties(self: *Device) void {
+        self.props.reset();
+        defer self.warnCacheOverflow();
+        const res = self.resources orelse return;
+
+        for (res.connectors[0..@intCast(res.count_connectors)]) |id| {
+            const obj = self.scanObject(id, c.DRM_MODE_OBJECT_CONNECTOR) orelse continue;
+            const conn = c.drmModeGetConnector(self.fd, id) orelse continue;
+            defer c.drmModeFreeConnector(conn);
+            if (self.activeCrtc(conn)) |crtc| obj.crtc_id = crtc.id;
+        }
+        for (res.crtcs[0..@intCast(res.count_crtcs)]) |id| {
+            _ = self.scanObject(id, c.DRM_MODE_OBJECT_CRTC);
+        }
+
+        const planes = c.drmModeGetPlaneResources(self.fd) orelse return;
+        defer c.drmModeFreePlaneResources(planes);
+        for (planes.planes[0..planes.count_planes]) |id| {
+            const obj = self.scanObject(id, c.DRM_MODE_OBJECT_PLANE) orelse continue;
+            const plane = c.drmModeGetPlane(self.fd, id) orelse continue;
+            defer c.drmModeFreePlane(plane);
+            obj.possible_crtcs = plane.possible_crtcs;
+        }
+    }
 
+    /// Resolve the CRTC and primary plane currently driving a connected output.
+    /// `output_name` is the full connector name ("DP-1", not "DP"); null picks
+    /// the first connected output. Call `enableAtomic` first.
+    pub fn findFlipTarget(self: *const Device, output_name: ?[]const u8) !FlipTarget {
+        const count = self.getConnectorCount();
         var i: u32 = 0;
-        while (i < props.?.count_props) : (i += 1) {
-            const prop = c.drmModeGetProperty(self.fd, props.?.props[i]);
-            if (prop == null) continue;
-            defer c.drmModeFreeProperty(prop);
+        while (i < count) : (i += 1) {
+            var conn = self.getConnector(i) orelse continue;
+            defer conn.deinit();
+            if (!conn.isConnected()) continue;
+            if (output_name) |name| {
+                var buf: [16]u8 = undefined;
+                if (!std.mem.eql(u8, name, conn.formatName(&buf))) continue;
+            }
+            if (try self.flipTargetFor(&conn)) |target| return target;
+        }
+        return error.NoConnectedOutput;
+    }
+
+    /// Every lit output, one per CRTC, in connector order. Returns the number
+    /// written to `out`.
+    pub fn findFlipTargets(self: *const Device, out: []FlipTarget) !usize {
+        var n: usize = 0;
+        const count = self.getConnectorCount();
+        var i: u32 = 0;
+        while (i < count and n < out.len) : (i += 1) {
+            var conn = self.getConnector(i) orelse continue;
+            defer conn.deinit();
+            if (!conn.isConnected()) continue;
+            if (try self.flipTargetFor(&conn)) |target| {
+                out[n] = target;
+                n += 1;
+            }
+        }
+        return n;
+    }
+
+    /// CRTC and primary plane of a connected connector; null if it is not lit
+    fn flipTargetFor(self: *const Device, conn: *const Connector) !?FlipTarget {
+        const crtc = self.activeCrtc(conn.handle) orelse return null;
+        // Pace against the mode the CRTC is scanning out, not the panel's preference
+        const mode = self.activeMode(crtc.id) orelse return null;
+        const plane_id = self.primaryPlane(crtc.index) orelse return null;
+        if (self.props.propId(plane_id, .fb_id) == null) return error.MissingProperty;
+
+        var target = FlipTarget{
+            .connector_id = conn.id,
+            .crtc_id = crtc.id,
+            .crtc_index = crtc.index,
+            .plane_id = plane_id,
+            .mode = mode,
+        };
+        _ = conn.formatName(&target.name);
+        return target;
+    }
+
+    /// Queue a nonblocking page flip of `flip.fb_id` on the target's primary plane.
+    /// Completion arrives as a flip event carrying `flip.user_data`. Returns the
+    /// out-fence fd (signalled when the frame starts scanning out), if requested.
+    pub fn commitFlip(self: *Device, target: *const FlipTarget, flip: Flip) !?std.posix.fd_t {
+        var batch = try AtomicBatch.init(self);
+        defer batch.deinit();
+
+        try batch.set(target.plane_id, .fb_id, flip.fb_id);
+
+        if (flip.in_fence_fd) |fence| {
+            if (self.props.propId(target.plane_id, .in_fence_fd) != null) {
+                try batch.set(target.plane_id, .in_fence_fd, @intCast(fence));
+            } else {
+                // Driver cannot wait on the fence itself; sync_file fds poll readable once signalled
+                var fds = [_]std.posix.pollfd{.{ .fd = fence, .events = std.posix.POLL.IN, .revents = 0 }};
+                _ = try std.posix.poll(&fds, -1);
+            }
+        }
+
+        // The kernel writes an s32 fd through OUT_FENCE_PTR
+        var out_fence: i32 = -1;
+        if (flip.out_fence and self.props.propId(target.crtc_id, .out_fence_ptr) != null) {
+            try batch.set(target.crtc_id, .out_fence_ptr, @intFromPtr(&out_fence));
+        }
+
+        const flags: AtomicBatch.Flags = if (flip.test_only)
+            .{ .test_only = true }
+        else
+            .{ .nonblock = true, .page_flip_event = true };
+        try batch.commit(flags, flip.user_data);
+
+        return if (out_fence >= 0) out_fence else null;
+    }
 
-            const prop_name = std.mem.span(@as([*:0]const u8, @ptrCast(&prop.?.name)));
-            if (std.mem.eql(u8, prop_name, name)) {
-                return props.?.props[i];
+    /// Formats and modifiers the plane can scan out. Uses IN_FORMATS when the
+    /// driver exposes it, otherwise the plane's format list with linear layout.
+    pub fn planeFormats(self: *const Device, plane_id: u32) PlaneFormats {
+        const blob_id = if (self.props.get(plane_id)) |plane| plane.value(.in_formats) else null;
+        if (blob_id) |id| {
+            if (c.drmModeGetPropertyBlob(self.fd, @intCast(id))) |blob| {
+                defer c.drmModeFreePropertyBlob(blob);
+                if (blob.data) |data| {
+                    const bytes: [*]const u8 = @ptrCast(data);
+                    return PlaneFormats.parseInFormats(bytes[0..blob.length]);
+                }
             }
         }
+
+        var formats = PlaneFormats{};
+        const plane = c.drmModeGetPlane(self.fd, plane_id) orelse return formats;
+        defer c.drmModeFreePlane(plane);
+        for (plane.formats[0..plane.count_formats]) |fourcc| formats.add(fourcc, 0);
+        return formats;
+    }
+
+    /// Import a client DMA-BUF as a framebuffer. The framebuffer keeps the
+    /// buffer alive; remove it with `removeFramebuffer`.
+    pub fn importDmaBuf(self: *Device, buf: DmaBuf) !u32 {
+        var handle: u32 = 0;
+        if (c.drmPrimeFDToHandle(self.fd, buf.fd, &handle) != 0) return error.ImportFailed;
+        // The framebuffer holds its own reference to the GEM object
+        defer _ = c.drmCloseBufferHandle(self.fd, handle);
+
+        const handles = [4]u32{ handle, 0, 0, 0 };
+        const pitches = [4]u32{ buf.pitch, 0, 0, 0 };
+        const offsets = [4]u32{ buf.offset, 0, 0, 0 };
+        const modifiers = [4]u64{ buf.modifier, 0, 0, 0 };
+        const flags: u32 = if (buf.modifier != modifier_invalid) c.DRM_MODE_FB_MODIFIERS else 0;
+
+        var fb_id: u32 = 0;
+        const ret = c.drmModeAddFB2WithModifiers(self.fd, buf.width, buf.height, buf.fourcc, &handles, &pitches, &offsets, &modifiers, &fb_id, flags);
+        if (ret != 0) return error.ImportFailed;
+        return fb_id;
+    }
+
+    /// Remove a framebuffer. Removing the one on screen turns the plane off.
+    pub fn removeFramebuffer(self: *Device, fb_id: u32) void {
+        _ = c.drmModeRmFB(self.fd, fb_id);
+    }
+
+    /// Read pending flip-completion events, waiting up to `timeout_ms`
+    /// (0 = don't wait, -1 = forever). Returns the number written to `out`.
+    pub fn readFlipEvents(self: *Device, out: *[max_events]FlipEvent, timeout_ms: i32) !usize {
+        var fds = [_]std.posix.pollfd{.{ .fd = self.fd, .events = std.posix.POLL.IN, .revents = 0 }};
+        if (try std.posix.poll(&fds, timeout_ms) == 0) return 0;
+
+        var buf: [max_events * @sizeOf(VblankEvent)]u8 align(8) = undefined;
+        const len = try std.posix.read(self.fd, &buf);
+        return parseFlipEvents(buf[0..len], out);
+    }
+
+    /// Log once per scan if objects were left out of the property cache
+    fn warnCacheOverflow(self: *const Device) void {
+        if (self.props.overflow == 0) return;
+        // Objects left out cannot be flipped or configured
+        std.log.warn("{s}: {d} KMS objects did not fit the property cache ({d}); some outputs are unavailable", .{
+            self.getNodeName(), self.props.overflow, PropertyCache.max_objects,
+        });
+    }
+
+    /// Add one object and the properties the backend uses to the cache
+    fn scanObject(self: *Device, object_id: u32, object_type: u32) ?*PropertyCache.Object {
+        const obj = self.props.addObject(object_id, object_type) orelse return null;
+        const props = c.drmModeObjectGetProperties(self.fd, object_id, object_type) orelse return obj;
+        defer c.drmModeFreeObjectProperties(props);
+
+        for (props.props[0..props.count_props], props.prop_values[0..props.count_props]) |prop_id, value| {
+            const prop = c.drmModeGetProperty(self.fd, prop_id) orelse continue;
+            defer c.drmModeFreeProperty(prop);
+            obj.record(std.mem.sliceTo(&prop.name, 0), prop_id, value);
+        }
+        return obj;
+    }
+
+    /// CRTC the connector's encoder is bound to. Flipping reuses the current
+    /// modeset, so the output must already be lit.
+    fn activeCrtc(self: *const Device, conn: *c.drmModeConnector) ?struct { id: u32, index: u32 } {
+        const res = self.resources orelse return null;
+        const encoder = c.drmModeGetEncoder(self.fd, conn.encoder_id) orelse return null;
+        defer c.drmModeFreeEncoder(encoder);
+
+        var i: u32 = 0;
+        while (i < res.count_crtcs) : (i += 1) {
+            if (res.crtcs[i] == encoder.crtc_id) return .{ .id = encoder.crtc_id, .index = i };
+        }
         return null;
     }
+
+    /// Mode a CRTC is currently scanning out; null if it is off
+    fn activeMode(self: *const Device, crtc_id: u32) ?Mode {
+        const crtc = c.drmModeGetCrtc(self.fd, crtc_id) orelse return null;
+        defer c.drmModeFreeCrtc(crtc);
+        if (crtc.mode_valid == 0) return null;
+        return Mode.fromInfo(crtc.mode);
+    }
+
+    fn primaryPlane(self: *const Device, crtc_index: u32) ?u32 {
+        for (self.props.objects[0..self.props.count]) |*obj| {
+            if (obj.type != c.DRM_MODE_OBJECT_PLANE) continue;
+            if (obj.possible_crtcs & (@as(u32, 1) << @intCast(crtc_index)) == 0) continue;
+            if (obj.value(.plane_type) == plane_type_primary) return obj.id;
+        }
+        return null;
+    }
+};
+
+/// Several property changes applied in one atomic commit, with property IDs
+/// taken from the device's cache
+pub const AtomicBatch = struct {
+    device: *Device,
+    req: *c.drmModeAtomicReq,
+
+    pub const Flags = struct {
+        nonblock: bool = false,
+        page_flip_event: bool = false,
+        test_only: bool = false,
+        allow_modeset: bool = false,
+
+        pub fn bits(self: Flags) u32 {
+            var flags: u32 = 0;
+            if (self.nonblock) flags |= c.DRM_MODE_ATOMIC_NONBLOCK;
+            if (self.page_flip_event) flags |= c.DRM_MODE_PAGE_FLIP_EVENT;
+            if (self.test_only) flags |= c.DRM_MODE_ATOMIC_TEST_ONLY;
+            if (self.allow_modeset) flags |= c.DRM_MODE_ATOMIC_ALLOW_MODESET;
+            return flags;
+        }
+    };
+
+    pub fn init(device: *Device) !AtomicBatch {
+        const req = c.drmModeAtomicAlloc() orelse return error.OutOfMemory;
+        return .{ .device = device, .req = req };
+    }
+
+    pub fn deinit(self: *AtomicBatch) void {
+        c.drmModeAtomicFree(self.req);
+    }
+
+    /// Queue `prop` = `value` on an object
+    pub fn set(self: *AtomicBatch, object_id: u32, prop: Prop, value: u64) !void {
+        const prop_id = self.device.props.propId(object_id, prop) orelse return error.PropertyNotSupported;
+        if (c.drmModeAtomicAddProperty(self.req, object_id, prop_id, value) < 0) return error.OutOfMemory;
+    }
+
+    /// Apply every queued change at once. `user_data` is returned in the
+    /// flip event when `page_flip_event` is set.
+    pub fn commit(self: *AtomicBatch, flags: Flags, user_data: u64) !void {
+        const ret = c.drmModeAtomicCommit(self.device.fd, self.req, flags.bits(), @ptrFromInt(user_data));
+        if (ret == -@as(c_int, @intFromEnum(std.posix.E.BUSY))) return error.FlipPending;
+        if (ret != 0) return error.CommitFailed;
+    }
+};
+
+/// DRM_PLANE_TYPE_PRIMARY value of the plane "type" property
+const plane_type_primary: u64 = 1;
+
+/// CRTC and primary plane an atomic flip targets
+pub const FlipTarget = struct {
+    connector_id: u32,
+    crtc_id: u32,
+    crtc_index: u32,
+    plane_id: u32,
+    mode: Mode,
+    /// Connector name, e.g. "DP-1" (NUL-terminated)
+    name: [16]u8 = [_]u8{0} ** 16,
+
+    pub fn getName(self: *const FlipTarget) []const u8 {
+        return std.mem.sliceTo(&self.name, 0);
+    }
+};
+
+/// One page-flip request
+pub const Flip = struct {
+    fb_id: u32,
+    /// Render-done fence the flip waits on
+    in_fence_fd: ?std.posix.fd_t = null,
+    /// Request an out fence signalled at scanout
+    out_fence: bool = true,
+    /// Returned in the flip event
+    user_data: u64 = 0,
+    /// Only ask the kernel whether the flip would be accepted
+    test_only: bool = false,
+};
+
+/// DRM_FORMAT_MOD_INVALID: the buffer has an implicit, driver-private layout
+pub const modifier_invalid: u64 = 0x00ffffffffffffff;
+
+/// A client buffer to import as a scanout framebuffer (single plane)
+pub const DmaBuf = struct {
+    fd: std.posix.fd_t,
+    width: u32,
+    height: u32,
+    pitch: u32,
+    offset: u32 = 0,
+    /// DRM fourcc
+    fourcc: u32,
+    modifier: u64 = modifier_invalid,
+};
+
+/// Format/modifier pairs a plane can scan out
+pub const PlaneFormats = struct {
+    pub const capacity = 256;
+
+    fourccs: [capacity]u32 = undefined,
+    modifiers: [capacity]u64 = undefined,
+    count: usize = 0,
+
+    pub fn add(self: *PlaneFormats, fourcc: u32, modifier: u64) void {
+        if (self.count == capacity) return;
+        self.fourccs[self.count] = fourcc;
+        self.modifiers[self.count] = modifier;
+        self.count += 1;
+    }
+
+    /// Whether a buffer of this format and modifier can go on the plane.
+    /// Implicit-modifier buffers only need the format to match.
+    pub fn supports(self: *const PlaneFormats, fourcc: u32, modifier: u64) bool {
+        for (self.fourccs[0..self.count], self.modifiers[0..self.count]) |f, m| {
+            if (f == fourcc and (modifier == modifier_invalid or m == modifier)) return true;
+        }
+        return false;
+    }
+
+    /// Decode an IN_FORMATS property blob (struct drm_format_modifier_blob)
+    pub fn parseInFormats(blob: []const u8) PlaneFormats {
+        var self = PlaneFormats{};
+        if (blob.len < @sizeOf(FormatModifierBlob)) return self;
+        const header = std.mem.bytesToValue(FormatModifierBlob, blob[0..@sizeOf(FormatModifierBlob)]);
+
+        const formats_end = @as(usize, header.formats_offset) + @as(usize, header.count_formats) * 4;
+        const modifiers_end = @as(usize, header.modifiers_offset) + @as(usize, header.count_modifiers) * @sizeOf(FormatModifier);
+        if (formats_end > blob.len or modifiers_end > blob.len) return self;
+
+        var i: usize = 0;
+        while (i < header.count_modifiers) : (i += 1) {
+            const pos = @as(usize, header.modifiers_offset) + i * @sizeOf(FormatModifier);
+            const entry = std.mem.bytesToValue(FormatModifier, blob[pos..][0..@sizeOf(FormatModifier)]);
+            // Bit n of the mask covers format (offset + n)
+            var mask = entry.formats;
+            while (mask != 0) : (mask &= mask - 1) {
+                const index = @as(usize, entry.offset) + @ctz(mask);
+                if (index >= header.count_formats) break;
+                const fpos = @as(usize, header.formats_offset) + index * 4;
+                self.add(std.mem.readInt(u32, blob[fpos..][0..4], builtin.cpu.arch.endian()), entry.modifier);
+            }
+        }
+        return self;
+    }
+};
+
+/// struct drm_format_modifier_blob
+const FormatModifierBlob = extern struct {
+    version: u32,
+    flags: u32,
+    count_formats: u32,
+    formats_offset: u32,
+    count_modifiers: u32,
+    modifiers_offset: u32,
+};
+
+/// struct drm_format_modifier
+const FormatModifier = extern struct {
+    formats: u64,
+    offset: u32,
+    pad: u32,
+    modifier: u64,
 };
 
 /// DRM connector (output/monitor)
@@ -215,6 +909,11 @@ pub const Connector = struct {
         return type_name;
     }
 
+    /// Name with the per-type index, as the kernel and compositors show it ("DP-1")
+    pub fn formatName(self: *const Connector, buf: []u8) []const u8 {
+        return std.fmt.bufPrint(buf, "{s}-{d}", .{ self.getName(), self.handle.connector_type_id }) catch self.getName();
+    }
+
     pub fn getModeCount(self: *const Connector) u32 {
         return @intCast(self.handle.count_modes);
     }
@@ -222,13 +921,7 @@ pub const Connector = struct {
     /// Get mode at index
     pub fn getMode(self: *const Connector, index: u32) ?Mode {
         if (index >= self.handle.count_modes) return null;
-        const m = self.handle.modes[index];
-        return Mode{
-            .width = @intCast(m.hdisplay),
-            .height = @intCast(m.vdisplay),
-            .refresh_hz = @intCast(m.vrefresh),
-            .flags = m.flags,
-        };
+        return Mode.fromInfo(self.handle.modes[index]);
     }
 
     /// Get preferred mode (usually native resolution)
@@ -236,14 +929,7 @@ pub const Connector = struct {
         var i: u32 = 0;
         while (i < self.handle.count_modes) : (i += 1) {
             const m = self.handle.modes[i];
-            if ((m.type & c.DRM_MODE_TYPE_PREFERRED) != 0) {
-                return Mode{
-                    .width = @intCast(m.hdisplay),
-                    .height = @intCast(m.vdisplay),
-                    .refresh_hz = @intCast(m.vrefresh),
-                    .flags = m.flags,
-                };
-            }
+            if ((m.type & c.DRM_MODE_TYPE_PREFERRED) != 0) return Mode.fromInfo(m);
         }
         // Fall back to first mode
         return self.getMode(0);
@@ -257,6 +943,15 @@ pub const Mode = struct {
     refresh_hz: u32,
     flags: u32,
 
+    pub fn fromInfo(m: c.drmModeModeInfo) Mode {
+        return Mode{
+            .width = @intCast(m.hdisplay),
+            .height = @intCast(m.vdisplay),
+            .refresh_hz = @intCast(m.vrefresh),
+            .flags = m.flags,
+        };
+    }
+
     pub fn isInterlaced(self: *const Mode) bool {
         return (self.flags & c.DRM_MODE_FLAG_INTERLACE) != 0;
     }
@@ -278,6 +973,491 @@ pub const FrameTiming = struct {
     }
 };
 
+/// Most flip events decoded per read
+pub const max_events = 32;
+
+/// DRM_EVENT_FLIP_COMPLETE from drm.h
+const drm_event_flip_complete: u32 = 0x02;
+
+/// struct drm_event
+const EventHeader = extern struct {
+    type: u32,
+    length: u32,
+};
+
+/// struct drm_event_vblank
+const VblankEvent = extern struct {
+    base: EventHeader,
+    user_data: u64,
+    tv_sec: u32,
+    tv_usec: u32,
+    sequence: u32,
+    crtc_id: u32,
+};
+
+/// A completed page flip
+pub const FlipEvent = struct {
+    user_data: u64,
+    /// 0 on kernels that predate per-CRTC events
+    crtc_id: u32,
+    /// Vblank the flip landed on (CLOCK_MONOTONIC)
+    timing: FrameTiming,
+};
+
+/// Decode flip-completion events from a read() of the DRM fd.
+/// Other event types are skipped. Returns the number written to `out`.
+pub fn parseFlipEvents(buf: []const u8, out: []FlipEvent) usize {
+    var n: usize = 0;
+    var pos: usize = 0;
+    while (pos + @sizeOf(EventHeader) <= buf.len and n < out.len) {
+        const header = std.mem.bytesToValue(EventHeader, buf[pos..][0..@sizeOf(EventHeader)]);
+        if (header.length < @sizeOf(EventHeader) or pos + header.length > buf.len) break;
+
+        if (header.type == drm_event_flip_complete and header.length >= @sizeOf(VblankEvent)) {
+            const event = std.mem.bytesToValue(VblankEvent, buf[pos..][0..@sizeOf(VblankEvent)]);
+            out[n] = .{
+                .user_data = event.user_data,
+                .crtc_id = event.crtc_id,
+                .timing = .{
+                    .sequence = event.sequence,
+                    .timestamp_ns = @as(u64, event.tv_sec) * std.time.ns_per_s +
+                        @as(u64, event.tv_usec) * std.time.ns_per_us,
+                },
+            };
+            n += 1;
+        }
+        pos += header.length;
+    }
+    return n;
+}
+
+/// CLOCK_MONOTONIC in nanoseconds, the clock DRM stamps vblank events with
+pub fn monotonicNs() u64 {
+    const ts = std.posix.clock_gettime(.MONOTONIC) catch return 0;
+    return @as(u64, @intCast(ts.sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.nsec));
+}
+
+/// Picks when to submit each atomic commit: as late as possible before the
+/// next vblank, with a lead learned from missed and hit flips.
+/// All timestamps are CLOCK_MONOTONIC.
+pub const CommitScheduler = struct {
+    /// Estimated refresh period, refined from flip timestamps
+    period_ns: u64,
+    /// Most recent flip completion
+    last_vblank: ?FrameTiming = null,
+    /// How long before vblank to commit
+    lead_ns: u64 = initial_lead_ns,
+    /// Vblank sequence the queued commit targets
+    expected_sequence: ?u32 = null,
+    hits: u64 = 0,
+    misses: u64 = 0,
+    /// Flip interval of a rate capped below the mode's; 0 flips every vblank
+    target_interval_ns: u64 = 0,
+    /// When the next capped flip is due
+    next_due_ns: u64 = 0,
+
+    pub const initial_lead_ns: u64 = 1_500_000;
+    pub const min_lead_ns: u64 = 500_000;
+    /// Added to the lead on a missed vblank
+    pub const miss_step_ns: u64 = 500_000;
+    /// Taken off the lead on every flip that made its vblank
+    pub const hit_decay_ns: u64 = 10_000;
+
+    pub fn init(refresh_hz: u32) CommitScheduler {
+        return .{ .period_ns = std.time.ns_per_s / @max(refresh_hz, 1) };
+    }
+
+    /// Flip at `target_hz` on average by skipping vblanks; a target at or
+    /// above the mode rate flips every vblank
+    pub fn setTargetRate(self: *CommitScheduler, target_hz: u32) void {
+        const interval = std.time.ns_per_s / @max(target_hz, 1);
+        self.target_interval_ns = if (interval > self.period_ns) interval else 0;
+        self.next_due_ns = 0;
+    }
+
+    /// Record a flip completion
+    pub fn onFlip(self: *CommitScheduler, timing: FrameTiming) void {
+        if (self.last_vblank) |last| {
+            const frames = timing.sequence -% last.sequence;
+            if (frames > 0 and frames < 8) {
+                const measured = timing.timeSince(&last) / frames;
+                // Light smoothing; scanout timestamps jitter by a few microseconds
+                if (measured > 0) self.period_ns = (self.period_ns * 7 + measured) / 8;
+            }
+        }
+
+        if (self.expected_sequence) |expected| {
+            if (@as(i32, @bitCast(timing.sequence -% expected)) > 0) {
+                self.misses += 1;
+                self.lead_ns = @min(self.lead_ns + miss_step_ns, self.period_ns / 2);
+            } else {
+                self.hits += 1;
+                self.lead_ns = @max(self.lead_ns -| hit_decay_ns, min_lead_ns);
+            }
+            self.expected_sequence = null;
+        }
+        self.last_vblank = timing;
+
+        if (self.target_interval_ns > 0) {
+            const due = self.next_due_ns + self.target_interval_ns;
+            // First flip, or a whole interval behind: restart the cadence here
+            self.next_due_ns = if (self.next_due_ns == 0 or due < timing.timestamp_ns)
+                timing.timestamp_ns + self.target_interval_ns
+            else
+                due;
+        }
+    }
+
+    /// First vblank after `now_ns`, extrapolated from the last flip
+    pub fn nextVblankNs(self: *const CommitScheduler, now_ns: u64) u64 {
+        const last = self.last_vblank orelse return now_ns;
+        if (now_ns < last.timestamp_ns) return last.timestamp_ns;
+        const frames = (now_ns - last.timestamp_ns) / self.period_ns + 1;
+        return last.timestamp_ns + frames * self.period_ns;
+    }
+
+    /// When to commit for the earliest vblank still reachable from `now_ns`
+    /// (with a target rate, the vblank nearest the next due flip).
+    /// Without a reference vblank yet, commit immediately.
+    pub fn commitDeadlineNs(self: *const CommitScheduler, now_ns: u64) u64 {
+        if (self.last_vblank == null) return now_ns;
+        var vblank = self.nextVblankNs(now_ns);
+        if (vblank -| self.lead_ns < now_ns) vblank += self.period_ns;
+        const half = self.period_ns / 2;
+        if (self.target_interval_ns > 0 and vblank + half < self.next_due_ns) {
+            vblank += (self.next_due_ns - half - vblank + self.period_ns - 1) / self.period_ns * self.period_ns;
+        }
+        return vblank - self.lead_ns;
+    }
+
+    /// Note a commit submitted at `now_ns` so its flip event can be checked
+    /// against the vblank it was meant to make
+    pub fn onCommit(self: *CommitScheduler, now_ns: u64) void {
+        const last = self.last_vblank orelse return;
+        const vblank = self.nextVblankNs(now_ns);
+        const frames = (vblank - last.timestamp_ns + self.period_ns / 2) / self.period_ns;
+        self.expected_sequence = last.sequence +% @as(u32, @intCast(frames));
+    }
+};
+
+/// Kernel uevent listener that reports DRM hotplug events
+/// (connector added, removed or changed)
+pub const HotplugMonitor = struct {
+    fd: std.posix.socket_t,
+
+    /// Kernel uevent multicast group
+    const kernel_group: u32 = 1;
+
+    pub fn open() !HotplugMonitor {
+        const fd = try std.posix.socket(
+            std.posix.AF.NETLINK,
+            std.posix.SOCK.DGRAM | std.posix.SOCK.CLOEXEC | std.posix.SOCK.NONBLOCK,
+            std.os.linux.NETLINK.KOBJECT_UEVENT,
+        );
+        errdefer std.posix.close(fd);
+
+        const addr = std.posix.sockaddr.nl{ .pid = 0, .groups = kernel_group };
+        try std.posix.bind(fd, @ptrCast(&addr), @sizeOf(std.posix.sockaddr.nl));
+        return .{ .fd = fd };
+    }
+
+    pub fn close(self: *HotplugMonitor) void {
+        std.posix.close(self.fd);
+    }
+
+    /// What changed since the last poll
+    pub const Changes = struct {
+        /// A connector on some card was plugged, unplugged or changed
+        connectors: bool = false,
+        /// Card nodes appeared or went away (GPU hotplug, driver reload)
+        cards_added: bool = false,
+        cards_removed: bool = false,
+
+        pub fn any(self: Changes) bool {
+            return self.connectors or self.cards_added or self.cards_removed;
+        }
+    };
+
+    /// Drain queued uevents without blocking
+    pub fn poll(self: *HotplugMonitor) Changes {
+        var changes = Changes{};
+        var buf: [4096]u8 = undefined;
+        while (true) {
+            const len = std.posix.recv(self.fd, &buf, 0) catch break;
+            const event = parseUevent(buf[0..len]) orelse continue;
+            if (event.hotplug) changes.connectors = true;
+            if (event.isCard()) switch (event.action) {
+                .add => changes.cards_added = true,
+                .remove => changes.cards_removed = true,
+                else => {},
+            };
+        }
+        return changes;
+    }
+};
+
+/// A DRM uevent from the kernel
+pub const Uevent = struct {
+    pub const Action = enum { add, remove, change, other };
+
+    action: Action,
+    /// Device node relative to /dev ("dri/card1"), if any
+    devname: []const u8 = "",
+    /// Connector status changed (HOTPLUG=1)
+    hotplug: bool = false,
+
+    /// Node name ("card1") for card devices, "" otherwise
+    pub fn cardName(self: Uevent) []const u8 {
+        const name = std.fs.path.basename(self.devname);
+        return if (std.mem.startsWith(u8, name, "card")) name else "";
+    }
+
+    pub fn isCard(self: Uevent) bool {
+        return self.cardName().len > 0;
+    }
+};
+
+/// Parse a kernel uevent ("ACTION@DEVPATH\0KEY=VALUE\0..."). Null for
+/// anything outside the drm subsystem.
+pub fn parseUevent(msg: []const u8) ?Uevent {
+    var event = Uevent{ .action = .other };
+    var drm_subsystem = false;
+    var fields = std.mem.splitScalar(u8, msg, 0);
+    while (fields.next()) |field| {
+        if (std.mem.eql(u8, field, "SUBSYSTEM=drm")) {
+            drm_subsystem = true;
+        } else if (std.mem.eql(u8, field, "HOTPLUG=1")) {
+            event.hotplug = true;
+        } else if (std.mem.startsWith(u8, field, "DEVNAME=")) {
+            event.devname = field["DEVNAME=".len..];
+        } else if (std.mem.startsWith(u8, field, "ACTION=")) {
+            event.action = std.meta.stringToEnum(Uevent.Action, field["ACTION=".len..]) orelse .other;
+        }
+    }
+    return if (drm_subsystem) event else null;
+}
+
+/// Whether a kernel uevent is a DRM connector hotplug
+pub fn isDrmHotplug(msg: []const u8) bool {
+    const event = parseUevent(msg) orelse return false;
+    return event.hotplug;
+}
+
+/// Framebuffers imported from client buffers, keyed by buffer identity.
+/// Games cycle through a small swapchain, so each buffer is imported once.
+pub const FramebufferCache = struct {
+    pub const max_entries = 4;
+
+    const Entry = struct {
+        /// Identity of the underlying buffer (the fd number alone is reused)
+        dev: u64 = 0,
+        ino: u64 = 0,
+        width: u32 = 0,
+        height: u32 = 0,
+        fb_id: u32 = 0,
+        /// The kernel refused to scan this buffer out
+        rejected: bool = false,
+        last_use: u64 = 0,
+    };
+
+    entries: [max_entries]Entry = [_]Entry{.{}} ** max_entries,
+    clock: u64 = 0,
+
+    pub const Lookup = union(enum) {
+        hit: u32,
+        rejected,
+        miss,
+    };
+
+    pub fn lookup(self: *FramebufferCache, dev: u64, ino: u64, width: u32, height: u32) Lookup {
+        for (&self.entries) |*entry| {
+            if ((entry.fb_id != 0 or entry.rejected) and entry.dev == dev and entry.ino == ino and
+                entry.width == width and entry.height == height)
+            {
+                self.clock += 1;
+                entry.last_use = self.clock;
+                return if (entry.rejected) .rejected else .{ .hit = entry.fb_id };
+            }
+        }
+        return .miss;
+    }
+
+    /// Insert a buffer (fb_id 0 = rejected). Returns the evicted framebuffer
+    /// to remove, never one of the `keep` framebuffers still on screen.
+    pub fn insert(self: *FramebufferCache, dev: u64, ino: u64, width: u32, height: u32, fb_id: u32, keep: [2]u32) ?u32 {
+        var victim: ?*Entry = null;
+        for (&self.entries) |*entry| {
+            if (entry.fb_id != 0 and (entry.fb_id == keep[0] or entry.fb_id == keep[1])) continue;
+            if (victim == null or entry.last_use < victim.?.last_use) victim = entry;
+        }
+        // At most two entries are pinned, so there is always a victim
+        const slot = victim.?;
+        const evicted = if (slot.fb_id != 0) slot.fb_id else null;
+
+        self.clock += 1;
+        slot.* = .{
+            .dev = dev,
+            .ino = ino,
+            .width = width,
+            .height = height,
+            .fb_id = fb_id,
+            .rejected = fb_id == 0,
+            .last_use = self.clock,
+        };
+        return evicted;
+    }
+
+    /// Drop every entry, returning the framebuffers to remove
+    pub fn clear(self: *FramebufferCache, out: *[max_entries]u32) usize {
+        var n: usize = 0;
+        for (&self.entries) |*entry| {
+            if (entry.fb_id != 0) {
+                out[n] = entry.fb_id;
+                n += 1;
+            }
+            entry.* = .{};
+        }
+        return n;
+    }
+};
+
+/// One output driven with nonblocking atomic page flips
+pub const AtomicOutput = struct {
+    device: Device,
+    target: FlipTarget,
+    scheduler: CommitScheduler,
+    sleeper: frame_pacing.HybridSleeper = .{},
+    /// A flip is queued and its completion event has not been read yet
+    flip_pending: bool = false,
+    next_user_data: u64 = 1,
+    /// What the primary plane can scan out directly
+    formats: PlaneFormats = .{},
+    client_fbs: FramebufferCache = .{},
+    /// Framebuffer on screen and the one queued behind it
+    current_fb: u32 = 0,
+    pending_fb: u32 = 0,
+
+    /// Open `path` (or the card of GPU `gpu_uuid`, or the default card),
+    /// enable atomic and resolve the output
+    pub fn open(path: ?[]const u8, gpu_uuid: ?[]const u8, output_name: ?[]const u8) !AtomicOutput {
+        var device = try Device.openSelected(path, gpu_uuid);
+        errdefer device.close();
+        try device.enableAtomic();
+
+        const target = try device.findFlipTarget(output_name);
+        return AtomicOutput{
+            .device = device,
+            .target = target,
+            .scheduler = CommitScheduler.init(target.mode.refresh_hz),
+            .formats = device.planeFormats(target.plane_id),
+        };
+    }
+
+    pub fn close(self: *AtomicOutput) void {
+        self.releaseClientBuffers();
+        self.device.close();
+    }
+
+    /// Re-resolve the output after a hotplug: resources, property cache,
+    /// CRTC/plane and mode. Fails if the output is gone.
+    pub fn refreshOutput(self: *AtomicOutput, output_name: ?[]const u8) !void {
+        self.device.handleHotplug();
+        const target = try self.device.findFlipTarget(output_name);
+        if (target.mode.refresh_hz != self.target.mode.refresh_hz or target.crtc_id != self.target.crtc_id) {
+            self.scheduler = CommitScheduler.init(target.mode.refresh_hz);
+            self.flip_pending = false;
+        }
+        if (target.plane_id != self.target.plane_id) self.formats = self.device.planeFormats(target.plane_id);
+        self.target = target;
+    }
+
+    /// Whether a client buffer could replace the composited frame on the primary plane
+    pub fn canScanOut(self: *const AtomicOutput, buf: DmaBuf) bool {
+        return buf.width == self.target.mode.width and buf.height == self.target.mode.height and
+            self.formats.supports(buf.fourcc, buf.modifier);
+    }
+
+    /// Framebuffer for a client buffer, importing (and test-committing) it on
+    /// first use. Returns null if the kernel cannot scan it out.
+    pub fn clientFramebuffer(self: *AtomicOutput, buf: DmaBuf) !?u32 {
+        const st = try std.posix.fstat(buf.fd);
+        const dev: u64 = @intCast(st.dev);
+        const ino: u64 = @intCast(st.ino);
+
+        switch (self.client_fbs.lookup(dev, ino, buf.width, buf.height)) {
+            .hit => |fb_id| return fb_id,
+            .rejected => return null,
+            .miss => {},
+        }
+
+        var fb_id: u32 = self.device.importDmaBuf(buf) catch 0;
+        if (fb_id != 0) {
+            // Pitch, placement or bandwidth limits only show up in a real check
+            if (self.device.commitFlip(&self.target, .{ .fb_id = fb_id, .out_fence = false, .test_only = true })) |_| {} else |_| {
+                self.device.removeFramebuffer(fb_id);
+                fb_id = 0;
+            }
+        }
+        if (self.client_fbs.insert(dev, ino, buf.width, buf.height, fb_id, .{ self.current_fb, self.pending_fb })) |evicted| {
+            self.device.removeFramebuffer(evicted);
+        }
+        return if (fb_id != 0) fb_id else null;
+    }
+
+    /// Remove every imported client framebuffer not on screen
+    pub fn releaseClientBuffers(self: *AtomicOutput) void {
+        var fbs: [FramebufferCache.max_entries]u32 = undefined;
+        const n = self.client_fbs.clear(&fbs);
+        for (fbs[0..n]) |fb_id| {
+            if (fb_id != self.current_fb and fb_id != self.pending_fb) self.device.removeFramebuffer(fb_id);
+        }
+    }
+
+    /// Wait until just before the next reachable vblank, then queue a
+    /// nonblocking flip. Returns the out fence, if the driver provides one.
+    pub fn present(self: *AtomicOutput, fb_id: u32, in_fence_fd: ?std.posix.fd_t) !?std.posix.fd_t {
+        // One flip in flight per CRTC; the caller drains events first
+        if (self.flip_pending) return error.FlipPending;
+
+        const now = monotonicNs();
+        const deadline = self.scheduler.commitDeadlineNs(now);
+        if (deadline > now) {
+            // The sleeper runs on MONOTONIC_RAW; carry the deadline over as a delta
+            _ = self.sleeper.sleepUntil(frame_pacing.monotonicRawNs() + (deadline - now));
+        }
+
+        const user_data = self.next_user_data;
+        self.next_user_data +%= 1;
+        const out_fence = try self.device.commitFlip(&self.target, .{
+            .fb_id = fb_id,
+            .in_fence_fd = in_fence_fd,
+            .user_data = user_data,
+        });
+        self.scheduler.onCommit(monotonicNs());
+        self.flip_pending = true;
+        self.pending_fb = fb_id;
+        return out_fence;
+    }
+
+    /// Process flip events for this output, waiting up to `timeout_ms`.
+    /// Returns the latest completed vblank, if any.
+    pub fn dispatchEvents(self: *AtomicOutput, timeout_ms: i32) !?FrameTiming {
+        var events: [max_events]FlipEvent = undefined;
+        const n = try self.device.readFlipEvents(&events, timeout_ms);
+
+        var latest: ?FrameTiming = null;
+        for (events[0..n]) |event| {
+            if (event.crtc_id != 0 and event.crtc_id != self.target.crtc_id) continue;
+            self.scheduler.onFlip(event.timing);
+            self.flip_pending = false;
+            self.current_fb = self.pending_fb;
+            self.pending_fb = 0;
+            latest = event.timing;
+        }
+        return latest;
+    }
+};
+
 /// Wait for vertical blank
 pub fn waitVblank(fd: std.posix.fd_t, crtc_id: u32) !FrameTiming {
     var vbl: c.drmVBlank = undefined;
@@ -300,3 +1480,169 @@ pub fn waitVblank(fd: std.posix.fd_t, crtc_id: u32) !FrameTiming {
 test "drm types compile" {
     _ = Mode{ .width = 1920, .height = 1080, .refresh_hz = 60, .flags = 0 };
 }
+
+test "parse flip events" {
+    var buf: [2 * @sizeOf(VblankEvent) + @sizeOf(EventHeader)]u8 align(8) = undefined;
+    const flip = VblankEvent{
+        .base = .{ .type = drm_event_flip_complete, .length = @sizeOf(VblankEvent) },
+        .user_data = 42,
+        .tv_sec = 3,
+        .tv_usec = 250,
+        .sequence = 1000,
+        .crtc_id = 51,
+    };
+    // A plain vblank event (type 0x01) in between is skipped
+    const vblank = EventHeader{ .type = 0x01, .length = @sizeOf(EventHeader) };
+    @memcpy(buf[0..@sizeOf(VblankEvent)], std.mem.asBytes(&flip));
+    @memcpy(buf[@sizeOf(VblankEvent)..][0..@sizeOf(EventHeader)], std.mem.asBytes(&vblank));
+    @memcpy(buf[@sizeOf(VblankEvent) + @sizeOf(EventHeader) ..], std.mem.asBytes(&flip));
+
+    var events: [max_events]FlipEvent = undefined;
+    try std.testing.expectEqual(@as(usize, 2), parseFlipEvents(&buf, &events));
+    try std.testing.expectEqual(@as(u64, 42), events[0].user_data);
+    try std.testing.expectEqual(@as(u32, 51), events[1].crtc_id);
+    try std.testing.expectEqual(@as(u64, 3_000_250_000), events[0].timing.timestamp_ns);
+
+    // A truncated trailing event is ignored
+    try std.testing.expectEqual(@as(usize, 1), parseFlipEvents(buf[0 .. @sizeOf(VblankEvent) + 4], &events));
+}
+
+test "in formats blob" {
+    const XR24: u32 = 0x34325258;
+    const AR24: u32 = 0x34325241;
+    const nv_block: u64 = 0x0300000000606015;
+
+    var blob: [@sizeOf(FormatModifierBlob) + 8 + 2 * @sizeOf(FormatModifier)]u8 align(8) = undefined;
+    const header = FormatModifierBlob{
+        .version = 1,
+        .flags = 0,
+        .count_formats = 2,
+        .formats_offset = @sizeOf(FormatModifierBlob),
+        .count_modifiers = 2,
+        .modifiers_offset = @sizeOf(FormatModifierBlob) + 8,
+    };
+    const mods = [2]FormatModifier{
+        .{ .formats = 0b11, .offset = 0, .pad = 0, .modifier = 0 }, // linear: both formats
+        .{ .formats = 0b01, .offset = 0, .pad = 0, .modifier = nv_block }, // tiled: XR24 only
+    };
+    @memcpy(blob[0..@sizeOf(FormatModifierBlob)], std.mem.asBytes(&header));
+    @memcpy(blob[@sizeOf(FormatModifierBlob)..][0..8], std.mem.asBytes(&[2]u32{ XR24, AR24 }));
+    @memcpy(blob[@sizeOf(FormatModifierBlob) + 8 ..], std.mem.asBytes(&mods));
+
+    const formats = PlaneFormats.parseInFormats(&blob);
+    try std.testing.expectEqual(@as(usize, 3), formats.count);
+    try std.testing.expect(formats.supports(XR24, nv_block));
+    try std.testing.expect(!formats.supports(AR24, nv_block));
+    try std.testing.expect(formats.supports(AR24, modifier_invalid));
+    try std.testing.expect(!formats.supports(0x3231564e, 0));
+}
+
+test "framebuffer cache keeps on-screen buffers" {
+    var cache = FramebufferCache{};
+    for (1..5) |i| {
+        try std.testing.expectEqual(@as(?u32, null), cache.insert(1, i, 1920, 1080, @intCast(10 + i), .{ 0, 0 }));
+    }
+    try std.testing.expectEqual(FramebufferCache.Lookup{ .hit = 12 }, cache.lookup(1, 2, 1920, 1080));
+    try std.testing.expectEqual(FramebufferCache.Lookup.miss, cache.lookup(1, 2, 2560, 1440));
+
+    // fb 11 is least recently used but still on screen, so fb 13 goes
+    try std.testing.expectEqual(@as(?u32, 13), cache.insert(1, 9, 1920, 1080, 0, .{ 11, 0 }));
+    try std.testing.expectEqual(FramebufferCache.Lookup.rejected, cache.lookup(1, 9, 1920, 1080));
+}
+
+test "property cache lookups" {
+    var cache = PropertyCache{};
+    const conn = cache.addObject(40, c.DRM_MODE_OBJECT_CONNECTOR).?;
+    conn.crtc_id = 51;
+    conn.record("vrr_capable", 7, 1);
+    conn.record("EDID", 8, 99);
+    const crtc = cache.addObject(51, c.DRM_MODE_OBJECT_CRTC).?;
+    crtc.record("VRR_ENABLED", 12, 0);
+    const plane = cache.addObject(33, c.DRM_MODE_OBJECT_PLANE).?;
+    plane.record("type", 20, plane_type_primary);
+    plane.record("max bpc", 21, 10);
+
+    try std.testing.expectEqual(@as(?u32, 12), cache.propId(51, .vrr_enabled));
+    try std.testing.expectEqual(@as(?u64, 1), cache.get(40).?.value(.vrr_capable));
+    try std.testing.expectEqual(@as(?u32, null), cache.propId(40, .vrr_enabled));
+    try std.testing.expectEqual(@as(?u64, plane_type_primary), cache.get(33).?.value(.plane_type));
+    try std.testing.expectEqual(@as(?u32, 21), cache.propId(33, .max_bpc));
+    try std.testing.expect(cache.get(99) == null);
+}
+
+test "property cache counts what does not fit" {
+    var cache = PropertyCache{};
+    for (0..PropertyCache.max_objects) |i| _ = cache.addObject(@intCast(i + 1), c.DRM_MODE_OBJECT_PLANE).?;
+    try std.testing.expect(cache.addObject(999, c.DRM_MODE_OBJECT_PLANE) == null);
+    try std.testing.expectEqual(@as(usize, 1), cache.overflow);
+    cache.reset();
+    try std.testing.expectEqual(@as(usize, 0), cache.overflow);
+}
+
+test "drm hotplug uevent" {
+    try std.testing.expect(isDrmHotplug("change@/devices/pci0000:00/0000:00:01.0/0000:01:00.0/drm/card1\x00ACTION=change\x00SUBSYSTEM=drm\x00HOTPLUG=1\x00SEQNUM=4242\x00"));
+    try std.testing.expect(!isDrmHotplug("add@/devices/virtual/net/tun0\x00ACTION=add\x00SUBSYSTEM=net\x00"));
+    try std.testing.expect(!isDrmHotplug("change@/devices/.../card1\x00SUBSYSTEM=drm\x00"));
+
+    const removed = parseUevent("remove@/devices/pci0000:00/0000:00:01.0/0000:01:00.0/drm/card1\x00ACTION=remove\x00DEVNAME=dri/card1\x00SUBSYSTEM=drm\x00").?;
+    try std.testing.expectEqual(Uevent.Action.remove, removed.action);
+    try std.testing.expectEqualStrings("card1", removed.cardName());
+    const render = parseUevent("add@/devices/.../drm/renderD128\x00ACTION=add\x00DEVNAME=dri/renderD128\x00SUBSYSTEM=drm\x00").?;
+    try std.testing.expect(!render.isCard());
+}
+
+test {
+    _ = discovery;
+}
+
+test "commit scheduler targets the vblank edge" {
+    var sched = CommitScheduler.init(100);
+    const period: u64 = 10_000_000;
+    try std.testing.expectEqual(@as(u64, 5), sched.commitDeadlineNs(5));
+
+    sched.onFlip(.{ .sequence = 10, .timestamp_ns = 100_000_000 });
+    // Next vblank at 110 ms: commit one lead ahead of it
+    try std.testing.expectEqual(110_000_000 - CommitScheduler.initial_lead_ns, sched.commitDeadlineNs(101_000_000));
+    // Too close to make 110 ms: aim for 120 ms instead
+    try std.testing.expectEqual(120_000_000 - CommitScheduler.initial_lead_ns, sched.commitDeadlineNs(109_000_000));
+
+    // Flip lands a vblank late: the lead grows
+    sched.onCommit(101_000_000);
+    sched.onFlip(.{ .sequence = 12, .timestamp_ns = 100_000_000 + 2 * period });
+    try std.testing.expectEqual(@as(u64, 1), sched.misses);
+    try std.testing.expectEqual(CommitScheduler.initial_lead_ns + CommitScheduler.miss_step_ns, sched.lead_ns);
+
+    // On time: the lead decays back toward the minimum
+    sched.onCommit(121_000_000);
+    sched.onFlip(.{ .sequence = 13, .timestamp_ns = 100_000_000 + 3 * period });
+    try std.testing.expectEqual(@as(u64, 1), sched.hits);
+    try std.testing.expect(sched.lead_ns < CommitScheduler.initial_lead_ns + CommitScheduler.miss_step_ns);
+    try std.testing.expectEqual(period, sched.period_ns);
+}
+
+test "commit scheduler skips vblanks to hold a capped rate" {
+    var sched = CommitScheduler.init(240);
+    sched.setTargetRate(144);
+    const period = sched.period_ns;
+    const base: u64 = std.time.ns_per_s;
+
+    var last = FrameTiming{ .sequence = 0, .timestamp_ns = base };
+    sched.onFlip(last);
+    for (0..12) |_| {
+        const deadline = sched.commitDeadlineNs(last.timestamp_ns + 1);
+        sched.onCommit(deadline);
+        const vblank = deadline + sched.lead_ns;
+        last = .{
+            .sequence = last.sequence + @as(u32, @intCast((vblank - last.timestamp_ns + period / 2) / period)),
+            .timestamp_ns = vblank,
+        };
+        sched.onFlip(last);
+    }
+    // 12 flips at 144 Hz span 20 vblanks at 240 Hz, none of them missed
+    try std.testing.expectEqual(@as(u32, 20), last.sequence);
+    try std.testing.expectEqual(@as(u64, 0), sched.misses);
+
+    // At or above the mode rate every vblank flips
+    sched.setTargetRate(240);
+    try std.testing.expectEqual(@as(u64, 0), sched.target_interval_ns);
+}
@@ -0,0 +1,121 @@
+//! primetime/foreground - Foreground Signal Across Processes
+//!
+//! Background work such as the shader pre-warm scheduler steps aside while a
+//! game is up, but usually runs in another process than the compositor
+//! (`nvprime runtime prewarm`). The compositor maps a small record under
+//! /dev/shm and stamps it with whether its game runs and when the last frame
+//! was presented. It holds an exclusive flock on the file while it runs, so
+//! a crashed compositor never leaves the signal set. Readers check the lock
+//! and ownership the same way telemetry segment readers do.
+
+const std = @import("std");
+const shm = @import("../../nvmon/shm.zig");
+const frame_pacing = @import("frame_pacing.zig");
+
+const posix = std.posix;
+
+/// Default record path
+pub const default_path = "/dev/shm/nvprime-foreground";
+
+/// "NVFG"
+const magic: u32 = 0x4746564e;
+
+pub const Record = extern struct {
+    /// Written last, so a reader that sees it sees the rest
+    magic: u32,
+    /// 1 while a game launched by the compositor runs
+    game_running: u32,
+    /// Last presented frame, CLOCK_MONOTONIC_RAW ns (0 = none yet)
+    last_frame_ns: u64,
+};
+
+/// Writer side, owned by the compositor
+pub const Publisher = struct {
+    mapping: []align(std.heap.page_size_min) u8,
+    path: []const u8,
+    /// Open for the publisher's lifetime; holds the liveness lock
+    file: std.fs.File,
+
+    const Self = @This();
+
+    /// Create (or replace) the record at `path`. `path` must outlive the
+    /// publisher. Fails with error.InUse while another compositor holds it.
+    pub fn create(path: []const u8) !Self {
+        if (try shm.isLocked(path)) return error.InUse;
+
+        std.fs.deleteFileAbsolute(path) catch |err| switch (err) {
+            error.FileNotFound => {},
+            else => return err,
+        };
+        const file = try std.fs.createFileAbsolute(path, .{ .read = true, .exclusive = true, .mode = 0o644 });
+        errdefer file.close();
+        errdefer std.fs.deleteFileAbsolute(path) catch {};
+        try posix.flock(file.handle, posix.LOCK.EX | posix.LOCK.NB);
+        try file.setEndPos(@sizeOf(Record));
+
+        const mapping = try posix.mmap(null, @sizeOf(Record), posix.PROT.READ | posix.PROT.WRITE, .{ .TYPE = .SHARED }, file.handle, 0);
+        const self = Self{ .mapping = mapping, .path = path, .file = file };
+        self.record().* = .{ .magic = 0, .game_running = 0, .last_frame_ns = 0 };
+        @atomicStore(u32, &self.record().magic, magic, .release);
+        return self;
+    }
+
+    /// Unmap and remove the record
+    pub fn close(self: *Self) void {
+        posix.munmap(self.mapping);
+        std.fs.deleteFileAbsolute(self.path) catch {};
+        self.file.close();
+    }
+
+    fn record(self: *const Self) *Record {
+        return @ptrCast(self.mapping.ptr);
+    }
+
+    pub fn setGameRunning(self: *const Self, running: bool) void {
+        @atomicStore(u32, &self.record().game_running, @intFromBool(running), .release);
+    }
+
+    /// Stamp a presented frame (a single store, fine on the frame path)
+    pub fn recordFrame(self: *const Self, now_ns: u64) void {
+        @atomicStore(u64, &self.record().last_frame_ns, now_ns, .monotonic);
+    }
+};
+
+/// Whether a live compositor publishing at `path` runs a game or presented
+/// a frame within `window_ns`. False if there is none or the record is not
+/// trustworthy.
+pub fn isActive(path: []const u8, window_ns: u64) bool {
+    const file = std.fs.openFileAbsolute(path, .{}) catch return false;
+    defer file.close();
+    const stat = posix.fstat(file.handle) catch return false;
+    if (!shm.isTrusted(stat) or stat.size < @sizeOf(Record)) return false;
+    if (!shm.holdsLock(file.handle)) return false;
+
+    var rec: Record = undefined;
+    const n = file.preadAll(std.mem.asBytes(&rec), 0) catch return false;
+    if (n < @sizeOf(Record) or rec.magic != magic) return false;
+    if (rec.game_running != 0) return true;
+    return rec.last_frame_ns != 0 and frame_pacing.monotonicRawNs() -| rec.last_frame_ns < window_ns;
+}
+
+test "foreground record" {
+    var path_buf: [64]u8 = undefined;
+    const path = try std.fmt.bufPrint(&path_buf, "/dev/shm/nvprime-test-fg-{d}", .{std.os.linux.getpid()});
+
+    var publisher = Publisher.create(path) catch return error.SkipZigTest;
+    try std.testing.expect(!isActive(path, std.time.ns_per_s));
+
+    publisher.setGameRunning(true);
+    try std.testing.expect(isActive(path, std.time.ns_per_s));
+
+    publisher.setGameRunning(false);
+    publisher.recordFrame(frame_pacing.monotonicRawNs());
+    try std.testing.expect(isActive(path, std.time.ns_per_s));
+    try std.testing.expect(!isActive(path, 0));
+
+    // A second compositor may not take over a live record
+    try std.testing.expectError(error.InUse, Publisher.create(path));
+
+    publisher.close();
+    try std.testing.expect(!isActive(path, std.time.ns_per_s));
+}
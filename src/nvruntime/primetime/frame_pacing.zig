@@ -17,6 +17,9 @@ pub const PacingMode = enum {
     vrr,
     /// Frame limiter - cap at specific FPS
     limited,
+    /// Predictive limiter - start each frame so it lands on the deadline,
+    /// with a learned sleep margin and a spin for the last stretch
+    predictive,
 };
 
 /// Frame statistics
@@ -64,8 +67,13 @@ pub const FrameStats = struct {
     }
 };
 
-/// Rolling statistics buffer
+/// Rolling statistics over the last N values.
+/// Push and every query are O(1): a running sum for the average, monotonic
+/// queues for min/max and a log-binned histogram for percentiles, so frame
+/// stats can be read every vblank without sorting the window.
 pub fn RollingStats(comptime N: usize) type {
+    comptime std.debug.assert(N > 0 and N <= std.math.maxInt(u16));
+
     return struct {
         const Self = @This();
 
@@ -73,51 +81,65 @@ pub fn RollingStats(comptime N: usize) type {
         index: usize = 0,
         count: usize = 0,
 
+        /// Values pushed so far; also the sequence number of the next value
+        pushed: u64 = 0,
+        sum: f64 = 0,
+        min_queue: MonotonicQueue(N, .min) = .{},
+        max_queue: MonotonicQueue(N, .max) = .{},
+        histogram: LogHistogram = .{},
+
         pub fn push(self: *Self, value: f32) void {
+            if (self.count == N) {
+                const evicted = self.values[self.index];
+                self.sum -= evicted;
+                self.histogram.remove(evicted);
+            } else {
+                self.count += 1;
+            }
+
             self.values[self.index] = value;
+            self.sum += value;
+            self.histogram.add(value);
+            self.min_queue.push(&self.values, self.pushed, value);
+            self.max_queue.push(&self.values, self.pushed, value);
+            self.pushed += 1;
+
             self.index = (self.index + 1) % N;
-            if (self.count < N) self.count += 1;
+            // Re-sum once per window so the running sum cannot drift
+            if (self.index == 0) self.sum = sumValues(self.values[0..self.count]);
         }
 
         pub fn average(self: *const Self) f32 {
             if (self.count == 0) return 0;
-            var sum: f32 = 0;
-            for (self.values[0..self.count]) |v| {
-                sum += v;
-            }
-            return sum / @as(f32, @floatFromInt(self.count));
+            return @floatCast(self.sum / @as(f64, @floatFromInt(self.count)));
         }
 
         pub fn min(self: *const Self) f32 {
             if (self.count == 0) return 0;
-            var m: f32 = self.values[0];
-            for (self.values[1..self.count]) |v| {
-                if (v < m) m = v;
-            }
-            return m;
+            return self.min_queue.front(&self.values);
         }
 
         pub fn max(self: *const Self) f32 {
             if (self.count == 0) return 0;
-            var m: f32 = self.values[0];
-            for (self.values[1..self.count]) |v| {
-                if (v > m) m = v;
-            }
-            return m;
+            return self.max_queue.front(&self.values);
         }
 
-        /// Calculate percentile (0-100)
+        /// Calculate percentile (0-100).
+        /// Exact at the extremes, otherwise within one histogram bin (~3%).
         pub fn percentile(self: *const Self, p: f32) f32 {
             if (self.count == 0) return 0;
             if (self.count == 1) return self.values[0];
 
-            // Copy and sort
-            var sorted: [N]f32 = undefined;
-            @memcpy(sorted[0..self.count], self.values[0..self.count]);
-            std.mem.sort(f32, sorted[0..self.count], {}, std.sort.asc(f32));
+            const rank = @as(usize, @intFromFloat(@as(f32, @floatFromInt(self.count - 1)) * std.math.clamp(p, 0, 100) / 100.0));
+            if (rank == 0) return self.min();
+            if (rank == self.count - 1) return self.max();
 
-            const idx = @as(usize, @intFromFloat(@as(f32, @floatFromInt(self.count - 1)) * p / 100.0));
-            return sorted[idx];
+            // Interpolate within the bin holding the rank
+            const pos = self.histogram.find(rank);
+            const lo = LogHistogram.lowerBound(pos.bin);
+            const hi = LogHistogram.lowerBound(pos.bin + 1);
+            const frac = (@as(f32, @floatFromInt(pos.offset)) + 0.5) / @as(f32, @floatFromInt(pos.count));
+            return std.math.clamp(lo + (hi - lo) * frac, self.min(), self.max());
         }
 
         /// Get 1% low (99th percentile of frame times)
@@ -127,6 +149,192 @@ pub fn RollingStats(comptime N: usize) type {
     };
 }
 
+const Extreme = enum { min, max };
+
+/// Sliding-window min or max: sequence numbers of values that can still
+/// become the extreme, in push order. Amortised O(1) per push.
+fn MonotonicQueue(comptime N: usize, comptime kind: Extreme) type {
+    return struct {
+        const Self = @This();
+
+        seqs: [N]u64 = undefined,
+        head: usize = 0,
+        tail: usize = 0,
+
+        /// `values[seq % N]` must already hold `value`
+        fn push(self: *Self, values: *const [N]f32, seq: u64, value: f32) void {
+            // Drop values that left the window
+            while (self.tail > self.head and self.seqs[self.head % N] + N <= seq) self.head += 1;
+            // Drop values the new one dominates
+            while (self.tail > self.head) {
+                const back = values[@intCast(self.seqs[(self.tail - 1) % N] % N)];
+                const keep = switch (kind) {
+                    .min => back < value,
+                    .max => back > value,
+                };
+                if (keep) break;
+                self.tail -= 1;
+            }
+            self.seqs[self.tail % N] = seq;
+            self.tail += 1;
+        }
+
+        fn front(self: *const Self, values: *const [N]f32) f32 {
+            return values[@intCast(self.seqs[self.head % N] % N)];
+        }
+    };
+}
+
+/// Log-spaced histogram over positive f32 values. Each octave is split into
+/// 2^sub_bits bins; the bin index is read straight from the float's exponent
+/// and top mantissa bits. Octave totals keep rank lookups to a short scan.
+const LogHistogram = struct {
+    const sub_bits = 5;
+    const subs = 1 << sub_bits;
+    /// Covers [2^min_exp, 2^(min_exp + octaves)): ~1us to ~16s in milliseconds
+    const min_exp = -10;
+    const octaves = 24;
+    const bins = octaves * subs;
+
+    counts: [bins]u16 = [_]u16{0} ** bins,
+    octave_counts: [octaves]u16 = [_]u16{0} ** octaves,
+
+    const Position = struct {
+        bin: usize,
+        /// Rank within the bin
+        offset: usize,
+        /// Values in the bin
+        count: usize,
+    };
+
+    fn binOf(value: f32) usize {
+        if (!(value > 0)) return 0; // zero, negative and NaN
+        const bits: u32 = @bitCast(value);
+        const exp = @as(i32, @intCast(bits >> 23)) - 127;
+        if (exp < min_exp) return 0;
+        if (exp >= min_exp + octaves) return bins - 1;
+        const sub = (bits >> (23 - sub_bits)) & (subs - 1);
+        return @as(usize, @intCast(exp - min_exp)) * subs + sub;
+    }
+
+    /// Smallest value mapping to `bin` (`bin == bins` gives the range end)
+    fn lowerBound(bin: usize) f32 {
+        const exp: i32 = @as(i32, @intCast(bin / subs)) + min_exp;
+        const bits = (@as(u32, @intCast(exp + 127)) << 23) | (@as(u32, @intCast(bin % subs)) << (23 - sub_bits));
+        return @bitCast(bits);
+    }
+
+    fn add(self: *LogHistogram, value: f32) void {
+        const bin = binOf(value);
+        self.counts[bin] += 1;
+        self.octave_counts[bin / subs] += 1;
+    }
+
+    fn remove(self: *LogHistogram, value: f32) void {
+        const bin = binOf(value);
+        self.counts[bin] -= 1;
+        self.octave_counts[bin / subs] -= 1;
+    }
+
+    /// Locate the value of the given rank (0 = smallest)
+    fn find(self: *const LogHistogram, rank: usize) Position {
+        var seen: usize = 0;
+        var octave: usize = 0;
+        while (octave < octaves - 1 and seen + self.octave_counts[octave] <= rank) : (octave += 1) {
+            seen += self.octave_counts[octave];
+        }
+        var bin = octave * subs;
+        while (bin < bins - 1 and seen + self.counts[bin] <= rank) : (bin += 1) {
+            seen += self.counts[bin];
+        }
+        return .{ .bin = bin, .offset = rank - seen, .count = @max(self.counts[bin], 1) };
+    }
+};
+
+/// Vectorised sum of a window
+fn sumValues(values: []const f32) f64 {
+    const lanes = 8;
+    var acc: @Vector(lanes, f64) = @splat(0);
+    var i: usize = 0;
+    while (i + lanes <= values.len) : (i += lanes) {
+        const chunk: @Vector(lanes, f32) = values[i..][0..lanes].*;
+        const wide: @Vector(lanes, f64) = @floatCast(chunk);
+        acc += wide;
+    }
+    var total = @reduce(.Add, acc);
+    for (values[i..]) |v| total += v;
+    return total;
+}
+
+/// CLOCK_MONOTONIC_RAW in nanoseconds (not slewed by NTP)
+pub fn monotonicRawNs() u64 {
+    const ts = std.posix.clock_gettime(.MONOTONIC_RAW) catch return @intCast(std.time.nanoTimestamp());
+    return @as(u64, @intCast(ts.sec)) * std.time.ns_per_s + @as(u64, @intCast(ts.nsec));
+}
+
+/// Sleep/spin hybrid wait. Learns how late the kernel wakes the thread,
+/// sleeps until that margin before the deadline, then spins on
+/// CLOCK_MONOTONIC_RAW for the remainder.
+pub const HybridSleeper = struct {
+    /// Recent wake-up overshoot of the sleep (us)
+    overshoot_us: RollingStats(128) = .{},
+    /// Added on top of the learned p99 overshoot
+    guard_ns: u64 = 50 * std.time.ns_per_us,
+    /// Margin used until enough wake-ups have been observed
+    initial_margin_ns: u64 = 1 * std.time.ns_per_ms,
+    min_margin_ns: u64 = 100 * std.time.ns_per_us,
+    max_margin_ns: u64 = 2 * std.time.ns_per_ms,
+    slack_reduced: bool = false,
+
+    /// How long before the deadline to stop sleeping
+    pub fn marginNs(self: *const HybridSleeper) u64 {
+        if (self.overshoot_us.count < 16) return self.initial_margin_ns;
+        const p99_ns: u64 = @intFromFloat(self.overshoot_us.percentile(99) * std.time.ns_per_us);
+        return std.math.clamp(p99_ns + self.guard_ns, self.min_margin_ns, self.max_margin_ns);
+    }
+
+    /// Wait until `deadline_ns` (CLOCK_MONOTONIC_RAW). Returns how late the wait ended.
+    pub fn sleepUntil(self: *HybridSleeper, deadline_ns: u64) u64 {
+        if (!self.slack_reduced) {
+            // The default 50us timer slack is pure overshoot for us
+            _ = std.posix.prctl(.SET_TIMERSLACK, .{1}) catch {};
+            self.slack_reduced = true;
+        }
+
+        var now = monotonicRawNs();
+        const margin = self.marginNs();
+        if (deadline_ns > now + margin) {
+            const wake = deadline_ns - margin;
+            precisionSleepNs(wake - now);
+            now = monotonicRawNs();
+            self.overshoot_us.push(@as(f32, @floatFromInt(now -| wake)) / 1000.0);
+        }
+        while (now < deadline_ns) {
+            std.atomic.spinLoopHint();
+            now = monotonicRawNs();
+        }
+        return now - deadline_ns;
+    }
+};
+
+/// Render-time forecast from recent frames (Reflex-style): how long a frame
+/// takes from CPU start to GPU completion, so it can be started just in time
+pub const PresentForecast = struct {
+    cpu_ms: RollingStats(64) = .{},
+    gpu_ms: RollingStats(64) = .{},
+
+    pub fn record(self: *PresentForecast, stats: *const FrameStats) void {
+        self.cpu_ms.push(@as(f32, @floatFromInt(stats.cpuTimeNs())) / 1_000_000.0);
+        self.gpu_ms.push(@as(f32, @floatFromInt(stats.gpuTimeNs())) / 1_000_000.0);
+    }
+
+    /// Predicted CPU + GPU time; p90 so that a slow frame rarely misses its slot
+    pub fn renderTimeNs(self: *const PresentForecast) u64 {
+        const ms = self.cpu_ms.percentile(90) + self.gpu_ms.percentile(90);
+        return @intFromFloat(@max(ms, 0) * 1_000_000.0);
+    }
+};
+
 /// Frame pacer state
 pub const FramePacer = struct {
     mode: PacingMode = .vsync,
@@ -142,6 +350,10 @@ pub const FramePacer = struct {
     frame_times: RollingStats(300) = .{},
     latencies: RollingStats(300) = .{},
 
+    // Predictive mode
+    sleeper: HybridSleeper = .{},
+    forecast: PresentForecast = .{},
+
     /// Initialize with target FPS
     pub fn init(target_fps: u32) FramePacer {
         return FramePacer{
@@ -174,6 +386,7 @@ pub const FramePacer = struct {
 
         self.frame_times.push(frame_time_ms);
         self.latencies.push(latency_ms);
+        self.forecast.record(stats);
 
         if (stats.present_ns > 0) {
             self.last_present_ns = stats.present_ns;
@@ -181,18 +394,54 @@ pub const FramePacer = struct {
         self.frame_number = stats.frame_number;
     }
 
-    /// Calculate how long to sleep before next frame (for frame limiting)
+    /// Record when a frame actually reached the display (monotonicRawNs clock),
+    /// e.g. from a page-flip event
+    pub fn recordPresent(self: *FramePacer, present_ns: u64) void {
+        self.last_present_ns = present_ns;
+    }
+
+    /// Calculate how long to sleep before next frame (for frame limiting).
+    /// In predictive mode this is the time until the forecast frame start.
     pub fn calculateSleepNs(self: *const FramePacer, current_ns: u64) u64 {
-        if (self.mode != .limited or self.target_frame_ns == 0) {
+        if ((self.mode != .limited and self.mode != .predictive) or self.target_frame_ns == 0) {
             return 0;
         }
 
         if (self.last_present_ns == 0) return 0;
 
-        const elapsed = current_ns - self.last_present_ns;
-        if (elapsed >= self.target_frame_ns) return 0;
+        const elapsed = current_ns -| self.last_present_ns;
+        const lead: u64 = if (self.mode == .predictive) self.forecast.renderTimeNs() else 0;
+        if (elapsed + lead >= self.target_frame_ns) return 0;
+
+        return self.target_frame_ns - elapsed - lead;
+    }
 
-        return self.target_frame_ns - elapsed;
+    /// Predicted present time of a frame started at `start_ns`
+    pub fn forecastPresentNs(self: *const FramePacer, start_ns: u64) u64 {
+        return start_ns + self.forecast.renderTimeNs();
+    }
+
+    /// Block until the next frame should start. Present timestamps must be
+    /// CLOCK_MONOTONIC_RAW (`monotonicRawNs`). Returns the start time.
+    pub fn waitForFrameStart(self: *FramePacer) u64 {
+        const now = monotonicRawNs();
+        switch (self.mode) {
+            .limited => {
+                precisionSleepNs(self.calculateSleepNs(now));
+                return monotonicRawNs();
+            },
+            .predictive => {
+                if (self.last_present_ns == 0 or self.target_frame_ns == 0) return now;
+                // Next present slot after now, then back off by the render forecast
+                var deadline = self.last_present_ns + self.target_frame_ns;
+                if (deadline <= now) deadline += ((now - deadline) / self.target_frame_ns + 1) * self.target_frame_ns;
+                const start = deadline -| self.forecast.renderTimeNs();
+                if (start <= now) return now;
+                _ = self.sleeper.sleepUntil(start);
+                return start;
+            },
+            else => return now,
+        }
     }
 
     /// Get current FPS
@@ -233,15 +482,56 @@ pub const FramePacer = struct {
     }
 };
 
-/// High precision sleep
+/// Plain relative sleep (subject to timer slack and wake-up latency)
 pub fn precisionSleepNs(ns: u64) void {
     if (ns == 0) return;
+    std.posix.nanosleep(ns / std.time.ns_per_s, ns % std.time.ns_per_s);
+}
 
-    const ts = std.posix.timespec{
-        .sec = @intCast(ns / 1_000_000_000),
-        .nsec = @intCast(ns % 1_000_000_000),
-    };
-    _ = std.posix.nanosleep(ts, null);
+/// Deadline wait strategy measured by `measureDeadlineJitter`
+pub const WaitStrategy = enum {
+    /// One nanosleep to the deadline (`limited` mode)
+    sleep,
+    /// Learned-margin sleep plus spin (`predictive` mode)
+    hybrid,
+};
+
+/// Distance from the deadline at which a wait returned
+pub const JitterReport = struct {
+    mean_us: f32 = 0,
+    p50_us: f32 = 0,
+    p99_us: f32 = 0,
+    max_us: f32 = 0,
+    /// Waits that returned before the deadline
+    early: u32 = 0,
+};
+
+/// Wait on a fixed cadence and report how far each wake-up lands from its deadline
+pub fn measureDeadlineJitter(strategy: WaitStrategy, period_ns: u64, iterations: u32) JitterReport {
+    var errors: RollingStats(1024) = .{};
+    var report = JitterReport{};
+    var sleeper = HybridSleeper{};
+
+    var deadline = monotonicRawNs() + period_ns;
+    for (0..iterations) |_| {
+        const now = switch (strategy) {
+            .sleep => blk: {
+                precisionSleepNs(deadline -| monotonicRawNs());
+                break :blk monotonicRawNs();
+            },
+            .hybrid => deadline + sleeper.sleepUntil(deadline),
+        };
+        if (now < deadline) report.early += 1;
+        const err_ns = if (now >= deadline) now - deadline else deadline - now;
+        errors.push(@as(f32, @floatFromInt(err_ns)) / 1000.0);
+        deadline += period_ns;
+    }
+
+    report.mean_us = errors.average();
+    report.p50_us = errors.percentile(50);
+    report.p99_us = errors.percentile(99);
+    report.max_us = errors.max();
+    return report;
 }
 
 test "frame pacer" {
@@ -262,3 +552,52 @@ test "rolling stats" {
     try std.testing.expectEqual(@as(f32, 10.0), stats.min());
     try std.testing.expectEqual(@as(f32, 30.0), stats.max());
 }
+
+test "rolling stats window eviction" {
+    var stats: RollingStats(4) = .{};
+    for ([_]f32{ 5, 1, 9, 3, 4, 6 }) |v| stats.push(v);
+
+    // Window is now { 9, 3, 4, 6 }
+    try std.testing.expectEqual(@as(f32, 3), stats.min());
+    try std.testing.expectEqual(@as(f32, 9), stats.max());
+    try std.testing.expectApproxEqAbs(@as(f32, 5.5), stats.average(), 0.0001);
+
+    stats.push(2);
+    stats.push(2);
+    try std.testing.expectEqual(@as(f32, 2), stats.min());
+    try std.testing.expectEqual(@as(f32, 6), stats.max());
+}
+
+test "rolling stats percentile matches sorted window" {
+    var stats: RollingStats(300) = .{};
+    var prng = std.Random.DefaultPrng.init(7);
+    const random = prng.random();
+    for (0..1000) |_| stats.push(4.0 + random.float(f32) * 20.0);
+
+    var sorted = stats.values;
+    std.mem.sort(f32, &sorted, {}, std.sort.asc(f32));
+    for ([_]f32{ 1, 50, 99 }) |p| {
+        const exact = sorted[@intFromFloat(299.0 * p / 100.0)];
+        try std.testing.expectApproxEqRel(exact, stats.percentile(p), 0.04);
+    }
+    try std.testing.expectEqual(sorted[0], stats.percentile(0));
+    try std.testing.expectEqual(sorted[299], stats.percentile(100));
+}
+
+test "hybrid sleeper never wakes early" {
+    const report = measureDeadlineJitter(.hybrid, 500 * std.time.ns_per_us, 20);
+    try std.testing.expectEqual(@as(u32, 0), report.early);
+}
+
+test "predictive sleep accounts for render time" {
+    var pacer = FramePacer.init(100);
+    pacer.setMode(.predictive);
+    for (0..8) |i| {
+        const base: u64 = i * 10_000_000;
+        pacer.recordFrame(&.{ .cpu_start_ns = base, .cpu_end_ns = base + 2_000_000, .gpu_submit_ns = base + 2_000_000, .gpu_complete_ns = base + 5_000_000, .present_ns = base + 6_000_000 });
+    }
+    // 10ms period, 5ms forecast render time: start 5ms after the last present,
+    // so 2ms in there are 3ms left to sleep
+    try std.testing.expectEqual(@as(u64, 5_000_000), pacer.forecast.renderTimeNs());
+    try std.testing.expectEqual(@as(u64, 3_000_000), pacer.calculateSleepNs(pacer.last_present_ns + 2_000_000));
+}
@@ -0,0 +1,431 @@
+//! Multi-output atomic KMS for PrimeTime
+//!
+//! Drives every lit output of one card in parallel. Each CRTC gets its own
+//! thread with its own commit scheduler and frame pacer, so a 60 Hz panel
+//! next to a 240 Hz one never waits on the other's vblank. All outputs share
+//! the card's fd (only one DRM master per card); a single event thread reads
+//! flip completions and hands each to the output encoded in its user data.
+//!
+//! The scene is published as an RCU snapshot: output threads read the
+//! latest one without locks, and publishing never blocks a frame.
+//! After a hotplug, `rescan` re-resolves the outputs on the same fd.
+
+const std = @import("std");
+const drm = @import("drm.zig");
+const frame_pacing = @import("frame_pacing.zig");
+const rcu = @import("rcu.zig");
+const multimon = @import("../../nvdisplay/multimon.zig");
+
+pub const max_outputs = 8;
+
+/// What every output composites from
+pub const Scene = struct {
+    /// Bumped on every publish
+    generation: u64 = 0,
+    /// Game buffer to show, if any
+    client: ?drm.DmaBuf = null,
+    overlay_count: u32 = 0,
+};
+
+const SceneRcu = rcu.Rcu(Scene);
+
+comptime {
+    // One reader slot per output thread
+    std.debug.assert(max_outputs <= SceneRcu.max_readers);
+}
+
+/// A rendered frame ready to flip
+pub const Frame = struct {
+    fb_id: u32,
+    /// Signalled when rendering finished
+    in_fence_fd: ?std.posix.fd_t = null,
+};
+
+/// Renders `scene` for `output` on the output's thread. Returns null to
+/// skip this vblank (nothing changed).
+pub const RenderFn = *const fn (context: ?*anyopaque, output: *const Output, scene: *const Scene) anyerror!?Frame;
+
+/// Called on the primary output's thread once its flip completed, with the
+/// time since the previous flip and the frame's stats. Must not block.
+pub const FrameFn = *const fn (context: ?*anyopaque, output: *const Output, interval_ns: u64, stats: *const frame_pacing.FrameStats) void;
+
+pub const Config = struct {
+    /// Only drive outputs enabled in this layout, using its refresh rates
+    /// as pacing targets; null drives every lit output at its mode's rate
+    layout: ?*const multimon.Layout = null,
+    render: RenderFn,
+    context: ?*anyopaque = null,
+    on_frame: ?FrameFn = null,
+    frame_context: ?*anyopaque = null,
+};
+
+/// Flip events carry the output index in the top byte
+pub fn encodeUserData(index: usize, sequence: u64) u64 {
+    return (@as(u64, @intCast(index)) << 56) | (sequence & 0x00ff_ffff_ffff_ffff);
+}
+
+pub fn decodeIndex(user_data: u64) usize {
+    return @intCast(user_data >> 56);
+}
+
+/// Refresh rate the layout asks of an output; null if the layout disables it
+fn layoutRefresh(layout: *const multimon.Layout, name: []const u8, mode_hz: u32) ?u32 {
+    for (layout.entries[0..layout.entry_count]) |*entry| {
+        if (!entry.enabled or !std.mem.eql(u8, entry.getName(), name)) continue;
+        return if (entry.refresh_hz > 0) @min(entry.refresh_hz, mode_hz) else mode_hz;
+    }
+    return null;
+}
+
+/// One CRTC and the thread that feeds it
+pub const Output = struct {
+    index: usize,
+    target: drm.FlipTarget,
+    scheduler: drm.CommitScheduler,
+    sleeper: frame_pacing.HybridSleeper = .{},
+    pacer: frame_pacing.FramePacer,
+    thread: ?std.Thread = null,
+
+    // Set by the event thread
+    flip_done: std.Thread.ResetEvent = .{},
+    flip_mutex: std.Thread.Mutex = .{},
+    last_flip: ?drm.FrameTiming = null,
+
+    // Owned by the output thread
+    flip_pending: bool = false,
+    sequence: u64 = 0,
+    current_fb: u32 = 0,
+    pending_fb: u32 = 0,
+    pending_stats: frame_pacing.FrameStats = .{},
+
+    frames: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    misses: std.atomic.Value(u64) = std.atomic.Value(u64).init(0),
+    /// Copy of the scheduler's commit lead for `stats`
+    lead_ns: std.atomic.Value(u64) = std.atomic.Value(u64).init(drm.CommitScheduler.initial_lead_ns),
+
+    fn init(index: usize, target: drm.FlipTarget, refresh_hz: u32) Output {
+        var pacer = frame_pacing.FramePacer.init(refresh_hz);
+        pacer.setMode(.vsync);
+        // A layout rate below the mode's skips vblanks to hold it
+        var scheduler = drm.CommitScheduler.init(target.mode.refresh_hz);
+        scheduler.setTargetRate(refresh_hz);
+        return .{
+            .index = index,
+            .target = target,
+            .scheduler = scheduler,
+            .pacer = pacer,
+        };
+    }
+
+    /// Called from the event thread
+    fn signalFlip(self: *Output, timing: drm.FrameTiming) void {
+        self.flip_mutex.lock();
+        self.last_flip = timing;
+        self.flip_mutex.unlock();
+        self.flip_done.set();
+    }
+
+    /// Account the flip the event thread signalled; false if there was none
+    fn completeFlip(self: *Output) bool {
+        self.flip_mutex.lock();
+        const timing = self.last_flip orelse {
+            self.flip_mutex.unlock();
+            return false;
+        };
+        self.last_flip = null;
+        self.flip_mutex.unlock();
+
+        const misses = self.scheduler.misses;
+        self.scheduler.onFlip(timing);
+        if (self.scheduler.misses != misses) _ = self.misses.fetchAdd(1, .monotonic);
+        self.lead_ns.store(self.scheduler.lead_ns, .monotonic);
+
+        // Flip timestamps are CLOCK_MONOTONIC; the pacer runs on MONOTONIC_RAW
+        const age = drm.monotonicNs() -| timing.timestamp_ns;
+        self.pending_stats.present_ns = frame_pacing.monotonicRawNs() -| age;
+        self.pacer.recordFrame(&self.pending_stats);
+        self.pacer.recordPresent(self.pending_stats.present_ns);
+
+        self.flip_pending = false;
+        self.current_fb = self.pending_fb;
+        self.pending_fb = 0;
+        _ = self.frames.fetchAdd(1, .monotonic);
+        return true;
+    }
+
+    /// Sleep until `deadline` (CLOCK_MONOTONIC)
+    fn sleepUntil(self: *Output, deadline: u64) void {
+        const now = drm.monotonicNs();
+        if (deadline > now) _ = self.sleeper.sleepUntil(frame_pacing.monotonicRawNs() + (deadline - now));
+    }
+};
+
+pub const OutputStats = struct {
+    name: [16]u8,
+    refresh_hz: u32,
+    frames: u64,
+    missed_vblanks: u64,
+    /// Current commit lead before vblank (ms)
+    lead_ms: f32,
+};
+
+pub const MultiOutput = struct {
+    allocator: std.mem.Allocator,
+    device: drm.Device,
+    config: Config,
+    outputs: [max_outputs]Output = undefined,
+    output_count: usize = 0,
+    /// Output whose frames feed `config.on_frame`: the layout's primary
+    /// display when it is driven, else the first output
+    primary: usize = 0,
+    scenes: SceneRcu,
+    running: std.atomic.Value(bool) = std.atomic.Value(bool).init(false),
+    event_thread: ?std.Thread = null,
+
+    /// Open `path` (or the card of GPU `gpu_uuid`, or the default card) and
+    /// resolve every lit output, filtered by the layout
+    pub fn open(allocator: std.mem.Allocator, path: ?[]const u8, gpu_uuid: ?[]const u8, config: Config) !*MultiOutput {
+        var device = try drm.Device.openSelected(path, gpu_uuid);
+        errdefer device.close();
+        return adopt(allocator, device, config);
+    }
+
+    /// Like `open`, on a card that is already open (e.g. a `dupe` of the
+    /// fd that holds DRM master). Takes ownership of `device` on success.
+    pub fn adopt(allocator: std.mem.Allocator, device: drm.Device, config: Config) !*MultiOutput {
+        var dev = device;
+        try dev.enableAtomic();
+
+        const self = try allocator.create(MultiOutput);
+        errdefer allocator.destroy(self);
+        self.* = .{
+            .allocator = allocator,
+            .device = dev,
+            .config = config,
+            .scenes = try SceneRcu.init(allocator, .{}),
+        };
+        errdefer self.scenes.deinit();
+        try self.resolveOutputs();
+        return self;
+    }
+
+    /// Rebuild one output per lit CRTC the layout enables. Threads must be stopped.
+    fn resolveOutputs(self: *MultiOutput) !void {
+        var targets: [max_outputs]drm.FlipTarget = undefined;
+        const found = try self.device.findFlipTargets(&targets);
+
+        const primary_name = if (self.config.layout) |layout|
+            if (layout.getPrimary()) |entry| entry.getName() else ""
+        else
+            "";
+        self.output_count = 0;
+        self.primary = 0;
+        for (targets[0..found]) |target| {
+            var refresh_hz = target.mode.refresh_hz;
+            if (self.config.layout) |layout| {
+                refresh_hz = layoutRefresh(layout, target.getName(), refresh_hz) orelse continue;
+            }
+            if (std.mem.eql(u8, target.getName(), primary_name)) self.primary = self.output_count;
+            self.outputs[self.output_count] = Output.init(self.output_count, target, refresh_hz);
+            self.output_count += 1;
+        }
+        if (self.output_count == 0) return error.NoConnectedOutput;
+    }
+
+    /// Re-resolve the outputs after a hotplug: stop the threads, refresh the
+    /// card's resources and property cache, rebuild the outputs and start
+    /// them again. With nothing left to drive the threads stay stopped and
+    /// error.NoConnectedOutput is returned; a later rescan brings them back.
+    pub fn rescan(self: *MultiOutput) !void {
+        self.stop();
+
+        // Flips queued by the old threads would complete on the new outputs
+        var events: [drm.max_events]drm.FlipEvent = undefined;
+        while ((self.device.readFlipEvents(&events, 50) catch 0) > 0) {}
+
+        self.device.handleHotplug();
+        try self.resolveOutputs();
+        try self.start();
+    }
+
+    /// Stop the threads, close the card and free `self`
+    pub fn close(self: *MultiOutput) void {
+        self.stop();
+        self.scenes.deinit();
+        self.device.close();
+        self.allocator.destroy(self);
+    }
+
+    /// Spawn the event thread and one thread per output
+    pub fn start(self: *MultiOutput) !void {
+        if (self.running.load(.acquire)) return;
+        self.running.store(true, .release);
+        errdefer self.stop();
+
+        self.event_thread = try std.Thread.spawn(.{}, eventMain, .{self});
+        for (self.outputs[0..self.output_count]) |*out| {
+            out.thread = try std.Thread.spawn(.{}, outputMain, .{ self, out });
+        }
+    }
+
+    pub fn stop(self: *MultiOutput) void {
+        self.running.store(false, .release);
+        for (self.outputs[0..self.output_count]) |*out| {
+            // Wake a thread waiting on a flip that will never complete
+            out.flip_done.set();
+            if (out.thread) |t| t.join();
+            out.thread = null;
+        }
+        if (self.event_thread) |t| t.join();
+        self.event_thread = null;
+    }
+
+    /// Make `scene` what every output shows from its next frame on
+    pub fn publishScene(self: *MultiOutput, scene: Scene) !void {
+        var next = scene;
+        next.generation = self.scenes.latest().generation + 1;
+        try self.scenes.publish(next);
+    }
+
+    pub fn outputCount(self: *const MultiOutput) usize {
+        return self.output_count;
+    }
+
+    pub fn stats(self: *const MultiOutput, index: usize) ?OutputStats {
+        if (index >= self.output_count) return null;
+        const out = &self.outputs[index];
+        return .{
+            .name = out.target.name,
+            .refresh_hz = out.target.mode.refresh_hz,
+            .frames = out.frames.load(.monotonic),
+            .missed_vblanks = out.misses.load(.monotonic),
+            .lead_ms = @as(f32, @floatFromInt(out.lead_ns.load(.monotonic))) / 1_000_000.0,
+        };
+    }
+
+    fn eventMain(self: *MultiOutput) void {
+        var events: [drm.max_events]drm.FlipEvent = undefined;
+        while (self.running.load(.acquire)) {
+            const n = self.device.readFlipEvents(&events, 100) catch |err| {
+                std.log.warn("primetime: reading flip events failed: {s}", .{@errorName(err)});
+                std.Thread.sleep(10 * std.time.ns_per_ms);
+                continue;
+            };
+            for (events[0..n]) |event| {
+                const index = decodeIndex(event.user_data);
+                if (index < self.output_count) self.outputs[index].signalFlip(event.timing);
+            }
+        }
+    }
+
+    fn outputMain(self: *MultiOutput, out: *Output) void {
+        while (self.running.load(.acquire)) {
+            if (out.flip_pending) {
+                out.flip_done.timedWait(100 * std.time.ns_per_ms) catch continue;
+                out.flip_done.reset();
+                if (!self.running.load(.acquire)) break;
+                const previous_present = out.pacer.last_present_ns;
+                if (!out.completeFlip()) continue;
+                if (out.index == self.primary) self.reportFrame(out, previous_present);
+            }
+
+            self.presentNext(out) catch |err| {
+                std.log.warn("primetime: {s} frame failed: {s}", .{ out.target.getName(), @errorName(err) });
+                out.sleepUntil(out.scheduler.nextVblankNs(drm.monotonicNs()));
+            };
+        }
+    }
+
+    /// Hand a completed frame to `config.on_frame`
+    fn reportFrame(self: *MultiOutput, out: *const Output, previous_present: u64) void {
+        const on_frame = self.config.on_frame orelse return;
+        const stats = &out.pending_stats;
+        const interval = if (previous_present > 0) stats.present_ns -| previous_present else stats.cpuTimeNs();
+        on_frame(self.config.frame_context, out, interval, stats);
+    }
+
+    /// Render the latest scene just in time for the next reachable vblank
+    /// and queue its flip
+    fn presentNext(self: *MultiOutput, out: *Output) !void {
+        // Start rendering so that the forecast render time ends at the deadline
+        const deadline = out.scheduler.commitDeadlineNs(drm.monotonicNs());
+        out.sleepUntil(deadline -| out.pacer.forecast.renderTimeNs());
+
+        var stats = frame_pacing.FrameStats{
+            .frame_number = out.pacer.frame_number + 1,
+            .cpu_start_ns = frame_pacing.monotonicRawNs(),
+        };
+        const scene = self.scenes.lock(out.index);
+        const rendered = self.config.render(self.config.context, out, scene);
+        self.scenes.unlock(out.index);
+        stats.cpu_end_ns = frame_pacing.monotonicRawNs();
+
+        const frame = try rendered orelse {
+            out.sleepUntil(out.scheduler.nextVblankNs(drm.monotonicNs()));
+            return;
+        };
+
+        // A long render may have pushed the frame to a later vblank
+        out.sleepUntil(out.scheduler.commitDeadlineNs(drm.monotonicNs()));
+
+        out.sequence +%= 1;
+        _ = try self.device.commitFlip(&out.target, .{
+            .fb_id = frame.fb_id,
+            .in_fence_fd = frame.in_fence_fd,
+            .out_fence = false,
+            .user_data = encodeUserData(out.index, out.sequence),
+        });
+        out.scheduler.onCommit(drm.monotonicNs());
+        stats.gpu_submit_ns = frame_pacing.monotonicRawNs();
+
+        out.pending_stats = stats;
+        out.pending_fb = frame.fb_id;
+        out.flip_pending = true;
+    }
+};
+
+test "user data carries the output index" {
+    const ud = encodeUserData(5, 0xffff_ffff_ffff_ffff);
+    try std.testing.expectEqual(@as(usize, 5), decodeIndex(ud));
+    try std.testing.expectEqual(@as(u64, 0x00ff_ffff_ffff_ffff), ud & 0x00ff_ffff_ffff_ffff);
+}
+
+test "layout filters outputs and caps refresh" {
+    var layout = multimon.Layout.init();
+    var entry = multimon.LayoutEntry{
+        .display_name = [_]u8{0} ** 32,
+        .position = .primary,
+        .x_offset = 0,
+        .y_offset = 0,
+        .width = 2560,
+        .height = 1440,
+        .refresh_hz = 144,
+        .rotation = .normal,
+        .enabled = true,
+    };
+    @memcpy(entry.display_name[0..4], "DP-1");
+    layout.entries[0] = entry;
+    @memcpy(entry.display_name[0..4], "DP-2");
+    entry.enabled = false;
+    layout.entries[1] = entry;
+    layout.entry_count = 2;
+
+    try std.testing.expectEqual(@as(?u32, 144), layoutRefresh(&layout, "DP-1", 240));
+    try std.testing.expectEqual(@as(?u32, 60), layoutRefresh(&layout, "DP-1", 60));
+    try std.testing.expectEqual(@as(?u32, null), layoutRefresh(&layout, "DP-2", 60));
+    try std.testing.expectEqual(@as(?u32, null), layoutRefresh(&layout, "HDMI-A-1", 60));
+}
+
+test "layout rate below the mode skips vblanks" {
+    const target = drm.FlipTarget{
+        .connector_id = 1,
+        .crtc_id = 2,
+        .crtc_index = 0,
+        .plane_id = 3,
+        .mode = .{ .width = 2560, .height = 1440, .refresh_hz = 240, .flags = 0 },
+    };
+    const capped = Output.init(0, target, 144);
+    try std.testing.expectEqual(@as(u64, std.time.ns_per_s / 144), capped.scheduler.target_interval_ns);
+    const full = Output.init(1, target, 240);
+    try std.testing.expectEqual(@as(u64, 0), full.scheduler.target_interval_ns);
+}
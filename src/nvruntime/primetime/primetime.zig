@@ -12,10 +12,17 @@
 //! This is the compositor core that VENOM builds upon.
 
 const std = @import("std");
-const frame_pacing = @import("frame_pacing.zig");
-
-// DRM is optional - only import when building with -Ddrm=true
-// const drm = @import("drm.zig");
+pub const frame_pacing = @import("frame_pacing.zig");
+// DRM calls resolve to stubs unless built with -Ddrm=true
+pub const drm = @import("drm.zig");
+pub const discovery = @import("discovery.zig");
+pub const multi_output = @import("multi_output.zig");
+pub const rcu = @import("rcu.zig");
+pub const foreground = @import("foreground.zig");
+const multimon = @import("../../nvdisplay/multimon.zig");
+const recorder = @import("../../nvmon/recorder.zig");
+const trace = @import("../../nvmon/trace.zig");
+const autotune = @import("../../nvpower/autotune.zig");
 
 pub const version = "0.1.0-dev";
 
@@ -79,6 +86,12 @@ pub const Config = struct {
     grab_keyboard: bool = true,
     /// Grab mouse exclusively
     grab_mouse: bool = true,
+    /// Drive the display directly with atomic KMS page flips (needs DRM master)
+    atomic_kms: bool = false,
+    /// DRM card to open (null = pick via gpu_uuid or discovery)
+    drm_device: ?[]const u8 = null,
+    /// Drive the card of this GPU (NVML UUID, e.g. "GPU-8c5b..."); needs the nvcaps registry
+    gpu_uuid: ?[]const u8 = null,
 };
 
 /// Output/display information
@@ -125,6 +138,8 @@ pub const PerfStats = struct {
     vrr_hz: u32 = 0,
     /// Frame number
     frame_count: u64 = 0,
+    /// The game's buffer is going straight to the primary plane (no composition)
+    scanout_bypass: bool = false,
 };
 
 /// Game capture mode for streaming/recording
@@ -134,6 +149,17 @@ pub const CaptureMode = enum {
     copy, // Fallback copy-based capture
 };
 
+/// pidfd for a child, or null when the kernel lacks pidfd_open
+fn openPidfd(pid: std.posix.pid_t) ?std.posix.fd_t {
+    const rc = std.os.linux.pidfd_open(pid, 0);
+    if (std.os.linux.E.init(rc) != .SUCCESS) return null;
+    return @intCast(rc);
+}
+
+/// Backoff bounds for reopening the display after a hotplug
+const reopen_min_delay_ms: u32 = 100;
+const reopen_max_delay_ms: u32 = 5000;
+
 /// The compositor instance
 pub const Compositor = struct {
     allocator: std.mem.Allocator,
@@ -152,6 +178,28 @@ pub const Compositor = struct {
 
     // Running game PID
     game_pid: ?std.posix.pid_t = null,
+    // pidfd of the game; readable once it exits, zombie or not
+    game_pidfd: ?std.posix.fd_t = null,
+    // Foreground signal for background work in other processes
+    foreground: ?foreground.Publisher = null,
+
+    // Atomic KMS output, when config.atomic_kms is set
+    display: ?drm.AtomicOutput = null,
+    // Connector hotplug uevents for the atomic output
+    hotplug: ?drm.HotplugMonitor = null,
+    // Failed reopen after a hotplug: next attempt (monotonic ns) and backoff
+    reopen_at_ns: ?u64 = null,
+    reopen_delay_ms: u32 = reopen_min_delay_ms,
+    // Every lit output paced and flipped on its own thread, instead of `display`
+    outputs: ?*multi_output.MultiOutput = null,
+    // Set from `startOutputs` to `stop`, so a card that comes back after a
+    // hotplug is driven the same way again
+    outputs_config: ?multi_output.Config = null,
+
+    // Overlay surfaces above the game (e.g. nvhud); any overlay forces composition
+    overlay_count: u32 = 0,
+    // Last frame was a client buffer scanned out directly
+    scanout_bypass: bool = false,
 
     /// Initialize the compositor
     pub fn init(allocator: std.mem.Allocator, config: Config) !*Compositor {
@@ -195,10 +243,265 @@ pub const Compositor = struct {
         // 6. Set up XDG shell
         // 7. Start backend
 
-        // For now, mark as running (stub)
+        if (self.config.atomic_kms) {
+            self.openDisplay() catch |err| {
+                self.state = .error_state;
+                return err;
+            };
+            if (self.config.output_name) |name| {
+                const len = @min(name.len, self.current_output.name.len);
+                @memcpy(self.current_output.name[0..len], name[0..len]);
+                self.current_output.name_len = len;
+            }
+            self.hotplug = drm.HotplugMonitor.open() catch null;
+        }
+
+        self.foreground = foreground.Publisher.create(foreground.default_path) catch |err| blk: {
+            std.log.warn("primetime: foreground signal unavailable: {}", .{err});
+            break :blk null;
+        };
+
         self.state = .running;
     }
 
+    /// Flip `fb_id` to the display just before the next reachable vblank.
+    /// `in_fence_fd` is the render-done fence; returns the scanout fence.
+    /// Waits for the previous flip to complete first.
+    pub fn presentFrame(self: *Compositor, fb_id: u32, in_fence_fd: ?std.posix.fd_t) !?std.posix.fd_t {
+        const display = if (self.display) |*d| d else return error.NoDisplay;
+        while (display.flip_pending) try self.dispatchDisplayEvents(-1);
+        const out_fence = try display.present(fb_id, in_fence_fd);
+        self.scanout_bypass = false;
+        return out_fence;
+    }
+
+    /// Try to put the sole fullscreen client buffer straight on the primary
+    /// plane, skipping composition. Returns false when the frame must be
+    /// composited instead (overlays visible, size or format mismatch, or the
+    /// kernel refused the buffer); the caller then composites and calls
+    /// `presentFrame`.
+    pub fn presentClientBuffer(self: *Compositor, buf: drm.DmaBuf, in_fence_fd: ?std.posix.fd_t) !bool {
+        const display = if (self.display) |*d| d else return false;
+        if (self.overlay_count > 0 or self.config.show_overlay) return false;
+        if (self.config.upscaler != .none or !display.canScanOut(buf)) return false;
+
+        const fb_id = try display.clientFramebuffer(buf) orelse return false;
+        while (display.flip_pending) try self.dispatchDisplayEvents(-1);
+        if (try display.present(fb_id, in_fence_fd)) |out_fence| {
+            // The client's buffer release is tied to the flip event, not the fence
+            std.posix.close(out_fence);
+        }
+        self.scanout_bypass = true;
+        return true;
+    }
+
+    /// Update the number of overlay surfaces shown above the game.
+    /// Direct scanout resumes once the last one is gone.
+    pub fn setOverlayCount(self: *Compositor, count: u32) void {
+        self.overlay_count = count;
+    }
+
+    /// Record a finished frame's timing with the pacer and, when running, the
+    /// flight recorder and the auto-tuner (lock-free, never blocks).
+    pub fn recordFrame(self: *Compositor, stats: *const frame_pacing.FrameStats) void {
+        const previous_present = self.pacer.last_present_ns;
+        const interval = if (stats.present_ns > 0 and previous_present > 0)
+            stats.present_ns -| previous_present
+        else
+            stats.cpuTimeNs();
+        self.pacer.recordFrame(stats);
+        self.reportFrame(interval, stats);
+    }
+
+    /// Frame hook of the output threads when driving several outputs
+    fn outputFrame(context: ?*anyopaque, _: *const multi_output.Output, interval_ns: u64, stats: *const frame_pacing.FrameStats) void {
+        const self: *Compositor = @ptrCast(@alignCast(context.?));
+        self.reportFrame(interval_ns, stats);
+    }
+
+    /// Feed a presented frame to the foreground signal, the flight recorder,
+    /// the auto-tuner and the trace. Lock-free, so safe from output threads.
+    fn reportFrame(self: *const Compositor, interval: u64, stats: *const frame_pacing.FrameStats) void {
+        const now = frame_pacing.monotonicRawNs();
+        last_frame_ns.store(now, .monotonic);
+        if (self.foreground) |*fg| fg.recordFrame(now);
+        recorder.recordFrame(interval, stats.totalLatencyNs());
+        autotune.recordFrame();
+
+        // Trace frame IDs are shared with Reflex, so take one rather than
+        // reusing the pacer's frame number
+        const frame = trace.beginFrame();
+        trace.complete(.primetime, "cpu", frame, stats.cpu_start_ns, stats.cpu_end_ns);
+        trace.complete(.primetime, "gpu", frame, stats.gpu_submit_ns, stats.gpu_complete_ns);
+        if (stats.present_ns > 0) trace.instantAt(.primetime, "present", frame, stats.present_ns);
+    }
+
+    /// Handle flip-completion events from the DRM fd; call from the event
+    /// loop when the fd is readable, or with a timeout to wait for one.
+    pub fn dispatchDisplayEvents(self: *Compositor, timeout_ms: i32) !void {
+        const display = if (self.display) |*d| d else return;
+        const timing = try display.dispatchEvents(timeout_ms) orelse return;
+
+        // Flip timestamps are CLOCK_MONOTONIC; the pacer runs on MONOTONIC_RAW
+        const age = drm.monotonicNs() -| timing.timestamp_ns;
+        const present_ns = frame_pacing.monotonicRawNs() -| age;
+        self.pacer.recordPresent(present_ns);
+        trace.instantAt(.primetime, "flip", trace.currentFrame(), present_ns);
+    }
+
+    /// React to pending hotplug uevents; call when `hotplugFd` is readable
+    /// or `hotplugTimeoutMs` has elapsed. Connector changes re-resolve the
+    /// output (or every output from `startOutputs`), a removed card drops
+    /// it, and the display is reopened once a matching card and output come
+    /// back.
+    pub fn handleHotplug(self: *Compositor) void {
+        const monitor = if (self.hotplug) |*m| m else return;
+        const changes = monitor.poll();
+        if (self.display == null and self.outputs == null) {
+            if (self.reopen_at_ns) |due| {
+                if (drm.monotonicNs() >= due) self.reopenDisplay();
+            }
+        }
+        if (!changes.any()) return;
+
+        if (self.outputs) |outputs| {
+            if (changes.cards_removed and discovery.enumerate().findByName(outputs.device.getNodeName()) == null) {
+                outputs.close();
+                self.outputs = null;
+                self.current_output.connected = false;
+                return;
+            }
+            outputs.rescan() catch |err| {
+                std.log.warn("primetime: re-resolving outputs failed: {}", .{err});
+                self.current_output.connected = false;
+                return;
+            };
+            self.current_output.connected = true;
+        } else if (self.display) |*display| {
+            if (changes.cards_removed and discovery.enumerate().findByName(display.device.getNodeName()) == null) {
+                display.close();
+                self.display = null;
+                self.scanout_bypass = false;
+                self.current_output.connected = false;
+                return;
+            }
+            display.refreshOutput(self.config.output_name) catch {
+                self.current_output.connected = false;
+                return;
+            };
+            self.applyDisplayOutput();
+        } else {
+            self.reopenDisplay();
+        }
+    }
+
+    /// Poll timeout for the hotplug fd: time until the next reopen attempt,
+    /// or -1 when none is scheduled
+    pub fn hotplugTimeoutMs(self: *const Compositor) i32 {
+        const due = self.reopen_at_ns orelse return -1;
+        const left_ms = (due -| drm.monotonicNs()) / std.time.ns_per_ms;
+        return @intCast(@min(left_ms, std.math.maxInt(i32)));
+    }
+
+    /// Open the display after a hotplug. Card-add uevents arrive before udev
+    /// has set up the node, so a failure is retried with exponential backoff.
+    fn reopenDisplay(self: *Compositor) void {
+        const opened = if (self.outputs_config) |config| self.openOutputs(null, config) else self.openDisplay();
+        if (opened) {
+            self.reopen_at_ns = null;
+            self.reopen_delay_ms = reopen_min_delay_ms;
+        } else |err| {
+            std.log.warn("primetime: reopening display failed: {}, retrying in {d} ms", .{ err, self.reopen_delay_ms });
+            self.reopen_at_ns = drm.monotonicNs() + @as(u64, self.reopen_delay_ms) * std.time.ns_per_ms;
+            self.reopen_delay_ms = @min(self.reopen_delay_ms * 2, reopen_max_delay_ms);
+        }
+    }
+
+    /// Drive every lit output of the card (filtered by `layout`) on its own
+    /// render/commit thread. Replaces the single atomic output; frames come
+    /// from `render`, called on the output threads with the latest scene.
+    /// Call after `start`; `stop` shuts the threads down. `layout` must stay
+    /// valid until then.
+    pub fn startOutputs(self: *Compositor, layout: ?*const multimon.Layout, render: multi_output.RenderFn, context: ?*anyopaque) !void {
+        if (self.state != .running) return error.NotRunning;
+        if (self.outputs != null) return error.AlreadyStarted;
+
+        const config = multi_output.Config{
+            .layout = layout,
+            .render = render,
+            .context = context,
+            .on_frame = outputFrame,
+            .frame_context = self,
+        };
+        // One DRM master per card: the output threads take over the
+        // display's fd, which is only closed once they run
+        try self.openOutputs(if (self.display) |*d| &d.device else null, config);
+        self.outputs_config = config;
+        if (self.display) |*display| {
+            display.close();
+            self.display = null;
+            self.scanout_bypass = false;
+        }
+    }
+
+    /// Open and start the output threads, on a handle of `device` when given
+    fn openOutputs(self: *Compositor, device: ?*const drm.Device, config: multi_output.Config) !void {
+        const outputs = if (device) |d| blk: {
+            var dup = try d.dupe();
+            errdefer dup.close();
+            break :blk try multi_output.MultiOutput.adopt(self.allocator, dup, config);
+        } else try multi_output.MultiOutput.open(self.allocator, self.config.drm_device, self.config.gpu_uuid, config);
+        errdefer outputs.close();
+        try outputs.start();
+        self.outputs = outputs;
+        self.current_output.connected = true;
+    }
+
+    /// Hand a new scene to every output thread; never waits on a frame
+    pub fn publishScene(self: *Compositor, scene: multi_output.Scene) !void {
+        const outputs = self.outputs orelse return error.NoDisplay;
+        var next = scene;
+        next.overlay_count = @max(scene.overlay_count, self.overlay_count);
+        try outputs.publishScene(next);
+    }
+
+    /// Per-output frame and vblank stats when driving several outputs
+    pub fn getOutputStats(self: *const Compositor, index: usize) ?multi_output.OutputStats {
+        const outputs = self.outputs orelse return null;
+        return outputs.stats(index);
+    }
+
+    fn openDisplay(self: *Compositor) !void {
+        self.display = try drm.AtomicOutput.open(self.config.drm_device, self.config.gpu_uuid, self.config.output_name);
+        self.applyDisplayOutput();
+    }
+
+    /// Uevent socket to poll for hotplugs, if the atomic backend is active
+    pub fn hotplugFd(self: *const Compositor) ?std.posix.fd_t {
+        const monitor = self.hotplug orelse return null;
+        return monitor.fd;
+    }
+
+    /// Mirror the atomic output's mode into current_output and apply VRR
+    fn applyDisplayOutput(self: *Compositor) void {
+        const display = if (self.display) |*d| d else return;
+        const mode = display.target.mode;
+        self.current_output.width = mode.width;
+        self.current_output.height = mode.height;
+        self.current_output.refresh_hz = mode.refresh_hz;
+        self.current_output.connected = true;
+        self.current_output.vrr_capable = display.device.supportsVrr(display.target.connector_id);
+        if (self.current_output.vrr_capable) {
+            display.device.setVrr(display.target.connector_id, self.config.vrr) catch {};
+        }
+    }
+
+    /// DRM fd to poll for display events, if the atomic backend is active
+    pub fn displayFd(self: *const Compositor) ?std.posix.fd_t {
+        const display = self.display orelse return null;
+        return display.device.fd;
+    }
+
     /// Stop the compositor
     pub fn stop(self: *Compositor) !void {
         if (self.state != .running) return;
@@ -206,7 +509,28 @@ pub const Compositor = struct {
         // Kill running game if any
         if (self.game_pid) |pid| {
             std.posix.kill(pid, std.posix.SIG.TERM) catch {};
-            self.game_pid = null;
+            self.clearGame();
+        }
+
+        if (self.hotplug) |*monitor| {
+            monitor.close();
+            self.hotplug = null;
+        }
+        self.reopen_at_ns = null;
+        self.reopen_delay_ms = reopen_min_delay_ms;
+        if (self.display) |*display| {
+            display.close();
+            self.display = null;
+        }
+        if (self.outputs) |outputs| {
+            outputs.close();
+            self.outputs = null;
+        }
+        self.outputs_config = null;
+        self.scanout_bypass = false;
+        if (self.foreground) |*fg| {
+            fg.close();
+            self.foreground = null;
         }
 
         self.state = .stopped;
@@ -241,6 +565,9 @@ pub const Compositor = struct {
 
         try child.spawn();
         self.game_pid = child.id;
+        self.game_pidfd = openPidfd(child.id);
+        game_running.store(true, .release);
+        if (self.foreground) |*fg| fg.setGameRunning(true);
     }
 
     /// Get current state
@@ -269,13 +596,17 @@ pub const Compositor = struct {
             .one_percent_low_fps = self.pacer.getOnePercentLowFps(),
             .vrr_hz = self.pacer.getOptimalVrrHz(),
             .frame_count = self.pacer.frame_number,
+            .scanout_bypass = self.scanout_bypass,
         };
     }
 
     /// Set VRR enabled
     pub fn setVrr(self: *Compositor, enabled: bool) void {
         self.config.vrr = enabled;
-        // TODO: When DRM backend is enabled (-Ddrm=true), set VRR on hardware
+        if (self.display) |*display| {
+            // Cached property ID: a single ioctl, cheap enough to toggle per game
+            display.device.setVrr(display.target.connector_id, enabled) catch {};
+        }
     }
 
     /// Set frame limit
@@ -294,8 +625,13 @@ pub const Compositor = struct {
 
     /// Check if game is still running
     pub fn isGameRunning(self: *const Compositor) bool {
+        if (self.game_pidfd) |fd| {
+            var fds = [_]std.posix.pollfd{.{ .fd = fd, .events = std.posix.POLL.IN, .revents = 0 }};
+            const ready = std.posix.poll(&fds, 0) catch return true;
+            return ready == 0;
+        }
         if (self.game_pid) |pid| {
-            // Check if process exists
+            // No pidfd (pre-5.3 kernel): an unreaped zombie still counts as running
             const result = std.posix.kill(pid, 0);
             return result != error.NoSuchProcess;
         }
@@ -306,11 +642,19 @@ pub const Compositor = struct {
     pub fn waitForGame(self: *Compositor) !u32 {
         if (self.game_pid) |pid| {
             const result = std.posix.waitpid(pid, 0);
-            self.game_pid = null;
+            self.clearGame();
             return result.status;
         }
         return 0;
     }
+
+    fn clearGame(self: *Compositor) void {
+        if (self.game_pidfd) |fd| std.posix.close(fd);
+        self.game_pidfd = null;
+        self.game_pid = null;
+        game_running.store(false, .release);
+        if (self.foreground) |*fg| fg.setGameRunning(false);
+    }
 };
 
 // ============================================================================
@@ -319,6 +663,23 @@ pub const Compositor = struct {
 
 var global_compositor: ?*Compositor = null;
 
+// Foreground signal for background work in this process
+var game_running = std.atomic.Value(bool).init(false);
+var last_frame_ns = std.atomic.Value(u64).init(0);
+
+/// Frames younger than this count as a game in the foreground
+const foreground_window_ns = std.time.ns_per_s;
+
+/// Whether a game is running under a compositor, in this process or
+/// another one, or its frames are still arriving. Background jobs poll it
+/// to get out of the way; a few syscalls when no compositor runs here.
+pub fn gameInForeground() bool {
+    if (game_running.load(.acquire)) return true;
+    const last = last_frame_ns.load(.monotonic);
+    if (last != 0 and frame_pacing.monotonicRawNs() -| last < foreground_window_ns) return true;
+    return foreground.isActive(foreground.default_path, foreground_window_ns);
+}
+
 /// Get global compositor state
 pub fn getState() CompositorState {
     if (global_compositor) |comp| {
@@ -407,3 +768,9 @@ test "upscaler descriptions" {
 test "compositor state" {
     try std.testing.expectEqual(CompositorState.uninitialized, getState());
 }
+
+test {
+    _ = rcu;
+    _ = foreground;
+    _ = multi_output;
+}
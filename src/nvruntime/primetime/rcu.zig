@@ -0,0 +1,162 @@
+//! RCU-style snapshots for PrimeTime
+//!
+//! One writer publishes immutable versions of a value; any number of
+//! reader threads read the latest version without locks or shared atomic
+//! counters. Every reader owns a slot in its own cache line and stamps the
+//! current epoch into it while reading. A replaced version is freed once
+//! every reader has either left its read section or entered after the
+//! replacement. The writer never waits for readers.
+
+const std = @import("std");
+
+pub fn Rcu(comptime T: type) type {
+    return struct {
+        const Self = @This();
+
+        pub const max_readers = 16;
+
+        const Node = struct {
+            value: T,
+            /// Epoch the node was replaced in
+            retired_at: u64 = 0,
+        };
+
+        /// Epoch a reader entered with; 0 when not reading
+        const Slot = struct {
+            epoch: std.atomic.Value(u64) align(std.atomic.cache_line) = std.atomic.Value(u64).init(0),
+        };
+
+        allocator: std.mem.Allocator,
+        current: std.atomic.Value(*Node),
+        epoch: std.atomic.Value(u64) = std.atomic.Value(u64).init(1),
+        slots: [max_readers]Slot = [_]Slot{.{}} ** max_readers,
+
+        // Writer side
+        write_mutex: std.Thread.Mutex = .{},
+        retired: std.ArrayList(*Node) = .empty,
+
+        pub fn init(allocator: std.mem.Allocator, initial: T) !Self {
+            const node = try allocator.create(Node);
+            node.* = .{ .value = initial };
+            return .{ .allocator = allocator, .current = std.atomic.Value(*Node).init(node) };
+        }
+
+        /// Free every version. No reader may be inside a read section.
+        pub fn deinit(self: *Self) void {
+            for (self.retired.items) |node| self.allocator.destroy(node);
+            self.retired.deinit(self.allocator);
+            self.allocator.destroy(self.current.load(.acquire));
+        }
+
+        /// Enter a read section on slot `reader` (one slot per thread) and
+        /// return the latest version. Valid until `unlock`.
+        pub fn lock(self: *Self, reader: usize) *const T {
+            // Stamp the epoch before loading the pointer: a writer that misses
+            // the stamp swapped before this load, so the old node is not seen
+            self.slots[reader].epoch.store(self.epoch.load(.seq_cst), .seq_cst);
+            return &self.current.load(.seq_cst).value;
+        }
+
+        pub fn unlock(self: *Self, reader: usize) void {
+            self.slots[reader].epoch.store(0, .release);
+        }
+
+        /// Copy of the latest version, for read-modify-publish on the writer
+        pub fn latest(self: *Self) T {
+            self.write_mutex.lock();
+            defer self.write_mutex.unlock();
+            return self.current.load(.acquire).value;
+        }
+
+        /// Make `value` the latest version. Replaced versions are freed as
+        /// soon as no reader can still hold them.
+        pub fn publish(self: *Self, value: T) !void {
+            const node = try self.allocator.create(Node);
+            node.* = .{ .value = value };
+
+            self.write_mutex.lock();
+            defer self.write_mutex.unlock();
+            self.retired.ensureUnusedCapacity(self.allocator, 1) catch |err| {
+                self.allocator.destroy(node);
+                return err;
+            };
+
+            const old = self.current.swap(node, .seq_cst);
+            old.retired_at = self.epoch.fetchAdd(1, .seq_cst) + 1;
+            self.retired.appendAssumeCapacity(old);
+            self.reclaim();
+        }
+
+        /// Versions waiting for readers to move on
+        pub fn pendingCount(self: *Self) usize {
+            self.write_mutex.lock();
+            defer self.write_mutex.unlock();
+            return self.retired.items.len;
+        }
+
+        fn reclaim(self: *Self) void {
+            var oldest: u64 = std.math.maxInt(u64);
+            for (&self.slots) |*slot| {
+                const epoch = slot.epoch.load(.seq_cst);
+                if (epoch != 0) oldest = @min(oldest, epoch);
+            }
+
+            // Readers that entered at or after `retired_at` see a newer node
+            var i: usize = 0;
+            while (i < self.retired.items.len) {
+                const node = self.retired.items[i];
+                if (node.retired_at <= oldest) {
+                    self.allocator.destroy(node);
+                    _ = self.retired.swapRemove(i);
+                } else i += 1;
+            }
+        }
+    };
+}
+
+test "readers keep their version until unlock" {
+    var rcu = try Rcu(u32).init(std.testing.allocator, 1);
+    defer rcu.deinit();
+
+    const seen = rcu.lock(0);
+    try rcu.publish(2);
+    try std.testing.expectEqual(@as(u32, 1), seen.*);
+    try std.testing.expectEqual(@as(usize, 1), rcu.pendingCount());
+
+    // A reader entering now gets the new version
+    try std.testing.expectEqual(@as(u32, 2), rcu.lock(1).*);
+    rcu.unlock(1);
+
+    rcu.unlock(0);
+    try rcu.publish(3);
+    try std.testing.expectEqual(@as(usize, 0), rcu.pendingCount());
+    try std.testing.expectEqual(@as(u32, 3), rcu.latest());
+}
+
+test "concurrent readers see consistent versions" {
+    const Pair = struct { a: u64, b: u64 };
+    const R = Rcu(Pair);
+    var rcu = try R.init(std.testing.allocator, .{ .a = 0, .b = 0 });
+    defer rcu.deinit();
+
+    var stop = std.atomic.Value(bool).init(false);
+    var torn = std.atomic.Value(u32).init(0);
+    const Reader = struct {
+        fn run(r: *R, slot: usize, done: *std.atomic.Value(bool), bad: *std.atomic.Value(u32)) void {
+            while (!done.load(.acquire)) {
+                const pair = r.lock(slot);
+                if (pair.a != pair.b) _ = bad.fetchAdd(1, .monotonic);
+                r.unlock(slot);
+            }
+        }
+    };
+
+    var threads: [3]std.Thread = undefined;
+    for (&threads, 0..) |*t, i| t.* = try std.Thread.spawn(.{}, Reader.run, .{ &rcu, i, &stop, &torn });
+    for (1..2000) |i| try rcu.publish(.{ .a = i, .b = i });
+    stop.store(true, .release);
+    for (threads) |t| t.join();
+
+    try std.testing.expectEqual(@as(u32, 0), torn.load(.monotonic));
+    try std.testing.expectEqual(@as(u64, 1999), rcu.latest().a);
+}
@@ -22,6 +22,9 @@ pub const nvcore = @import("nvcore/nvcore.zig");
 pub const nvpower = @import("nvpower/nvpower.zig");
 pub const nvdisplay = @import("nvdisplay/nvdisplay.zig");
 
+// Telemetry
+pub const nvmon = @import("nvmon/nvmon.zig");
+
 // Runtime subsystems (gaming stack)
 pub const nvruntime = struct {
     /// NVIDIA Vulkan extensions (re-exports nvvk)
@@ -69,9 +72,9 @@ pub const deps = struct {
 // Version info
 pub const version = struct {
     pub const major = 0;
-    pub const minor = 1;
+    pub const minor = 2;
     pub const patch = 0;
-    pub const string = "0.1.0-dev";
+    pub const string = "0.2.0-dev";
 };
 
 /// Initialize all NVPrime subsystems
@@ -82,6 +85,7 @@ pub fn init() !void {
 
 /// Deinitialize all NVPrime subsystems
 pub fn deinit() void {
+    nvmon.sampler.stop();
     nvcaps.deinit();
     nvml.shutdown();
 }